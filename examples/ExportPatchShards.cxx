@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "itkOpenSlideImageIO.h"
+#include "itksys/SystemTools.hxx"
+#include "itk_jpeg.h"
+
+void
+Usage(const char * cArg0)
+{
+  std::cerr << "Usage: " << cArg0 << " slideListFile outputDirectory level patchSize stride [options]" << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Tiles each slide of slideListFile (one path per line) at the given level with patchSize x patchSize"
+            << std::endl;
+  std::cerr << "patches every stride pixels, drops patches with too little tissue and writes the others to tar shards"
+            << std::endl;
+  std::cerr << "outputDirectory/shard-000000.tar, ... Each patch is stored as <key>.jpg (or <key>.rgb) with its slide"
+            << std::endl;
+  std::cerr << "and coordinates in <key>.json, the layout WebDataset reads." << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Options:" << std::endl;
+  std::cerr << "  tissue=fraction   Minimum tissue fraction of a patch (default 0.5, 0 keeps all patches)" << std::endl;
+  std::cerr << "  saturation=value  Minimum saturation of a tissue pixel in the mask (default 20)" << std::endl;
+  std::cerr << "  maskSize=pixels   Maximum size of the low resolution tissue mask (default 1024)" << std::endl;
+  std::cerr << "  shard=count       Patches per shard (default 1000)" << std::endl;
+  std::cerr << "  format=jpg|raw    JPEG or raw interleaved RGB patches (default jpg)" << std::endl;
+  std::cerr << "  quality=value     JPEG quality (default 90)" << std::endl;
+  std::cerr << "  threads=count     Number of threads decoding and encoding patches (default all cores)" << std::endl;
+  exit(1);
+}
+
+
+struct ExportOptions
+{
+  int           level = 0;
+  unsigned long patchSize = 0;
+  unsigned long stride = 0;
+  double        minimumTissueFraction = 0.5;
+  unsigned int  saturationThreshold = 20;
+  unsigned long maskSize = 1024;
+  size_t        patchesPerShard = 1000;
+  bool          encodeJpeg = true;
+  int           quality = 90;
+  unsigned int  numberOfThreads = 1;
+};
+
+
+// Appends records to sequentially numbered tar files. Write() may be called concurrently.
+class ShardWriter
+{
+public:
+  ShardWriter(const std::string & directory, size_t patchesPerShard)
+    : m_Directory(directory)
+    , m_PatchesPerShard(std::max<size_t>(1, patchesPerShard))
+  {}
+
+  ~ShardWriter() { Close(); }
+
+  // Writes the patch and its JSON metadata as <key>.<extension> and <key>.json into the current shard
+  bool
+  Write(const std::string & key, const char * extension, const std::vector<unsigned char> & data,
+        const std::string & json);
+
+  // Finishes the last shard
+  bool
+  Close();
+
+  size_t
+  GetNumberOfShards() const
+  {
+    return m_NumberOfShards;
+  }
+
+  size_t
+  GetNumberOfPatches() const
+  {
+    return m_NumberOfPatches;
+  }
+
+private:
+  std::string   m_Directory;
+  size_t        m_PatchesPerShard;
+  std::mutex    m_Mutex;
+  std::ofstream m_Stream;
+  size_t        m_PatchesInShard = 0;
+  size_t        m_NumberOfShards = 0;
+  size_t        m_NumberOfPatches = 0;
+
+  // Writes a tar header and the data padded to 512 bytes (m_Mutex must be locked)
+  bool
+  WriteEntry(const std::string & name, const void * data, size_t size);
+
+  // Ends and closes the current shard (m_Mutex must be locked)
+  bool
+  FinishShard();
+};
+
+
+// Tiles one slide after another, with all threads reading and encoding the patches of the current slide
+class PatchExporter
+{
+public:
+  using ReaderIOType = itk::OpenSlideImageIO;
+
+  PatchExporter(const ExportOptions & options, ShardWriter & writer)
+    : m_Options(options)
+    , m_Writer(writer)
+  {}
+
+  // Returns false if the slide could not be opened or a patch could not be read
+  bool
+  ExportSlide(size_t slideIndex, const std::string & slidePath);
+
+private:
+  struct Patch
+  {
+    long long x;
+    long long y;
+    double    tissueFraction;
+  };
+
+  const ExportOptions & m_Options;
+  ShardWriter &         m_Writer;
+
+  ReaderIOType::Pointer m_ReaderIO;
+  size_t                m_SlideIndex = 0;
+  std::string           m_SlidePath;
+  double                m_Downsample = 1.0;
+  std::vector<Patch>    m_Patches;
+  std::atomic<size_t>   m_NextPatch{ 0 };
+  std::atomic<bool>     m_Failed{ false };
+  std::mutex            m_ErrorMutex;
+
+  // Finds the patches with enough tissue in a thumbnail of the slide
+  void
+  SelectPatches(unsigned long width, unsigned long height);
+
+  void
+  Worker();
+
+  static bool
+  EncodeJpeg(const std::vector<unsigned char> & rgb, unsigned long width, unsigned long height, int quality,
+             std::vector<unsigned char> & jpeg);
+};
+
+
+int
+main(int argc, char ** argv)
+{
+  const char * const cArg0 = argv[0];
+  if (argc < 6)
+  {
+    Usage(cArg0);
+    return EXIT_FAILURE;
+  }
+
+  ExportOptions options;
+  options.level = atoi(argv[3]);
+  options.patchSize = strtoul(argv[4], NULL, 10);
+  options.stride = strtoul(argv[5], NULL, 10);
+  options.numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 6; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const size_t      equal = arg.find('=');
+    const std::string key = arg.substr(0, equal);
+    const char *      value = equal != std::string::npos ? argv[i] + equal + 1 : "";
+
+    if (key == "tissue")
+      options.minimumTissueFraction = atof(value);
+    else if (key == "saturation")
+      options.saturationThreshold = (unsigned int)atoi(value);
+    else if (key == "maskSize")
+      options.maskSize = strtoul(value, NULL, 10);
+    else if (key == "shard")
+      options.patchesPerShard = strtoul(value, NULL, 10);
+    else if (key == "format" && (std::string(value) == "jpg" || std::string(value) == "raw"))
+      options.encodeJpeg = std::string(value) == "jpg";
+    else if (key == "quality")
+      options.quality = std::min(100, std::max(1, atoi(value)));
+    else if (key == "threads")
+      options.numberOfThreads = std::max(1, atoi(value));
+    else
+    {
+      std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+      Usage(cArg0);
+    }
+  }
+
+  if (options.level < 0 || options.patchSize == 0 || options.stride == 0 || options.maskSize == 0)
+  {
+    Usage(cArg0);
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream listStream(argv[1]);
+  if (!listStream)
+  {
+    std::cerr << "Error: Could not open slide list '" << argv[1] << "'." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> slides;
+  std::string              line;
+  while (std::getline(listStream, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.resize(line.size() - 1);
+    }
+
+    if (!line.empty())
+    {
+      slides.push_back(line);
+    }
+  }
+
+  if (!itksys::SystemTools::MakeDirectory(argv[2]))
+  {
+    std::cerr << "Error: Could not create output directory '" << argv[2] << "'." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  ShardWriter   writer(argv[2], options.patchesPerShard);
+  PatchExporter exporter(options, writer);
+  size_t        numberOfFailedSlides = 0;
+
+  for (size_t i = 0; i < slides.size(); ++i)
+  {
+    if (!exporter.ExportSlide(i, slides[i]))
+    {
+      ++numberOfFailedSlides;
+    }
+  }
+
+  if (!writer.Close())
+  {
+    return EXIT_FAILURE;
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Wrote " << writer.GetNumberOfPatches() << " patches of " << slides.size() << " slides into "
+            << writer.GetNumberOfShards() << " shards in " << seconds << " s ("
+            << (seconds > 0.0 ? writer.GetNumberOfPatches() / seconds : 0.0) << " patches/s)." << std::endl;
+
+  return numberOfFailedSlides == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+bool
+PatchExporter ::ExportSlide(size_t slideIndex, const std::string & slidePath)
+{
+  m_SlideIndex = slideIndex;
+  m_SlidePath = slidePath;
+  m_Patches.clear();
+  m_NextPatch = 0;
+  m_Failed = false;
+
+  // The ImageIO converts to interleaved RGB while reading and ReadRegion() may be called concurrently
+  m_ReaderIO = ReaderIOType::New();
+  m_ReaderIO->SetFileName(slidePath);
+  m_ReaderIO->SetOutputLayout(ReaderIOType::OutputLayoutEnum::RGB);
+
+  ReaderIOType::SizeValueType width = 0, height = 0;
+
+  try
+  {
+    m_ReaderIO->ReadImageInformation();
+
+    if (!m_ReaderIO->GetLevelDimensions(m_Options.level, width, height))
+    {
+      std::cerr << "Error: Slide '" << slidePath << "' has no level " << m_Options.level << '.' << std::endl;
+      return false;
+    }
+
+    m_Downsample = m_ReaderIO->GetLevelDownsample(m_Options.level);
+
+    this->SelectPatches(width, height);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: Could not open slide '" << slidePath << "': " << e.GetDescription() << std::endl;
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < m_Options.numberOfThreads; ++i)
+  {
+    threads.push_back(std::thread(&PatchExporter::Worker, this));
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Exported " << m_Patches.size() << " patches of '" << slidePath << "' in " << seconds << " s."
+            << std::endl;
+
+  m_ReaderIO = nullptr; // Close the slide
+
+  return !m_Failed;
+}
+
+
+void
+PatchExporter ::SelectPatches(unsigned long width, unsigned long height)
+{
+  if (width < m_Options.patchSize || height < m_Options.patchSize)
+  {
+    return;
+  }
+
+  ReaderIOType::TissueMask mask = ReaderIOType::TissueMask();
+
+  if (m_Options.minimumTissueFraction > 0.0)
+  {
+    m_ReaderIO->ReadTissueMask(m_Options.maskSize, m_Options.maskSize, m_Options.saturationThreshold, mask);
+  }
+
+  for (unsigned long y = 0; y + m_Options.patchSize <= height; y += m_Options.stride)
+  {
+    for (unsigned long x = 0; x + m_Options.patchSize <= width; x += m_Options.stride)
+    {
+      Patch patch = { (long long)x, (long long)y, 1.0 };
+
+      if (m_Options.minimumTissueFraction > 0.0)
+      {
+        patch.tissueFraction =
+          mask.ComputeTissueFraction(width, height, x, y, m_Options.patchSize, m_Options.patchSize);
+
+        if (patch.tissueFraction < m_Options.minimumTissueFraction)
+        {
+          continue;
+        }
+      }
+
+      m_Patches.push_back(patch);
+    }
+  }
+}
+
+
+void
+PatchExporter ::Worker()
+{
+  const unsigned long        patchSize = m_Options.patchSize;
+  std::vector<unsigned char> rgb(3 * patchSize * patchSize);
+  std::vector<unsigned char> jpeg;
+
+  itk::ImageIORegion region(2);
+  region.SetSize(0, patchSize);
+  region.SetSize(1, patchSize);
+
+  for (size_t i = m_NextPatch++; i < m_Patches.size() && !m_Failed; i = m_NextPatch++)
+  {
+    const Patch & patch = m_Patches[i];
+
+    region.SetIndex(0, patch.x);
+    region.SetIndex(1, patch.y);
+
+    try
+    {
+      m_ReaderIO->ReadRegion(m_Options.level, region, rgb.data());
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::lock_guard<std::mutex> lock(m_ErrorMutex);
+      std::cerr << "Error: Could not read patch of '" << m_SlidePath << "': " << e.GetDescription() << std::endl;
+      m_Failed = true;
+      return;
+    }
+
+    if (m_Options.encodeJpeg && !EncodeJpeg(rgb, patchSize, patchSize, m_Options.quality, jpeg))
+    {
+      std::lock_guard<std::mutex> lock(m_ErrorMutex);
+      std::cerr << "Error: Could not encode patch of '" << m_SlidePath << "'." << std::endl;
+      m_Failed = true;
+      return;
+    }
+
+    // Keys are short and unique regardless of the slide's file name, which is in the metadata
+    char key[64] = "";
+    snprintf(key, sizeof(key), "%06lu_%d_%lld_%lld", (unsigned long)m_SlideIndex, m_Options.level, patch.x, patch.y);
+
+    std::stringstream json;
+    json << "{\"slide\": \"";
+
+    for (size_t j = 0; j < m_SlidePath.size(); ++j)
+    {
+      const char c = m_SlidePath[j];
+      if (c == '"' || c == '\\')
+        json << '\\';
+      json << c;
+    }
+
+    json << "\", \"level\": " << m_Options.level << ", \"x\": " << patch.x << ", \"y\": " << patch.y
+         << ", \"x0\": " << (long long)std::llround(patch.x * m_Downsample)
+         << ", \"y0\": " << (long long)std::llround(patch.y * m_Downsample) << ", \"width\": " << patchSize
+         << ", \"height\": " << patchSize << ", \"tissue\": " << patch.tissueFraction << "}";
+
+    if (!m_Writer.Write(key, m_Options.encodeJpeg ? "jpg" : "rgb", m_Options.encodeJpeg ? jpeg : rgb, json.str()))
+    {
+      m_Failed = true;
+      return;
+    }
+  }
+}
+
+
+namespace
+{
+
+// libjpeg reports errors by calling error_exit(), which must not return
+struct JpegErrorManager
+{
+  jpeg_error_mgr pub;
+  jmp_buf        setjmpBuffer;
+};
+
+void
+JpegErrorExit(j_common_ptr cinfo)
+{
+  longjmp(((JpegErrorManager *)cinfo->err)->setjmpBuffer, 1);
+}
+
+// Compresses into a buffer libjpeg allocates. The buffer belongs to the caller's frame, so it is still valid after
+// an error jumped back here.
+bool
+CompressJpeg(const unsigned char * rgb, unsigned long width, unsigned long height, int quality,
+             unsigned char ** outBuffer, unsigned long * outSize)
+{
+  jpeg_compress_struct cinfo;
+  JpegErrorManager     jerr;
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = JpegErrorExit;
+
+  if (setjmp(jerr.setjmpBuffer))
+  {
+    jpeg_destroy_compress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, outBuffer, outSize);
+
+  cinfo.image_width = (JDIMENSION)width;
+  cinfo.image_height = (JDIMENSION)height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  while (cinfo.next_scanline < cinfo.image_height)
+  {
+    JSAMPROW row = (JSAMPROW)&rgb[3 * width * cinfo.next_scanline];
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  return true;
+}
+
+} // end anonymous namespace
+
+
+bool
+PatchExporter ::EncodeJpeg(const std::vector<unsigned char> & rgb, unsigned long width, unsigned long height,
+                           int quality, std::vector<unsigned char> & jpeg)
+{
+  unsigned char * outBuffer = NULL;
+  unsigned long   outSize = 0;
+
+  const bool success = CompressJpeg(rgb.data(), width, height, quality, &outBuffer, &outSize);
+
+  if (success)
+  {
+    jpeg.assign(outBuffer, outBuffer + outSize);
+  }
+
+  free(outBuffer);
+
+  return success;
+}
+
+
+bool
+ShardWriter ::Write(const std::string & key, const char * extension, const std::vector<unsigned char> & data,
+                    const std::string & json)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  if (!m_Stream.is_open() || m_PatchesInShard == m_PatchesPerShard)
+  {
+    if (m_Stream.is_open() && !FinishShard())
+    {
+      std::cerr << "Error: Could not write shard " << m_NumberOfShards - 1 << '.' << std::endl;
+      return false;
+    }
+
+    char shardName[32] = "";
+    snprintf(shardName, sizeof(shardName), "shard-%06lu.tar", (unsigned long)m_NumberOfShards);
+
+    const std::string shardPath = m_Directory + '/' + shardName;
+
+    m_Stream.open(shardPath.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!m_Stream)
+    {
+      std::cerr << "Error: Could not open shard '" << shardPath << "'." << std::endl;
+      return false;
+    }
+
+    m_PatchesInShard = 0;
+    ++m_NumberOfShards;
+  }
+
+  if (!WriteEntry(key + '.' + extension, data.data(), data.size()) ||
+      !WriteEntry(key + ".json", json.data(), json.size()))
+  {
+    std::cerr << "Error: Could not write shard " << m_NumberOfShards - 1 << '.' << std::endl;
+    return false;
+  }
+
+  ++m_PatchesInShard;
+  ++m_NumberOfPatches;
+
+  return true;
+}
+
+
+bool
+ShardWriter ::Close()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  return !m_Stream.is_open() || FinishShard();
+}
+
+
+bool
+ShardWriter ::FinishShard()
+{
+  // Two zero blocks end a tar file
+  const std::vector<char> endBlocks(1024, 0);
+  m_Stream.write(endBlocks.data(), endBlocks.size());
+  m_Stream.close();
+
+  return !m_Stream.fail();
+}
+
+
+bool
+ShardWriter ::WriteEntry(const std::string & name, const void * data, size_t size)
+{
+  // POSIX ustar header of a regular file
+  char header[512];
+  memset(header, 0, sizeof(header));
+
+  // Fields: name, mode, uid, gid, size, mtime, typeflag (regular file), magic and version
+  strncpy(header, name.c_str(), 99);
+  snprintf(header + 100, 8, "%07o", 0644);
+  snprintf(header + 108, 8, "%07o", 0);
+  snprintf(header + 116, 8, "%07o", 0);
+  snprintf(header + 124, 12, "%011llo", (unsigned long long)size);
+  snprintf(header + 136, 12, "%011llo", (unsigned long long)time(NULL));
+  header[156] = '0';
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+
+  // The checksum is computed with the checksum field set to spaces
+  memset(header + 148, ' ', 8);
+
+  unsigned int checksum = 0;
+  for (size_t i = 0; i < sizeof(header); ++i)
+  {
+    checksum += (unsigned char)header[i];
+  }
+
+  snprintf(header + 148, 8, "%06o", checksum);
+  header[155] = ' ';
+
+  const size_t padding = (512 - size % 512) % 512;
+  const char   zeros[512] = { 0 };
+
+  m_Stream.write(header, sizeof(header));
+  m_Stream.write((const char *)data, size);
+  m_Stream.write(zeros, padding);
+
+  return !m_Stream.fail();
+}
@@ -0,0 +1,1029 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "itkOpenSlideImageIO.h"
+#include "itkMultiThreaderBase.h"
+#include "itksys/SystemTools.hxx"
+#include "itk_jpeg.h"
+#include "itk_png.h"
+
+void
+Usage(const char * cArg0)
+{
+  std::cerr << "Usage: " << cArg0 << " slideFile outputBase [options]" << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Writes the Deep Zoom image outputBase.dzi with its tiles in outputBase_files/." << std::endl;
+  std::cerr << "Zoom levels whose scale matches a level of the slide are read from that level, the others are"
+            << std::endl;
+  std::cerr << "downsampled from the next finer zoom level while it is produced, so the slide is read once."
+            << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Options:" << std::endl;
+  std::cerr << "  tileSize=pixels   Tile size without overlap (default 254)" << std::endl;
+  std::cerr << "  overlap=pixels    Overlap of neighboring tiles (default 1)" << std::endl;
+  std::cerr << "  format=jpeg|png   Tile format (default jpeg)" << std::endl;
+  std::cerr << "  quality=value     JPEG quality (default 90)" << std::endl;
+  std::cerr << "  threads=count     Number of threads reading and encoding (default all cores)" << std::endl;
+  std::cerr << "  serve=port        Serve the output directory on http://127.0.0.1:port/ afterwards (for testing"
+            << std::endl;
+  std::cerr << "                    a viewer; not for production use)" << std::endl;
+  exit(1);
+}
+
+
+struct DeepZoomOptions
+{
+  unsigned long tileSize = 254;
+  unsigned long overlap = 1;
+  bool          png = false;
+  int           quality = 90;
+  unsigned int  numberOfThreads = 1;
+  int           servePort = 0;
+
+  const char *
+  GetFormat() const
+  {
+    return png ? "png" : "jpeg";
+  }
+};
+
+
+// Encodes tiles with a pool of threads. Submit() blocks while the queue is full, which bounds the memory of
+// tiles waiting to be written.
+class TileEncoder
+{
+public:
+  TileEncoder(const DeepZoomOptions & options, const std::string & filesDirectory);
+
+  ~TileEncoder() { Finish(); }
+
+  void
+  Submit(int zoom, unsigned long column, unsigned long row, unsigned long width, unsigned long height,
+         std::vector<unsigned char> && rgb);
+
+  // Waits for all tiles to be written. Returns false if a tile could not be written.
+  bool
+  Finish();
+
+  size_t
+  GetNumberOfTiles() const
+  {
+    return m_NumberOfTiles;
+  }
+
+private:
+  struct Tile
+  {
+    int                        zoom;
+    unsigned long              column;
+    unsigned long              row;
+    unsigned long              width;
+    unsigned long              height;
+    std::vector<unsigned char> rgb;
+  };
+
+  const DeepZoomOptions &  m_Options;
+  std::string              m_FilesDirectory;
+  std::vector<std::thread> m_Threads;
+  std::deque<Tile>         m_Queue;
+  size_t                   m_MaximumQueueSize;
+  bool                     m_Finished = false;
+  std::mutex               m_Mutex;
+  std::condition_variable  m_QueueNotEmpty;
+  std::condition_variable  m_QueueNotFull;
+  std::atomic<size_t>      m_NumberOfTiles{ 0 };
+  std::atomic<bool>        m_Failed{ false };
+
+  void
+  Worker();
+
+  bool
+  WriteTile(const Tile & tile) const;
+};
+
+
+// The rows of one zoom level, which arrive in order. Complete rows of tiles are cut and submitted, and if the next
+// coarser zoom level is derived from this one, each pair of rows is averaged into one of its rows. The pairs of the
+// rows appended at once are averaged in parallel and passed on together.
+class DeepZoomLevel
+{
+public:
+  DeepZoomLevel(int zoom, unsigned long width, unsigned long height, const DeepZoomOptions & options,
+                TileEncoder & encoder, itk::MultiThreaderBase * threader)
+    : m_Zoom(zoom)
+    , m_Width(width)
+    , m_Height(height)
+    , m_Options(options)
+    , m_Encoder(encoder)
+    , m_Threader(threader)
+  {}
+
+  unsigned long
+  GetWidth() const
+  {
+    return m_Width;
+  }
+
+  unsigned long
+  GetHeight() const
+  {
+    return m_Height;
+  }
+
+  // Sets the zoom level to feed with downsampled rows (NULL if it is read from the slide)
+  void
+  SetCoarserLevel(DeepZoomLevel * coarserLevel)
+  {
+    m_CoarserLevel = coarserLevel;
+  }
+
+  // Appends the next rows (width interleaved RGB pixels each)
+  void
+  AppendRows(const unsigned char * rgb, unsigned long numberOfRows);
+
+  // Flushes a pending odd row into the coarser zoom level once all rows have been appended
+  void
+  Finish();
+
+private:
+  int                      m_Zoom;
+  unsigned long            m_Width;
+  unsigned long            m_Height;
+  const DeepZoomOptions &  m_Options;
+  TileEncoder &            m_Encoder;
+  itk::MultiThreaderBase * m_Threader;
+  DeepZoomLevel *          m_CoarserLevel = NULL;
+
+  std::vector<unsigned char> m_Rows; // Rows from m_FirstRow to m_NumberOfRows
+  unsigned long              m_FirstRow = 0;
+  unsigned long              m_NumberOfRows = 0;
+  unsigned long              m_NextTileRow = 0;
+  std::vector<unsigned char> m_EvenRow; // Waits for its odd row to be averaged
+  bool                       m_HasEvenRow = false;
+
+  void
+  SubmitTileRows();
+
+  // Averages a pair of rows into a row of the coarser zoom level
+  void
+  Downsample(const unsigned char * evenRow, const unsigned char * oddRow, unsigned char * coarserRow) const;
+};
+
+
+class DeepZoomGenerator
+{
+public:
+  using ReaderIOType = itk::OpenSlideImageIO;
+
+  explicit DeepZoomGenerator(const DeepZoomOptions & options)
+    : m_Options(options)
+  {}
+
+  // Returns false on failure
+  bool
+  Generate(const std::string & slideFile, const std::string & outputBase);
+
+private:
+  const DeepZoomOptions &         m_Options;
+  ReaderIOType::Pointer           m_ReaderIO;
+  itk::MultiThreaderBase::Pointer m_Threader;
+
+  // Reads the slide level into the zoom level strip by strip, with the strips read in parallel column chunks
+  bool
+  ReadSourceLevel(int slideLevel, DeepZoomLevel & zoomLevel);
+};
+
+
+#if !defined(_WIN32)
+// A minimal HTTP/1.0 server for the files of a directory
+class TileServer
+{
+public:
+  explicit TileServer(const std::string & directory)
+    : m_Directory(directory)
+  {}
+
+  bool
+  Serve(int port);
+
+private:
+  std::string m_Directory;
+
+  void
+  HandleConnection(int connection) const;
+
+  static void
+  SendResponse(int connection, const char * status, const char * contentType, const std::string & body);
+};
+#endif
+
+
+int
+main(int argc, char ** argv)
+{
+  const char * const cArg0 = argv[0];
+  if (argc < 3)
+  {
+    Usage(cArg0);
+    return EXIT_FAILURE;
+  }
+
+  DeepZoomOptions options;
+  options.numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 3; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const size_t      equal = arg.find('=');
+    const std::string key = arg.substr(0, equal);
+    const std::string value = equal != std::string::npos ? arg.substr(equal + 1) : "";
+
+    if (key == "tileSize")
+      options.tileSize = strtoul(value.c_str(), NULL, 10);
+    else if (key == "overlap")
+      options.overlap = strtoul(value.c_str(), NULL, 10);
+    else if (key == "format" && (value == "jpeg" || value == "png"))
+      options.png = value == "png";
+    else if (key == "quality")
+      options.quality = std::min(100, std::max(1, atoi(value.c_str())));
+    else if (key == "threads")
+      options.numberOfThreads = std::max(1, atoi(value.c_str()));
+    else if (key == "serve")
+      options.servePort = atoi(value.c_str());
+    else
+    {
+      std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+      Usage(cArg0);
+    }
+  }
+
+  if (options.tileSize == 0 || options.overlap >= options.tileSize)
+  {
+    Usage(cArg0);
+    return EXIT_FAILURE;
+  }
+
+  const std::string outputBase = argv[2];
+
+  DeepZoomGenerator generator(options);
+  if (!generator.Generate(argv[1], outputBase))
+  {
+    return EXIT_FAILURE;
+  }
+
+  if (options.servePort > 0)
+  {
+#if !defined(_WIN32)
+    std::string directory = itksys::SystemTools::GetFilenamePath(outputBase);
+    if (directory.empty())
+    {
+      directory = ".";
+    }
+
+    TileServer server(directory);
+    if (!server.Serve(options.servePort))
+    {
+      return EXIT_FAILURE;
+    }
+#else
+    std::cerr << "Error: Serving is not supported on Windows." << std::endl;
+    return EXIT_FAILURE;
+#endif
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+bool
+DeepZoomGenerator ::Generate(const std::string & slideFile, const std::string & outputBase)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  // ReadRegion() converts to interleaved RGB and may be called concurrently
+  m_ReaderIO = ReaderIOType::New();
+  m_ReaderIO->SetFileName(slideFile);
+  m_ReaderIO->SetOutputLayout(ReaderIOType::OutputLayoutEnum::RGB);
+
+  ReaderIOType::SizeValueType width = 0, height = 0;
+
+  try
+  {
+    m_ReaderIO->ReadImageInformation();
+    m_ReaderIO->GetLevelDimensions(0, width, height);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: Could not open slide '" << slideFile << "': " << e.GetDescription() << std::endl;
+    return false;
+  }
+
+  if (width == 0 || height == 0)
+  {
+    std::cerr << "Error: Slide '" << slideFile << "' is empty." << std::endl;
+    return false;
+  }
+
+  // Zoom level z is 2^(maxZoom - z) times smaller than level 0, down to 1 x 1 pixel at zoom level 0
+  int maxZoom = 0;
+  while ((std::max(width, height) - 1) >> maxZoom > 0)
+  {
+    ++maxZoom;
+  }
+
+  const std::string filesDirectory = outputBase + "_files";
+
+  for (int zoom = 0; zoom <= maxZoom; ++zoom)
+  {
+    std::stringstream zoomDirectory;
+    zoomDirectory << filesDirectory << '/' << zoom;
+
+    if (!itksys::SystemTools::MakeDirectory(zoomDirectory.str()))
+    {
+      std::cerr << "Error: Could not create directory '" << zoomDirectory.str() << "'." << std::endl;
+      return false;
+    }
+  }
+
+  m_Threader = itk::MultiThreaderBase::New();
+  m_Threader->SetNumberOfWorkUnits(m_Options.numberOfThreads);
+
+  TileEncoder                                 encoder(m_Options, filesDirectory);
+  std::vector<std::unique_ptr<DeepZoomLevel>> zoomLevels(maxZoom + 1);
+  std::vector<int>                            sourceLevels(maxZoom + 1, -1);
+
+  for (int zoom = maxZoom; zoom >= 0; --zoom)
+  {
+    const int           shift = maxZoom - zoom;
+    const unsigned long zoomWidth = (unsigned long)((width + (1ULL << shift) - 1) >> shift);
+    const unsigned long zoomHeight = (unsigned long)((height + (1ULL << shift) - 1) >> shift);
+
+    zoomLevels[zoom].reset(new DeepZoomLevel(zoom, zoomWidth, zoomHeight, m_Options, encoder, m_Threader));
+
+    // Read the zoom level from a slide level of the same scale, otherwise downsample the next finer zoom level
+    const double scale = (double)(1ULL << shift);
+    for (int level = 0; level < m_ReaderIO->GetLevelCount() && sourceLevels[zoom] < 0; ++level)
+    {
+      if (std::fabs(m_ReaderIO->GetLevelDownsample(level) / scale - 1.0) < 0.01)
+      {
+        sourceLevels[zoom] = level;
+      }
+    }
+
+    if (sourceLevels[zoom] < 0)
+    {
+      zoomLevels[zoom + 1]->SetCoarserLevel(zoomLevels[zoom].get());
+    }
+  }
+
+  for (int zoom = maxZoom; zoom >= 0; --zoom)
+  {
+    if (sourceLevels[zoom] < 0)
+    {
+      continue;
+    }
+
+    std::cerr << "Reading zoom level " << zoom << " from slide level " << sourceLevels[zoom] << " ..." << std::endl;
+
+    if (!ReadSourceLevel(sourceLevels[zoom], *zoomLevels[zoom]))
+    {
+      return false;
+    }
+  }
+
+  if (!encoder.Finish())
+  {
+    return false;
+  }
+
+  const std::string dziFile = outputBase + ".dzi";
+  std::ofstream     dziStream(dziFile.c_str(), std::ofstream::out | std::ofstream::trunc);
+
+  dziStream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"" << m_Options.GetFormat()
+            << "\" Overlap=\"" << m_Options.overlap << "\" TileSize=\"" << m_Options.tileSize << "\">\n"
+            << "  <Size Width=\"" << width << "\" Height=\"" << height << "\"/>\n"
+            << "</Image>\n";
+
+  dziStream.close();
+
+  if (dziStream.fail())
+  {
+    std::cerr << "Error: Could not write '" << dziFile << "'." << std::endl;
+    return false;
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Wrote " << encoder.GetNumberOfTiles() << " tiles of " << maxZoom + 1 << " zoom levels in " << seconds
+            << " s (" << (seconds > 0.0 ? width * (double)height / seconds / 1e6 : 0.0) << " megapixels/s)."
+            << std::endl;
+
+  return true;
+}
+
+
+bool
+DeepZoomGenerator ::ReadSourceLevel(int slideLevel, DeepZoomLevel & zoomLevel)
+{
+  const unsigned long zoomWidth = zoomLevel.GetWidth();
+  const unsigned long zoomHeight = zoomLevel.GetHeight();
+
+  // The slide level may be a pixel smaller or larger than the zoom level, so edge pixels are replicated as needed
+  ReaderIOType::SizeValueType levelWidth = 0, levelHeight = 0;
+  m_ReaderIO->GetLevelDimensions(slideLevel, levelWidth, levelHeight);
+
+  const unsigned long readWidth = std::min<unsigned long>(zoomWidth, levelWidth);
+  const unsigned long chunkWidth = 1024;
+  const unsigned long numberOfChunks = (readWidth + chunkWidth - 1) / chunkWidth;
+  const unsigned long stripHeight = 4 * m_Options.tileSize;
+
+  std::vector<unsigned char> strip(3 * zoomWidth * stripHeight);
+  std::atomic<bool>          failed{ false };
+  std::string                error;
+  std::mutex                 errorMutex;
+
+  for (unsigned long y = 0; y < zoomHeight; y += stripHeight)
+  {
+    const unsigned long rows = std::min(stripHeight, zoomHeight - y);
+    const unsigned long readRows = y < levelHeight ? std::min<unsigned long>(rows, levelHeight - y) : 0;
+
+    m_Threader->ParallelizeArray(
+      0,
+      numberOfChunks,
+      [&](itk::SizeValueType chunk) {
+        const unsigned long x = chunk * chunkWidth;
+        const unsigned long columns = std::min(chunkWidth, readWidth - x);
+
+        if (readRows == 0 || failed)
+        {
+          return;
+        }
+
+        std::vector<unsigned char> pixels(3 * columns * readRows);
+
+        itk::ImageIORegion region(2);
+        region.SetIndex(0, x);
+        region.SetIndex(1, y);
+        region.SetSize(0, columns);
+        region.SetSize(1, readRows);
+
+        try
+        {
+          m_ReaderIO->ReadRegion(slideLevel, region, pixels.data());
+        }
+        catch (itk::ExceptionObject & e)
+        {
+          std::lock_guard<std::mutex> lock(errorMutex);
+          error = e.GetDescription();
+          failed = true;
+          return;
+        }
+
+        for (unsigned long row = 0; row < readRows; ++row)
+        {
+          memcpy(&strip[3 * (row * zoomWidth + x)], &pixels[3 * row * columns], 3 * columns);
+        }
+      },
+      nullptr);
+
+    if (failed)
+    {
+      std::cerr << "Error: Could not read slide level " << slideLevel << ": " << error << std::endl;
+      return false;
+    }
+
+    for (unsigned long row = 0; row < rows; ++row)
+    {
+      unsigned char * const rowPixels = &strip[3 * row * zoomWidth];
+
+      if (row >= readRows)
+      {
+        // Below the slide level (or the whole strip if y is): repeat the last row read
+        const unsigned char * const lastRow = row > 0 ? &strip[3 * (row - 1) * zoomWidth] : rowPixels;
+        if (lastRow != rowPixels)
+        {
+          memcpy(rowPixels, lastRow, 3 * zoomWidth);
+        }
+      }
+      else
+      {
+        for (unsigned long x = readWidth; x < zoomWidth; ++x)
+        {
+          memcpy(&rowPixels[3 * x], &rowPixels[3 * (readWidth - 1)], 3);
+        }
+      }
+    }
+
+    zoomLevel.AppendRows(strip.data(), rows);
+
+    // Keep the last row for zoom levels taller than the slide level
+    if (rows == stripHeight && y + rows < zoomHeight)
+    {
+      memcpy(strip.data(), &strip[3 * (rows - 1) * zoomWidth], 3 * zoomWidth);
+    }
+  }
+
+  zoomLevel.Finish();
+
+  return true;
+}
+
+
+void
+DeepZoomLevel ::AppendRows(const unsigned char * rgb, unsigned long numberOfRows)
+{
+  const size_t rowSize = 3 * m_Width;
+
+  m_Rows.insert(m_Rows.end(), rgb, rgb + numberOfRows * rowSize);
+  m_NumberOfRows += numberOfRows;
+
+  if (m_CoarserLevel != NULL)
+  {
+    // A pending even row pairs with the first row appended
+    const unsigned long pendingRows = m_HasEvenRow ? 1 : 0;
+    const unsigned long numberOfPairs = (pendingRows + numberOfRows) / 2;
+    const size_t        coarserRowSize = 3 * m_CoarserLevel->GetWidth();
+
+    std::vector<unsigned char> coarserRows(numberOfPairs * coarserRowSize);
+
+    m_Threader->ParallelizeArray(
+      0,
+      numberOfPairs,
+      [&](itk::SizeValueType pair) {
+        const unsigned char * const evenRow =
+          pair == 0 && m_HasEvenRow ? m_EvenRow.data() : rgb + (2 * pair - pendingRows) * rowSize;
+        const unsigned char * const oddRow = rgb + (2 * pair + 1 - pendingRows) * rowSize;
+
+        Downsample(evenRow, oddRow, &coarserRows[pair * coarserRowSize]);
+      },
+      nullptr);
+
+    // An unpaired last row waits for the next rows
+    if ((pendingRows + numberOfRows) % 2 != 0 && numberOfRows > 0)
+    {
+      m_EvenRow.assign(rgb + (numberOfRows - 1) * rowSize, rgb + numberOfRows * rowSize);
+    }
+
+    m_HasEvenRow = (pendingRows + numberOfRows) % 2 != 0;
+
+    if (numberOfPairs > 0)
+    {
+      m_CoarserLevel->AppendRows(coarserRows.data(), numberOfPairs);
+    }
+  }
+
+  SubmitTileRows();
+}
+
+
+void
+DeepZoomLevel ::Finish()
+{
+  if (m_CoarserLevel == NULL)
+  {
+    return;
+  }
+
+  // An odd last row is averaged with itself
+  if (m_HasEvenRow)
+  {
+    std::vector<unsigned char> coarserRow(3 * m_CoarserLevel->GetWidth());
+
+    Downsample(m_EvenRow.data(), m_EvenRow.data(), coarserRow.data());
+    m_HasEvenRow = false;
+
+    m_CoarserLevel->AppendRows(coarserRow.data(), 1);
+  }
+
+  m_CoarserLevel->Finish();
+}
+
+
+void
+DeepZoomLevel ::SubmitTileRows()
+{
+  const unsigned long tileSize = m_Options.tileSize;
+  const unsigned long overlap = m_Options.overlap;
+  const unsigned long numberOfTileRows = (m_Height + tileSize - 1) / tileSize;
+  const unsigned long numberOfTileColumns = (m_Width + tileSize - 1) / tileSize;
+  const size_t        rowSize = 3 * m_Width;
+
+  while (m_NextTileRow < numberOfTileRows)
+  {
+    const unsigned long tileRow = m_NextTileRow;
+    const unsigned long y0 = tileRow * tileSize > overlap ? tileRow * tileSize - overlap : 0;
+    const unsigned long y1 = std::min(m_Height, (tileRow + 1) * tileSize + overlap);
+
+    if (m_NumberOfRows < y1)
+    {
+      break;
+    }
+
+    for (unsigned long column = 0; column < numberOfTileColumns; ++column)
+    {
+      const unsigned long x0 = column * tileSize > overlap ? column * tileSize - overlap : 0;
+      const unsigned long x1 = std::min(m_Width, (column + 1) * tileSize + overlap);
+
+      std::vector<unsigned char> tile(3 * (x1 - x0) * (y1 - y0));
+
+      for (unsigned long y = y0; y < y1; ++y)
+      {
+        memcpy(&tile[3 * (y - y0) * (x1 - x0)], &m_Rows[(y - m_FirstRow) * rowSize + 3 * x0], 3 * (x1 - x0));
+      }
+
+      m_Encoder.Submit(m_Zoom, column, tileRow, x1 - x0, y1 - y0, std::move(tile));
+    }
+
+    ++m_NextTileRow;
+
+    // Only rows of the next tile row (including its overlap) are still needed
+    const unsigned long nextY0 = std::min(m_NumberOfRows, m_NextTileRow * tileSize - overlap);
+
+    m_Rows.erase(m_Rows.begin(), m_Rows.begin() + (nextY0 - m_FirstRow) * rowSize);
+    m_FirstRow = nextY0;
+  }
+}
+
+
+void
+DeepZoomLevel ::Downsample(const unsigned char * evenRow,
+                           const unsigned char * oddRow,
+                           unsigned char *       coarserRow) const
+{
+  const unsigned long coarserWidth = m_CoarserLevel->GetWidth();
+
+  for (unsigned long x = 0; x < coarserWidth; ++x)
+  {
+    // An odd last column is averaged with itself
+    const unsigned long x0 = 2 * x;
+    const unsigned long x1 = std::min(x0 + 1, m_Width - 1);
+
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      const unsigned int sum = evenRow[3 * x0 + c] + evenRow[3 * x1 + c] + oddRow[3 * x0 + c] + oddRow[3 * x1 + c];
+      coarserRow[3 * x + c] = (unsigned char)((sum + 2) / 4);
+    }
+  }
+}
+
+
+TileEncoder ::TileEncoder(const DeepZoomOptions & options, const std::string & filesDirectory)
+  : m_Options(options)
+  , m_FilesDirectory(filesDirectory)
+  , m_MaximumQueueSize(4 * options.numberOfThreads)
+{
+  for (unsigned int i = 0; i < options.numberOfThreads; ++i)
+  {
+    m_Threads.push_back(std::thread(&TileEncoder::Worker, this));
+  }
+}
+
+
+void
+TileEncoder ::Submit(int zoom, unsigned long column, unsigned long row, unsigned long width, unsigned long height,
+                     std::vector<unsigned char> && rgb)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_QueueNotFull.wait(lock, [this] { return m_Queue.size() < m_MaximumQueueSize; });
+
+  Tile tile;
+  tile.zoom = zoom;
+  tile.column = column;
+  tile.row = row;
+  tile.width = width;
+  tile.height = height;
+  tile.rgb = std::move(rgb);
+
+  m_Queue.push_back(std::move(tile));
+  m_QueueNotEmpty.notify_one();
+}
+
+
+bool
+TileEncoder ::Finish()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Finished = true;
+  }
+
+  m_QueueNotEmpty.notify_all();
+
+  for (size_t i = 0; i < m_Threads.size(); ++i)
+  {
+    m_Threads[i].join();
+  }
+
+  m_Threads.clear();
+
+  return !m_Failed;
+}
+
+
+void
+TileEncoder ::Worker()
+{
+  while (true)
+  {
+    Tile tile;
+
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_QueueNotEmpty.wait(lock, [this] { return !m_Queue.empty() || m_Finished; });
+
+      if (m_Queue.empty())
+      {
+        return;
+      }
+
+      tile = std::move(m_Queue.front());
+      m_Queue.pop_front();
+    }
+
+    m_QueueNotFull.notify_one();
+
+    if (!WriteTile(tile))
+    {
+      m_Failed = true;
+    }
+
+    ++m_NumberOfTiles;
+  }
+}
+
+
+namespace
+{
+
+// libjpeg reports errors by calling error_exit(), which must not return
+struct JpegErrorManager
+{
+  jpeg_error_mgr pub;
+  jmp_buf        setjmpBuffer;
+};
+
+void
+JpegErrorExit(j_common_ptr cinfo)
+{
+  longjmp(((JpegErrorManager *)cinfo->err)->setjmpBuffer, 1);
+}
+
+bool
+WriteJpeg(FILE * file, const unsigned char * rgb, unsigned long width, unsigned long height, int quality)
+{
+  jpeg_compress_struct cinfo;
+  JpegErrorManager     jerr;
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = JpegErrorExit;
+
+  if (setjmp(jerr.setjmpBuffer))
+  {
+    jpeg_destroy_compress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, file);
+
+  cinfo.image_width = (JDIMENSION)width;
+  cinfo.image_height = (JDIMENSION)height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  while (cinfo.next_scanline < cinfo.image_height)
+  {
+    JSAMPROW row = (JSAMPROW)&rgb[3 * width * cinfo.next_scanline];
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  return true;
+}
+
+bool
+WritePng(FILE * file, const unsigned char * rgb, unsigned long width, unsigned long height)
+{
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop   info = png != NULL ? png_create_info_struct(png) : NULL;
+
+  if (png == NULL || info == NULL || setjmp(png_jmpbuf(png)))
+  {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+
+  png_init_io(png, file);
+
+  // Tiles are small and written once, so favor speed over size
+  png_set_compression_level(png, 1);
+  png_set_IHDR(png,
+               info,
+               (png_uint_32)width,
+               (png_uint_32)height,
+               8,
+               PNG_COLOR_TYPE_RGB,
+               PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+
+  for (unsigned long y = 0; y < height; ++y)
+  {
+    png_write_row(png, (png_const_bytep)&rgb[3 * width * y]);
+  }
+
+  png_write_end(png, info);
+  png_destroy_write_struct(&png, &info);
+
+  return true;
+}
+
+} // end anonymous namespace
+
+
+bool
+TileEncoder ::WriteTile(const Tile & tile) const
+{
+  std::stringstream fileName;
+  fileName << m_FilesDirectory << '/' << tile.zoom << '/' << tile.column << '_' << tile.row << '.'
+           << m_Options.GetFormat();
+
+  FILE * const file = fopen(fileName.str().c_str(), "wb");
+  if (file == NULL)
+  {
+    std::cerr << "Error: Could not open '" << fileName.str() << "'." << std::endl;
+    return false;
+  }
+
+  const bool success = m_Options.png ? WritePng(file, tile.rgb.data(), tile.width, tile.height)
+                                     : WriteJpeg(file, tile.rgb.data(), tile.width, tile.height, m_Options.quality);
+
+  if (fclose(file) != 0 || !success)
+  {
+    std::cerr << "Error: Could not write '" << fileName.str() << "'." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+#if !defined(_WIN32)
+bool
+TileServer ::Serve(int port)
+{
+  const int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+  {
+    std::cerr << "Error: Could not create socket." << std::endl;
+    return false;
+  }
+
+  const int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  // Only local connections: this is for testing viewers
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons((uint16_t)port);
+
+  if (bind(listener, (const sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0)
+  {
+    std::cerr << "Error: Could not listen on port " << port << '.' << std::endl;
+    close(listener);
+    return false;
+  }
+
+  std::cerr << "Serving '" << m_Directory << "' on http://127.0.0.1:" << port << "/ (Ctrl+C to stop) ..."
+            << std::endl;
+
+  while (true)
+  {
+    const int connection = accept(listener, NULL, NULL);
+    if (connection < 0)
+    {
+      continue;
+    }
+
+    // Viewers request many tiles at once
+    std::thread(&TileServer::HandleConnection, this, connection).detach();
+  }
+}
+
+
+void
+TileServer ::HandleConnection(int connection) const
+{
+  char    request[4096];
+  ssize_t length = recv(connection, request, sizeof(request) - 1, 0);
+
+  if (length <= 0)
+  {
+    close(connection);
+    return;
+  }
+
+  request[length] = '\0';
+
+  std::stringstream requestStream(request);
+  std::string       method, path;
+  requestStream >> method >> path;
+
+  const size_t query = path.find('?');
+  if (query != std::string::npos)
+  {
+    path.resize(query);
+  }
+
+  if (method != "GET" || path.empty() || path[0] != '/' || path.find("..") != std::string::npos)
+  {
+    SendResponse(connection, "400 Bad Request", "text/plain", "Bad request\n");
+    close(connection);
+    return;
+  }
+
+  const std::string extension = itksys::SystemTools::GetFilenameLastExtension(path);
+  const char *      contentType = "application/octet-stream";
+
+  if (extension == ".dzi" || extension == ".xml")
+    contentType = "application/xml";
+  else if (extension == ".jpeg" || extension == ".jpg")
+    contentType = "image/jpeg";
+  else if (extension == ".png")
+    contentType = "image/png";
+  else if (extension == ".html")
+    contentType = "text/html";
+
+  std::ifstream fileStream((m_Directory + path).c_str(), std::ifstream::in | std::ifstream::binary);
+  if (!fileStream)
+  {
+    SendResponse(connection, "404 Not Found", "text/plain", "Not found\n");
+    close(connection);
+    return;
+  }
+
+  std::stringstream body;
+  body << fileStream.rdbuf();
+
+  SendResponse(connection, "200 OK", contentType, body.str());
+  close(connection);
+}
+
+
+void
+TileServer ::SendResponse(int connection, const char * status, const char * contentType, const std::string & body)
+{
+  std::stringstream header;
+  header << "HTTP/1.0 " << status << "\r\n"
+         << "Content-Type: " << contentType << "\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << "Access-Control-Allow-Origin: *\r\n"
+         << "Connection: close\r\n\r\n";
+
+  const std::string response = header.str() + body;
+
+  for (size_t sent = 0; sent < response.size();)
+  {
+    const ssize_t count = send(connection, response.data() + sent, response.size() - sent, 0);
+    if (count <= 0)
+    {
+      return;
+    }
+
+    sent += count;
+  }
+}
+#endif
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "itkOpenSlideImageIO.h"
+#include "itkMetaDataObject.h"
+
+void
+Usage(const char * cArg0)
+{
+  std::cerr << "Usage: " << cArg0 << " slideListFile indexFile [numberOfThreads]" << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "slideListFile lists one slide path per line. indexFile is written as tab separated values with" << std::endl;
+  std::cerr << "one line per slide in the order of slideListFile. At most numberOfThreads slides are open at once."
+            << std::endl;
+  exit(1);
+}
+
+
+// Everything the index stores about one slide
+struct SlideRecord
+{
+  std::string path;
+  std::string status; // "ok" or the error message
+  std::string vendor;
+  std::string levels;     // width,height,downsample;...
+  std::string mpp;        // mpp-x,mpp-y
+  std::string bounds;     // x,y,width,height
+  std::string associated; // name=width,height;...
+  double      seconds = 0.0;
+};
+
+
+class SlideIndexer
+{
+public:
+  using ReaderIOType = itk::OpenSlideImageIO;
+
+  SlideIndexer(const std::vector<std::string> & slides, unsigned int numberOfThreads)
+    : m_Slides(slides)
+    , m_Records(slides.size())
+    , m_NumberOfThreads(std::max(1u, numberOfThreads))
+  {}
+
+  // Index all slides with a bounded number of worker threads (each worker holds at most one open slide)
+  void
+  Run();
+
+  bool
+  WriteIndex(const char * fileName) const;
+
+private:
+  const std::vector<std::string> & m_Slides;
+  std::vector<SlideRecord>         m_Records;
+  unsigned int                     m_NumberOfThreads;
+
+  std::atomic<size_t> m_NextSlide{ 0 };
+  std::atomic<size_t> m_NumberDone{ 0 };
+  std::mutex          m_ProgressMutex;
+
+  std::chrono::steady_clock::time_point m_StartTime;
+
+  void
+  Worker();
+
+  static void
+  IndexSlide(ReaderIOType * readerIO, SlideRecord & record);
+
+  void
+  ReportProgress();
+
+  static std::string
+  GetProperty(ReaderIOType * readerIO, const char * key)
+  {
+    std::string value;
+    itk::ExposeMetaData(readerIO->GetMetaDataDictionary(), key, value);
+    return value;
+  }
+
+  // Tabs and line breaks would break the record format
+  static std::string
+  Sanitize(std::string value)
+  {
+    std::replace(value.begin(), value.end(), '\t', ' ');
+    std::replace(value.begin(), value.end(), '\n', ' ');
+    std::replace(value.begin(), value.end(), '\r', ' ');
+    return value;
+  }
+};
+
+
+int
+main(int argc, char ** argv)
+{
+  const char * const cArg0 = argv[0];
+  if (argc < 3 || argc > 4)
+  {
+    Usage(cArg0);
+    return EXIT_FAILURE;
+  }
+
+  unsigned int numberOfThreads = std::thread::hardware_concurrency();
+  if (argc > 3)
+  {
+    numberOfThreads = (unsigned int)atoi(argv[3]);
+  }
+
+  std::ifstream listStream(argv[1]);
+  if (!listStream)
+  {
+    std::cerr << "Error: Could not open slide list '" << argv[1] << "'." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> slides;
+  std::string              line;
+  while (std::getline(listStream, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.resize(line.size() - 1);
+    }
+
+    if (!line.empty())
+    {
+      slides.push_back(line);
+    }
+  }
+
+  std::cerr << "Indexing " << slides.size() << " slides with " << std::max(1u, numberOfThreads) << " threads ..."
+            << std::endl;
+
+  SlideIndexer indexer(slides, numberOfThreads);
+  indexer.Run();
+
+  if (!indexer.WriteIndex(argv[2]))
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+void
+SlideIndexer ::Run()
+{
+  m_NextSlide = 0;
+  m_NumberDone = 0;
+  m_StartTime = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < m_NumberOfThreads; ++i)
+  {
+    threads.push_back(std::thread(&SlideIndexer::Worker, this));
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_StartTime).count();
+  std::cerr << "Indexed " << m_Slides.size() << " slides in " << seconds << " s." << std::endl;
+}
+
+
+void
+SlideIndexer ::Worker()
+{
+  // One ImageIO per worker: opening the next slide closes the previous one
+  ReaderIOType::Pointer readerIO = ReaderIOType::New();
+
+  for (size_t i = m_NextSlide++; i < m_Slides.size(); i = m_NextSlide++)
+  {
+    SlideRecord & record = m_Records[i];
+    record.path = m_Slides[i];
+
+    const auto start = std::chrono::steady_clock::now();
+
+    IndexSlide(readerIO, record);
+
+    record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ++m_NumberDone;
+    ReportProgress();
+  }
+}
+
+
+void
+SlideIndexer ::IndexSlide(ReaderIOType * readerIO, SlideRecord & record)
+{
+  readerIO->SetFileName(record.path);
+  readerIO->SetLevel(0);
+
+  try
+  {
+    readerIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    record.status = Sanitize(e.GetDescription());
+    return;
+  }
+
+  record.status = "ok";
+  record.vendor = GetProperty(readerIO, "openslide.vendor");
+
+  std::stringstream stream;
+
+  const int levelCount = readerIO->GetLevelCount();
+  for (int level = 0; level < levelCount; ++level)
+  {
+    ReaderIOType::SizeValueType width = 0, height = 0;
+    readerIO->GetLevelDimensions(level, width, height);
+
+    if (level > 0)
+    {
+      stream << ';';
+    }
+
+    stream << width << ',' << height << ',' << readerIO->GetLevelDownsample(level);
+  }
+
+  record.levels = stream.str();
+
+  const std::string mppX = GetProperty(readerIO, "openslide.mpp-x");
+  const std::string mppY = GetProperty(readerIO, "openslide.mpp-y");
+  if (!mppX.empty() && !mppY.empty())
+  {
+    record.mpp = mppX + ',' + mppY;
+  }
+
+  const std::string boundsX = GetProperty(readerIO, "openslide.bounds-x");
+  const std::string boundsY = GetProperty(readerIO, "openslide.bounds-y");
+  const std::string boundsWidth = GetProperty(readerIO, "openslide.bounds-width");
+  const std::string boundsHeight = GetProperty(readerIO, "openslide.bounds-height");
+  if (!boundsX.empty() && !boundsY.empty() && !boundsWidth.empty() && !boundsHeight.empty())
+  {
+    record.bounds = boundsX + ',' + boundsY + ',' + boundsWidth + ',' + boundsHeight;
+  }
+
+  stream.str("");
+  stream.clear();
+
+  const ReaderIOType::AssociatedImageNameContainer associatedImages = readerIO->GetAssociatedImageNames();
+  for (size_t i = 0; i < associatedImages.size(); ++i)
+  {
+    ReaderIOType::SizeValueType width = 0, height = 0;
+    readerIO->GetAssociatedImageDimensions(associatedImages[i], width, height);
+
+    if (i > 0)
+    {
+      stream << ';';
+    }
+
+    stream << Sanitize(associatedImages[i]) << '=' << width << ',' << height;
+  }
+
+  record.associated = stream.str();
+}
+
+
+void
+SlideIndexer ::ReportProgress()
+{
+  const size_t numberDone = m_NumberDone;
+  const size_t reportInterval = std::max<size_t>(1, m_Slides.size() / 100);
+
+  if (numberDone % reportInterval != 0 && numberDone != m_Slides.size())
+  {
+    return;
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_StartTime).count();
+
+  std::lock_guard<std::mutex> lock(m_ProgressMutex);
+  std::cerr << "Indexed " << numberDone << '/' << m_Slides.size() << " slides ("
+            << (seconds > 0.0 ? numberDone / seconds : 0.0) << " slides/s)" << std::endl;
+}
+
+
+bool
+SlideIndexer ::WriteIndex(const char * fileName) const
+{
+  std::ofstream indexStream(fileName, std::ofstream::out | std::ofstream::trunc);
+  if (!indexStream)
+  {
+    std::cerr << "Error: Could not open index file '" << fileName << "'." << std::endl;
+    return false;
+  }
+
+  indexStream << "path\tstatus\tvendor\tlevels\tmpp\tbounds\tassociated\tseconds\n";
+
+  for (size_t i = 0; i < m_Records.size(); ++i)
+  {
+    const SlideRecord & record = m_Records[i];
+
+    indexStream << Sanitize(record.path) << '\t' << record.status << '\t' << record.vendor << '\t' << record.levels
+                << '\t' << record.mpp << '\t' << record.bounds << '\t' << record.associated << '\t' << record.seconds
+                << '\n';
+  }
+
+  return !indexStream.fail();
+}
@@ -46,6 +46,14 @@ median.SetRadius(radiusValue)
 
 writer = itk.ImageFileWriter[ImageType].New(Input=median.GetOutput(),
     FileName=outputImage)
-# Process the image in three chunks
-writer.SetNumberOfStreamDivisions(3)
+# Process the image in as many chunks as needed to stay within 256 MiB
+# (the grayscale reader output and the median output take 2 bytes per pixel)
+imageio.SetFileName(inputImage)
+imageio.ReadImageInformation()
+imageio.SetMemoryBudget(256 * 1024 * 1024)
+numberOfStreamDivisions = imageio.ComputeNumberOfStreamDivisions(2.0)
+if numberOfStreamDivisions == 0:
+    print("The image cannot be streamed in strips within 256 MiB.")
+    sys.exit(1)
+writer.SetNumberOfStreamDivisions(numberOfStreamDivisions)
 writer.Update()
@@ -0,0 +1,161 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideBufferPool_h
+#define itkOpenSlideBufferPool_h
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "IOOpenSlideExport.h"
+
+namespace itk
+{
+
+/** \class OpenSlideBufferPool
+ *
+ * \brief Recycles fixed-size, aligned memory buffers for reading many patches.
+ *
+ * Reading tens of thousands of small patches per second spends a noticeable part of its time allocating a new
+ * buffer per patch and faulting in (and zeroing) its pages. The pool hands out buffers of one size and keeps
+ * released buffers for the next request, so a steady stream of patch reads allocates only as many buffers as are
+ * in use at the same time.
+ *
+ * OpenSlideImageIO takes its decode buffers from a pool set with SetBufferPool() and
+ * OpenSlideRegionReader::ReadPatchImage() backs its images with pooled buffers (see OpenSlidePooledImageContainer),
+ * which return to the pool when the image is destroyed. The counters tell how many buffers were actually
+ * allocated, e.g. to check that the pool is large enough.
+ *
+ * All methods may be called concurrently.
+ *
+ *  \ingroup IOOpenSlide
+ */
+class IOOpenSlide_EXPORT OpenSlideBufferPool : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlideBufferPool);
+
+  /** Standard class type alias. */
+  using Self = OpenSlideBufferPool;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlideBufferPool);
+
+/** Sets the size in bytes of the buffers (0 by default, which makes every request fail). Requests may be smaller,
+ * e.g. set this to the size of the largest patch. Free buffers are deallocated; buffers in use are deallocated when
+ * they are released. */
+  virtual void SetBufferSize(size_t bufferSize);
+
+/** Returns the size in bytes of the buffers. */
+  virtual size_t GetBufferSize() const;
+
+/** Sets the alignment in bytes of the buffers (64 by default, a cache line). It must be a power of 2 and a
+ * multiple of sizeof(void *), otherwise an exception is thrown. Free buffers are deallocated. */
+  virtual void SetAlignment(size_t alignment);
+
+/** Returns the alignment in bytes of the buffers. */
+  virtual size_t GetAlignment() const;
+
+/** Turn on/off backing buffers with transparent huge pages (off by default). Buffers are then aligned to and
+ * rounded up to 2 MiB, which saves page faults and TLB misses for large buffers. This is a hint that is only
+ * supported on Linux; elsewhere buffers are allocated normally. Free buffers are deallocated. */
+  virtual void SetUseHugePages(bool bUseHugePages);
+
+/** Returns whether buffers are backed with huge pages. */
+  virtual bool GetUseHugePages() const;
+
+/** Sets how many released buffers are kept for later requests (64 by default). Further released buffers are
+ * deallocated. */
+  virtual void SetMaximumNumberOfFreeBuffers(size_t maximumNumberOfFreeBuffers);
+
+/** Returns how many released buffers are kept for later requests. */
+  virtual size_t GetMaximumNumberOfFreeBuffers() const;
+
+/** Returns a buffer of at least the given size in bytes. Its contents are undefined (they are not zeroed).
+ * Throws an exception if the size exceeds the buffer size or the allocation fails. */
+  virtual void * AcquireBuffer(size_t size);
+
+/** Returns a buffer of AcquireBuffer() to the pool. Throws an exception if the buffer is not from this pool. */
+  virtual void ReleaseBuffer(void *p_Buffer);
+
+/** Deallocates all free buffers. */
+  virtual void ReleaseFreeBuffers();
+
+/** Returns the number of buffers requested with AcquireBuffer(). */
+  virtual uint64_t GetNumberOfAcquisitions() const;
+
+/** Returns the number of buffers that were allocated (requests that no free buffer could serve). */
+  virtual uint64_t GetNumberOfAllocations() const;
+
+/** Returns the number of buffers that were deallocated. */
+  virtual uint64_t GetNumberOfDeallocations() const;
+
+/** Returns the number of buffers in use. */
+  virtual size_t GetNumberOfBuffersInUse() const;
+
+/** Returns the number of free buffers kept for later requests. */
+  virtual size_t GetNumberOfFreeBuffers() const;
+
+/** Sets the numbers of acquisitions, allocations and deallocations to 0. */
+  virtual void ResetCounters();
+
+protected:
+  OpenSlideBufferPool();
+  ~OpenSlideBufferPool();
+  virtual void PrintSelf(std::ostream& os, Indent indent) const;
+
+private:
+  size_t m_BufferSize;
+  size_t m_Alignment;
+  bool   m_UseHugePages;
+  size_t m_MaximumNumberOfFreeBuffers;
+
+  mutable std::mutex                 m_Mutex;
+  size_t                             m_AllocationSize; // Buffer size rounded up to the alignment (or 2 MiB)
+  std::vector<void *>                m_FreeBuffers;
+  std::unordered_map<void *, size_t> m_BuffersInUse; // Allocation size of each buffer in use
+  uint64_t                           m_NumberOfAcquisitions;
+  uint64_t                           m_NumberOfAllocations;
+  uint64_t                           m_NumberOfDeallocations;
+
+  // Computes m_AllocationSize and deallocates the free buffers (m_Mutex must be locked)
+  void UpdateAllocationSize();
+
+  // Returns the alignment of the allocations (m_Mutex must be locked)
+  size_t GetAllocationAlignment() const;
+
+  // Allocates a buffer of m_AllocationSize bytes (NULL on failure, m_Mutex must be locked)
+  void * Allocate() const;
+
+  // Deallocates a buffer of Allocate()
+  static void Deallocate(void *p_Buffer);
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideBufferPool_h
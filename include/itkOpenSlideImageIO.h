@@ -19,6 +19,7 @@
 #define itkOpenSlideImageIO_h
 
 #include "itkImageIOBase.h"
+#include "itkOpenSlideBufferPool.h"
 #include "IOOpenSlideExport.h"
 
 namespace itk
@@ -27,6 +28,12 @@ namespace itk
 // Forward declare a wrapper class that is responsible for openslide_t (among other things)
 class OpenSlideWrapper;
 
+// Forward declare the statistics accumulated while reading
+class OpenSlideStatistics;
+
+// Forward declare the conversion of OpenSlide's pixels to the output pixels
+class OpenSlidePixelConverter;
+
 /** \class OpenSlideImageIO
  *
  * \brief OpenSlide is a C library that provides a simple interface to read whole-slide
@@ -59,6 +66,95 @@ public:
   using Superclass = ImageIOBase;
   using Pointer = SmartPointer<Self>;
   using AssociatedImageNameContainer = std::vector<std::string>;
+  using RegionContainer = std::vector<ImageIORegion>;
+  using SpacingContainer = std::vector<double>;
+  using BufferContainer = std::vector<std::vector<unsigned char>>;
+  using HistogramType = std::vector<uint64_t>;
+
+  /** Memory layouts of the pixels written by Read(), ReadRegion() and ReadRegions().
+   * RGBA and RGB are interleaved (HWC) and RGB drops the alpha channel.
+   * PlanarRGB and PlanarRGBA store each channel as a contiguous plane (CHW). */
+  enum class OutputLayoutEnum : uint8_t
+  {
+    RGBA,
+    RGB,
+    PlanarRGB,
+    PlanarRGBA
+  };
+
+  /** Component types of the pixels that are read. Half stores IEEE 754 half-precision floats as unsigned short. */
+  enum class OutputComponentEnum : uint8_t
+  {
+    UnsignedChar,
+    Float,
+    Half
+  };
+
+  /** Color transforms applied while reading.
+   * StainDeconvolution writes the concentrations of 3 stains (see SetStainMatrix()) instead of R, G and B.
+   * Reinhard maps the colors of the slide to the statistics of a target (see SetReinhardTarget()).
+   * Macenko is StainDeconvolution with the hematoxylin and eosin stains estimated from the slide. */
+  enum class ColorTransformEnum : uint8_t
+  {
+    None,
+    StainDeconvolution,
+    Reinhard,
+    Macenko
+  };
+
+  /** How Read() fills the pixels of an IORegion that lie outside of the image.
+   * Transparent writes zeros (transparent black, like OpenSlide outside of the scanned area) and
+   * Replicate repeats the nearest edge pixel, like a ZeroFluxNeumannBoundaryCondition. */
+  enum class PaddingEnum : uint8_t
+  {
+    Transparent,
+    Replicate
+  };
+
+  /** How ReadRegionAtSpacing() reduces a level to a coarser spacing (see SetResamplingMode()).
+   * Exact filters the decoded level pixels with an area filter. ScaledDCT first decodes JPEG tiles of TIFF-based
+   * slides at 1/2, 1/4 or 1/8 of their size in the DCT domain. */
+  enum class ResamplingEnum : uint8_t
+  {
+    Exact,
+    ScaledDCT
+  };
+
+  /** Layout of the compressed tiles of a level (see GetRawTileLayout()). Compression, photometric interpretation,
+   * samples per pixel and bits per sample are the values of the TIFF tags (e.g. compression 7 for JPEG and 33003 or
+   * 33005 for Aperio JPEG 2000). m_JPEGTables holds the tables JPEG compressed tiles share (empty if none). */
+  struct RawTileLayout
+  {
+    SizeValueType              m_Width;
+    SizeValueType              m_Height;
+    SizeValueType              m_TileWidth;
+    SizeValueType              m_TileHeight;
+    SizeValueType              m_TilesAcross;
+    SizeValueType              m_TilesDown;
+    unsigned int               m_Directory;
+    unsigned int               m_Compression;
+    unsigned int               m_Photometric;
+    unsigned int               m_SamplesPerPixel;
+    unsigned int               m_BitsPerSample;
+    std::vector<unsigned char> m_JPEGTables;
+  };
+
+  /** Tissue mask of an overview of the level 0 image (see ReadTissueMask()). m_Pixels holds m_Width x m_Height
+   * values that are 1 for tissue and 0 for background. m_Integral holds their integral image with an extra leading
+   * row and column, so that the tissue of any region is counted in constant time. */
+  struct TissueMask
+  {
+    SizeValueType              m_Width;
+    SizeValueType              m_Height;
+    std::vector<unsigned char> m_Pixels;
+    std::vector<unsigned int>  m_Integral;
+
+    /** Returns the fraction of tissue of the mask pixels that the region of width x height pixels at (x, y) of an
+     * image of imageWidth x imageHeight pixels (any level of the slide) overlaps (at least one mask pixel). Returns 0
+     * if the mask is empty. */
+    double ComputeTissueFraction(SizeValueType imageWidth, SizeValueType imageHeight, SizeValueType x,
+                                 SizeValueType y, SizeValueType width, SizeValueType height) const;
+  };
 
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
@@ -86,6 +182,116 @@ public:
   /** Reads the data from disk into the memory buffer provided. */
   virtual void Read(void* buffer);
 
+  /** Reads the given region of the given level into the memory buffer provided. The buffer holds
+   * GetPixelSize() bytes per pixel in the output layout and component type, with the color transform applied.
+   * Unlike Read(), this does not depend on the IORegion or the selected level and does not modify
+   * the ImageIO. Once ReadImageInformation() has been called, several threads may call this
+   * concurrently on the same instance as long as no thread changes the file name or calls
+   * ReadImageInformation() at the same time. Throws an exception if the region is not inside the level image. */
+  virtual void ReadRegion(int iLevel, const ImageIORegion &clRegion, void *buffer) const;
+
+  /** Reads several equally sized regions of the given level into consecutive parts of the memory buffer provided.
+   * The buffer holds one patch after another in the output layout, so planar layouts give an NCHW tensor and
+   * interleaved layouts an NHWC tensor. Regions that overlap the same native tiles are grouped and each group is
+   * decoded once as its bounding box (if that is not larger than its regions), which is then cut into the patches.
+   * Groups are read in parallel. Patches are the same as those of ReadRegion(): at levels other than 0, only regions
+   * on the same grid of exactly streamable regions are grouped. This has the same thread safety as ReadRegion().
+   * Throws an exception if the regions differ in size or any region is not inside the level image. */
+  virtual void ReadRegions(int iLevel, const RegionContainer &vRegions, void *buffer) const;
+
+  /** Draws numberOfRegions regions of width x height pixels uniformly inside the given level with a generator seeded
+   * with the given seed and reads them into the memory buffer provided like ReadRegions(). vRegions receives the
+   * regions in the order of the buffer. The same seed draws the same regions. This has the same thread safety as
+   * ReadRegion(). Throws an exception if the level is smaller than a region. */
+  virtual void ReadRandomRegions(int iLevel, SizeValueType width, SizeValueType height, SizeValueType numberOfRegions,
+                                 uint64_t seed, RegionContainer &vRegions, void *buffer) const;
+
+  /** Reads an overview of the whole level 0 image (or its bounds, see SetUseBounds()) that fits into
+   * maxWidth x maxHeight pixels with the same aspect ratio (it is never larger than level 0).
+   * The cheapest source is used: the "thumbnail" associated image if it is large enough (and bounds are not used),
+   * otherwise the smallest level that is large enough. The source is decoded and reduced with an area filter in
+   * parallel. The buffer receives width x height interleaved RGB pixels regardless of the output layout, component
+   * type and color transform. This has the same thread safety as ReadRegion(). Throws an exception on failure. */
+  virtual void ReadThumbnail(SizeValueType maxWidth, SizeValueType maxHeight, std::vector<unsigned char> &buffer,
+                             SizeValueType &width, SizeValueType &height) const;
+
+  /** Reads the tissue mask of the thumbnail that fits into maxWidth x maxHeight pixels (see ReadThumbnail()).
+   * A pixel is tissue if it is not transparent and the difference of its largest and smallest color channel is at
+   * least saturationThreshold, the rule of the statistics (see SetTissueSaturationThreshold()). This has the same
+   * thread safety as ReadRegion(). Throws an exception on failure. */
+  virtual void ReadTissueMask(SizeValueType maxWidth, SizeValueType maxHeight, unsigned int saturationThreshold,
+                              TissueMask &mask) const;
+
+  /** Reads the same physical region at several spacings in one call (e.g. the same field of view at 20x, 10x and 5x).
+   * a_dOrigin and a_dSize give the region in physical coordinates (as reported for the level images, i.e. microns
+   * when the slide reports its resolution) and must be inside the level 0 image. Output i has the spacing vSpacings[i]
+   * in both directions; vRegions[i] receives its size and its index in the grid of that spacing (the region snapped to
+   * the nearest pixel of the grid) and vBuffers[i] the pixels of that grid region (see ReadRegionAtSpacing()) in the
+   * output layout. Each output is either decoded from the closest level with at least that resolution
+   * or filtered down from an output of higher resolution, whichever a simple cost model (decoding a pixel costs about
+   * as much as filtering eight) predicts to be cheaper. Levels are decoded at most once and outputs are computed
+   * with an area filter in parallel. This has the same thread safety as ReadRegion(). Throws an exception on
+   * failure. */
+  virtual void ReadMultiResolutionRegion(const double a_dOrigin[2], const double a_dSize[2],
+                                         const SpacingContainer &vSpacings, BufferContainer &vBuffers,
+                                         RegionContainer &vRegions) const;
+
+  /** Reads the given region of the grid with the given spacing into the memory buffer provided (in the output layout).
+   * The grid covers the level images from their origin, so pixel (i, j) covers the physical region from
+   * origin + (i, j) * spacing to origin + (i + 1, j + 1) * spacing, which must be inside the level 0 image. Only the
+   * pixels of the cheapest level (see GetLevelForSpacing()) covering the region are decoded. They are read as they are
+   * if the level has the spacing of the grid and reduced with an area filter in parallel otherwise. Returns the level
+   * that was decoded. This has the same thread safety as ReadRegion(). Throws an exception on failure. */
+  virtual int ReadRegionAtSpacing(const double a_dSpacing[2], const ImageIORegion &clRegion, void *buffer) const;
+
+  /** Returns the lowest resolution level with at least the resolution of the given spacing (i.e. the cheapest level
+   * to read it from), 0 if no level has or -1 if the slide is not opened. */
+  virtual int GetLevelForSpacing(const double a_dSpacing[2]) const;
+
+  /** Sets how ReadRegionAtSpacing() reduces a level to a coarser spacing (Exact by default).
+   * With ScaledDCT, a spacing at least 2, 4 or 8 times that of the level decodes the JPEG tiles of Aperio and generic
+   * tiled TIFF levels (8 bit RGB or YCbCr, see GetRawTileLayout()) with libjpeg at 1/2, 1/4 or 1/8 of their size, and
+   * only the rest of the reduction uses the area filter. This skips most of the inverse DCT and the full resolution
+   * pixels, so it is several times faster, but libjpeg's reduced inverse DCT only approximates the area filter.
+   * For RGB tiles pixels differ from Exact by less than 0.2 on average and by a few levels at most; for YCbCr tiles
+   * with subsampled chroma, the chroma is reduced differently and pixels differ by about 1 on average and by up to
+   * about 25 at sharp color edges. Levels that cannot be decoded this way are read exactly. */
+  virtual void SetResamplingMode(ResamplingEnum eResamplingMode);
+
+  /** Returns how ReadRegionAtSpacing() reduces a level to a coarser spacing. */
+  virtual ResamplingEnum GetResamplingMode() const;
+
+  /** Returns the layout of the compressed tiles of the given level. Returns false if the slide is not read from tiled
+   * TIFF directories (Aperio and generic tiled TIFF slides are) or the level has no such directory. */
+  virtual bool GetRawTileLayout(int iLevel, RawTileLayout &clLayout) const;
+
+  /** Reads the compressed bytes of tile (tileX, tileY) of the given level as they are stored in the file, so
+   * tile-aligned crops and conversions can copy tiles without decoding and encoding them again. Tiles cover the whole
+   * level image (regardless of SetUseBounds()) in rows of m_TilesAcross tiles and edge tiles have the full tile size.
+   * With shared JPEG tables a tile is an abbreviated JPEG stream: copy it along with the tables to another TIFF, or
+   * insert the tables without their end marker after the start marker of the tile for a standalone JPEG (mind the
+   * photometric interpretation, JPEG tiles of Aperio slides are often RGB rather than YCbCr). Tiles the slide does
+   * not store give an empty buffer. This has the same thread safety as ReadRegion(), but reads of the file are
+   * serialized. Throws an exception on failure. */
+  virtual void ReadRawTile(int iLevel, SizeValueType tileX, SizeValueType tileY,
+                           std::vector<unsigned char> &buffer) const;
+
+  /** Turn on/off decoding the JPEG tiles of TIFF-based slides directly (off by default, see GetRawTileLayout()).
+   * OpenSlide composites tiles through a premultiplied ARGB surface which is then converted to the output layout.
+   * With this on, levels of Aperio and generic tiled TIFF slides with 8 bit RGB or YCbCr JPEG tiles are decoded with
+   * libjpeg instead. Unsigned char RGBA and RGB outputs of Read() and ReadRegion() are written straight from the
+   * decoder unless a color transform, statistics or reused streaming borders need ARGB pixels; everything else is
+   * converted from ARGB as usual. Other slides and levels are still read by OpenSlide, and the tile cache is not
+   * used for decoded levels. Level 0 gives the same pixels as OpenSlide. Other levels give the stored pixels, which
+   * OpenSlide shifts by a fraction of a pixel for regions off the grid of exactly streamable regions. */
+  virtual void SetDirectTileDecoding(bool bDirectTileDecoding);
+
+  /** Returns whether the JPEG tiles of TIFF-based slides are decoded directly. */
+  virtual bool GetDirectTileDecoding() const;
+
+  /** Returns the number of tiles decoded directly since ReadImageInformation(). */
+  virtual uint64_t GetNumberOfDirectlyDecodedTiles() const;
+
   /*-------- This part of the interfaces deals with writing data. ----- */
 
   /** Determine the file type. Returns true if this ImageIO can write the
@@ -106,6 +312,12 @@ public:
   virtual ImageIORegion
   GenerateStreamableReadRegionFromRequestedRegion( const ImageIORegion & requested ) const;
 
+/** Closes the file handles of the slide but keeps the header read by ReadImageInformation(). The slide is opened
+ * again on the next read. This bounds the number of open files when many slides are kept around (see
+ * OpenSlideSeriesImageIO). It must not be called concurrently with reads, and it restarts
+ * GetNumberOfDirectlyDecodedTiles(). */
+  virtual void ReleaseSlide();
+
 /** Get underlying OpenSlide library version */
   virtual std::string GetOpenSlideVersion() const;
 
@@ -139,6 +351,18 @@ public:
 /** Returns all associated image names stored in the file. */
   virtual AssociatedImageNameContainer GetAssociatedImageNames() const;
 
+/** Returns the dimensions of the given level without selecting it.
+ * When bounds are used, these are the dimensions of the bounded region (see SetUseBounds()).
+ * Returns false if the level does not exist or no file is opened (call ReadImageInformation() first). */
+  virtual bool GetLevelDimensions(int iLevel, SizeValueType &width, SizeValueType &height) const;
+
+/** Returns the downsample factor of the given level relative to level 0 (-1 on failure). */
+  virtual double GetLevelDownsample(int iLevel) const;
+
+/** Returns the dimensions of the given associated image without selecting it.
+ * Returns false if the associated image does not exist or no file is opened. */
+  virtual bool GetAssociatedImageDimensions(const std::string &strName, SizeValueType &width, SizeValueType &height) const;
+
 /** Returns the absolute maximum number of streamable regions (tiles). */
   virtual int64_t ComputeMaximumNumberOfStreamableRegions() const;
 
@@ -160,6 +384,229 @@ public:
 /** Returns whether approximate streaming is enabled or not. */
   virtual bool GetApproximateStreaming() const;
 
+/** Turn on/off restricting level images to the bounds of the scanned area (off by default).
+  * Some slides (e.g. MIRAX and some Hamamatsu slides) report the bounding box of the scanned area with the
+  * openslide.bounds-x/y/width/height properties. It is often a small fraction of the level 0 canvas.
+  * When enabled, ReadImageInformation() reports the bounding box (scaled to the selected level and enlarged to be
+  * exactly streamable) as the image extent and sets the origin to its physical position. Read() and ReadRegion()
+  * then take coordinates relative to the bounding box. This has no effect on slides without bounds.
+  * Call ReadImageInformation() again after calling this function.
+  */
+  virtual void SetUseBounds(bool bUseBounds);
+
+/** Returns whether level images are restricted to the bounds of the scanned area. */
+  virtual bool GetUseBounds() const;
+
+/** Sets the memory budget in bytes for streaming (0 for no limit, the default). This does not change how the
+  * ImageIO reads; it is used by ComputeStreamingPlan() and ComputeNumberOfStreamDivisions(). */
+  virtual void SetMemoryBudget(uint64_t ui64Bytes);
+
+/** Returns the memory budget in bytes for streaming. */
+  virtual uint64_t GetMemoryBudget() const;
+
+/** Computes how to stream the selected image within the memory budget (valid after ReadImageInformation()).
+  * dDownstreamBytesPerPixel is the memory the downstream pipeline needs per streamed pixel (e.g. the output and
+  * any intermediate images of the filters). The estimate also counts the output pixels of this ImageIO, its
+  * decode buffer and OpenSlide's tile cache.
+  * Pieces are full-width strips (as produced by ImageFileWriter and StreamingImageFilter with their default
+  * splitters) unless even the thinnest strip exceeds the budget, in which case pieceWidth is less than the image
+  * width and the pieces are tiles (use a splitter like ImageRegionSplitterMultidimensional). Piece sizes are
+  * multiples of the minimum streamable region and, where possible, of the native tile size so that tiles are not
+  * decoded once for each piece they overlap.
+  * Returns false if the smallest possible piece exceeds the budget (or the image cannot be streamed). */
+  virtual bool ComputeStreamingPlan(double dDownstreamBytesPerPixel, SizeValueType &pieceWidth,
+                                    SizeValueType &pieceHeight, SizeValueType &numberOfPieces) const;
+
+/** Returns a number of stream divisions for ImageFileWriter::SetNumberOfStreamDivisions() or
+  * StreamingImageFilter::SetNumberOfStreamDivisions() with their default splitter, which cuts N divisions into
+  * full-width strips of ceil(height / N) rows. The number is the smallest one whose strips fit in the strips of
+  * ComputeStreamingPlan() and end on the same tile boundaries (or at least on the minimum streamable region).
+  * Returns 0 if the budget cannot be met with strips: ComputeStreamingPlan() fails, needs tiles, or no number of
+  * divisions gives strips on the streamable grid. */
+  virtual SizeValueType ComputeNumberOfStreamDivisions(double dDownstreamBytesPerPixel) const;
+
+/** Returns how many pixels of the selected level are outside the bounds and hence never read
+  * (0 if bounds are not used or not available). */
+  virtual uint64_t GetNumberOfPixelsSkippedByBounds() const;
+
+/** Sets a directory for a persistent cache of slide headers (empty string disables the cache, the default).
+  * With the cache, ReadImageInformation() stores everything it and the level/associated image queries need
+  * (dimensions and downsample factors of each level, associated image dimensions and the property dictionary)
+  * keyed by the slide's absolute path, size and modification time. Later calls, also from other processes,
+  * answer from the cache and defer opening the slide with OpenSlide until pixels are first read.
+  * NOTE: Only the main slide file and the Slidedat.ini header of MIRAX slides are checked for changes (e.g. not the
+  * data files of MIRAX slides).
+  */
+  virtual void SetHeaderCacheDirectory(const std::string &strDirectory);
+
+/** Returns the directory of the persistent header cache (empty string if disabled). */
+  virtual std::string GetHeaderCacheDirectory() const;
+
+/** Sets a directory for a persistent cache of decoded tiles (empty string disables the cache, the default).
+  * With the cache, pixels are read tile by tile (the slide's native tile size rounded to the level's minimum
+  * streamable region size) and each decoded tile is stored as raw ARGB pixels keyed by the slide's absolute path,
+  * size and modification time, the level, the tile size and the tile index. Later reads of the same tiles, also from
+  * other processes sharing the directory (e.g. data loader workers over several training epochs), skip decoding.
+  * Levels whose minimum streamable region is very large are not cached.
+  * Call ReadImageInformation() again after calling this function. */
+  virtual void SetTileCacheDirectory(const std::string &strDirectory);
+
+/** Returns the directory of the persistent tile cache (empty string if disabled). */
+  virtual std::string GetTileCacheDirectory() const;
+
+/** Sets the size limit of the tile cache directory in bytes (4 GiB by default, 0 for no limit).
+  * The least recently read tiles are removed in one batch down to three quarters of the limit once the directory
+  * exceeds it. */
+  virtual void SetTileCacheSize(uint64_t ui64Bytes);
+
+/** Returns the size limit of the tile cache directory in bytes. */
+  virtual uint64_t GetTileCacheSize() const;
+
+/** Returns the number of tiles read from the tile cache since ReadImageInformation(). */
+  virtual uint64_t GetTileCacheHits() const;
+
+/** Returns the number of tiles that were not in the tile cache and had to be decoded since ReadImageInformation(). */
+  virtual uint64_t GetTileCacheMisses() const;
+
+/** Sets a pool for the decode buffers of Read(), ReadRegion() and ReadRegions() (none by default).
+  * Output layouts and component types other than unsigned char RGBA are converted from a buffer of OpenSlide's
+  * ARGB pixels. With a pool whose buffers are large enough, this buffer is recycled instead of allocated per read. */
+  virtual void SetBufferPool(OpenSlideBufferPool *p_clBufferPool);
+
+/** Returns the pool of the decode buffers. */
+  virtual OpenSlideBufferPool * GetBufferPool() const;
+
+/** Turn on/off keeping the pixels of the previous Read() to reuse where the next IORegion overlaps it (off by
+  * default). Neighborhood filters enlarge each streamed piece by their radius, so adjacent pieces share border rows
+  * and columns. With this on, Read() copies the overlap from the previous piece and only decodes the new rectangles
+  * around it. The kept pixels take the memory of one RGBA piece. Borders are only reused for level 0 or with
+  * approximate streaming, since rectangles of other levels may differ slightly from one read
+  * (see SetApproximateStreaming()).
+  * ReadImageInformation() clears the kept pixels. */
+  virtual void SetReuseStreamingBorders(bool bReuseStreamingBorders);
+
+/** Returns whether Read() reuses the overlap with the previous piece. */
+  virtual bool GetReuseStreamingBorders() const;
+
+/** Sets how Read() fills the pixels of an IORegion that lie outside of the image (Transparent by default).
+  * ImageFileReader never requests such regions, this is for callers that add a halo to the regions they read.
+  * Padding is filled without calling OpenSlide. */
+  virtual void SetPaddingMode(PaddingEnum ePaddingMode);
+
+/** Returns how pixels outside of the image are filled. */
+  virtual PaddingEnum GetPaddingMode() const;
+
+/** Returns the number of pixels Read() copied from the previous piece since ReadImageInformation(). */
+  virtual uint64_t GetNumberOfReusedPixels() const;
+
+/** Returns the number of pixels Read() filled as padding since ReadImageInformation(). */
+  virtual uint64_t GetNumberOfPaddedPixels() const;
+
+/** Turn on/off accumulating statistics of the pixels Read(), ReadRegion() and ReadRegions() decode (off by default).
+  * Statistics are taken of the decoded RGBA pixels (before color transforms) and accumulate over calls, e.g. over
+  * all pieces of a streamed read, until ResetStatistics(). Large reads are accumulated in parallel chunks and
+  * concurrent ReadRegion() calls merge their partial statistics. */
+  virtual void SetComputeStatistics(bool bComputeStatistics);
+
+/** Returns whether statistics are accumulated while reading. */
+  virtual bool GetComputeStatistics() const;
+
+/** Sets the minimum saturation (the difference of the largest and smallest of R, G and B) of an opaque pixel to
+  * count as tissue (20 by default). Background is close to gray, stained tissue is not. */
+  virtual void SetTissueSaturationThreshold(unsigned int uiThreshold);
+
+/** Returns the minimum saturation of tissue pixels. */
+  virtual unsigned int GetTissueSaturationThreshold() const;
+
+/** Clears the accumulated statistics. */
+  virtual void ResetStatistics();
+
+/** Accumulates statistics of the IORegion of the selected level without keeping its pixels (regardless of
+  * GetComputeStatistics()). The level is decoded in parallel strips, so only a few strips are in memory at a time.
+  * Call ReadImageInformation() first (the IORegion defaults to the largest possible region if it is empty).
+  * Throws an exception on failure or if an associated image is selected. */
+  virtual void ReadStatistics();
+
+/** Returns the number of pixels the statistics were accumulated over. */
+  virtual uint64_t GetNumberOfStatisticsPixels() const;
+
+/** Returns the 256 bin histogram of the given channel (0 to 3 for R, G, B and A). */
+  virtual HistogramType GetHistogram(unsigned int uiChannel) const;
+
+/** Returns the mean of the given channel (0 to 3 for R, G, B and A). */
+  virtual double GetMean(unsigned int uiChannel) const;
+
+/** Returns the fraction of tissue pixels (see SetTissueSaturationThreshold()). */
+  virtual double GetTissueFraction() const;
+
+/** Sets the memory layout of the pixels Read(), ReadRegion() and ReadRegions() write (RGBA by default).
+  * The pixels are converted once, directly from OpenSlide's decode buffer.
+  * ReadImageInformation() reports RGBA and RGB layouts as RGBA and RGB pixels, so ImageFileReader can produce
+  * RGBAPixel, RGBPixel or VectorImage outputs. Planar layouts are reported as 3 or 4 component vector pixels but
+  * are meant for callers using the ImageIO directly (ImageFileReader expects interleaved pixels).
+  * Call ReadImageInformation() again after calling this function. */
+  virtual void SetOutputLayout(OutputLayoutEnum eLayout);
+
+/** Returns the memory layout of the pixels that are read. */
+  virtual OutputLayoutEnum GetOutputLayout() const;
+
+/** Returns the number of channels (3 or 4) of the given output layout. */
+  static unsigned int GetNumberOfLayoutComponents(OutputLayoutEnum eLayout);
+
+/** Sets the component type of the pixels Read(), ReadRegion() and ReadRegions() write (unsigned char by default).
+  * Float and Half components are normalized (see SetNormalization()) in the same pass that converts OpenSlide's
+  * pixels to the output layout, so no unsigned char image is kept around.
+  * Call ReadImageInformation() again after calling this function. */
+  virtual void SetOutputComponentType(OutputComponentEnum eComponentType);
+
+/** Returns the component type of the pixels that are read. */
+  virtual OutputComponentEnum GetOutputComponentType() const;
+
+/** Sets the per-channel normalization of Float and Half components:
+  * value = (pixel * dScale - a_dMean[c]) / a_dStdDev[c] for the channels c = R, G, B, A.
+  * The default (1, 0, 1) keeps the values in [0, 255]. Use a scale of 1/255 for ImageNet-style mean and standard
+  * deviation. Throws an exception if a standard deviation is 0. */
+  virtual void SetNormalization(double dScale, const double a_dMean[4], const double a_dStdDev[4]);
+
+/** Returns the per-channel normalization of Float and Half components. */
+  virtual void GetNormalization(double &dScale, double a_dMean[4], double a_dStdDev[4]) const;
+
+/** Sets the color transform applied while reading (None by default). The transform is part of the same pass that
+  * converts OpenSlide's pixels to the output layout and component type, so streamed reads produce transformed
+  * pixels without intermediate images.
+  * StainDeconvolution requires Float or Half components. The stain concentrations are normalized like the channels
+  * R, G and B (see SetNormalization()) and take their place in the output layout (alpha is kept).
+  * Reinhard needs the color statistics of the slide. ReadImageInformation() computes them once from the tissue
+  * (pixels that are neither transparent nor near white) of the lowest resolution level.
+  * Macenko also requires Float or Half components. ReadImageInformation() estimates the hematoxylin and eosin stains
+  * from the same tissue with Macenko's method (the extreme angles of the optical densities in the plane of their 2
+  * principal directions) and replaces the stain matrix with them (see GetStainMatrix()). The stain matrix is left
+  * alone if there is too little stained tissue.
+  * Call ReadImageInformation() again after calling this function. Reads throw an exception while StainDeconvolution or
+  * Macenko is combined with UnsignedChar components. */
+  virtual void SetColorTransform(ColorTransformEnum eColorTransform);
+
+/** Returns the color transform applied while reading. */
+  virtual ColorTransformEnum GetColorTransform() const;
+
+/** Sets the optical density vectors (R, G, B) of the 3 stains, one stain per row (Ruifrok and Johnston's
+  * hematoxylin, eosin and DAB by default). The vectors are normalized. If the third row is 0, it is set to the
+  * cross product of the first two. Throws an exception if the stains are not linearly independent. */
+  virtual void SetStainMatrix(const double a_dStains[9]);
+
+/** Returns the normalized stain vectors, one stain per row. */
+  virtual void GetStainMatrix(double a_dStains[9]) const;
+
+/** Sets the target mean and standard deviation of the l-alpha-beta channels for Reinhard color normalization. */
+  virtual void SetReinhardTarget(const double a_dMean[3], const double a_dStdDev[3]);
+
+/** Returns the target mean and standard deviation of the l-alpha-beta channels for Reinhard color normalization. */
+  virtual void GetReinhardTarget(double a_dMean[3], double a_dStdDev[3]) const;
+
+/** Returns the mean and standard deviation of the l-alpha-beta channels of the slide (valid after
+  * ReadImageInformation() with the Reinhard color transform). */
+  virtual void GetReinhardSource(double a_dMean[3], double a_dStdDev[3]) const;
+
 protected:
   OpenSlideImageIO();
   ~OpenSlideImageIO();
@@ -168,6 +615,81 @@ protected:
 private:
 
   OpenSlideWrapper *m_OpenSlideWrapper; // Opaque pointer to a wrapper that manages openslide_t
+  OpenSlideStatistics *m_Statistics; // Opaque pointer to the statistics accumulated while reading
+  OpenSlidePixelConverter *m_PixelConverter; // Opaque pointer to the conversion to the output pixels
+  std::string m_HeaderCacheDirectory;
+  std::string m_TileCacheDirectory;
+  uint64_t m_TileCacheSize;
+  OpenSlideBufferPool::Pointer m_BufferPool;
+  bool m_ReuseStreamingBorders;
+  PaddingEnum m_PaddingMode;
+  ResamplingEnum m_ResamplingMode;
+  int32_t m_BorderLevel; // The previous piece, its level and its ARGB pixels (m_BorderPixels is empty if none)
+  int64_t m_BorderX;
+  int64_t m_BorderY;
+  int64_t m_BorderWidth;
+  int64_t m_BorderHeight;
+  std::vector<uint32_t> m_BorderPixels;
+  uint64_t m_NumberOfReusedPixels;
+  uint64_t m_NumberOfPaddedPixels;
+  bool m_ComputeStatistics;
+  unsigned int m_TissueSaturationThreshold;
+  uint64_t m_MemoryBudget;
+
+  // Sets the pixel type and number of components for the output layout
+  void UpdatePixelTypeInfo();
+
+  // Computes the minimum streamable region size of the selected level and the column and row steps of pieces that also
+  // end on native tile boundaries. Returns false if the level cannot be streamed.
+  bool ComputeStreamingSteps(int64_t &i64MinWidth, int64_t &i64MinHeight, int64_t &i64ColumnStep,
+                             int64_t &i64RowStep) const;
+
+  // Reads a region like ReadRegion(). Nested loops run in the calling thread if bSerial is set (see
+  // OpenSlideThreader), e.g. for the regions ReadRegions() reads in parallel.
+  void ReadSingleRegion(int iLevel, const ImageIORegion &clRegion, void *buffer, bool bSerial) const;
+
+  // Adds ARGB pixels to the statistics (in parallel chunks for large buffers unless bSerial is set)
+  void AccumulateStatistics(const uint32_t *p_u32Source, int64_t i64Count, bool bSerial) const;
+
+  // Decodes the bounding box of regions of ReadRegions() once and cuts it into their patches (in the output layout at
+  // the given indices of the buffer). Nested loops run in the calling thread if bSerial is set. Returns NULL for
+  // success.
+  const char *ReadRegionGroup(int iLevel, const RegionContainer &vRegions, const std::vector<size_t> &vIndices,
+                              void *buffer, bool bSerial) const;
+
+  // Decodes the thumbnail of ReadThumbnail() as ARGB pixels. Returns NULL for success.
+  const char *ReadThumbnailPixels(SizeValueType maxWidth, SizeValueType maxHeight, std::vector<uint32_t> &vThumbnail,
+                                  int64_t &i64Width, int64_t &i64Height) const;
+
+  // Cuts the rows i64Y to i64Y + i64Height of the given level into strips for parallel reads. The boundaries between
+  // strips are on the level's grid of exactly streamable regions, so the strips give the same pixels as one read of
+  // all rows. vStripRows receives the first row of each strip followed by the end of the last strip.
+  void ComputeReadStrips(int iLevel, int64_t i64Y, int64_t i64Height, std::vector<int64_t> &vStripRows) const;
+
+  // Decodes a region of the given level in parallel strips. Returns NULL for success.
+  const char *ReadLevelRegionInStrips(int iLevel, int64_t i64X, int64_t i64Y, int64_t i64Width, int64_t i64Height,
+                                      uint32_t *p_u32Dest) const;
+
+  // Decodes a region of the given level scaled down by ui32Scale in the DCT domain in parallel strips (absolute
+  // coordinates of the scaled level, see ReadRegionAtSpacing()). Returns false if the level cannot be decoded at that
+  // scale, otherwise sets p_cError (NULL for success).
+  bool ReadScaledLevelRegion(int iLevel, uint32_t ui32Scale, int64_t i64X, int64_t i64Y, int64_t i64Width,
+                             int64_t i64Height, uint32_t *p_u32Dest, const char *&p_cError) const;
+
+  // Decodes a region of the given level straight into unsigned char RGBA or RGB output if direct tile decoding applies
+  // and nothing needs ARGB pixels. Returns false if it does not apply, otherwise sets p_cError (NULL for success).
+  bool ReadLevelRegionDirectly(int iLevel, int64_t i64X, int64_t i64Y, int64_t i64Width, int64_t i64Height,
+                               void *buffer, const char *&p_cError) const;
+
+  // Decodes a piece of Read() that may extend outside of the image, filling the outside as padding.
+  // Returns NULL for success.
+  const char *ReadStreamingPiece(uint32_t *p_u32Dest, int64_t i64X, int64_t i64Y, int64_t i64Width,
+                                 int64_t i64Height);
+
+  // Decodes a piece of Read() inside of the level image, copying its overlap with the previous piece when
+  // m_ReuseStreamingBorders is on. Returns NULL for success.
+  const char *ReadReusingBorders(uint32_t *p_u32Dest, int64_t i64X, int64_t i64Y, int64_t i64Width,
+                                 int64_t i64Height);
 };
 
 } // end namespace itk
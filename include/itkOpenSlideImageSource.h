@@ -0,0 +1,125 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkOpenSlideImageSource_h
+#define itkOpenSlideImageSource_h
+
+#include <string>
+#include "itkImageSource.h"
+#include "itkImage.h"
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideRegionReader.h"
+
+namespace itk
+{
+
+/** \class OpenSlideImageSource
+ *
+ * \brief Produces a slide on a grid of the given output spacing, reading each requested region from the cheapest level.
+ *
+ * ImageFileReader reads the level selected before ReadImageInformation(), so a pipeline asking for a physical region
+ * at a coarse spacing either decodes far more resolution than it needs or has to pick the level itself. This source
+ * instead describes the whole slide on a grid of the output spacing (see SetOutputSpacing()) and, for each requested
+ * region, decodes only the pixels of the lowest resolution level that still has the output resolution and reduces
+ * them to the output grid (see OpenSlideImageIO::ReadRegionAtSpacing()). A level with the output spacing is copied
+ * as it is.
+ *
+ * \code
+ * source->SetFileName(fileName);
+ * source->SetOutputSpacing(spacing); // e.g. 4 microns per pixel
+ * source->UpdateOutputInformation();
+ * source->GetOutput()->SetRequestedRegion(region);
+ * source->GetOutput()->Update();
+ * \endcode
+ *
+ * The output starts at the corner of the level 0 image and covers its whole pixels, so its origin (the center of its
+ * first pixel) is the origin of the level images shifted by half the difference of the spacings. TPixel is one of
+ * the pixel types of OpenSlideRegionReader. Streaming filters downstream only cause their pieces to be read. Other
+ * ImageIO settings (e.g. normalization, color transforms, bounds or the caches) can be set on GetImageIO() before the
+ * first update; the level and associated image are chosen by the source.
+ *
+ *  \ingroup IOOpenSlide
+ */
+template <typename TPixel>
+class ITK_TEMPLATE_EXPORT OpenSlideImageSource : public ImageSource<Image<TPixel, 2>>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlideImageSource);
+
+  /** Standard class type alias. */
+  using Self = OpenSlideImageSource;
+  using Superclass = ImageSource<Image<TPixel, 2>>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  using PixelType = TPixel;
+  using PixelTraits = OpenSlideRegionReaderPixelTraits<TPixel>;
+  using OutputImageType = Image<TPixel, 2>;
+  using SpacingType = typename OutputImageType::SpacingType;
+  using RegionType = typename OutputImageType::RegionType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlideImageSource);
+
+/** Sets the slide to read. The slide is opened by the next update. */
+  virtual void SetFileName(const std::string &strFileName);
+
+/** Returns the slide to read. */
+  virtual const std::string & GetFileName() const;
+
+/** Returns the ImageIO that reads the regions (e.g. to configure caches or a color transform). */
+  virtual OpenSlideImageIO * GetImageIO() const;
+
+/** Sets the spacing of the output in physical units (as reported for the level images, i.e. microns when the slide
+ * reports its resolution). Components that are not positive use the spacing of level 0 (the default). */
+  virtual void SetOutputSpacing(const SpacingType &clSpacing);
+
+/** Returns the spacing of the output as set. */
+  virtual const SpacingType & GetOutputSpacing() const;
+
+/** Returns the level the last update decoded (-1 if none). */
+  virtual int GetLastReadLevel() const;
+
+protected:
+  OpenSlideImageSource();
+  ~OpenSlideImageSource() {}
+  virtual void PrintSelf(std::ostream& os, Indent indent) const;
+
+  /** Opens the slide if needed and describes it on the grid of the output spacing. */
+  virtual void GenerateOutputInformation();
+
+  /** Reads the requested region of the output from the cheapest level. */
+  virtual void GenerateData();
+
+private:
+  std::string               m_FileName;
+  OpenSlideImageIO::Pointer m_ImageIO;
+  SpacingType               m_OutputSpacing;
+  bool                      m_Opened;
+  int                       m_LastReadLevel;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkOpenSlideImageSource.hxx"
+#endif
+
+#endif // itkOpenSlideImageSource_h
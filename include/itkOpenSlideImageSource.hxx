@@ -0,0 +1,180 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkOpenSlideImageSource_hxx
+#define itkOpenSlideImageSource_hxx
+
+#include <algorithm>
+#include <cmath>
+#include "itkOpenSlideImageSource.h"
+
+namespace itk
+{
+
+template <typename TPixel>
+OpenSlideImageSource<TPixel>::OpenSlideImageSource()
+{
+  m_ImageIO = OpenSlideImageIO::New();
+  m_OutputSpacing.Fill(0.0);
+  m_Opened = false;
+  m_LastReadLevel = -1;
+}
+
+template <typename TPixel>
+void
+OpenSlideImageSource<TPixel>::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "File Name: " << m_FileName << '\n';
+  os << indent << "Output Spacing: " << m_OutputSpacing << '\n';
+  os << indent << "Opened: " << m_Opened << '\n';
+  os << indent << "Last Read Level: " << m_LastReadLevel << '\n';
+}
+
+/** Sets the slide to read. */
+template <typename TPixel>
+void
+OpenSlideImageSource<TPixel>::SetFileName(const std::string & strFileName)
+{
+  if (m_FileName == strFileName)
+    return;
+
+  m_FileName = strFileName;
+  m_Opened = false;
+  this->Modified();
+}
+
+/** Returns the slide to read. */
+template <typename TPixel>
+const std::string &
+OpenSlideImageSource<TPixel>::GetFileName() const
+{
+  return m_FileName;
+}
+
+/** Returns the ImageIO that reads the regions. */
+template <typename TPixel>
+OpenSlideImageIO *
+OpenSlideImageSource<TPixel>::GetImageIO() const
+{
+  return m_ImageIO.GetPointer();
+}
+
+/** Sets the spacing of the output. */
+template <typename TPixel>
+void
+OpenSlideImageSource<TPixel>::SetOutputSpacing(const SpacingType & clSpacing)
+{
+  if (m_OutputSpacing == clSpacing)
+    return;
+
+  m_OutputSpacing = clSpacing;
+  this->Modified();
+}
+
+/** Returns the spacing of the output as set. */
+template <typename TPixel>
+const typename OpenSlideImageSource<TPixel>::SpacingType &
+OpenSlideImageSource<TPixel>::GetOutputSpacing() const
+{
+  return m_OutputSpacing;
+}
+
+/** Returns the level the last update decoded. */
+template <typename TPixel>
+int
+OpenSlideImageSource<TPixel>::GetLastReadLevel() const
+{
+  return m_LastReadLevel;
+}
+
+template <typename TPixel>
+void
+OpenSlideImageSource<TPixel>::GenerateOutputInformation()
+{
+  OutputImageType * const p_clOutput = this->GetOutput();
+
+  if (!m_Opened)
+  {
+    // The pixel type decides the layout regardless of what was set on the ImageIO
+    m_ImageIO->SetOutputLayout(PixelTraits::Layout);
+    m_ImageIO->SetOutputComponentType(PixelTraits::ComponentType);
+    m_ImageIO->SetFileName(m_FileName);
+    m_ImageIO->SetAssociatedImageName("");
+    m_ImageIO->SetLevel(0);
+    m_ImageIO->ReadImageInformation();
+
+    if (m_ImageIO->GetNumberOfComponents() * m_ImageIO->GetComponentSize() != sizeof(PixelType))
+    {
+      itkExceptionMacro("Error OpenSlideImageSource could not open file: "
+                        << m_FileName << std::endl
+                        << "Reason: ImageIO pixels do not match the pixel type.");
+    }
+
+    m_Opened = true;
+  }
+
+  SpacingType                         clSpacing;
+  typename OutputImageType::PointType clOrigin;
+  RegionType                          clRegion;
+
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    const double dSpacing0 = m_ImageIO->GetSpacing(i);
+
+    clSpacing[i] = m_OutputSpacing[i] > 0.0 ? m_OutputSpacing[i] : dSpacing0;
+
+    // The origin is the center of the first pixel, which covers the first clSpacing[i] / dSpacing0 level 0 pixels
+    clOrigin[i] = m_ImageIO->GetOrigin(i) + 0.5 * (clSpacing[i] - dSpacing0);
+
+    // Whole output pixels of the level 0 image (tolerating rounding errors of the spacings)
+    const double dSize = std::floor(m_ImageIO->GetDimensions(i) * dSpacing0 / clSpacing[i] + 1e-6);
+    clRegion.SetSize(i, std::max<SizeValueType>(1, (SizeValueType)dSize));
+  }
+
+  p_clOutput->SetLargestPossibleRegion(clRegion);
+  p_clOutput->SetSpacing(clSpacing);
+  p_clOutput->SetOrigin(clOrigin);
+  p_clOutput->SetMetaDataDictionary(m_ImageIO->GetMetaDataDictionary());
+}
+
+template <typename TPixel>
+void
+OpenSlideImageSource<TPixel>::GenerateData()
+{
+  OutputImageType * const p_clOutput = this->GetOutput();
+
+  this->AllocateOutputs();
+
+  const RegionType & clRequestedRegion = p_clOutput->GetRequestedRegion();
+  const SpacingType & clSpacing = p_clOutput->GetSpacing();
+
+  ImageIORegion clRegion(2);
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    clRegion.SetIndex(i, clRequestedRegion.GetIndex(i));
+    clRegion.SetSize(i, clRequestedRegion.GetSize(i));
+  }
+
+  const double a_dSpacing[2] = { clSpacing[0], clSpacing[1] };
+
+  m_LastReadLevel = m_ImageIO->ReadRegionAtSpacing(a_dSpacing, clRegion, p_clOutput->GetBufferPointer());
+}
+
+} // end namespace itk
+
+#endif // itkOpenSlideImageSource_hxx
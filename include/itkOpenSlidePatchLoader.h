@@ -0,0 +1,262 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlidePatchLoader_h
+#define itkOpenSlidePatchLoader_h
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkOpenSlideImageIO.h"
+#include "IOOpenSlideExport.h"
+
+namespace itk
+{
+
+/** \class OpenSlidePatchLoader
+ *
+ * \brief Samples random patches from a set of slides into batch buffers, safely across forked worker processes.
+ *
+ * Data loaders of training frameworks often fork worker processes after the parent has opened the slides. A forked
+ * process must not use an openslide_t it inherited: its locks and file descriptors are shared with the parent and
+ * other workers, and a lock another thread held at the time of the fork is never released. Opening the slide for
+ * every sample is safe but slow. The loader remembers the process that opened its slides. When it is used in another
+ * process, it abandons the inherited handles without closing them and lazily opens the slides again, so each process
+ * keeps its own cache of open slides (see SetMaximumNumberOfOpenSlides()).
+ *
+ * The dimensions and tissue masks of the slides are plain data and survive a fork. Call PrepareSlides() in the parent
+ * so workers inherit them instead of computing them again. After a fork the random generator is reseeded from the
+ * seed and the process ID, so workers draw different patches; call SetSeed() in each worker for reproducible
+ * sampling.
+ *
+ * SamplePatches() draws patches of one size from one level, uniformly over the slides and, with a minimum tissue
+ * fraction, from the tissue of a low resolution mask like the ExportPatchShards example. ReadPatches() reads them into
+ * one preallocated buffer in the output layout (N x H x W x C for interleaved and N x C x H x W for planar layouts).
+ *
+ * All methods may be called concurrently from several threads of a process, but a process must not fork while
+ * another thread uses the loader.
+ *
+ *  \ingroup IOOpenSlide
+ */
+class IOOpenSlide_EXPORT OpenSlidePatchLoader : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlidePatchLoader);
+
+  /** Standard class type alias. */
+  using Self = OpenSlidePatchLoader;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlidePatchLoader);
+
+  using ImageIOType = OpenSlideImageIO;
+
+  /** A sampled patch: the slide (see AddSlide()), the index of its top left pixel in the level and the fraction of
+   * its mask pixels that are tissue (1 if tissue is not used). */
+  struct Patch
+  {
+    unsigned int  m_Slide;
+    SizeValueType m_X;
+    SizeValueType m_Y;
+    double        m_TissueFraction;
+  };
+
+  using PatchContainer = std::vector<Patch>;
+
+/** Adds a slide and returns its index. The slide is not opened until it is needed. */
+  virtual unsigned int AddSlide(const std::string &strFileName);
+
+/** Removes all slides and closes the slides opened by this process. */
+  virtual void ClearSlides();
+
+/** Returns the number of slides. */
+  virtual unsigned int GetNumberOfSlides() const;
+
+/** Returns the file name of the given slide. */
+  virtual std::string GetSlideFileName(unsigned int uiSlide) const;
+
+/** Sets the level patches are read from (0 by default). Slides that do not have the level are not sampled. */
+  virtual void SetLevel(int iLevel);
+
+/** Returns the level patches are read from. */
+  virtual int GetLevel() const;
+
+/** Sets the width and height of the patches in pixels (256 by default). Smaller slides are not sampled. */
+  virtual void SetPatchSize(SizeValueType patchSize);
+
+/** Returns the width and height of the patches in pixels. */
+  virtual SizeValueType GetPatchSize() const;
+
+/** Sets the minimum fraction of tissue of a sampled patch (0 by default, which samples patches uniformly). Patches
+ * are drawn around tissue pixels of the mask. If no patch with enough tissue is found in 32 attempts, the one with the
+ * most tissue is taken. Slides without tissue are sampled uniformly. */
+  virtual void SetMinimumTissueFraction(double dMinimumTissueFraction);
+
+/** Returns the minimum fraction of tissue of a sampled patch. */
+  virtual double GetMinimumTissueFraction() const;
+
+/** Sets the minimum saturation (maximum minus minimum of R, G and B) of tissue pixels in the mask (20 by default). */
+  virtual void SetTissueSaturationThreshold(unsigned int uiThreshold);
+
+/** Returns the minimum saturation of tissue pixels in the mask. */
+  virtual unsigned int GetTissueSaturationThreshold() const;
+
+/** Sets the maximum width and height of the tissue masks (1024 by default, see OpenSlideImageIO::ReadThumbnail()). */
+  virtual void SetMaskSize(SizeValueType maskSize);
+
+/** Returns the maximum width and height of the tissue masks. */
+  virtual SizeValueType GetMaskSize() const;
+
+/** Sets the output layout of the patches (RGB by default, see OpenSlideImageIO::SetOutputLayout()). */
+  virtual void SetOutputLayout(ImageIOType::OutputLayoutEnum eLayout);
+
+/** Returns the output layout of the patches. */
+  virtual ImageIOType::OutputLayoutEnum GetOutputLayout() const;
+
+/** Sets the component type of the patches (UnsignedChar by default, see OpenSlideImageIO::SetOutputComponentType()). */
+  virtual void SetOutputComponentType(ImageIOType::OutputComponentEnum eComponentType);
+
+/** Returns the component type of the patches. */
+  virtual ImageIOType::OutputComponentEnum GetOutputComponentType() const;
+
+/** Sets the normalization of float and half patches (see OpenSlideImageIO::SetNormalization()). */
+  virtual void SetNormalization(double dScale, const double a_dMean[4], const double a_dStdDev[4]);
+
+/** Sets the header cache directory of the slides (see OpenSlideImageIO::SetHeaderCacheDirectory()). With a cache,
+ * a worker opening a slide again does not parse its header. */
+  virtual void SetHeaderCacheDirectory(const std::string &strDirectory);
+
+/** Returns the header cache directory of the slides. */
+  virtual std::string GetHeaderCacheDirectory() const;
+
+/** Sets how many slides each process keeps open (16 by default, at least 1). The least recently used slide is closed
+ * when another one needs to be opened. */
+  virtual void SetMaximumNumberOfOpenSlides(unsigned int uiMaximumNumberOfOpenSlides);
+
+/** Returns how many slides each process keeps open. */
+  virtual unsigned int GetMaximumNumberOfOpenSlides() const;
+
+/** Seeds the random generator of this process (0 by default). */
+  virtual void SetSeed(uint64_t ui64Seed);
+
+/** Returns the seed of the random generator. */
+  virtual uint64_t GetSeed() const;
+
+/** Returns the size in bytes of one patch in the buffer of ReadPatches(). */
+  virtual size_t GetPatchBufferSize() const;
+
+/** Opens every slide to read its level dimensions and computes its tissue mask if tissue is used. This is done
+ * lazily otherwise. Throws an exception if a slide cannot be read. */
+  virtual void PrepareSlides();
+
+/** Draws the given number of patches. They are ordered by slide, so ReadPatches() reads the patches of each slide in
+ * one go. Throws an exception if no slide is large enough for a patch or a slide cannot be read. */
+  virtual void SamplePatches(SizeValueType numberOfPatches, PatchContainer &vPatches);
+
+/** Reads the patches into consecutive parts of the buffer provided, which must hold
+ * vPatches.size() * GetPatchBufferSize() bytes. Throws an exception on failure. */
+  virtual void ReadPatches(const PatchContainer &vPatches, void *buffer);
+
+/** Draws the given number of patches and reads them into the buffer provided (see SamplePatches() and
+ * ReadPatches()). */
+  virtual void ReadBatch(SizeValueType numberOfPatches, void *buffer, PatchContainer &vPatches);
+
+/** Returns the number of slides this process opened since it was forked (or the loader was created). */
+  virtual uint64_t GetNumberOfOpenedSlides() const;
+
+/** Returns the number of forks the loader detected, i.e. how often it abandoned the slides of another process. */
+  virtual unsigned int GetNumberOfDetectedForks() const;
+
+protected:
+  OpenSlidePatchLoader();
+  ~OpenSlidePatchLoader();
+  virtual void PrintSelf(std::ostream& os, Indent indent) const;
+
+private:
+  // Level dimensions and tissue mask of a slide (both 0 if the slide does not have the level)
+  struct SlideInformation
+  {
+    std::string                m_FileName;
+    bool                       m_HasInformation;
+    SizeValueType              m_Width;
+    SizeValueType              m_Height;
+    ImageIOType::TissueMask    m_TissueMask;
+    std::vector<SizeValueType> m_TissuePixels; // Indices of the tissue pixels of the mask
+  };
+
+  int                              m_Level;
+  SizeValueType                    m_PatchSize;
+  double                           m_MinimumTissueFraction;
+  unsigned int                     m_TissueSaturationThreshold;
+  SizeValueType                    m_MaskSize;
+  ImageIOType::OutputLayoutEnum    m_OutputLayout;
+  ImageIOType::OutputComponentEnum m_OutputComponentType;
+  double                           m_NormalizationScale;
+  double                           m_NormalizationMean[4];
+  double                           m_NormalizationStdDev[4];
+  std::string                      m_HeaderCacheDirectory;
+  unsigned int                     m_MaximumNumberOfOpenSlides;
+  uint64_t                         m_Seed;
+
+  mutable std::mutex                 m_Mutex;
+  std::vector<SlideInformation>      m_Slides;
+  std::vector<ImageIOType::Pointer>  m_ImageIOs; // Slides opened by this process (null if not open)
+  std::vector<uint64_t>              m_LastUse;  // Use counter of each open slide
+  uint64_t                           m_UseCounter;
+  unsigned int                       m_NumberOfOpenSlides;
+  uint64_t                           m_NumberOfOpenedSlides;
+  unsigned int                       m_NumberOfDetectedForks;
+  int64_t                            m_ProcessId; // The process that opened m_ImageIOs
+  std::mt19937_64                    m_Generator;
+
+  // Abandons the slides and reseeds the generator if this is not the process that opened them (m_Mutex must be
+  // locked)
+  void CheckProcess();
+
+  // Closes the slides opened by this process (m_Mutex must be locked)
+  void CloseSlides();
+
+  // Returns the ImageIO of the slide, opening it if needed (m_Mutex must be locked)
+  ImageIOType::Pointer GetImageIO(unsigned int uiSlide);
+
+  // Reads the level dimensions and tissue mask of the slide if not done yet (m_Mutex must be locked)
+  void UpdateSlideInformation(unsigned int uiSlide);
+
+  // Forgets the level dimensions and tissue masks after a setting they depend on changed (m_Mutex must be locked)
+  void ResetSlideInformation();
+
+  // Draws a patch of the slide (m_Mutex must be locked)
+  Patch SamplePatch(unsigned int uiSlide);
+
+  // Returns the ID of the calling process
+  static int64_t GetProcessId();
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlidePatchLoader_h
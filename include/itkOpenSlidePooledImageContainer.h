@@ -0,0 +1,118 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlidePooledImageContainer_h
+#define itkOpenSlidePooledImageContainer_h
+
+#include "itkImportImageContainer.h"
+#include "itkOpenSlideBufferPool.h"
+
+namespace itk
+{
+
+/** \class OpenSlidePooledImageContainer
+ *
+ * \brief Pixel container of an itk::Image whose buffer is taken from an OpenSlideBufferPool and returned to it
+ * when the container is destroyed.
+ *
+ * The container is an ImportImageContainer, so it can be set with Image::SetPixelContainer(). The pixels are not
+ * initialized. The container keeps the pool alive. If the image reallocates its buffer (e.g. to grow), the pooled
+ * buffer is still returned when the container is destroyed.
+ *
+ * \code
+ * container->AllocateFromPool(pool, region.GetNumberOfPixels());
+ * image->SetRegions(region);
+ * image->SetPixelContainer(container);
+ * \endcode
+ *
+ *  \ingroup IOOpenSlide
+ */
+template <typename TElementIdentifier, typename TElement>
+class ITK_TEMPLATE_EXPORT OpenSlidePooledImageContainer : public ImportImageContainer<TElementIdentifier, TElement>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlidePooledImageContainer);
+
+  /** Standard class type alias. */
+  using Self = OpenSlidePooledImageContainer;
+  using Superclass = ImportImageContainer<TElementIdentifier, TElement>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  using ElementIdentifier = TElementIdentifier;
+  using Element = TElement;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlidePooledImageContainer);
+
+/** Imports a buffer of the pool for the given number of elements. A previous pooled buffer is returned first.
+ * Throws an exception if the elements do not fit into a buffer of the pool. */
+  void AllocateFromPool(OpenSlideBufferPool *p_clPool, ElementIdentifier size)
+  {
+    this->ReleaseToPool();
+
+    TElement * const p_Buffer = static_cast<TElement *>(p_clPool->AcquireBuffer(size * sizeof(TElement)));
+
+    m_BufferPool = p_clPool;
+    m_PooledBuffer = p_Buffer;
+    this->SetImportPointer(p_Buffer, size, false);
+  }
+
+/** Returns the pooled buffer to its pool (if any). The container is empty afterwards unless it reallocated. */
+  void ReleaseToPool()
+  {
+    if (m_PooledBuffer == nullptr)
+      return;
+
+    if (this->GetImportPointer() == m_PooledBuffer)
+      this->SetImportPointer(nullptr, 0, false);
+
+    m_BufferPool->ReleaseBuffer(m_PooledBuffer);
+    m_BufferPool = nullptr;
+    m_PooledBuffer = nullptr;
+  }
+
+/** Returns the pool of the buffer (nullptr if none). */
+  OpenSlideBufferPool * GetBufferPool() const { return m_BufferPool.GetPointer(); }
+
+protected:
+  OpenSlidePooledImageContainer() { m_PooledBuffer = nullptr; }
+  ~OpenSlidePooledImageContainer()
+  {
+    // Destructors must not throw. ReleaseBuffer() only throws for a buffer the pool does not know, which is a bug.
+    try
+    {
+      this->ReleaseToPool();
+    }
+    catch (...)
+    {
+      itkAssertInDebugAndIgnoreInReleaseMacro(false);
+    }
+  }
+
+private:
+  OpenSlideBufferPool::Pointer m_BufferPool;
+  TElement *                   m_PooledBuffer;
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlidePooledImageContainer_h
@@ -0,0 +1,179 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkOpenSlideRegionReader_h
+#define itkOpenSlideRegionReader_h
+
+#include <string>
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImage.h"
+#include "itkRGBAPixel.h"
+#include "itkRGBPixel.h"
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideBufferPool.h"
+#include "itkOpenSlidePooledImageContainer.h"
+
+namespace itk
+{
+
+/** \class OpenSlideRegionReaderPixelTraits
+ *
+ * \brief Maps the pixel types OpenSlideRegionReader supports to the output layout and component type of
+ * OpenSlideImageIO. Other pixel types do not compile.
+ *
+ *  \ingroup IOOpenSlide
+ */
+template <typename TPixel>
+struct OpenSlideRegionReaderPixelTraits;
+
+template <>
+struct OpenSlideRegionReaderPixelTraits<RGBAPixel<unsigned char>>
+{
+  static constexpr OpenSlideImageIO::OutputLayoutEnum    Layout = OpenSlideImageIO::OutputLayoutEnum::RGBA;
+  static constexpr OpenSlideImageIO::OutputComponentEnum ComponentType =
+    OpenSlideImageIO::OutputComponentEnum::UnsignedChar;
+};
+
+template <>
+struct OpenSlideRegionReaderPixelTraits<RGBPixel<unsigned char>>
+{
+  static constexpr OpenSlideImageIO::OutputLayoutEnum    Layout = OpenSlideImageIO::OutputLayoutEnum::RGB;
+  static constexpr OpenSlideImageIO::OutputComponentEnum ComponentType =
+    OpenSlideImageIO::OutputComponentEnum::UnsignedChar;
+};
+
+template <>
+struct OpenSlideRegionReaderPixelTraits<RGBAPixel<float>>
+{
+  static constexpr OpenSlideImageIO::OutputLayoutEnum    Layout = OpenSlideImageIO::OutputLayoutEnum::RGBA;
+  static constexpr OpenSlideImageIO::OutputComponentEnum ComponentType = OpenSlideImageIO::OutputComponentEnum::Float;
+};
+
+template <>
+struct OpenSlideRegionReaderPixelTraits<RGBPixel<float>>
+{
+  static constexpr OpenSlideImageIO::OutputLayoutEnum    Layout = OpenSlideImageIO::OutputLayoutEnum::RGB;
+  static constexpr OpenSlideImageIO::OutputComponentEnum ComponentType = OpenSlideImageIO::OutputComponentEnum::Float;
+};
+
+/** \class OpenSlideRegionReader
+ *
+ * \brief Reads patches of a slide straight into caller provided buffers of TPixel.
+ *
+ * Reading small patches through ImageFileReader spends much of its time outside of decoding: finding the ImageIO,
+ * reading the image information and meta data dictionary, negotiating regions and allocating a new image for each
+ * patch. This reader opens the slide once and each ReadPatch() only decodes and converts the patch into the buffer.
+ *
+ * TPixel is one of RGBAPixel<unsigned char>, RGBPixel<unsigned char>, RGBAPixel<float> and RGBPixel<float>.
+ * Float components range from 0 to 255 unless a normalization is set. Other ImageIO settings (e.g. normalization,
+ * color transforms or the header and tile caches) can be set on GetImageIO() before Open().
+ *
+ * \code
+ * reader->SetFileName(fileName);
+ * reader->Open();
+ * reader->ReadPatch(0, x, y, 256, 256, buffer);
+ * \endcode
+ *
+ * ReadPatchImage() returns the patch as an itk::Image instead. With a buffer pool (see SetBufferPool()), the images
+ * and any decode buffers are backed by recycled buffers, so reading a steady stream of patches does not allocate.
+ *
+ * Once opened, several threads may call ReadPatch() concurrently.
+ *
+ *  \ingroup IOOpenSlide
+ */
+template <typename TPixel>
+class ITK_TEMPLATE_EXPORT OpenSlideRegionReader : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlideRegionReader);
+
+  /** Standard class type alias. */
+  using Self = OpenSlideRegionReader;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  using PixelType = TPixel;
+  using PixelTraits = OpenSlideRegionReaderPixelTraits<TPixel>;
+  using ImageType = Image<TPixel, 2>;
+  using ImagePointer = typename ImageType::Pointer;
+  using PooledContainerType = OpenSlidePooledImageContainer<SizeValueType, TPixel>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlideRegionReader);
+
+/** Sets the slide to read. Call Open() again after calling this function. */
+  virtual void SetFileName(const std::string &strFileName);
+
+/** Returns the slide to read. */
+  virtual const std::string & GetFileName() const;
+
+/** Returns the ImageIO that reads the patches (e.g. to configure caches before Open()). */
+  virtual OpenSlideImageIO * GetImageIO() const;
+
+/** Sets a pool for the buffers of ReadPatchImage() and the decode buffers of the ImageIO (none by default).
+ * Patches larger than the pool's buffers are allocated normally. */
+  virtual void SetBufferPool(OpenSlideBufferPool *p_clBufferPool);
+
+/** Returns the pool for the buffers of ReadPatchImage(). */
+  virtual OpenSlideBufferPool * GetBufferPool() const;
+
+/** Opens the slide and reads its image information. Throws an exception on failure. */
+  virtual void Open();
+
+/** Returns whether the slide is opened. */
+  virtual bool IsOpened() const;
+
+/** Returns the number of levels (valid after Open()). */
+  virtual int GetLevelCount() const;
+
+/** Returns the dimensions of the given level. Returns false if the level does not exist or the slide is not opened. */
+  virtual bool GetLevelDimensions(int iLevel, SizeValueType &width, SizeValueType &height) const;
+
+/** Reads width x height pixels of the given level starting at (x, y) into the buffer provided.
+ * Throws an exception if the patch is not inside the level image or the slide is not opened. */
+  virtual void ReadPatch(int iLevel, IndexValueType x, IndexValueType y, SizeValueType width, SizeValueType height,
+                         PixelType *p_Buffer) const;
+
+/** Reads a patch like ReadPatch() into a new image with the index (x, y) and the spacing of the given level.
+ * The image buffer is taken from the buffer pool if one is set and returns to it when the image is destroyed. */
+  virtual ImagePointer ReadPatchImage(int iLevel, IndexValueType x, IndexValueType y, SizeValueType width,
+                                      SizeValueType height) const;
+
+protected:
+  OpenSlideRegionReader();
+  ~OpenSlideRegionReader() {}
+  virtual void PrintSelf(std::ostream& os, Indent indent) const;
+
+private:
+  std::string                  m_FileName;
+  OpenSlideImageIO::Pointer    m_ImageIO;
+  OpenSlideBufferPool::Pointer m_BufferPool;
+  bool                         m_Opened;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkOpenSlideRegionReader.hxx"
+#endif
+
+#endif // itkOpenSlideRegionReader_h
@@ -0,0 +1,212 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkOpenSlideRegionReader_hxx
+#define itkOpenSlideRegionReader_hxx
+
+#include "itkOpenSlideRegionReader.h"
+
+namespace itk
+{
+
+template <typename TPixel>
+OpenSlideRegionReader<TPixel>::OpenSlideRegionReader()
+{
+  m_ImageIO = OpenSlideImageIO::New();
+  m_Opened = false;
+
+  m_ImageIO->SetOutputLayout(PixelTraits::Layout);
+  m_ImageIO->SetOutputComponentType(PixelTraits::ComponentType);
+}
+
+template <typename TPixel>
+void
+OpenSlideRegionReader<TPixel>::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "File Name: " << m_FileName << '\n';
+  os << indent << "Buffer Pool: " << m_BufferPool.GetPointer() << '\n';
+  os << indent << "Opened: " << m_Opened << '\n';
+}
+
+/** Sets the slide to read. */
+template <typename TPixel>
+void
+OpenSlideRegionReader<TPixel>::SetFileName(const std::string & strFileName)
+{
+  m_FileName = strFileName;
+  m_Opened = false;
+  this->Modified();
+}
+
+/** Returns the slide to read. */
+template <typename TPixel>
+const std::string &
+OpenSlideRegionReader<TPixel>::GetFileName() const
+{
+  return m_FileName;
+}
+
+/** Returns the ImageIO that reads the patches. */
+template <typename TPixel>
+OpenSlideImageIO *
+OpenSlideRegionReader<TPixel>::GetImageIO() const
+{
+  return m_ImageIO.GetPointer();
+}
+
+/** Sets the pool for the buffers of ReadPatchImage(). */
+template <typename TPixel>
+void
+OpenSlideRegionReader<TPixel>::SetBufferPool(OpenSlideBufferPool * p_clBufferPool)
+{
+  m_BufferPool = p_clBufferPool;
+  m_ImageIO->SetBufferPool(p_clBufferPool);
+  this->Modified();
+}
+
+/** Returns the pool for the buffers of ReadPatchImage(). */
+template <typename TPixel>
+OpenSlideBufferPool *
+OpenSlideRegionReader<TPixel>::GetBufferPool() const
+{
+  return m_BufferPool.GetPointer();
+}
+
+template <typename TPixel>
+void
+OpenSlideRegionReader<TPixel>::Open()
+{
+  m_Opened = false;
+
+  // The pixel type decides the layout regardless of what was set on the ImageIO
+  m_ImageIO->SetOutputLayout(PixelTraits::Layout);
+  m_ImageIO->SetOutputComponentType(PixelTraits::ComponentType);
+  m_ImageIO->SetFileName(m_FileName);
+  m_ImageIO->ReadImageInformation();
+
+  if (m_ImageIO->GetNumberOfComponents() * m_ImageIO->GetComponentSize() != sizeof(PixelType))
+  {
+    itkExceptionMacro("Error OpenSlideRegionReader could not open file: "
+                      << m_FileName << std::endl
+                      << "Reason: ImageIO pixels do not match the pixel type.");
+  }
+
+  m_Opened = true;
+}
+
+/** Returns whether the slide is opened. */
+template <typename TPixel>
+bool
+OpenSlideRegionReader<TPixel>::IsOpened() const
+{
+  return m_Opened;
+}
+
+/** Returns the number of levels. */
+template <typename TPixel>
+int
+OpenSlideRegionReader<TPixel>::GetLevelCount() const
+{
+  return m_Opened ? m_ImageIO->GetLevelCount() : 0;
+}
+
+/** Returns the dimensions of the given level. */
+template <typename TPixel>
+bool
+OpenSlideRegionReader<TPixel>::GetLevelDimensions(int iLevel, SizeValueType & width, SizeValueType & height) const
+{
+  width = height = 0;
+  return m_Opened && m_ImageIO->GetLevelDimensions(iLevel, width, height);
+}
+
+template <typename TPixel>
+void
+OpenSlideRegionReader<TPixel>::ReadPatch(int            iLevel,
+                                         IndexValueType x,
+                                         IndexValueType y,
+                                         SizeValueType  width,
+                                         SizeValueType  height,
+                                         PixelType *    p_Buffer) const
+{
+  if (!m_Opened)
+  {
+    itkExceptionMacro("Error OpenSlideRegionReader could not read patch: " << m_FileName << std::endl
+                                                                           << "Reason: Slide is not opened.");
+  }
+
+  ImageIORegion clRegion(2);
+  clRegion.SetIndex(0, x);
+  clRegion.SetIndex(1, y);
+  clRegion.SetSize(0, width);
+  clRegion.SetSize(1, height);
+
+  m_ImageIO->ReadRegion(iLevel, clRegion, p_Buffer);
+}
+
+template <typename TPixel>
+auto
+OpenSlideRegionReader<TPixel>::ReadPatchImage(int            iLevel,
+                                              IndexValueType x,
+                                              IndexValueType y,
+                                              SizeValueType  width,
+                                              SizeValueType  height) const -> ImagePointer
+{
+  if (!m_Opened)
+  {
+    itkExceptionMacro("Error OpenSlideRegionReader could not read patch: " << m_FileName << std::endl
+                                                                           << "Reason: Slide is not opened.");
+  }
+
+  typename ImageType::RegionType clRegion;
+  clRegion.SetIndex(0, x);
+  clRegion.SetIndex(1, y);
+  clRegion.SetSize(0, width);
+  clRegion.SetSize(1, height);
+
+  // The ImageIO reports the spacing of its selected level
+  const double dScale = m_ImageIO->GetLevelDownsample(iLevel) / m_ImageIO->GetLevelDownsample(m_ImageIO->GetLevel());
+
+  typename ImageType::SpacingType clSpacing;
+  clSpacing[0] = m_ImageIO->GetSpacing(0) * dScale;
+  clSpacing[1] = m_ImageIO->GetSpacing(1) * dScale;
+
+  ImagePointer p_clImage = ImageType::New();
+  p_clImage->SetRegions(clRegion);
+  p_clImage->SetSpacing(clSpacing);
+
+  const SizeValueType numberOfPixels = clRegion.GetNumberOfPixels();
+
+  if (m_BufferPool.IsNotNull() && numberOfPixels * sizeof(PixelType) <= m_BufferPool->GetBufferSize())
+  {
+    typename PooledContainerType::Pointer p_clContainer = PooledContainerType::New();
+    p_clContainer->AllocateFromPool(m_BufferPool, numberOfPixels);
+    p_clImage->SetPixelContainer(p_clContainer);
+  }
+  else
+  {
+    p_clImage->Allocate(false);
+  }
+
+  this->ReadPatch(iLevel, x, y, width, height, p_clImage->GetBufferPointer());
+
+  return p_clImage;
+}
+
+} // end namespace itk
+
+#endif // itkOpenSlideRegionReader_hxx
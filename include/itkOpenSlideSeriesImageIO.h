@@ -0,0 +1,171 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkOpenSlideSeriesImageIO_h
+#define itkOpenSlideSeriesImageIO_h
+
+#include "itkImageIOBase.h"
+#include "itkOpenSlideImageIO.h"
+#include "IOOpenSlideExport.h"
+
+namespace itk
+{
+
+/** \class OpenSlideSeriesImageIO
+ *
+ * \brief Reads an ordered list of whole-slide images (e.g. serial sections) as one 3D RGBA image.
+ *
+ * Each slide becomes one slice along z. Headers and slices are read concurrently, each slice directly into its part
+ * of the volume buffer, so no intermediate 2D images are joined. Streaming is supported along z and within slices.
+ * Only a bounded number of slides hold open files at a time (see SetMaximumNumberOfOpenSlides()), the others keep
+ * their headers and are opened again when they are read.
+ *
+ * All slides are read at the same level, or, if a target spacing is set, each slide is read at the level that
+ * best matches that spacing (using the openslide.mpp-x property). The volume is as large as the largest slice;
+ * smaller slices are padded with transparent black. Slices are not resampled: the in-plane spacing is that of the
+ * first slide, and ReadImageInformation() throws an exception if the spacing of another slide differs from it by more
+ * than the tolerance (see SetSpacingTolerance()). The slice spacing is set with SetSliceThickness().
+ *
+ * This ImageIO is not registered with the ImageIO factory. Set it on an ImageFileReader with SetImageIO() and give
+ * the reader the first file name:
+ *
+ * \code
+ * io->SetFileNames(fileNames);
+ * reader->SetImageIO(io);
+ * reader->SetFileName(fileNames[0]);
+ * \endcode
+ *
+ *  \warning As with SetApproximateStreaming(), streaming within slices of levels other than 0 may not give
+ *  pixel-by-pixel identical images as reading the slices in all at once.
+ *
+ *  \ingroup IOFilters
+ *
+ *  \ingroup IOOpenSlide
+ */
+class IOOpenSlide_EXPORT OpenSlideSeriesImageIO : public ImageIOBase
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlideSeriesImageIO);
+
+  /** Standard class type alias. */
+  using Self = OpenSlideSeriesImageIO;
+  using Superclass = ImageIOBase;
+  using Pointer = SmartPointer<Self>;
+  using FileNamesContainer = std::vector<std::string>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlideSeriesImageIO);
+
+ /*-------- This part of the interfaces deals with reading data. ----- */
+
+  /** Returns true if the file is a slide OpenSlide can read. */
+  virtual bool CanReadFile(const char*);
+
+  /** Streaming is supported along z and within slices. */
+  virtual bool CanStreamRead();
+
+  /** Reads the headers of all slides and sets the dimensions, spacing and origin of the volume. */
+  virtual void ReadImageInformation();
+
+  /** Reads the IORegion of the volume into the memory buffer provided (slices are read concurrently, in batches of at
+ * most the maximum number of open slides). */
+  virtual void Read(void* buffer);
+
+  /*-------- This part of the interfaces deals with writing data. ----- */
+
+  /** Writing is not supported. */
+  virtual bool CanWriteFile(const char*);
+
+  virtual void WriteImageInformation();
+
+  virtual void Write(const void* buffer);
+
+/** Sets the ordered list of slides. Slide i becomes slice i of the volume.
+ * This also sets the file name to the first slide. */
+  virtual void SetFileNames(const FileNamesContainer &vFileNames);
+
+/** Returns the ordered list of slides. */
+  virtual const FileNamesContainer & GetFileNames() const;
+
+/** Sets the level to read from every slide (default 0). Ignored if a target spacing is set, except for slides without
+ * MPP information. ReadImageInformation() throws an exception if a slide does not have the level. */
+  virtual void SetLevel(int iLevel);
+
+/** Returns the level to read from every slide. */
+  virtual int GetLevel() const;
+
+/** Sets the in-plane spacing (in microns) the levels are selected for. 0 (default) disables this and SetLevel()
+ * is used instead. Slides without MPP information are read at the level given with SetLevel(). */
+  virtual void SetTargetSpacing(double dSpacing);
+
+/** Returns the target in-plane spacing (0 if disabled). */
+  virtual double GetTargetSpacing() const;
+
+/** Sets the spacing along z (default 1). */
+  virtual void SetSliceThickness(double dThickness);
+
+/** Returns the spacing along z. */
+  virtual double GetSliceThickness() const;
+
+/** Sets the largest relative difference of the in-plane spacing of a slide from that of the first slide (default
+ * 0.01). Slices are stacked as they are, so a larger difference would stretch them against each other. */
+  virtual void SetSpacingTolerance(double dTolerance);
+
+/** Returns the largest relative difference of the in-plane spacings. */
+  virtual double GetSpacingTolerance() const;
+
+/** Sets how many slides keep their files open (16 by default, at least 1). The least recently read slides are
+ * released when others need to be read. */
+  virtual void SetMaximumNumberOfOpenSlides(unsigned int uiMaximumNumberOfOpenSlides);
+
+/** Returns how many slides keep their files open. */
+  virtual unsigned int GetMaximumNumberOfOpenSlides() const;
+
+/** Returns the level read from the given slide (valid after ReadImageInformation()). */
+  virtual int GetSliceLevel(unsigned int uiSlice) const;
+
+protected:
+  OpenSlideSeriesImageIO();
+  ~OpenSlideSeriesImageIO();
+  virtual void PrintSelf(std::ostream& os, Indent indent) const;
+
+private:
+  FileNamesContainer                     m_FileNames;
+  std::vector<OpenSlideImageIO::Pointer> m_SliceIOs;
+  std::vector<int>                       m_SliceLevels;
+  int                                    m_Level;
+  double                                 m_TargetSpacing;
+  double                                 m_SliceThickness;
+  double                                 m_SpacingTolerance;
+  unsigned int                           m_MaximumNumberOfOpenSlides;
+  std::vector<uint64_t>                  m_SliceLastUse; // Use counter of each open slide (0 if released)
+  uint64_t                               m_UseCounter;
+  unsigned int                           m_NumberOfOpenSlides;
+
+  // Reads the header of the given slide at its level
+  OpenSlideImageIO::Pointer ReadSliceInformation(size_t slice) const;
+
+  // Marks the given slides as used and releases the least recently used other slides beyond the budget
+  void AcquireSlices(size_t firstSlice, size_t numberOfSlices);
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideSeriesImageIO_h
@@ -0,0 +1,195 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkOpenSlideTiledImage_h
+#define itkOpenSlideTiledImage_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "itkObject.h"
+#include "itkImage.h"
+#include "itkRGBAPixel.h"
+#include "itkOpenSlideImageIO.h"
+#include "IOOpenSlideExport.h"
+
+namespace itk
+{
+
+/** \class OpenSlideTiledImage
+ *
+ * \brief Gives random access to a level image of a slide without reading it in full.
+ *
+ * Pixels are read through an OpenSlideImageIO tile by tile the first time they are accessed. Tiles stay resident
+ * until the memory budget is exceeded, after which the least recently used tiles are released. This suits algorithms
+ * that touch unpredictable parts of the slide (e.g. region growing or connected components) on levels that do not
+ * fit into memory.
+ *
+ * GetPixel() and TransformPhysicalPointToIndex() work like those of itk::Image, so index based code can be
+ * written for both. GetRegion() copies a region into a new itk::Image with the proper spacing and origin, so
+ * existing filters can run on any part of the level.
+ *
+ * \code
+ * io->SetFileName(fileName);
+ * tiledImage->SetImageIO(io);
+ * tiledImage->SetLevel(1);
+ * tiledImage->Initialize();
+ * const PixelType pixel = tiledImage->GetPixel(index);
+ * \endcode
+ *
+ * GetPixel(), ReadRegion() and GetRegion() may be called concurrently. Tiles are read outside of the lock, so
+ * threads only wait for each other when they need the same tile. Each thread keeps its last tile for GetPixel(), so
+ * pixels of that tile are returned without locking (that tile stays allocated until the thread accesses another one,
+ * even if it is released).
+ *
+ *  \ingroup IOOpenSlide
+ */
+class IOOpenSlide_EXPORT OpenSlideTiledImage : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(OpenSlideTiledImage);
+
+  /** Standard class type alias. */
+  using Self = OpenSlideTiledImage;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  using PixelType = RGBAPixel<unsigned char>;
+  using ImageType = Image<PixelType, 2>;
+  using IndexType = ImageType::IndexType;
+  using SizeType = ImageType::SizeType;
+  using RegionType = ImageType::RegionType;
+  using SpacingType = ImageType::SpacingType;
+  using PointType = ImageType::PointType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkOverrideGetNameOfClassMacro(OpenSlideTiledImage);
+
+/** Sets the ImageIO to read from. Its file name must be set; Initialize() selects the level on it and calls
+ * ReadImageInformation(). Its output layout must be RGBA with unsigned char components (the default). */
+  virtual void SetImageIO(OpenSlideImageIO *p_clImageIO);
+
+/** Returns the ImageIO to read from. */
+  virtual OpenSlideImageIO * GetImageIO() const;
+
+/** Sets the level to give access to (default 0). Call Initialize() again after calling this function. */
+  virtual void SetLevel(int iLevel);
+
+/** Returns the level to give access to. */
+  virtual int GetLevel() const;
+
+/** Sets the width and height of the tiles that are read (default 512).
+ * Call Initialize() again after calling this function. */
+  virtual void SetTileSize(SizeValueType tileSize);
+
+/** Returns the width and height of the tiles that are read. */
+  virtual SizeValueType GetTileSize() const;
+
+/** Sets the memory budget in bytes for resident tiles (default 256 MiB). Budgets below one tile keep one tile
+ * resident. */
+  virtual void SetMemoryBudget(uint64_t ui64Bytes);
+
+/** Returns the memory budget in bytes for resident tiles. */
+  virtual uint64_t GetMemoryBudget() const;
+
+/** Reads the image information of the level and releases all tiles. Throws an exception on failure. */
+  virtual void Initialize();
+
+/** Returns the region of the level image (valid after Initialize()). */
+  virtual const RegionType & GetLargestPossibleRegion() const;
+
+/** Returns the spacing of the level image (valid after Initialize()). */
+  virtual const SpacingType & GetSpacing() const;
+
+/** Returns the origin of the level image (valid after Initialize()). */
+  virtual const PointType & GetOrigin() const;
+
+/** Returns the pixel at the given index, reading its tile if it is not resident.
+ * Throws an exception if the index is outside the image or the tile cannot be read. */
+  virtual PixelType GetPixel(const IndexType &clIndex) const;
+
+/** Copies the given region into the buffer provided (reading the tiles that are not resident).
+ * Throws an exception if the region is not inside the image or a tile cannot be read. */
+  virtual void ReadRegion(const RegionType &clRegion, PixelType *p_clBuffer) const;
+
+/** Returns a new image of the given region (see ReadRegion()). */
+  virtual ImageType::Pointer GetRegion(const RegionType &clRegion) const;
+
+/** Computes the index of the given physical point. Returns false if the point is outside the image. */
+  virtual bool TransformPhysicalPointToIndex(const PointType &clPoint, IndexType &clIndex) const;
+
+/** Releases all resident tiles. */
+  virtual void ReleaseTiles();
+
+/** Returns the number of tiles currently resident. */
+  virtual SizeValueType GetNumberOfResidentTiles() const;
+
+/** Returns the number of tiles read since Initialize() (tiles that were released and accessed again count again). */
+  virtual SizeValueType GetNumberOfTileReads() const;
+
+protected:
+  OpenSlideTiledImage();
+  ~OpenSlideTiledImage();
+  virtual void PrintSelf(std::ostream& os, Indent indent) const;
+
+private:
+  struct Tile
+  {
+    int64_t                m_Key;
+    RegionType             m_Region;
+    std::vector<PixelType> m_Pixels;
+  };
+
+  using TilePointer = std::shared_ptr<const Tile>;
+  using TileList = std::list<TilePointer>;
+
+  OpenSlideImageIO::Pointer m_ImageIO;
+  int                       m_Level;
+  SizeValueType             m_TileSize;
+  uint64_t                  m_MemoryBudget;
+  RegionType                m_LargestPossibleRegion;
+  SpacingType               m_Spacing;
+  PointType                 m_Origin;
+  SizeValueType             m_NumberOfTilesX;
+  uint64_t                  m_InstanceId; // Identifies the tiles of this image among the tiles kept by threads
+  std::atomic<uint64_t>     m_Generation; // Incremented when the tiles are released
+
+  mutable std::mutex                                      m_TileMutex;
+  mutable std::condition_variable                         m_TileRead; // Signals the end of the reads of tiles
+  mutable TileList                                        m_Tiles;    // Most recently used first
+  mutable std::unordered_map<int64_t, TileList::iterator> m_TileMap;
+  mutable std::unordered_set<int64_t>                     m_TilesBeingRead;
+  mutable SizeValueType                                   m_NumberOfTileReads;
+
+  // Returns the tile containing the given index, reading it if needed (m_TileMutex must not be locked). Only one
+  // thread reads a tile, others needing it wait for that read.
+  TilePointer GetTile(IndexValueType x, IndexValueType y) const;
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideTiledImage_h
@@ -5,6 +5,9 @@ https://openslide.org.")
 itk_module(IOOpenSlide
   DEPENDS
     ITKIOImageBase
+  PRIVATE_DEPENDS
+    ITKTIFF
+    ITKJPEG
   TEST_DEPENDS
     ITKTestKernel
     ITKIOMeta
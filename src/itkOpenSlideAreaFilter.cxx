@@ -0,0 +1,153 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "itkOpenSlideAreaFilter.h"
+#include "itkOpenSlideThreader.h"
+
+namespace itk
+{
+
+void
+OpenSlideAreaFilter::ComputeWeights(int64_t                i64SourceSize,
+                                    int64_t                i64DestSize,
+                                    double                 dOffset,
+                                    double                 dScale,
+                                    std::vector<int64_t> & vOffsets,
+                                    std::vector<int64_t> & vIndices,
+                                    std::vector<float> &   vWeights)
+{
+  vOffsets.assign(1, 0);
+  vIndices.clear();
+  vWeights.clear();
+
+  for (int64_t i = 0; i < i64DestSize; ++i)
+  {
+    const double  dBegin = std::max(0.0, dOffset + i * dScale);
+    const double  dEnd = std::min((double)i64SourceSize, dOffset + (i + 1) * dScale);
+    const int64_t i64First = (int64_t)dBegin;
+    const int64_t i64Last = std::min(i64SourceSize, (int64_t)std::ceil(dEnd));
+
+    for (int64_t j = i64First; j < i64Last; ++j)
+    {
+      const double dCoverage = std::min(dEnd, j + 1.0) - std::max(dBegin, (double)j);
+      if (dCoverage <= 0.0)
+        continue;
+
+      vIndices.push_back(j);
+      vWeights.push_back((float)(dCoverage / (dEnd - dBegin)));
+    }
+
+    if (vIndices.size() == (size_t)vOffsets.back())
+    {
+      vIndices.push_back(std::min(i64SourceSize - 1, std::max<int64_t>(0, (int64_t)dBegin)));
+      vWeights.push_back(1.0f);
+    }
+
+    vOffsets.push_back((int64_t)vIndices.size());
+  }
+}
+
+void
+OpenSlideAreaFilter::ResampleRow(const uint32_t *             p_ui32Source,
+                                 int64_t                      i64SourceWidth,
+                                 const std::vector<int64_t> & vXOffsets,
+                                 const std::vector<int64_t> & vXIndices,
+                                 const std::vector<float> &   vXWeights,
+                                 const std::vector<int64_t> & vYOffsets,
+                                 const std::vector<int64_t> & vYIndices,
+                                 const std::vector<float> &   vYWeights,
+                                 int64_t                      i64DestY,
+                                 uint32_t *                   p_ui32Dest)
+{
+  const int64_t      i64DestWidth = (int64_t)vXOffsets.size() - 1;
+  std::vector<float> vRow(4 * i64SourceWidth, 0.0f);
+
+  // Vertical pass into one row of floats, then the horizontal pass (channels in ARGB byte order from the top)
+  for (int64_t k = vYOffsets[i64DestY]; k < vYOffsets[i64DestY + 1]; ++k)
+  {
+    const uint32_t * const p_ui32Row = p_ui32Source + vYIndices[k] * i64SourceWidth;
+    const float            fWeight = vYWeights[k];
+
+    for (int64_t x = 0; x < i64SourceWidth; ++x)
+    {
+      const uint32_t ui32Pixel = p_ui32Row[x];
+      vRow[4 * x] += fWeight * (ui32Pixel >> 24);
+      vRow[4 * x + 1] += fWeight * ((ui32Pixel >> 16) & 0xff);
+      vRow[4 * x + 2] += fWeight * ((ui32Pixel >> 8) & 0xff);
+      vRow[4 * x + 3] += fWeight * (ui32Pixel & 0xff);
+    }
+  }
+
+  for (int64_t x = 0; x < i64DestWidth; ++x)
+  {
+    float a_fSum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int64_t k = vXOffsets[x]; k < vXOffsets[x + 1]; ++k)
+    {
+      const float * const p_fPixel = &vRow[4 * vXIndices[k]];
+      for (int c = 0; c < 4; ++c)
+        a_fSum[c] += vXWeights[k] * p_fPixel[c];
+    }
+
+    uint32_t ui32Pixel = 0;
+    for (int c = 0; c < 4; ++c)
+      ui32Pixel = (ui32Pixel << 8) | (uint32_t)std::min(255.0f, a_fSum[c] + 0.5f);
+
+    p_ui32Dest[x] = ui32Pixel;
+  }
+}
+
+void
+OpenSlideAreaFilter::Resample(const uint32_t * p_ui32Source,
+                              int64_t          i64SourceWidth,
+                              int64_t          i64SourceHeight,
+                              double           dOffsetX,
+                              double           dOffsetY,
+                              double           dScaleX,
+                              double           dScaleY,
+                              uint32_t *       p_ui32Dest,
+                              int64_t          i64DestWidth,
+                              int64_t          i64DestHeight)
+{
+  std::vector<int64_t> vXOffsets, vXIndices, vYOffsets, vYIndices;
+  std::vector<float>   vXWeights, vYWeights;
+
+  ComputeWeights(i64SourceWidth, i64DestWidth, dOffsetX, dScaleX, vXOffsets, vXIndices, vXWeights);
+  ComputeWeights(i64SourceHeight, i64DestHeight, dOffsetY, dScaleY, vYOffsets, vYIndices, vYWeights);
+
+  OpenSlideThreader::ParallelizeArray(
+    i64DestHeight,
+    [&](int64_t i64Y) {
+      ResampleRow(p_ui32Source,
+                  i64SourceWidth,
+                  vXOffsets,
+                  vXIndices,
+                  vXWeights,
+                  vYOffsets,
+                  vYIndices,
+                  vYWeights,
+                  i64Y,
+                  p_ui32Dest + i64Y * i64DestWidth);
+    },
+    false);
+}
+
+} // end namespace itk
@@ -0,0 +1,78 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideAreaFilter_h
+#define itkOpenSlideAreaFilter_h
+
+#include <cstdint>
+#include <vector>
+
+namespace itk
+{
+
+// Area (box) filter resampling of ARGB pixels
+// Each destination pixel is the average of the source pixels it covers, weighted by the covered fraction of each.
+// This is what reads between pyramid levels and thumbnails use to scale down without aliasing.
+class OpenSlideAreaFilter
+{
+public:
+  // Computes the weights of an area (box) filter resampling i64SourceSize samples to i64DestSize samples.
+  // Destination sample i covers the source coordinates dOffset + i * dScale to dOffset + (i + 1) * dScale and averages
+  // the source samples vIndices[vOffsets[i]] to vIndices[vOffsets[i + 1] - 1] with the given weights (the fraction of
+  // each source sample it covers, normalized to sum to 1). Parts outside of the source are ignored (destination
+  // samples entirely outside take the nearest source sample).
+  static void
+  ComputeWeights(int64_t                i64SourceSize,
+                 int64_t                i64DestSize,
+                 double                 dOffset,
+                 double                 dScale,
+                 std::vector<int64_t> & vOffsets,
+                 std::vector<int64_t> & vIndices,
+                 std::vector<float> &   vWeights);
+
+  // Computes row i64DestY of the area filtered image as ARGB pixels (see ComputeWeights())
+  static void
+  ResampleRow(const uint32_t *             p_ui32Source,
+              int64_t                      i64SourceWidth,
+              const std::vector<int64_t> & vXOffsets,
+              const std::vector<int64_t> & vXIndices,
+              const std::vector<float> &   vXWeights,
+              const std::vector<int64_t> & vYOffsets,
+              const std::vector<int64_t> & vYIndices,
+              const std::vector<float> &   vYWeights,
+              int64_t                      i64DestY,
+              uint32_t *                   p_ui32Dest);
+
+  // Resamples ARGB pixels in parallel rows. Destination pixel (x, y) covers the source pixels
+  // dOffsetX + x * dScaleX to dOffsetX + (x + 1) * dScaleX (and likewise in y).
+  static void
+  Resample(const uint32_t * p_ui32Source,
+           int64_t          i64SourceWidth,
+           int64_t          i64SourceHeight,
+           double           dOffsetX,
+           double           dOffsetY,
+           double           dScaleX,
+           double           dScaleY,
+           uint32_t *       p_ui32Dest,
+           int64_t          i64DestWidth,
+           int64_t          i64DestHeight);
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideAreaFilter_h
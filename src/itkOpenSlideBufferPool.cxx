@@ -0,0 +1,348 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(_WIN32)
+#  include <malloc.h>
+#else
+#  include <sys/mman.h>
+#endif
+
+#include "itkOpenSlideBufferPool.h"
+
+namespace itk
+{
+
+namespace
+{
+
+// Transparent huge pages on x86-64 and most ARM64 kernels
+const size_t hugePageSize = 2 << 20;
+
+} // end anonymous namespace
+
+OpenSlideBufferPool::OpenSlideBufferPool()
+{
+  m_BufferSize = 0;
+  m_Alignment = 64;
+  m_UseHugePages = false;
+  m_MaximumNumberOfFreeBuffers = 64;
+  m_AllocationSize = 0;
+  m_NumberOfAcquisitions = 0;
+  m_NumberOfAllocations = 0;
+  m_NumberOfDeallocations = 0;
+}
+
+OpenSlideBufferPool::~OpenSlideBufferPool()
+{
+  // Buffers still in use are leaked rather than pulled from under their users
+  for (size_t i = 0; i < m_FreeBuffers.size(); ++i)
+    Deallocate(m_FreeBuffers[i]);
+}
+
+void
+OpenSlideBufferPool::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Buffer Size: " << m_BufferSize << '\n';
+  os << indent << "Alignment: " << m_Alignment << '\n';
+  os << indent << "Use Huge Pages: " << m_UseHugePages << '\n';
+  os << indent << "Maximum Number Of Free Buffers: " << m_MaximumNumberOfFreeBuffers << '\n';
+  os << indent << "Acquisitions: " << this->GetNumberOfAcquisitions() << '\n';
+  os << indent << "Allocations: " << this->GetNumberOfAllocations() << '\n';
+  os << indent << "Deallocations: " << this->GetNumberOfDeallocations() << '\n';
+  os << indent << "Buffers In Use: " << this->GetNumberOfBuffersInUse() << '\n';
+  os << indent << "Free Buffers: " << this->GetNumberOfFreeBuffers() << '\n';
+}
+
+/** Sets the size in bytes of the buffers. */
+void
+OpenSlideBufferPool::SetBufferSize(size_t bufferSize)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_BufferSize = bufferSize;
+  this->UpdateAllocationSize();
+  this->Modified();
+}
+
+/** Returns the size in bytes of the buffers. */
+size_t
+OpenSlideBufferPool::GetBufferSize() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_BufferSize;
+}
+
+void
+OpenSlideBufferPool::SetAlignment(size_t alignment)
+{
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void *) != 0)
+  {
+    itkExceptionMacro("Error OpenSlideBufferPool could not set alignment: "
+                      << alignment << std::endl
+                      << "Reason: Alignment is not a power of 2 and a multiple of " << sizeof(void *) << '.');
+  }
+
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_Alignment = alignment;
+  this->UpdateAllocationSize();
+  this->Modified();
+}
+
+/** Returns the alignment in bytes of the buffers. */
+size_t
+OpenSlideBufferPool::GetAlignment() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_Alignment;
+}
+
+/** Turn on/off backing buffers with huge pages. */
+void
+OpenSlideBufferPool::SetUseHugePages(bool bUseHugePages)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_UseHugePages = bUseHugePages;
+  this->UpdateAllocationSize();
+  this->Modified();
+}
+
+/** Returns whether buffers are backed with huge pages. */
+bool
+OpenSlideBufferPool::GetUseHugePages() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_UseHugePages;
+}
+
+/** Sets how many released buffers are kept. */
+void
+OpenSlideBufferPool::SetMaximumNumberOfFreeBuffers(size_t maximumNumberOfFreeBuffers)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_MaximumNumberOfFreeBuffers = maximumNumberOfFreeBuffers;
+
+  while (m_FreeBuffers.size() > m_MaximumNumberOfFreeBuffers)
+  {
+    Deallocate(m_FreeBuffers.back());
+    m_FreeBuffers.pop_back();
+    ++m_NumberOfDeallocations;
+  }
+
+  this->Modified();
+}
+
+/** Returns how many released buffers are kept. */
+size_t
+OpenSlideBufferPool::GetMaximumNumberOfFreeBuffers() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_MaximumNumberOfFreeBuffers;
+}
+
+void *
+OpenSlideBufferPool::AcquireBuffer(size_t size)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  if (m_BufferSize == 0 || size > m_BufferSize)
+  {
+    itkExceptionMacro("Error OpenSlideBufferPool could not acquire buffer of " << size << " bytes." << std::endl
+                                                                                << "Reason: Buffer size is "
+                                                                                << m_BufferSize << " bytes.");
+  }
+
+  ++m_NumberOfAcquisitions;
+
+  void * p_Buffer = NULL;
+
+  if (!m_FreeBuffers.empty())
+  {
+    p_Buffer = m_FreeBuffers.back();
+    m_FreeBuffers.pop_back();
+  }
+  else
+  {
+    p_Buffer = this->Allocate();
+
+    if (p_Buffer == NULL)
+    {
+      itkExceptionMacro("Error OpenSlideBufferPool could not acquire buffer of " << size << " bytes." << std::endl
+                                                                                  << "Reason: Allocation failed.");
+    }
+
+    ++m_NumberOfAllocations;
+  }
+
+  m_BuffersInUse.emplace(p_Buffer, m_AllocationSize);
+
+  return p_Buffer;
+}
+
+void
+OpenSlideBufferPool::ReleaseBuffer(void * p_Buffer)
+{
+  if (p_Buffer == NULL)
+    return;
+
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  auto itr = m_BuffersInUse.find(p_Buffer);
+  if (itr == m_BuffersInUse.end())
+  {
+    itkExceptionMacro("Error OpenSlideBufferPool could not release buffer." << std::endl
+                                                                            << "Reason: Buffer is not in use.");
+  }
+
+  // Buffers acquired before the size or alignment changed do not fit later requests
+  if (itr->second == m_AllocationSize && m_FreeBuffers.size() < m_MaximumNumberOfFreeBuffers)
+  {
+    m_FreeBuffers.push_back(p_Buffer);
+  }
+  else
+  {
+    Deallocate(p_Buffer);
+    ++m_NumberOfDeallocations;
+  }
+
+  m_BuffersInUse.erase(itr);
+}
+
+/** Deallocates all free buffers. */
+void
+OpenSlideBufferPool::ReleaseFreeBuffers()
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  for (size_t i = 0; i < m_FreeBuffers.size(); ++i)
+    Deallocate(m_FreeBuffers[i]);
+
+  m_NumberOfDeallocations += m_FreeBuffers.size();
+  m_FreeBuffers.clear();
+}
+
+/** Returns the number of buffers requested. */
+uint64_t
+OpenSlideBufferPool::GetNumberOfAcquisitions() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_NumberOfAcquisitions;
+}
+
+/** Returns the number of buffers that were allocated. */
+uint64_t
+OpenSlideBufferPool::GetNumberOfAllocations() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_NumberOfAllocations;
+}
+
+/** Returns the number of buffers that were deallocated. */
+uint64_t
+OpenSlideBufferPool::GetNumberOfDeallocations() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_NumberOfDeallocations;
+}
+
+/** Returns the number of buffers in use. */
+size_t
+OpenSlideBufferPool::GetNumberOfBuffersInUse() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_BuffersInUse.size();
+}
+
+/** Returns the number of free buffers. */
+size_t
+OpenSlideBufferPool::GetNumberOfFreeBuffers() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_FreeBuffers.size();
+}
+
+/** Resets the counters. */
+void
+OpenSlideBufferPool::ResetCounters()
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_NumberOfAcquisitions = 0;
+  m_NumberOfAllocations = 0;
+  m_NumberOfDeallocations = 0;
+}
+
+void
+OpenSlideBufferPool::UpdateAllocationSize()
+{
+  const size_t alignment = this->GetAllocationAlignment();
+
+  m_AllocationSize = (m_BufferSize + alignment - 1) / alignment * alignment;
+
+  for (size_t i = 0; i < m_FreeBuffers.size(); ++i)
+    Deallocate(m_FreeBuffers[i]);
+
+  m_NumberOfDeallocations += m_FreeBuffers.size();
+  m_FreeBuffers.clear();
+}
+
+size_t
+OpenSlideBufferPool::GetAllocationAlignment() const
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (m_UseHugePages)
+    return std::max(m_Alignment, hugePageSize);
+#endif // __linux__ && MADV_HUGEPAGE
+
+  return m_Alignment;
+}
+
+void *
+OpenSlideBufferPool::Allocate() const
+{
+  const size_t alignment = this->GetAllocationAlignment();
+
+#if defined(_WIN32)
+  return _aligned_malloc(m_AllocationSize, alignment);
+#else
+  void * p_Buffer = NULL;
+  if (posix_memalign(&p_Buffer, alignment, m_AllocationSize) != 0)
+    return NULL;
+
+#  if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // Only a hint: this fails harmlessly if transparent huge pages are disabled
+  if (m_UseHugePages)
+    madvise(p_Buffer, m_AllocationSize, MADV_HUGEPAGE);
+#  endif // __linux__ && MADV_HUGEPAGE
+
+  return p_Buffer;
+#endif // _WIN32
+}
+
+void
+OpenSlideBufferPool::Deallocate(void * p_Buffer)
+{
+#if defined(_WIN32)
+  _aligned_free(p_Buffer);
+#else
+  free(p_Buffer);
+#endif // _WIN32
+}
+
+} // end namespace itk
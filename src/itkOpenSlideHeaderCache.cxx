@@ -0,0 +1,282 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "itkOpenSlideHeaderCache.h"
+#include "itksys/SystemTools.hxx"
+
+namespace itk
+{
+
+bool
+OpenSlideHeaderCache::Load(const std::string & strCacheDirectory,
+                           const std::string & strFileName,
+                           OpenSlideHeader &   clHeader)
+{
+  clHeader.Clear();
+
+  std::string strPath, strKey;
+  if (!GetKey(strFileName, strPath, strKey))
+    return false;
+
+  std::ifstream cacheStream(GetCacheFileName(strCacheDirectory, strPath).c_str(), std::ios::binary);
+  if (!cacheStream)
+    return false;
+
+  std::string strLine;
+  if (!std::getline(cacheStream, strLine) || strLine != GetMagic())
+    return false;
+
+  if (!std::getline(cacheStream, strLine) || strLine != strKey)
+    return false; // Slide changed or hash collision
+
+  while (std::getline(cacheStream, strLine))
+  {
+    std::vector<std::string> vFields;
+    Split(strLine, vFields);
+
+    if (vFields.size() == 2 && vFields[0] == "vendor")
+    {
+      clHeader.m_Vendor = vFields[1];
+    }
+    else if (vFields.size() == 4 && vFields[0] == "level")
+    {
+      clHeader.m_LevelWidths.push_back(strtoll(vFields[1].c_str(), NULL, 10));
+      clHeader.m_LevelHeights.push_back(strtoll(vFields[2].c_str(), NULL, 10));
+      clHeader.m_LevelDownsamples.push_back(strtod(vFields[3].c_str(), NULL));
+    }
+    else if (vFields.size() == 4 && vFields[0] == "associated")
+    {
+      clHeader.m_AssociatedImageNames.push_back(vFields[1]);
+      clHeader.m_AssociatedImageWidths.push_back(strtoll(vFields[2].c_str(), NULL, 10));
+      clHeader.m_AssociatedImageHeights.push_back(strtoll(vFields[3].c_str(), NULL, 10));
+    }
+    else if (vFields.size() == 3 && vFields[0] == "property")
+    {
+      clHeader.m_Properties[vFields[1]] = vFields[2];
+    }
+    else if (vFields.size() == 1 && vFields[0] == "end")
+    {
+      return clHeader.m_LevelWidths.size() > 0;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  // Truncated or corrupt
+  clHeader.Clear();
+  return false;
+}
+
+bool
+OpenSlideHeaderCache::Save(const std::string &     strCacheDirectory,
+                           const std::string &     strFileName,
+                           const OpenSlideHeader & clHeader)
+{
+  std::string strPath, strKey;
+  if (!GetKey(strFileName, strPath, strKey))
+    return false;
+
+  if (!itksys::SystemTools::MakeDirectory(strCacheDirectory))
+    return false;
+
+  const std::string strCacheFileName = GetCacheFileName(strCacheDirectory, strPath);
+
+  std::stringstream tmpNameStream;
+  tmpNameStream << strCacheFileName << ".tmp" << std::hex << std::random_device()();
+  const std::string strTmpFileName = tmpNameStream.str();
+
+  {
+    std::ofstream cacheStream(strTmpFileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!cacheStream)
+      return false;
+
+    cacheStream << std::setprecision(17);
+    cacheStream << GetMagic() << '\n' << strKey << '\n';
+    cacheStream << "vendor\t" << Escape(clHeader.m_Vendor) << '\n';
+
+    for (size_t i = 0; i < clHeader.m_LevelWidths.size(); ++i)
+    {
+      cacheStream << "level\t" << clHeader.m_LevelWidths[i] << '\t' << clHeader.m_LevelHeights[i] << '\t'
+                  << clHeader.m_LevelDownsamples[i] << '\n';
+    }
+
+    for (size_t i = 0; i < clHeader.m_AssociatedImageNames.size(); ++i)
+    {
+      cacheStream << "associated\t" << Escape(clHeader.m_AssociatedImageNames[i]) << '\t'
+                  << clHeader.m_AssociatedImageWidths[i] << '\t' << clHeader.m_AssociatedImageHeights[i] << '\n';
+    }
+
+    for (std::map<std::string, std::string>::const_iterator itr = clHeader.m_Properties.begin();
+         itr != clHeader.m_Properties.end();
+         ++itr)
+    {
+      cacheStream << "property\t" << Escape(itr->first) << '\t' << Escape(itr->second) << '\n';
+    }
+
+    cacheStream << "end\n";
+
+    if (!cacheStream)
+    {
+      cacheStream.close();
+      itksys::SystemTools::RemoveFile(strTmpFileName);
+      return false;
+    }
+  }
+
+  if (!itksys::SystemTools::RenameFile(strTmpFileName, strCacheFileName))
+  {
+    itksys::SystemTools::RemoveFile(strTmpFileName);
+    return false;
+  }
+
+  return true;
+}
+
+bool
+OpenSlideHeaderCache::GetKey(const std::string & strFileName, std::string & strPath, std::string & strKey)
+{
+  if (!itksys::SystemTools::FileExists(strFileName, true))
+    return false;
+
+  strPath = itksys::SystemTools::CollapseFullPath(strFileName);
+
+  std::stringstream keyStream;
+  keyStream << Escape(strPath) << '\t' << itksys::SystemTools::FileLength(strFileName) << '\t'
+            << itksys::SystemTools::ModifiedTime(strFileName);
+
+  // MIRAX keeps the slide header in Slidedat.ini of a directory named like the slide without extension, so rewriting
+  // it leaves the .mrxs untouched. The key covers it when it exists (and changes when it appears or disappears).
+  const std::string strCompanion = itksys::SystemTools::GetFilenamePath(strPath) + '/' +
+                                   itksys::SystemTools::GetFilenameWithoutLastExtension(strPath) + "/Slidedat.ini";
+
+  if (itksys::SystemTools::FileExists(strCompanion, true))
+  {
+    keyStream << '\t' << Escape(strCompanion) << '\t' << itksys::SystemTools::FileLength(strCompanion) << '\t'
+              << itksys::SystemTools::ModifiedTime(strCompanion);
+  }
+
+  strKey = keyStream.str();
+
+  return true;
+}
+
+uint64_t
+OpenSlideHeaderCache::Hash(const std::string & strValue)
+{
+  uint64_t ui64Hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < strValue.size(); ++i)
+  {
+    ui64Hash ^= (unsigned char)strValue[i];
+    ui64Hash *= 1099511628211ULL;
+  }
+
+  return ui64Hash;
+}
+
+const char *
+OpenSlideHeaderCache::GetMagic()
+{
+  return "ITKIOOpenSlide header cache 1";
+}
+
+std::string
+OpenSlideHeaderCache::GetCacheFileName(const std::string & strCacheDirectory, const std::string & strPath)
+{
+  std::stringstream nameStream;
+  nameStream << strCacheDirectory << '/' << std::hex << std::setw(16) << std::setfill('0') << Hash(strPath)
+             << ".oshdr";
+
+  return nameStream.str();
+}
+
+std::string
+OpenSlideHeaderCache::Escape(const std::string & strValue)
+{
+  std::string strEscaped;
+  for (size_t i = 0; i < strValue.size(); ++i)
+  {
+    switch (strValue[i])
+    {
+      case '\\':
+        strEscaped += "\\\\";
+        break;
+      case '\t':
+        strEscaped += "\\t";
+        break;
+      case '\n':
+        strEscaped += "\\n";
+        break;
+      case '\r':
+        strEscaped += "\\r";
+        break;
+      default:
+        strEscaped += strValue[i];
+        break;
+    }
+  }
+
+  return strEscaped;
+}
+
+void
+OpenSlideHeaderCache::Split(const std::string & strLine, std::vector<std::string> & vFields)
+{
+  vFields.clear();
+  vFields.push_back(std::string());
+
+  for (size_t i = 0; i < strLine.size(); ++i)
+  {
+    if (strLine[i] == '\t')
+    {
+      vFields.push_back(std::string());
+    }
+    else if (strLine[i] == '\\' && i + 1 < strLine.size())
+    {
+      ++i;
+      switch (strLine[i])
+      {
+        case 't':
+          vFields.back() += '\t';
+          break;
+        case 'n':
+          vFields.back() += '\n';
+          break;
+        case 'r':
+          vFields.back() += '\r';
+          break;
+        default:
+          vFields.back() += strLine[i];
+          break;
+      }
+    }
+    else
+    {
+      vFields.back() += strLine[i];
+    }
+  }
+}
+
+} // end namespace itk
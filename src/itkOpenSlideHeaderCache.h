@@ -0,0 +1,92 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideHeaderCache_h
+#define itkOpenSlideHeaderCache_h
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+// Everything ReadImageInformation() and the query functions need to know about a slide.
+// This is gathered once when the slide is opened (or loaded from the header cache) so that
+// queries do not need an openslide_t context.
+struct OpenSlideHeader
+{
+  std::string                        m_Vendor;
+  std::vector<int64_t>               m_LevelWidths;
+  std::vector<int64_t>               m_LevelHeights;
+  std::vector<double>                m_LevelDownsamples;
+  std::map<std::string, std::string> m_Properties;
+  std::vector<std::string>           m_AssociatedImageNames;
+  std::vector<int64_t>               m_AssociatedImageWidths;
+  std::vector<int64_t>               m_AssociatedImageHeights;
+
+  void
+  Clear()
+  {
+    *this = OpenSlideHeader();
+  }
+};
+
+// Persistent header cache
+// Each slide header is stored in its own small text file in the cache directory. The file name is derived from the
+// absolute slide path and the file records the path, size and modification time of the slide (and of the companion
+// header of multi-file formats like MIRAX). A cached header is only used when all of them still match. Files are
+// written to a temporary name and then renamed so that concurrent processes never see partially written headers.
+class OpenSlideHeaderCache
+{
+public:
+  static bool
+  Load(const std::string & strCacheDirectory, const std::string & strFileName, OpenSlideHeader & clHeader);
+
+  static bool
+  Save(const std::string & strCacheDirectory, const std::string & strFileName, const OpenSlideHeader & clHeader);
+
+  // The key identifies the slide file and its content (path, size and modification time of the slide and its companion
+  // header file, if any)
+  static bool
+  GetKey(const std::string & strFileName, std::string & strPath, std::string & strKey);
+
+  // FNV-1a hash (stable across builds unlike std::hash)
+  static uint64_t
+  Hash(const std::string & strValue);
+
+private:
+  static const char *
+  GetMagic();
+
+  // Named after the hash of the absolute path
+  static std::string
+  GetCacheFileName(const std::string & strCacheDirectory, const std::string & strPath);
+
+  // Tabs, line breaks and backslashes are escaped so that each record stays on one line
+  static std::string
+  Escape(const std::string & strValue);
+
+  static void
+  Split(const std::string & strLine, std::vector<std::string> & vFields);
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideHeaderCache_h
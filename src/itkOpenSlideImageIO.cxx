@@ -16,546 +16,71 @@
  *
  *=========================================================================*/
 
-#include <cctype>
+#include <cmath>
+#include <cstring>
 #include <algorithm>
-#include <sstream>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <unordered_map>
 
 #include "itkIOCommon.h"
 #include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideAreaFilter.h"
+#include "itkOpenSlidePixelConverter.h"
+#include "itkOpenSlideStatistics.h"
+#include "itkOpenSlideThreader.h"
+#include "itkOpenSlideWrapper.h"
 #include "itksys/SystemTools.hxx"
 #include "itkMetaDataDictionary.h"
 #include "itkMetaDataObject.h"
-
-// OpenSlide
-#include "openslide.h"
+#include "itkRGBPixel.h"
 
 namespace itk
 {
 
-// OpenSlide wrapper class
-// This is responsible for freeing the OpenSlide context on destruction
-// It also allows for seamless access to various levels and associated images through one set of functions (as opposed
-// to two)
-class OpenSlideWrapper
+// Decode buffer of Read(), ReadRegion() and ReadRegions(), taken from the buffer pool when one is set and its buffers
+// are large enough
+class OpenSlideDecodeBuffer
 {
 public:
-  // GCD Algorithm from wikipedia pseudo code:
-  // https://en.wikipedia.org/wiki/Greatest_common_divisor#Binary_method
-  //
-  // NOTE: While vnl_rational can do this too, vnl_rational is defined for long integers (32 bit integers on amd64).
-  //       Slides can be extremely large. It would ideal to work with 64 bit integers.
-  static uint64_t
-  GCD(uint64_t ui64A, uint64_t ui64B)
-  {
-    if (ui64A == 0)
-      return ui64B;
-
-    if (ui64B == 0)
-      return ui64A;
-
-    if (ui64A == 1 || ui64B == 1)
-      return 1;
-
-    if (ui64A == ui64B)
-      return ui64A;
-
-    unsigned int uiExp = 0;
-    while ((ui64A & 1) == 0 && (ui64B & 1) == 0)
-    {
-      ui64A >>= 1;
-      ui64B >>= 1;
-      ++uiExp;
-    }
-
-    while (ui64A != ui64B)
-    {
-      if ((ui64A & 1) == 0)
-        ui64A >>= 1;
-      else if ((ui64B & 1) == 0)
-        ui64B >>= 1;
-      else if (ui64A > ui64B)
-        ui64A = (ui64A - ui64B) >> 1;
-      else
-        ui64B = (ui64B - ui64A) >> 1;
-    }
-
-    return ui64A << uiExp;
-  }
-
-  // Detects the vendor. Should return NULL if the file is not readable.
-  static const char *
-  DetectVendor(const char * p_cFileName)
-  {
-    return openslide_detect_vendor(p_cFileName);
-  }
-
-  // Weak check if the file can be read
-  static bool
-  CanReadFile(const char * p_cFileName)
-  {
-    return DetectVendor(p_cFileName) != NULL;
-  }
-
-  // Returns version of OpenSlide library
-  static const char *
-  GetVersion()
-  {
-    return openslide_get_version();
-  }
-
-  // Constructors
-  OpenSlideWrapper()
-  {
-    m_Osr = NULL;
-    m_Level = 0;
-    m_ApproximateStreaming = false;
-  }
-
-  OpenSlideWrapper(const char * p_cFileName)
-  {
-    m_Osr = NULL;
-    m_Level = 0;
-    m_ApproximateStreaming = false;
-    Open(p_cFileName);
-  }
-
-  // Destructor
-  ~OpenSlideWrapper() { Close(); }
-
-  // Set whether streaming should be approximate or exact
-  void
-  SetApproximateStreaming(bool bApproximateStreaming)
-  {
-    m_ApproximateStreaming = bApproximateStreaming;
-  }
-
-  // Determine whether streaming is exact or approximate
-  bool
-  GetApproximateStreaming() const
-  {
-    return m_ApproximateStreaming;
-  }
-
-  // Tells the ImageIO if the wrapper is in a state where stream reading can occur.
-  // While OpenSlide supports reading regions of level images, it does not for associated images.
-  bool
-  CanStreamRead() const
-  {
-    if (m_AssociatedImage.size() > 0)
-      return false;
-
-    // XXX: ITK streams along X. Shouldn't we check if the minimum spacing in Y is not the size of the whole image?
-    return m_ApproximateStreaming || ComputeMaximumNumberOfStreamableRegions() > 1;
-  }
-
-  // Closes the currently opened file
-  void
-  Close()
-  {
-    if (m_Osr != NULL)
-    {
-      openslide_close(m_Osr);
-      m_Osr = NULL;
-    }
-  }
-
-  // Checks weather a slide file is currently opened
-  bool
-  IsOpened() const
-  {
-    return m_Osr != NULL;
-  }
-
-  // Opens a slide file
-  bool
-  Open(const char * p_cFileName)
-  {
-    Close();
-    m_Osr = openslide_open(p_cFileName);
-    return m_Osr != NULL;
-  }
-
-  // Get error string, NULL if there is no error
-  const char *
-  GetError() const
-  {
-    if (m_Osr == NULL)
-      return "OpenSlideWrapper has no file open.";
-
-    return openslide_get_error(m_Osr);
-  }
-
-  // Sets the level that is accessible with ReadRegion, GetDimensions, GetSpacing.
-  // Clears any associated image context.
-  void
-  SetLevel(int32_t i32Level)
-  {
-    m_Level = i32Level;
-    m_AssociatedImage.clear();
-  }
-
-  // Returns the currently selected level
-  int32_t
-  GetLevel() const
-  {
-    return m_Level;
-  }
-
-  // Sets the associated image that is accessible with ReadRegion, GetDimensions
-  void
-  SetAssociatedImageName(const std::string & strImageName)
-  {
-    m_AssociatedImage = strImageName;
-    m_Level = 0;
-  }
-
-  // Returns the currently selected associated image
-  const std::string &
-  GetAssociatedImageName() const
-  {
-    return m_AssociatedImage;
-  }
-
-  // Given a downsample factor, uses OpenSlide to determine the best level to use.
-  bool
-  SetBestLevelForDownsample(double dDownsample)
-  {
-    if (m_Osr == NULL)
-      return false;
-
-    const int32_t i32Level = openslide_get_best_level_for_downsample(m_Osr, dDownsample);
-
-    if (i32Level < 0)
-      return false;
-
-    SetLevel(i32Level);
-
-    return true;
-  }
-
-  // Returns the number of levels in this file
-  int32_t
-  GetLevelCount() const
-  {
-    if (m_Osr == NULL)
-      return -1;
-
-    return openslide_get_level_count(m_Osr);
-  }
-
-  // Returns NULL for success
-  // NOTE: When reading associated images, x, y, width and height are ignored.
-  const char *
-  ReadRegion(uint32_t * p_ui32Dest, int64_t i64X, int64_t i64Y, int64_t i64Width, int64_t i64Height) const
-  {
-    if (m_Osr == NULL)
-      return "OpenSlideWrapper has no file open.";
-
-    if (m_AssociatedImage.size() > 0)
-    {
-      openslide_read_associated_image(m_Osr, m_AssociatedImage.c_str(), p_ui32Dest);
-    }
-    else
-    {
-      const double dDownsampleFactor = openslide_get_level_downsample(m_Osr, m_Level);
-
-      if (dDownsampleFactor <= 0.0)
-        return "Could not get downsample factor.";
-
-      // NOTE: API expects level 0 coordinates. So we upsample the coordinates.
-      // XXX: This can subtly change the image compared to reading all at once.
-      //      The handling of coordinates internally in OpenSlide is quite similar!
-      i64X = (int64_t)(i64X * dDownsampleFactor);
-      i64Y = (int64_t)(i64Y * dDownsampleFactor);
-
-      openslide_read_region(m_Osr, p_ui32Dest, i64X, i64Y, m_Level, i64Width, i64Height);
-    }
-
-    return openslide_get_error(m_Osr);
-  }
-
-  // Computes the spacing depending on selected level
-  // Default spacing is relative to 1 MPP if the function fails to detect spacing information (downsample factor is
-  // considered)
-  bool
-  GetSpacing(double & dSpacingX, double & dSpacingY) const
+  OpenSlideDecodeBuffer(OpenSlideBufferPool * p_clBufferPool, size_t count)
   {
-    dSpacingX = dSpacingY = 1.0;
+    m_BufferPool = NULL;
+    m_Buffer = NULL;
 
-    if (m_Osr == NULL)
-      return false;
-
-    if (m_AssociatedImage.size() > 0)
-      return false;
-
-    const double dDownsample = openslide_get_level_downsample(m_Osr, m_Level);
+    if (count == 0)
+      return;
 
-    if (dDownsample <= 0.0)
-      return false;
-
-    if (!GetPropertyValue(OPENSLIDE_PROPERTY_NAME_MPP_X, dSpacingX) ||
-        !GetPropertyValue(OPENSLIDE_PROPERTY_NAME_MPP_Y, dSpacingY))
+    if (p_clBufferPool != NULL && count * sizeof(uint32_t) <= p_clBufferPool->GetBufferSize())
     {
-      dSpacingX = dSpacingY = dDownsample;
-      return false;
+      m_Buffer = (uint32_t *)p_clBufferPool->AcquireBuffer(count * sizeof(uint32_t));
+      m_BufferPool = p_clBufferPool;
     }
-
-    dSpacingX *= dDownsample;
-    dSpacingY *= dDownsample;
-
-    return true;
-  }
-
-  // Returns the dimension of the level or associated image
-  bool
-  GetDimensions(int64_t & i64Width, int64_t & i64Height) const
-  {
-    i64Width = i64Height = 0;
-
-    if (m_Osr == NULL)
-      return false;
-
-    if (m_AssociatedImage.size() > 0)
-      openslide_get_associated_image_dimensions(m_Osr, m_AssociatedImage.c_str(), &i64Width, &i64Height);
     else
-      openslide_get_level_dimensions(m_Osr, m_Level, &i64Width, &i64Height);
-
-    return i64Width > 0 && i64Height > 0;
-  }
-
-  // Retrieves associated image names from the open slide and places them into a std::vector
-  std::vector<std::string>
-  GetAssociatedImageNames() const
-  {
-    if (m_Osr == NULL)
-      return std::vector<std::string>();
-
-    const char * const * p_cNames = openslide_get_associated_image_names(m_Osr);
-
-    if (p_cNames == NULL)
-      return std::vector<std::string>();
-
-    std::vector<std::string> vNames;
-
-    for (int i = 0; p_cNames[i] != NULL; ++i)
-      vNames.push_back(p_cNames[i]);
-
-    return vNames;
-  }
-
-  // Forms an ITK MetaDataDictionary
-  MetaDataDictionary
-  GetMetaDataDictionary() const
-  {
-    if (m_Osr == NULL)
-      return MetaDataDictionary();
-
-    MetaDataDictionary clTags;
-
-    const char * const * p_cNames = openslide_get_property_names(m_Osr);
-
-    if (p_cNames != NULL)
     {
-      std::string strValue;
-
-      for (int i = 0; p_cNames[i] != NULL; ++i)
-      {
-        strValue.clear();
-
-        if (GetPropertyValue(p_cNames[i], strValue))
-          EncapsulateMetaData<std::string>(clTags, p_cNames[i], strValue);
-      }
-    }
-
-    return clTags;
-  }
-
-  // Templated functions for accessing and casting property values
-  template <typename ValueType>
-  bool
-  GetPropertyValue(const char * p_cKey, ValueType & value) const
-  {
-    if (m_Osr == NULL)
-      return false;
-
-    const char * const p_cValue = openslide_get_property_value(m_Osr, p_cKey);
-    if (p_cValue == NULL)
-      return false;
-
-    std::stringstream valueStream;
-
-    valueStream << p_cValue;
-    valueStream >> value;
-
-    return !valueStream.fail() && !valueStream.bad();
-  }
-
-  bool
-  GetPropertyValue(const char * p_cKey, std::string & strValue) const
-  {
-    if (m_Osr == NULL)
-      return false;
-
-    const char * const p_cValue = openslide_get_property_value(m_Osr, p_cKey);
-    if (p_cValue == NULL)
-      return false;
-
-    strValue = p_cValue;
-    return true;
-  }
-
-  // Compute the minimum streamable region size
-  // Explanation:
-  // OpenSlide expects level 0 coordinates in openslide_read_region(). This is OK if we're reading level 0 images.
-  // However, if we're reading level L images with L > 0, this becomes problematic. This can be seen with a little math.
-  // First, note the equation relating level 0 and level L coordinates:
-  //
-  // x_0 = D * x_L
-  //
-  // Here D is the downsample factor and is a real number (openslide_get_level_downsample() returns double).
-  // From OpenSlide's source code, OpenSlide downsamples x_0 to x_L with a floor operation:
-  //
-  // x_L = floor(x_0 / D)
-  //
-  // Likewise, OpenSlide upsamples x_0 with a floor operation
-  //
-  // x_0 = floor(x_L * D)
-  //
-  // In this implementation, ITK works with coordinates at the selected level. When L > 0, it becomes challenging
-  // to pick coordinates x_0 that identify x_L exactly. We derive x_0 by upsampling as above. But several values of x_0
-  // will map to x_L. We need to pick x_L so that it is invariant to an upsample and subsequent downsample. In math we
-  // want x_L so that:
-  //
-  // x_L = Downsample(Upsample(x_L)) = floor(floor(x_L * D) / D)
-  //
-  // D is known to be a rational number A/B since it is computed by dividing the dimensions of level 0 and level L
-  // images. If A/B is a reduced fraction, we would like to determine x_L so that it is divisible by B. When B divides
-  // x_L we have the identity:
-  //
-  // Upsample(x_L) = D * x_L
-  //
-  // A subsequent downsample gives:
-  //
-  // Downsample(D * x_L) = x_L
-  //
-  // Which is what we wanted. Consequently, if dimensions are coprime, the image cannot technically be streamed.
-  // In that case the ImageIORegion would reflect entire level L image.
-  // This wrapper also supports approximate streaming (ignoring this issue).
-  bool
-  ComputeMinimumStreamableRegionSize(int64_t & i64Width, int64_t & i64Height) const
-  {
-    i64Width = i64Height = 0;
-
-    if (m_Osr == NULL)
-      return false;
-
-    if (m_Level == 0 || m_ApproximateStreaming)
-    { // Nothing to do
-      i64Width = i64Height = 1;
-      return true;
+      m_vBuffer.resize(count);
+      m_Buffer = m_vBuffer.data();
     }
-
-    int64_t i64WidthLevel0 = 0, i64HeightLevel0 = 0;
-    int64_t i64WidthLevelL = 0, i64HeightLevelL = 0;
-
-    openslide_get_level0_dimensions(m_Osr, &i64WidthLevel0, &i64HeightLevel0);
-    openslide_get_level_dimensions(m_Osr, m_Level, &i64WidthLevelL, &i64HeightLevelL);
-
-    if (i64WidthLevel0 <= 0 || i64HeightLevel0 <= 0 || i64WidthLevelL <= 0 || i64HeightLevelL <= 0)
-      return false;
-
-    i64Width = i64WidthLevelL / (int64_t)GCD(i64WidthLevel0, i64WidthLevelL);
-    i64Height = i64HeightLevelL / (int64_t)GCD(i64HeightLevel0, i64HeightLevelL);
-
-    return true;
-  }
-
-  // Compute absolute maximum number of streamable regions
-  int64_t
-  ComputeMaximumNumberOfStreamableRegions() const
-  {
-    int64_t i64RegionWidth = 0, i64RegionHeight = 0;
-
-    if (!ComputeMinimumStreamableRegionSize(i64RegionWidth, i64RegionHeight))
-      return -1;
-
-    int64_t i64Width = 0, i64Height = 0;
-
-    openslide_get_level_dimensions(m_Osr, m_Level, &i64Width, &i64Height);
-
-    if (i64Width <= 0 || i64Height <= 0)
-      return -1;
-
-    // NOTE: The width and height are multiplies of region width and height
-    return (i64Width / i64RegionWidth) * (i64Height / i64RegionHeight);
   }
 
-  // After alignment, what's the maximum number of streamable regions of this size?
-  int64_t
-  ComputeMaximumNumberOfStreamableRegions(int64_t i64X, int64_t i64Y, int64_t i64Width, int64_t i64Height) const
+  ~OpenSlideDecodeBuffer()
   {
-    if (m_Osr == NULL)
-      return -1;
-
-    int64_t i64ImageWidth = 0, i64ImageHeight = 0;
-
-    openslide_get_level_dimensions(m_Osr, m_Level, &i64ImageWidth, &i64ImageHeight);
-
-    if (i64ImageWidth <= 0 || i64ImageHeight <= 0)
-      return -1;
-
-    if (!AlignReadRegion(i64X, i64Y, i64Width, i64Height))
-      return -1;
-
-    return (i64ImageWidth + i64Width - 1) / i64Width * (i64ImageHeight + i64Height - 1) / i64Height;
+    if (m_BufferPool != NULL)
+      m_BufferPool->ReleaseBuffer(m_Buffer);
   }
 
-  // Align X, Y and region dimensions to be on the grid of points invariant to upsample/downsample
-  bool
-  AlignReadRegion(int64_t & i64X, int64_t & i64Y, int64_t & i64Width, int64_t & i64Height) const
-  {
-    if (m_Osr == NULL)
-      return false;
-
-    if (m_Level == 0 || m_ApproximateStreaming) // Nothing to do
-      return true;
-
-    int64_t i64MinWidth = 0, i64MinHeight = 0;
-
-    if (!ComputeMinimumStreamableRegionSize(i64MinWidth, i64MinHeight))
-      return false;
-
-    int64_t i64XUpper = i64X + i64Width;
-    int64_t i64YUpper = i64Y + i64Height;
-
-    // Align X and Y to be on the grid with spacing MinWidth and MinHeight
-    int64_t r = (i64X % i64MinWidth);
-    i64X -= r;
-
-    r = (i64Y % i64MinHeight);
-    i64Y -= r;
-
-    // Align the upper coordinates (remove remainder and add one full spacing)
-    r = (i64XUpper % i64MinWidth);
-    if (r != 0)
-      i64XUpper += i64MinWidth - r;
-
-    r = (i64YUpper % i64MinHeight);
-    if (r != 0)
-      i64YUpper += i64MinHeight - r;
-
-    // Update width and height
-    i64Width = i64XUpper - i64X;
-    i64Height = i64YUpper - i64Y;
-
-    return true;
-  }
+  uint32_t * GetBuffer() const { return m_Buffer; }
 
 private:
-  openslide_t * m_Osr;
-  int32_t       m_Level;
-  std::string   m_AssociatedImage;
-  bool          m_ApproximateStreaming;
+  OpenSlideBufferPool * m_BufferPool;
+  uint32_t *            m_Buffer;
+  std::vector<uint32_t> m_vBuffer;
+
+  OpenSlideDecodeBuffer(const OpenSlideDecodeBuffer &) = delete;
+  OpenSlideDecodeBuffer & operator=(const OpenSlideDecodeBuffer &) = delete;
 };
 
 OpenSlideImageIO::OpenSlideImageIO()
@@ -565,6 +90,19 @@ OpenSlideImageIO::OpenSlideImageIO()
 
   m_OpenSlideWrapper = NULL;
   m_OpenSlideWrapper = new OpenSlideWrapper();
+  m_Statistics = new OpenSlideStatistics();
+  m_PixelConverter = new OpenSlidePixelConverter();
+  m_ComputeStatistics = false;
+  m_TissueSaturationThreshold = 20;
+  m_MemoryBudget = 0;
+  m_TileCacheSize = 4ULL << 30;
+  m_ReuseStreamingBorders = false;
+  m_PaddingMode = PaddingEnum::Transparent;
+  m_ResamplingMode = ResamplingEnum::Exact;
+  m_BorderLevel = -1;
+  m_BorderX = m_BorderY = m_BorderWidth = m_BorderHeight = 0;
+  m_NumberOfReusedPixels = 0;
+  m_NumberOfPaddedPixels = 0;
 
   this->SetNumberOfDimensions(2); // OpenSlide is 2D.
   this->SetPixelTypeInfo(&clPixel);
@@ -605,14 +143,43 @@ OpenSlideImageIO::~OpenSlideImageIO()
     delete m_OpenSlideWrapper;
     m_OpenSlideWrapper = NULL;
   }
+
+  delete m_Statistics;
+  m_Statistics = NULL;
+
+  delete m_PixelConverter;
+  m_PixelConverter = NULL;
 }
 
 void
 OpenSlideImageIO::PrintSelf(std::ostream & os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
+
+  double dScale = 0.0, a_dMean[4], a_dStdDev[4];
+  this->GetNormalization(dScale, a_dMean, a_dStdDev);
+
   os << indent << "Level: " << GetLevel() << '\n';
   os << indent << "Associated Image: " << GetAssociatedImageName() << '\n';
+  os << indent << "Header Cache Directory: " << m_HeaderCacheDirectory << '\n';
+  os << indent << "Tile Cache Directory: " << m_TileCacheDirectory << '\n';
+  os << indent << "Tile Cache Size: " << m_TileCacheSize << '\n';
+  os << indent << "Buffer Pool: " << m_BufferPool.GetPointer() << '\n';
+  os << indent << "Reuse Streaming Borders: " << m_ReuseStreamingBorders << '\n';
+  os << indent << "Padding Mode: " << static_cast<int>(m_PaddingMode) << '\n';
+  os << indent << "Reused Pixels: " << m_NumberOfReusedPixels << '\n';
+  os << indent << "Padded Pixels: " << m_NumberOfPaddedPixels << '\n';
+  os << indent << "Direct Tile Decoding: " << GetDirectTileDecoding() << '\n';
+  os << indent << "Resampling Mode: " << static_cast<int>(m_ResamplingMode) << '\n';
+  os << indent << "Compute Statistics: " << m_ComputeStatistics << '\n';
+  os << indent << "Tissue Saturation Threshold: " << m_TissueSaturationThreshold << '\n';
+  os << indent << "Use Bounds: " << GetUseBounds() << '\n';
+  os << indent << "Pixels Skipped By Bounds: " << GetNumberOfPixelsSkippedByBounds() << '\n';
+  os << indent << "Output Layout: " << static_cast<int>(this->GetOutputLayout()) << '\n';
+  os << indent << "Output Component Type: " << static_cast<int>(this->GetOutputComponentType()) << '\n';
+  os << indent << "Normalization Scale: " << dScale << '\n';
+  os << indent << "Color Transform: " << static_cast<int>(this->GetColorTransform()) << '\n';
+  os << indent << "Memory Budget: " << m_MemoryBudget << '\n';
 }
 
 bool
@@ -646,11 +213,8 @@ OpenSlideImageIO::CanStreamRead()
 void
 OpenSlideImageIO::ReadImageInformation()
 {
-  using PixelType = RGBAPixel<unsigned char>;
-  PixelType clPixel;
-
   this->SetNumberOfDimensions(2);
-  this->SetPixelTypeInfo(&clPixel);
+  this->UpdatePixelTypeInfo();
 
   m_Dimensions[0] = 0;
   m_Dimensions[1] = 0;
@@ -661,13 +225,23 @@ OpenSlideImageIO::ReadImageInformation()
   m_Origin[0] = 0.0;
   m_Origin[1] = 0.0;
 
+  // The previous piece may be of another file, level or associated image
+  std::vector<uint32_t>().swap(m_BorderPixels);
+  m_BorderLevel = -1;
+  m_NumberOfReusedPixels = 0;
+  m_NumberOfPaddedPixels = 0;
+
   if (m_OpenSlideWrapper == NULL)
   {
     itkExceptionMacro("Error OpenSlideImageIO could not open file: " << this->GetFileName() << std::endl
                                                                      << "Reason: NULL OpenSlideWrapper pointer.");
   }
 
-  if (!m_OpenSlideWrapper->Open(this->GetFileName()))
+  const bool bOpened = m_HeaderCacheDirectory.empty()
+                         ? m_OpenSlideWrapper->Open(this->GetFileName())
+                         : m_OpenSlideWrapper->Open(this->GetFileName(), m_HeaderCacheDirectory);
+
+  if (!bOpened)
   {
     itkExceptionMacro("Error OpenSlideImageIO could not open file: " << this->GetFileName() << std::endl
                                                                      << "Reason: "
@@ -675,9 +249,14 @@ OpenSlideImageIO::ReadImageInformation()
     // NOTE: OpenSlide needs to be opened to query API for errors. This is assumed to be related to a system error.
   }
 
+  if (!m_OpenSlideWrapper->SetTileCache(m_TileCacheDirectory, m_TileCacheSize))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not use tile cache directory: " << m_TileCacheDirectory);
+  }
 
   // This will fill in default values as needed (in case it fails)
   m_OpenSlideWrapper->GetSpacing(m_Spacing[0], m_Spacing[1]);
+  m_OpenSlideWrapper->GetOrigin(m_Origin[0], m_Origin[1]);
 
   {
     int64_t i64Width = 0, i64Height = 0;
@@ -710,6 +289,35 @@ OpenSlideImageIO::ReadImageInformation()
     m_Dimensions[1] = (SizeValueType)i64Height;
   }
 
+  const ColorTransformEnum eColorTransform = m_PixelConverter->GetColorTransform();
+
+  const char * const p_cOutputError = m_PixelConverter->CheckOutput();
+  if (p_cOutputError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read image information: " << this->GetFileName() << std::endl
+                                                                                  << "Reason: " << p_cOutputError);
+  }
+
+  if (eColorTransform == ColorTransformEnum::Macenko)
+  {
+    double a_dStains[9];
+
+    // Too little stained tissue: keep the stain matrix
+    if (m_OpenSlideWrapper->EstimateMacenkoStains(a_dStains))
+      m_PixelConverter->SetStainMatrix(a_dStains);
+  }
+
+  if (eColorTransform == ColorTransformEnum::Reinhard)
+  {
+    double a_dMean[3], a_dStdDev[3];
+
+    // No tissue: leave the colors as they are
+    if (!m_OpenSlideWrapper->ComputeLabStatistics(a_dMean, a_dStdDev))
+      m_PixelConverter->GetReinhardTarget(a_dMean, a_dStdDev);
+
+    m_PixelConverter->SetReinhardSource(a_dMean, a_dStdDev);
+  }
+
   this->SetMetaDataDictionary(m_OpenSlideWrapper->GetMetaDataDictionary());
 }
 
@@ -717,7 +325,7 @@ OpenSlideImageIO::ReadImageInformation()
 void
 OpenSlideImageIO::Read(void * buffer)
 {
-  uint32_t * const p_u32Buffer = (uint32_t *)buffer;
+  uint32_t * p_u32Buffer = (uint32_t *)buffer;
 
   if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
   {
@@ -725,6 +333,13 @@ OpenSlideImageIO::Read(void * buffer)
                                                                        << "Reason: OpenSlide context is not opened.");
   }
 
+  const char * const p_cOutputError = m_PixelConverter->CheckOutput();
+  if (p_cOutputError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: " << p_cOutputError);
+  }
+
   const ImageIORegion            clRegionToRead = this->GetIORegion();
   const ImageIORegion::SizeType  clSize = clRegionToRead.GetSize();
   const ImageIORegion::IndexType clStart = clRegionToRead.GetIndex();
@@ -736,7 +351,34 @@ OpenSlideImageIO::Read(void * buffer)
                       << "Reason: Requested region size in pixels overflows.");
   }
 
-  const char * p_cError = m_OpenSlideWrapper->ReadRegion(p_u32Buffer, clStart[0], clStart[1], clSize[0], clSize[1]);
+  // Only unsigned char RGBA has the size of OpenSlide's ARGB pixels, others are converted from a decode buffer
+  const bool bDecode = m_PixelConverter->NeedsDecodeBuffer();
+
+  const char * p_cError = NULL;
+
+  // Direct tile decoding writes the output itself, but only pieces inside of a level image without reused borders
+  if (!m_ReuseStreamingBorders && m_OpenSlideWrapper->GetAssociatedImageName().empty() && clStart[0] >= 0 &&
+      clStart[1] >= 0 && clStart[0] + clSize[0] <= this->GetDimensions(0) &&
+      clStart[1] + clSize[1] <= this->GetDimensions(1) &&
+      this->ReadLevelRegionDirectly(
+        m_OpenSlideWrapper->GetLevel(), clStart[0], clStart[1], clSize[0], clSize[1], buffer, p_cError))
+  {
+    if (p_cError != NULL)
+    {
+      std::string strError = p_cError;
+      m_OpenSlideWrapper->Close();
+      itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                         << "Reason: " << strError);
+    }
+
+    return;
+  }
+
+  OpenSlideDecodeBuffer clDecodeBuffer(m_BufferPool.GetPointer(), bDecode ? clRegionToRead.GetNumberOfPixels() : 0);
+  if (bDecode)
+    p_u32Buffer = clDecodeBuffer.GetBuffer();
+
+  p_cError = this->ReadStreamingPiece(p_u32Buffer, clStart[0], clStart[1], clSize[0], clSize[1]);
 
   if (p_cError != NULL)
   {
@@ -746,233 +388,2361 @@ OpenSlideImageIO::Read(void * buffer)
                                                                        << "Reason: " << strError);
   }
 
-  // Re-order the bytes (ARGB -> RGBA)
-  const int64_t i64TotalSize = clRegionToRead.GetNumberOfPixels();
-  for (int64_t i = 0; i < i64TotalSize; ++i)
-  {
-    // XXX: Endianness?
-    RGBAPixel<unsigned char> clPixel;
-    clPixel.SetRed((p_u32Buffer[i] >> 16) & 0xff);
-    clPixel.SetGreen((p_u32Buffer[i] >> 8) & 0xff);
-    clPixel.SetBlue(p_u32Buffer[i] & 0xff);
-    clPixel.SetAlpha((p_u32Buffer[i] >> 24) & 0xff);
+  if (m_ComputeStatistics)
+    this->AccumulateStatistics(p_u32Buffer, clRegionToRead.GetNumberOfPixels(), false);
 
-    p_u32Buffer[i] = *reinterpret_cast<uint32_t *>(clPixel.GetDataPointer());
-  }
+  m_PixelConverter->Convert(p_u32Buffer, buffer, clRegionToRead.GetNumberOfPixels(), false);
 }
 
 bool
-OpenSlideImageIO::CanWriteFile(const char * /*name*/)
+OpenSlideImageIO::ReadLevelRegionDirectly(int           iLevel,
+                                          int64_t       i64X,
+                                          int64_t       i64Y,
+                                          int64_t       i64Width,
+                                          int64_t       i64Height,
+                                          void *        buffer,
+                                          const char *& p_cError) const
 {
-  return false;
+  if (m_PixelConverter->GetOutputComponentType() != OutputComponentEnum::UnsignedChar ||
+      m_PixelConverter->GetColorTransform() != ColorTransformEnum::None || m_ComputeStatistics)
+    return false;
+
+  switch (m_PixelConverter->GetOutputLayout())
+  {
+    case OutputLayoutEnum::RGBA:
+      return m_OpenSlideWrapper->DecodeLevelRegion(
+        buffer, OpenSlideTileFormatEnum::RGBA, iLevel, i64X, i64Y, i64Width, i64Height, p_cError);
+    case OutputLayoutEnum::RGB:
+      return m_OpenSlideWrapper->DecodeLevelRegion(
+        buffer, OpenSlideTileFormatEnum::RGB, iLevel, i64X, i64Y, i64Width, i64Height, p_cError);
+    default:
+      return false;
+  }
 }
 
-void
-OpenSlideImageIO ::WriteImageInformation(void)
+const char *
+OpenSlideImageIO::ReadStreamingPiece(uint32_t * p_u32Dest,
+                                     int64_t    i64X,
+                                     int64_t    i64Y,
+                                     int64_t    i64Width,
+                                     int64_t    i64Height)
 {
-  // add writing here
-}
+  // Associated images are always read whole
+  if (m_OpenSlideWrapper->GetAssociatedImageName().size() > 0)
+    return m_OpenSlideWrapper->ReadRegion(p_u32Dest, i64X, i64Y, i64Width, i64Height);
 
+  int64_t i64ImageWidth = 0, i64ImageHeight = 0;
+  if (!m_OpenSlideWrapper->GetDimensions(i64ImageWidth, i64ImageHeight))
+    return "Could not get image dimensions.";
 
-/**
- *
- */
-void
-OpenSlideImageIO::Write(const void * /*buffer*/)
-{}
+  const int64_t i64InsideX = std::max<int64_t>(i64X, 0);
+  const int64_t i64InsideY = std::max<int64_t>(i64Y, 0);
+  const int64_t i64InsideWidth = std::max<int64_t>(0, std::min(i64X + i64Width, i64ImageWidth) - i64InsideX);
+  const int64_t i64InsideHeight = std::max<int64_t>(0, std::min(i64Y + i64Height, i64ImageHeight) - i64InsideY);
 
-/** Given a requested region, determine what could be the region that we can
- * read from the file. This is called the streamable region, which will be
- * smaller than the LargestPossibleRegion and greater or equal to the
-RequestedRegion */
-ImageIORegion
-OpenSlideImageIO::GenerateStreamableReadRegionFromRequestedRegion(const ImageIORegion & requested) const
-{
+  if (i64InsideWidth == i64Width && i64InsideHeight == i64Height)
+    return this->ReadReusingBorders(p_u32Dest, i64X, i64Y, i64Width, i64Height);
+
+  m_NumberOfPaddedPixels += i64Width * i64Height - i64InsideWidth * i64InsideHeight;
+
+  const bool bReplicate = m_PaddingMode == PaddingEnum::Replicate;
+
+  if (i64ImageWidth <= 0 || i64ImageHeight <= 0 || (!bReplicate && (i64InsideWidth == 0 || i64InsideHeight == 0)))
+  {
+    std::fill(p_u32Dest, p_u32Dest + i64Width * i64Height, 0);
+    return NULL;
+  }
+
+  // Decode the pixels inside of the image. For Replicate, this is the nearest edge row or column if the region does
+  // not overlap the image in that direction.
+  const int64_t i64SourceX = std::min(std::max<int64_t>(i64X, 0), i64ImageWidth - 1);
+  const int64_t i64SourceY = std::min(std::max<int64_t>(i64Y, 0), i64ImageHeight - 1);
+  const int64_t i64SourceWidth =
+    std::min(std::max<int64_t>(i64X + i64Width, 1), i64ImageWidth) - i64SourceX;
+  const int64_t i64SourceHeight =
+    std::min(std::max<int64_t>(i64Y + i64Height, 1), i64ImageHeight) - i64SourceY;
+
+  std::vector<uint32_t> vSource(i64SourceWidth * i64SourceHeight);
+
+  const char * const p_cError =
+    this->ReadReusingBorders(vSource.data(), i64SourceX, i64SourceY, i64SourceWidth, i64SourceHeight);
+  if (p_cError != NULL)
+    return p_cError;
+
+  // Columns [0, i64LeftEnd) and [i64RightBegin, i64Width) of the destination are padding
+  const int64_t i64LeftEnd = std::min(std::max<int64_t>(i64SourceX - i64X, 0), i64Width);
+  const int64_t i64RightBegin =
+    std::max(std::min<int64_t>(i64SourceX + i64SourceWidth - i64X, i64Width), i64LeftEnd);
+
+  for (int64_t y = 0; y < i64Height; ++y)
+  {
+    uint32_t * const p_u32DestRow = p_u32Dest + y * i64Width;
+    const int64_t    i64SourceRow = i64Y + y;
+
+    if (!bReplicate && (i64SourceRow < i64SourceY || i64SourceRow >= i64SourceY + i64SourceHeight))
+    {
+      std::fill(p_u32DestRow, p_u32DestRow + i64Width, 0);
+      continue;
+    }
+
+    const uint32_t * const p_u32SourceRow =
+      vSource.data() +
+      (std::min(std::max(i64SourceRow, i64SourceY), i64SourceY + i64SourceHeight - 1) - i64SourceY) * i64SourceWidth;
+
+    std::fill(p_u32DestRow, p_u32DestRow + i64LeftEnd, bReplicate ? p_u32SourceRow[0] : 0);
+    std::copy(p_u32SourceRow + (i64X + i64LeftEnd - i64SourceX),
+              p_u32SourceRow + (i64X + i64RightBegin - i64SourceX),
+              p_u32DestRow + i64LeftEnd);
+    std::fill(p_u32DestRow + i64RightBegin,
+              p_u32DestRow + i64Width,
+              bReplicate ? p_u32SourceRow[i64SourceWidth - 1] : 0);
+  }
+
+  return NULL;
+}
+
+const char *
+OpenSlideImageIO::ReadReusingBorders(uint32_t * p_u32Dest,
+                                     int64_t    i64X,
+                                     int64_t    i64Y,
+                                     int64_t    i64Width,
+                                     int64_t    i64Height)
+{
+  const int32_t i32Level = m_OpenSlideWrapper->GetLevel();
+
+  // Rectangles of levels other than 0 are only exact on the grid of streamable regions
+  if (!m_ReuseStreamingBorders || (i32Level != 0 && !m_OpenSlideWrapper->GetApproximateStreaming()))
+    return m_OpenSlideWrapper->ReadRegion(p_u32Dest, i64X, i64Y, i64Width, i64Height);
+
+  int64_t i64BeginX = 0, i64BeginY = 0, i64EndX = 0, i64EndY = 0; // The overlap with the previous piece
+  if (!m_BorderPixels.empty() && m_BorderLevel == i32Level)
+  {
+    i64BeginX = std::max(i64X, m_BorderX);
+    i64BeginY = std::max(i64Y, m_BorderY);
+    i64EndX = std::min(i64X + i64Width, m_BorderX + m_BorderWidth);
+    i64EndY = std::min(i64Y + i64Height, m_BorderY + m_BorderHeight);
+  }
+
+  const char * p_cError = NULL;
+
+  if (i64BeginX >= i64EndX || i64BeginY >= i64EndY)
+  {
+    p_cError = m_OpenSlideWrapper->ReadRegion(p_u32Dest, i64X, i64Y, i64Width, i64Height);
+  }
+  else
+  {
+    for (int64_t y = i64BeginY; y < i64EndY; ++y)
+    {
+      const uint32_t * const p_u32Border =
+        m_BorderPixels.data() + (y - m_BorderY) * m_BorderWidth + (i64BeginX - m_BorderX);
+      std::copy(p_u32Border,
+                p_u32Border + (i64EndX - i64BeginX),
+                p_u32Dest + (y - i64Y) * i64Width + (i64BeginX - i64X));
+    }
+
+    m_NumberOfReusedPixels += (i64EndX - i64BeginX) * (i64EndY - i64BeginY);
+
+    // Full width rows above and below the overlap are contiguous in the destination
+    if (i64BeginY > i64Y)
+      p_cError = m_OpenSlideWrapper->ReadRegion(p_u32Dest, i64X, i64Y, i64Width, i64BeginY - i64Y);
+
+    if (p_cError == NULL && i64EndY < i64Y + i64Height)
+    {
+      p_cError = m_OpenSlideWrapper->ReadRegion(
+        p_u32Dest + (i64EndY - i64Y) * i64Width, i64X, i64EndY, i64Width, i64Y + i64Height - i64EndY);
+    }
+
+    // Columns left and right of the overlap are decoded separately and copied into their rows
+    const int64_t a_i64ColumnX[2] = { i64X, i64EndX };
+    const int64_t a_i64ColumnWidth[2] = { i64BeginX - i64X, i64X + i64Width - i64EndX };
+
+    std::vector<uint32_t> vColumns;
+    for (int i = 0; i < 2 && p_cError == NULL; ++i)
+    {
+      if (a_i64ColumnWidth[i] <= 0)
+        continue;
+
+      vColumns.resize(a_i64ColumnWidth[i] * (i64EndY - i64BeginY));
+      p_cError = m_OpenSlideWrapper->ReadRegion(
+        vColumns.data(), a_i64ColumnX[i], i64BeginY, a_i64ColumnWidth[i], i64EndY - i64BeginY);
+
+      for (int64_t y = i64BeginY; p_cError == NULL && y < i64EndY; ++y)
+      {
+        const uint32_t * const p_u32Column = vColumns.data() + (y - i64BeginY) * a_i64ColumnWidth[i];
+        std::copy(p_u32Column,
+                  p_u32Column + a_i64ColumnWidth[i],
+                  p_u32Dest + (y - i64Y) * i64Width + (a_i64ColumnX[i] - i64X));
+      }
+    }
+  }
+
+  if (p_cError != NULL)
+  {
+    m_BorderPixels.clear();
+    return p_cError;
+  }
+
+  m_BorderPixels.assign(p_u32Dest, p_u32Dest + i64Width * i64Height);
+  m_BorderLevel = i32Level;
+  m_BorderX = i64X;
+  m_BorderY = i64Y;
+  m_BorderWidth = i64Width;
+  m_BorderHeight = i64Height;
+
+  return NULL;
+}
+
+void
+OpenSlideImageIO::ReadRegion(int iLevel, const ImageIORegion & clRegion, void * buffer) const
+{
+  this->ReadSingleRegion(iLevel, clRegion, buffer, false);
+}
+
+void
+OpenSlideImageIO::ReadSingleRegion(int iLevel, const ImageIORegion & clRegion, void * buffer, bool bSerial) const
+{
+  uint32_t * p_u32Buffer = (uint32_t *)buffer;
+
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: OpenSlide context is not opened.");
+  }
+
+  // Also checked here since the color transform or the component type may have changed after ReadImageInformation()
+  const char * const p_cOutputError = m_PixelConverter->CheckOutput();
+  if (p_cOutputError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: " << p_cOutputError);
+  }
+
+  const ImageIORegion::SizeType  clSize = clRegion.GetSize();
+  const ImageIORegion::IndexType clStart = clRegion.GetIndex();
+
+  if (clStart.size() != 2 || clSize.size() != 2)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: Region is not 2D.");
+  }
+
+  int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(iLevel, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: Invalid level " << iLevel << '.');
+  }
+
+  if (clStart[0] < 0 || clStart[1] < 0 || (int64_t)(clStart[0] + clSize[0]) > i64LevelWidth ||
+      (int64_t)(clStart[1] + clSize[1]) > i64LevelHeight)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Region is outside of level " << iLevel << " image.");
+  }
+
+  if (((uint64_t)clSize[0]) * ((uint64_t)clSize[1]) > std::numeric_limits<ImageIORegion::SizeValueType>::max())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Requested region size in pixels overflows.");
+  }
+
+  const char * p_cError = NULL;
+  if (this->ReadLevelRegionDirectly(iLevel, clStart[0], clStart[1], clSize[0], clSize[1], buffer, p_cError))
+  {
+    if (p_cError != NULL)
+    {
+      itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                         << "Reason: " << p_cError);
+    }
+
+    return;
+  }
+
+  const bool bDecode = m_PixelConverter->NeedsDecodeBuffer();
+
+  OpenSlideDecodeBuffer clDecodeBuffer(m_BufferPool.GetPointer(), bDecode ? clRegion.GetNumberOfPixels() : 0);
+  if (bDecode)
+    p_u32Buffer = clDecodeBuffer.GetBuffer();
+
+  p_cError = m_OpenSlideWrapper->ReadLevelRegion(p_u32Buffer, iLevel, clStart[0], clStart[1], clSize[0], clSize[1]);
+
+  if (p_cError != NULL)
+  {
+    // NOTE: Unlike Read(), the context is not closed here since other threads may be using it.
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: " << p_cError);
+  }
+
+  if (m_ComputeStatistics)
+    this->AccumulateStatistics(p_u32Buffer, clRegion.GetNumberOfPixels(), bSerial);
+
+  m_PixelConverter->Convert(p_u32Buffer, buffer, clRegion.GetNumberOfPixels(), bSerial);
+}
+
+void
+OpenSlideImageIO::ReadRegions(int iLevel, const RegionContainer & vRegions, void * buffer) const
+{
+  if (vRegions.empty())
+    return;
+
+  const ImageIORegion::SizeType clSize = vRegions[0].GetSize();
+
+  for (size_t i = 1; i < vRegions.size(); ++i)
+  {
+    if (vRegions[i].GetSize() != clSize)
+    {
+      itkExceptionMacro("Error OpenSlideImageIO could not read regions: " << this->GetFileName() << std::endl
+                                                                          << "Reason: Regions differ in size.");
+    }
+  }
+
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read regions: " << this->GetFileName() << std::endl
+                                                                        << "Reason: OpenSlide context is not opened.");
+  }
+
+  const char * const p_cOutputError = m_PixelConverter->CheckOutput();
+  if (p_cOutputError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read regions: " << this->GetFileName() << std::endl
+                                                                        << "Reason: " << p_cOutputError);
+  }
+
+  int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(iLevel, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read regions: " << this->GetFileName() << std::endl
+                                                                        << "Reason: Invalid level " << iLevel << '.');
+  }
+
+  for (size_t i = 0; i < vRegions.size(); ++i)
+  {
+    const ImageIORegion::IndexType clStart = vRegions[i].GetIndex();
+
+    if (clStart.size() != 2 || clSize.size() != 2 || clStart[0] < 0 || clStart[1] < 0 ||
+        (int64_t)(clStart[0] + clSize[0]) > i64LevelWidth || (int64_t)(clStart[1] + clSize[1]) > i64LevelHeight)
+    {
+      itkExceptionMacro("Error OpenSlideImageIO could not read regions: "
+                        << this->GetFileName() << std::endl
+                        << "Reason: Region " << i << " is outside of level " << iLevel << " image.");
+    }
+  }
+
+  const size_t  patchBytes = vRegions[0].GetNumberOfPixels() * m_PixelConverter->GetOutputPixelSize();
+  const int64_t i64Width = clSize[0];
+  const int64_t i64Height = clSize[1];
+
+  // Native tiles (256 x 256 if the slide does not report them) and the grid of exactly streamable regions. Cutting
+  // a patch out of a larger region gives the same pixels as reading it if both are on the same grid.
+  int64_t i64TileWidth = 0, i64TileHeight = 0;
+  if (!m_OpenSlideWrapper->GetLevelTileSize(iLevel, i64TileWidth, i64TileHeight))
+    i64TileWidth = i64TileHeight = 256;
+
+  int64_t i64MinWidth = 0, i64MinHeight = 0;
+  const bool bGroup = m_OpenSlideWrapper->ComputeMinimumStreamableRegionSize(iLevel, i64MinWidth, i64MinHeight) &&
+                      i64MinWidth > 0 && i64MinHeight > 0 && i64Width > 0 && i64Height > 0;
+
+  // Union-find of the regions that share a native tile on the same grid
+  std::vector<size_t> vParents(vRegions.size());
+  for (size_t i = 0; i < vParents.size(); ++i)
+    vParents[i] = i;
+
+  auto FindGroup = [&vParents](size_t i) {
+    while (vParents[i] != i)
+    {
+      vParents[i] = vParents[vParents[i]];
+      i = vParents[i];
+    }
+    return i;
+  };
+
+  if (bGroup)
+  {
+    const uint64_t ui64TilesAcross = (i64LevelX + i64LevelWidth + i64TileWidth - 1) / i64TileWidth;
+    const uint64_t ui64TilesDown = (i64LevelY + i64LevelHeight + i64TileHeight - 1) / i64TileHeight;
+
+    std::unordered_map<uint64_t, size_t> mTiles; // The first region overlapping each tile (per grid)
+
+    for (size_t i = 0; i < vRegions.size(); ++i)
+    {
+      const int64_t  i64X = i64LevelX + vRegions[i].GetIndex(0);
+      const int64_t  i64Y = i64LevelY + vRegions[i].GetIndex(1);
+      const uint64_t ui64Grid = (i64Y % i64MinHeight) * i64MinWidth + (i64X % i64MinWidth);
+
+      for (int64_t i64TileY = i64Y / i64TileHeight; i64TileY <= (i64Y + i64Height - 1) / i64TileHeight; ++i64TileY)
+      {
+        for (int64_t i64TileX = i64X / i64TileWidth; i64TileX <= (i64X + i64Width - 1) / i64TileWidth; ++i64TileX)
+        {
+          const uint64_t ui64Key = (ui64Grid * ui64TilesDown + i64TileY) * ui64TilesAcross + i64TileX;
+          const auto     clInserted = mTiles.emplace(ui64Key, i);
+
+          if (!clInserted.second)
+            vParents[FindGroup(i)] = FindGroup(clInserted.first->second);
+        }
+      }
+    }
+  }
+
+  // Groups in the order of their first region
+  std::vector<std::vector<size_t>> vGroups;
+  std::vector<size_t>              vGroupOfRoot(vRegions.size(), vRegions.size());
+
+  for (size_t i = 0; i < vRegions.size(); ++i)
+  {
+    const size_t root = FindGroup(i);
+
+    if (vGroupOfRoot[root] == vRegions.size())
+    {
+      vGroupOfRoot[root] = vGroups.size();
+      vGroups.push_back(std::vector<size_t>());
+    }
+
+    vGroups[vGroupOfRoot[root]].push_back(i);
+  }
+
+  // Groups whose bounding box would decode more pixels than their regions (or take more than 64 MiB) are split in
+  // two at a tile row or column near the middle of the longer side of the box until they fit. Regions that start in
+  // the same tile in both directions are read one by one if they still do not fit.
+  std::vector<std::vector<size_t>> vPending;
+  vPending.swap(vGroups);
+
+  while (!vPending.empty())
+  {
+    std::vector<size_t> vGroup;
+    vGroup.swap(vPending.back());
+    vPending.pop_back();
+
+    int64_t i64X0 = std::numeric_limits<int64_t>::max(), i64Y0 = std::numeric_limits<int64_t>::max();
+    int64_t i64X1 = 0, i64Y1 = 0;
+
+    for (const size_t i : vGroup)
+    {
+      i64X0 = std::min<int64_t>(i64X0, vRegions[i].GetIndex(0));
+      i64Y0 = std::min<int64_t>(i64Y0, vRegions[i].GetIndex(1));
+      i64X1 = std::max<int64_t>(i64X1, vRegions[i].GetIndex(0) + i64Width);
+      i64Y1 = std::max<int64_t>(i64Y1, vRegions[i].GetIndex(1) + i64Height);
+    }
+
+    const double dBoxPixels = (double)(i64X1 - i64X0) * (i64Y1 - i64Y0);
+
+    if (vGroup.size() < 2 ||
+        (dBoxPixels <= (double)vGroup.size() * i64Width * i64Height && dBoxPixels <= (double)(16 << 20)))
+    {
+      vGroups.push_back(std::move(vGroup));
+      continue;
+    }
+
+    // Absolute tile boundary to split at, preferably across the longer side (0 if all regions start in one tile)
+    const bool         bWide = i64X1 - i64X0 >= i64Y1 - i64Y0;
+    const unsigned int a_uiDimensions[2] = { bWide ? 0U : 1U, bWide ? 1U : 0U };
+    const int64_t      a_i64Offsets[2] = { i64LevelX, i64LevelY };
+    const int64_t      a_i64Tiles[2] = { i64TileWidth, i64TileHeight };
+    const int64_t      a_i64Centers[2] = { (i64X0 + i64X1) / 2, (i64Y0 + i64Y1) / 2 };
+
+    unsigned int uiDimension = 0;
+    int64_t      i64Split = 0;
+
+    for (unsigned int k = 0; k < 2 && i64Split == 0; ++k)
+    {
+      uiDimension = a_uiDimensions[k];
+
+      const int64_t i64Offset = a_i64Offsets[uiDimension];
+      const int64_t i64Tile = a_i64Tiles[uiDimension];
+
+      int64_t i64First = std::numeric_limits<int64_t>::max(), i64Last = 0;
+      for (const size_t i : vGroup)
+      {
+        i64First = std::min<int64_t>(i64First, i64Offset + vRegions[i].GetIndex(uiDimension));
+        i64Last = std::max<int64_t>(i64Last, i64Offset + vRegions[i].GetIndex(uiDimension));
+      }
+
+      // Boundaries after the first start up to the last start keep both halves non-empty
+      const int64_t i64Lowest = (i64First / i64Tile + 1) * i64Tile;
+      const int64_t i64Highest = (i64Last / i64Tile) * i64Tile;
+
+      if (i64Lowest <= i64Highest)
+      {
+        const int64_t i64Nearest = (i64Offset + a_i64Centers[uiDimension] + i64Tile / 2) / i64Tile * i64Tile;
+        i64Split = std::min(i64Highest, std::max(i64Lowest, i64Nearest));
+      }
+    }
+
+    if (i64Split == 0)
+    {
+      for (const size_t i : vGroup)
+        vGroups.push_back(std::vector<size_t>(1, i));
+
+      continue;
+    }
+
+    std::vector<size_t> vBefore, vAfter;
+
+    for (const size_t i : vGroup)
+    {
+      if (a_i64Offsets[uiDimension] + vRegions[i].GetIndex(uiDimension) < i64Split)
+        vBefore.push_back(i);
+      else
+        vAfter.push_back(i);
+    }
+
+    vPending.push_back(std::move(vAfter));
+    vPending.push_back(std::move(vBefore));
+  }
+
+  unsigned char * const p_ucBuffer = (unsigned char *)buffer;
+
+  const char *       p_cError = NULL;
+  std::exception_ptr clException;
+  std::mutex         clErrorMutex;
+
+  // Nested loops run serially when the groups already keep the workers busy
+  const bool bSerial = vGroups.size() > 1;
+
+  OpenSlideThreader::ParallelizeArray(
+    (int64_t)vGroups.size(),
+    [&](int64_t i64Group) {
+      const std::vector<size_t> & vIndices = vGroups[i64Group];
+
+      try
+      {
+        if (vIndices.size() == 1)
+        {
+          this->ReadSingleRegion(iLevel, vRegions[vIndices[0]], p_ucBuffer + vIndices[0] * patchBytes, bSerial);
+          return;
+        }
+
+        const char * const p_cGroupError = this->ReadRegionGroup(iLevel, vRegions, vIndices, buffer, bSerial);
+
+        if (p_cGroupError != NULL)
+        {
+          std::lock_guard<std::mutex> clLock(clErrorMutex);
+          p_cError = p_cGroupError;
+        }
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> clLock(clErrorMutex);
+        clException = std::current_exception();
+      }
+    },
+    false);
+
+  if (clException)
+    std::rethrow_exception(clException);
+
+  if (p_cError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read regions: " << this->GetFileName() << std::endl
+                                                                        << "Reason: " << p_cError);
+  }
+}
+
+void
+OpenSlideImageIO::ReadRandomRegions(int               iLevel,
+                                    SizeValueType     width,
+                                    SizeValueType     height,
+                                    SizeValueType     numberOfRegions,
+                                    uint64_t          seed,
+                                    RegionContainer & vRegions,
+                                    void *            buffer) const
+{
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read random regions: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: OpenSlide context is not opened.");
+  }
+
+  int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(iLevel, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read random regions: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Invalid level " << iLevel << '.');
+  }
+
+  if (width == 0 || height == 0 || (int64_t)width > i64LevelWidth || (int64_t)height > i64LevelHeight)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read random regions: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Level " << iLevel << " is smaller than " << width << " x " << height << " pixels.");
+  }
+
+  std::mt19937_64                         clGenerator(seed);
+  std::uniform_int_distribution<int64_t> clXDistribution(0, i64LevelWidth - (int64_t)width);
+  std::uniform_int_distribution<int64_t> clYDistribution(0, i64LevelHeight - (int64_t)height);
+
+  vRegions.assign(numberOfRegions, ImageIORegion(2));
+
+  for (size_t i = 0; i < vRegions.size(); ++i)
+  {
+    vRegions[i].SetIndex(0, clXDistribution(clGenerator));
+    vRegions[i].SetIndex(1, clYDistribution(clGenerator));
+    vRegions[i].SetSize(0, width);
+    vRegions[i].SetSize(1, height);
+  }
+
+  this->ReadRegions(iLevel, vRegions, buffer);
+}
+
+const char *
+OpenSlideImageIO::ReadRegionGroup(int                         iLevel,
+                                  const RegionContainer &     vRegions,
+                                  const std::vector<size_t> & vIndices,
+                                  void *                      buffer,
+                                  bool                        bSerial) const
+{
+  const int64_t i64Width = vRegions[vIndices[0]].GetSize(0);
+  const int64_t i64Height = vRegions[vIndices[0]].GetSize(1);
+
+  int64_t i64X0 = std::numeric_limits<int64_t>::max(), i64Y0 = std::numeric_limits<int64_t>::max();
+  int64_t i64X1 = 0, i64Y1 = 0;
+
+  for (const size_t i : vIndices)
+  {
+    i64X0 = std::min<int64_t>(i64X0, vRegions[i].GetIndex(0));
+    i64Y0 = std::min<int64_t>(i64Y0, vRegions[i].GetIndex(1));
+    i64X1 = std::max<int64_t>(i64X1, vRegions[i].GetIndex(0) + i64Width);
+    i64Y1 = std::max<int64_t>(i64Y1, vRegions[i].GetIndex(1) + i64Height);
+  }
+
+  const int64_t i64BoxWidth = i64X1 - i64X0;
+
+  // From the buffer pool if its buffers are large enough, like the decode buffer of the patches
+  OpenSlideDecodeBuffer  clBox(m_BufferPool.GetPointer(), i64BoxWidth * (i64Y1 - i64Y0));
+  const uint32_t * const p_u32Box = clBox.GetBuffer();
+
+  const char * const p_cError =
+    m_OpenSlideWrapper->ReadLevelRegion(clBox.GetBuffer(), iLevel, i64X0, i64Y0, i64BoxWidth, i64Y1 - i64Y0);
+
+  if (p_cError != NULL)
+    return p_cError;
+
+  const bool bDecode = m_PixelConverter->NeedsDecodeBuffer();
+
+  const int64_t i64Pixels = i64Width * i64Height;
+  const size_t  patchBytes = i64Pixels * m_PixelConverter->GetOutputPixelSize();
+
+  OpenSlideDecodeBuffer clDecodeBuffer(m_BufferPool.GetPointer(), bDecode ? i64Pixels : 0);
+
+  for (const size_t i : vIndices)
+  {
+    void * const     p_vPatch = (unsigned char *)buffer + i * patchBytes;
+    uint32_t * const p_u32Patch = bDecode ? clDecodeBuffer.GetBuffer() : (uint32_t *)p_vPatch;
+
+    const int64_t i64X = vRegions[i].GetIndex(0) - i64X0;
+    const int64_t i64Y = vRegions[i].GetIndex(1) - i64Y0;
+
+    for (int64_t y = 0; y < i64Height; ++y)
+    {
+      const uint32_t * const p_u32Row = p_u32Box + (i64Y + y) * i64BoxWidth + i64X;
+      std::copy(p_u32Row, p_u32Row + i64Width, p_u32Patch + y * i64Width);
+    }
+
+    if (m_ComputeStatistics)
+      this->AccumulateStatistics(p_u32Patch, i64Pixels, bSerial);
+
+    m_PixelConverter->Convert(p_u32Patch, p_vPatch, i64Pixels, bSerial);
+  }
+
+  return NULL;
+}
+
+void
+OpenSlideImageIO::ReadThumbnail(SizeValueType                maxWidth,
+                                SizeValueType                maxHeight,
+                                std::vector<unsigned char> & buffer,
+                                SizeValueType &              width,
+                                SizeValueType &              height) const
+{
+  std::vector<uint32_t> vThumbnail;
+  int64_t               i64ThumbWidth = 0, i64ThumbHeight = 0;
+
+  const char * const p_cError =
+    this->ReadThumbnailPixels(maxWidth, maxHeight, vThumbnail, i64ThumbWidth, i64ThumbHeight);
+
+  if (p_cError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read thumbnail: " << this->GetFileName() << std::endl
+                                                                          << "Reason: " << p_cError);
+  }
+
+  buffer.resize(3 * vThumbnail.size());
+  OpenSlidePixelConverter::ConvertARGBToRGB(vThumbnail.data(), buffer.data(), (int64_t)vThumbnail.size());
+
+  width = (SizeValueType)i64ThumbWidth;
+  height = (SizeValueType)i64ThumbHeight;
+}
+
+void
+OpenSlideImageIO::ReadTissueMask(SizeValueType maxWidth,
+                                 SizeValueType maxHeight,
+                                 unsigned int  saturationThreshold,
+                                 TissueMask &  mask) const
+{
+  std::vector<uint32_t> vThumbnail;
+  int64_t               i64Width = 0, i64Height = 0;
+
+  const char * const p_cError = this->ReadThumbnailPixels(maxWidth, maxHeight, vThumbnail, i64Width, i64Height);
+
+  if (p_cError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read tissue mask: " << this->GetFileName() << std::endl
+                                                                            << "Reason: " << p_cError);
+  }
+
+  mask.m_Width = (SizeValueType)i64Width;
+  mask.m_Height = (SizeValueType)i64Height;
+  mask.m_Pixels.resize(vThumbnail.size());
+  mask.m_Integral.assign((i64Width + 1) * (i64Height + 1), 0);
+
+  // Integral image of the mask, so the tissue of each region is summed in constant time
+  for (int64_t y = 0; y < i64Height; ++y)
+  {
+    unsigned int uiRowSum = 0;
+
+    for (int64_t x = 0; x < i64Width; ++x)
+    {
+      const unsigned char ucTissue = OpenSlideStatistics::IsTissue(vThumbnail[y * i64Width + x], saturationThreshold);
+
+      mask.m_Pixels[y * i64Width + x] = ucTissue;
+      uiRowSum += ucTissue;
+
+      mask.m_Integral[(y + 1) * (i64Width + 1) + x + 1] = mask.m_Integral[y * (i64Width + 1) + x + 1] + uiRowSum;
+    }
+  }
+}
+
+double
+OpenSlideImageIO::TissueMask::ComputeTissueFraction(SizeValueType imageWidth,
+                                                    SizeValueType imageHeight,
+                                                    SizeValueType x,
+                                                    SizeValueType y,
+                                                    SizeValueType width,
+                                                    SizeValueType height) const
+{
+  if (m_Width == 0 || m_Height == 0 || imageWidth == 0 || imageHeight == 0)
+    return 0.0;
+
+  const double dScaleX = (double)m_Width / imageWidth;
+  const double dScaleY = (double)m_Height / imageHeight;
+  const size_t stride = m_Width + 1;
+
+  // Mask pixels the region overlaps (at least one)
+  const SizeValueType mx0 = std::min<SizeValueType>(m_Width - 1, (SizeValueType)(x * dScaleX));
+  const SizeValueType my0 = std::min<SizeValueType>(m_Height - 1, (SizeValueType)(y * dScaleY));
+  const SizeValueType mx1 =
+    std::max<SizeValueType>(mx0 + 1, std::min<SizeValueType>(m_Width, (SizeValueType)std::ceil((x + width) * dScaleX)));
+  const SizeValueType my1 = std::max<SizeValueType>(
+    my0 + 1, std::min<SizeValueType>(m_Height, (SizeValueType)std::ceil((y + height) * dScaleY)));
+
+  const unsigned int tissue = m_Integral[my1 * stride + mx1] - m_Integral[my0 * stride + mx1] -
+                              m_Integral[my1 * stride + mx0] + m_Integral[my0 * stride + mx0];
+
+  return (double)tissue / ((mx1 - mx0) * (my1 - my0));
+}
+
+const char *
+OpenSlideImageIO::ReadThumbnailPixels(SizeValueType           maxWidth,
+                                      SizeValueType           maxHeight,
+                                      std::vector<uint32_t> & vThumbnail,
+                                      int64_t &               i64ThumbWidth,
+                                      int64_t &               i64ThumbHeight) const
+{
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+    return "OpenSlide context is not opened.";
+
+  int64_t i64X = 0, i64Y = 0, i64Width = 0, i64Height = 0;
+  if (maxWidth == 0 || maxHeight == 0 || !m_OpenSlideWrapper->GetLevelExtent(0, i64X, i64Y, i64Width, i64Height))
+    return "Invalid thumbnail or image size.";
+
+  // Fit into maxWidth x maxHeight, but do not upsample
+  const double dScale = std::min(1.0, std::min((double)maxWidth / i64Width, (double)maxHeight / i64Height));
+
+  i64ThumbWidth = std::max<int64_t>(1, (int64_t)(i64Width * dScale + 0.5));
+  i64ThumbHeight = std::max<int64_t>(1, (int64_t)(i64Height * dScale + 0.5));
+
+  // The smallest level that is at least as large as the thumbnail (the number of decoded pixels dominates the cost)
+  int32_t i32Level = 0;
+  int64_t i64SourceWidth = i64Width, i64SourceHeight = i64Height;
+
+  for (int32_t i = m_OpenSlideWrapper->GetLevelCount() - 1; i > 0; --i)
+  {
+    int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+    if (m_OpenSlideWrapper->GetLevelExtent(i, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight) &&
+        i64LevelWidth >= i64ThumbWidth && i64LevelHeight >= i64ThumbHeight)
+    {
+      i32Level = i;
+      i64SourceWidth = i64LevelWidth;
+      i64SourceHeight = i64LevelHeight;
+      break;
+    }
+  }
+
+  // The associated thumbnail shows the whole slide, so it only matches when bounds are not used.
+  // Allow a slightly different aspect ratio since scanners round its size.
+  bool    bAssociated = false;
+  int64_t i64AssociatedWidth = 0, i64AssociatedHeight = 0;
+
+  if (!m_OpenSlideWrapper->GetUseBounds() &&
+      m_OpenSlideWrapper->GetAssociatedImageDimensions("thumbnail", i64AssociatedWidth, i64AssociatedHeight))
+  {
+    const double dAspect = (double)i64Width / i64Height;
+    const double dAssociatedAspect = (double)i64AssociatedWidth / i64AssociatedHeight;
+
+    bAssociated = i64AssociatedWidth >= i64ThumbWidth && i64AssociatedHeight >= i64ThumbHeight &&
+                  std::fabs(dAssociatedAspect - dAspect) <= 0.02 * dAspect &&
+                  i64AssociatedWidth * i64AssociatedHeight < i64SourceWidth * i64SourceHeight;
+  }
+
+  if (bAssociated)
+  {
+    i64SourceWidth = i64AssociatedWidth;
+    i64SourceHeight = i64AssociatedHeight;
+  }
+
+  std::vector<uint32_t> vSource(i64SourceWidth * i64SourceHeight);
+
+  const char * const p_cError =
+    bAssociated ? m_OpenSlideWrapper->ReadAssociatedImage("thumbnail", vSource.data())
+                : this->ReadLevelRegionInStrips(i32Level, 0, 0, i64SourceWidth, i64SourceHeight, vSource.data());
+
+  if (p_cError != NULL)
+    return p_cError;
+
+  vThumbnail.resize(i64ThumbWidth * i64ThumbHeight);
+
+  OpenSlideAreaFilter::Resample(vSource.data(),
+                                i64SourceWidth,
+                                i64SourceHeight,
+                                0.0,
+                                0.0,
+                                (double)i64SourceWidth / i64ThumbWidth,
+                                (double)i64SourceHeight / i64ThumbHeight,
+                                vThumbnail.data(),
+                                i64ThumbWidth,
+                                i64ThumbHeight);
+
+  return NULL;
+}
+
+void
+OpenSlideImageIO::ReadMultiResolutionRegion(const double             a_dOrigin[2],
+                                            const double             a_dSize[2],
+                                            const SpacingContainer & vSpacings,
+                                            BufferContainer &        vBuffers,
+                                            RegionContainer &        vRegions) const
+{
+  // Relative costs per pixel of decoding a level and of filtering a pixel of the source
+  const double dDecodeCost = 8.0;
+  const double dFilterCost = 1.0;
+
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read multi-resolution region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: OpenSlide context is not opened.");
+  }
+
+  const char * const p_cOutputError = m_PixelConverter->CheckOutput();
+  if (p_cOutputError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read multi-resolution region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: " << p_cOutputError);
+  }
+
+  double dSpacing0X = 1.0, dSpacing0Y = 1.0;
+  m_OpenSlideWrapper->GetLevelSpacing(0, dSpacing0X, dSpacing0Y);
+
+  int64_t i64Extent0X = 0, i64Extent0Y = 0, i64Extent0Width = 0, i64Extent0Height = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(0, i64Extent0X, i64Extent0Y, i64Extent0Width, i64Extent0Height) ||
+      a_dSize[0] <= 0.0 || a_dSize[1] <= 0.0 || a_dOrigin[0] < i64Extent0X * dSpacing0X ||
+      a_dOrigin[1] < i64Extent0Y * dSpacing0Y ||
+      a_dOrigin[0] + a_dSize[0] > (i64Extent0X + i64Extent0Width) * dSpacing0X ||
+      a_dOrigin[1] + a_dSize[1] > (i64Extent0Y + i64Extent0Height) * dSpacing0Y)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read multi-resolution region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Region is outside of level 0 image.");
+  }
+
+  for (size_t i = 0; i < vSpacings.size(); ++i)
+  {
+    if (!(vSpacings[i] > 0.0))
+    {
+      itkExceptionMacro("Error OpenSlideImageIO could not read multi-resolution region: "
+                        << this->GetFileName() << std::endl
+                        << "Reason: Invalid spacing " << vSpacings[i] << '.');
+    }
+  }
+
+  // Highest resolution first, so lower resolutions can be filtered down from it
+  std::vector<size_t> vOrder(vSpacings.size());
+  for (size_t i = 0; i < vOrder.size(); ++i)
+    vOrder[i] = i;
+
+  std::sort(vOrder.begin(), vOrder.end(), [&vSpacings](size_t a, size_t b) { return vSpacings[a] < vSpacings[b]; });
+
+  // Decoded level regions (absolute level coordinates) and the ARGB outputs
+  struct DecodedRegion
+  {
+    int64_t               m_X, m_Y, m_Width, m_Height;
+    std::vector<uint32_t> m_Pixels;
+  };
+
+  std::map<int32_t, DecodedRegion>   mDecoded;
+  std::vector<std::vector<uint32_t>> vOutputs(vSpacings.size());
+  std::vector<double>                vOriginsX(vSpacings.size()), vOriginsY(vSpacings.size());
+
+  vRegions.assign(vSpacings.size(), ImageIORegion(2));
+
+  for (size_t n = 0; n < vOrder.size(); ++n)
+  {
+    const size_t  k = vOrder[n];
+    const double  dSpacing = vSpacings[k];
+    const int64_t i64Width = std::max<int64_t>(1, (int64_t)(a_dSize[0] / dSpacing + 0.5));
+    const int64_t i64Height = std::max<int64_t>(1, (int64_t)(a_dSize[1] / dSpacing + 0.5));
+
+    vRegions[k].SetIndex(0, (int64_t)((a_dOrigin[0] - i64Extent0X * dSpacing0X) / dSpacing + 0.5));
+    vRegions[k].SetIndex(1, (int64_t)((a_dOrigin[1] - i64Extent0Y * dSpacing0Y) / dSpacing + 0.5));
+    vRegions[k].SetSize(0, i64Width);
+    vRegions[k].SetSize(1, i64Height);
+
+    // Each output is the region of its grid (like ReadRegionAtSpacing()), so outputs of different spacings are offset
+    // against each other by the fractions of a pixel lost when snapping the origin to each grid
+    const double dOriginX = i64Extent0X * dSpacing0X + vRegions[k].GetIndex(0) * dSpacing;
+    const double dOriginY = i64Extent0Y * dSpacing0Y + vRegions[k].GetIndex(1) * dSpacing;
+
+    vOriginsX[k] = dOriginX;
+    vOriginsY[k] = dOriginY;
+    vOutputs[k].resize(i64Width * i64Height);
+
+    // The lowest resolution level with at least the requested resolution
+    const double  a_dSpacing[2] = { dSpacing, dSpacing };
+    const int32_t i32Level = this->GetLevelForSpacing(a_dSpacing);
+    double        dLevelSpacingX = dSpacing0X, dLevelSpacingY = dSpacing0Y;
+
+    if (i32Level > 0)
+      m_OpenSlideWrapper->GetLevelSpacing(i32Level, dLevelSpacingX, dLevelSpacingY);
+
+    int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+    m_OpenSlideWrapper->GetLevelExtent(i32Level, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight);
+
+    // The level pixels covering the region (tolerating rounding errors of physical coordinates on the pixel grid)
+    const double  dEpsilon = 1e-6;
+    const int64_t i64X0 = std::max(i64LevelX, (int64_t)std::floor(dOriginX / dLevelSpacingX + dEpsilon));
+    const int64_t i64Y0 = std::max(i64LevelY, (int64_t)std::floor(dOriginY / dLevelSpacingY + dEpsilon));
+    const int64_t i64X1 = std::min(i64LevelX + i64LevelWidth,
+                                   (int64_t)std::ceil((dOriginX + i64Width * dSpacing) / dLevelSpacingX - dEpsilon));
+    const int64_t i64Y1 = std::min(i64LevelY + i64LevelHeight,
+                                   (int64_t)std::ceil((dOriginY + i64Height * dSpacing) / dLevelSpacingY - dEpsilon));
+
+    const double dLevelPixels = (double)std::max<int64_t>(1, i64X1 - i64X0) * std::max<int64_t>(1, i64Y1 - i64Y0);
+    const double dLevelCost =
+      (mDecoded.count(i32Level) > 0 ? 0.0 : dDecodeCost * dLevelPixels) + dFilterCost * dLevelPixels;
+
+    // The cheapest output of higher resolution to filter down from
+    size_t bestSource = vSpacings.size();
+    double dBestCost = dLevelCost;
+
+    for (size_t m = 0; m < n; ++m)
+    {
+      const size_t j = vOrder[m];
+      const double dCost = dFilterCost * vOutputs[j].size();
+
+      if (dCost < dBestCost)
+      {
+        bestSource = j;
+        dBestCost = dCost;
+      }
+    }
+
+    if (bestSource < vSpacings.size())
+    {
+      const double dScale = dSpacing / vSpacings[bestSource];
+
+      // The origin of this output in pixels of the source output (fractional unless both grids are aligned)
+      OpenSlideAreaFilter::Resample(vOutputs[bestSource].data(),
+                                    vRegions[bestSource].GetSize(0),
+                                    vRegions[bestSource].GetSize(1),
+                                    (dOriginX - vOriginsX[bestSource]) / vSpacings[bestSource],
+                                    (dOriginY - vOriginsY[bestSource]) / vSpacings[bestSource],
+                                    dScale,
+                                    dScale,
+                                    vOutputs[k].data(),
+                                    i64Width,
+                                    i64Height);
+      continue;
+    }
+
+    DecodedRegion & clDecoded = mDecoded[i32Level];
+
+    // Outputs on different grids need slightly different level pixels, so a decoded region may have to grow
+    if (clDecoded.m_Pixels.empty() || i64X0 < clDecoded.m_X || i64Y0 < clDecoded.m_Y ||
+        std::max(i64X0 + 1, i64X1) > clDecoded.m_X + clDecoded.m_Width ||
+        std::max(i64Y0 + 1, i64Y1) > clDecoded.m_Y + clDecoded.m_Height)
+    {
+      int64_t i64DecodeX0 = i64X0, i64DecodeY0 = i64Y0;
+      int64_t i64DecodeX1 = std::max(i64X0 + 1, i64X1), i64DecodeY1 = std::max(i64Y0 + 1, i64Y1);
+
+      if (!clDecoded.m_Pixels.empty())
+      {
+        i64DecodeX0 = std::min(i64DecodeX0, clDecoded.m_X);
+        i64DecodeY0 = std::min(i64DecodeY0, clDecoded.m_Y);
+        i64DecodeX1 = std::max(i64DecodeX1, clDecoded.m_X + clDecoded.m_Width);
+        i64DecodeY1 = std::max(i64DecodeY1, clDecoded.m_Y + clDecoded.m_Height);
+      }
+
+      clDecoded.m_X = i64DecodeX0;
+      clDecoded.m_Y = i64DecodeY0;
+      clDecoded.m_Width = i64DecodeX1 - i64DecodeX0;
+      clDecoded.m_Height = i64DecodeY1 - i64DecodeY0;
+      clDecoded.m_Pixels.assign(clDecoded.m_Width * clDecoded.m_Height, 0);
+
+      const char * const p_cError = this->ReadLevelRegionInStrips(i32Level,
+                                                                  clDecoded.m_X - i64LevelX,
+                                                                  clDecoded.m_Y - i64LevelY,
+                                                                  clDecoded.m_Width,
+                                                                  clDecoded.m_Height,
+                                                                  clDecoded.m_Pixels.data());
+
+      if (p_cError != NULL)
+      {
+        itkExceptionMacro("Error OpenSlideImageIO could not read multi-resolution region: "
+                          << this->GetFileName() << std::endl
+                          << "Reason: " << p_cError);
+      }
+    }
+
+    OpenSlideAreaFilter::Resample(clDecoded.m_Pixels.data(),
+                                  clDecoded.m_Width,
+                                  clDecoded.m_Height,
+                                  dOriginX / dLevelSpacingX - clDecoded.m_X,
+                                  dOriginY / dLevelSpacingY - clDecoded.m_Y,
+                                  dSpacing / dLevelSpacingX,
+                                  dSpacing / dLevelSpacingY,
+                                  vOutputs[k].data(),
+                                  i64Width,
+                                  i64Height);
+  }
+
+  // Convert only now since the color transforms work in place
+  vBuffers.resize(vSpacings.size());
+
+  for (size_t k = 0; k < vSpacings.size(); ++k)
+  {
+    vBuffers[k].resize(vOutputs[k].size() * m_PixelConverter->GetOutputPixelSize());
+    m_PixelConverter->Convert(vOutputs[k].data(), vBuffers[k].data(), (int64_t)vOutputs[k].size(), false);
+  }
+}
+
+int
+OpenSlideImageIO::ReadRegionAtSpacing(const double a_dSpacing[2], const ImageIORegion & clRegion, void * buffer) const
+{
+  uint32_t * p_u32Buffer = (uint32_t *)buffer;
+
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: OpenSlide context is not opened.");
+  }
+
+  const char * const p_cOutputError = m_PixelConverter->CheckOutput();
+  if (p_cOutputError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: " << p_cOutputError);
+  }
+
+  const ImageIORegion::SizeType  clSize = clRegion.GetSize();
+  const ImageIORegion::IndexType clStart = clRegion.GetIndex();
+
+  if (clStart.size() != 2 || clSize.size() != 2)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: Region is not 2D.");
+  }
+
+  if (!(a_dSpacing[0] > 0.0) || !(a_dSpacing[1] > 0.0))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Invalid spacing " << a_dSpacing[0] << ", " << a_dSpacing[1] << '.');
+  }
+
+  if (((uint64_t)clSize[0]) * ((uint64_t)clSize[1]) > std::numeric_limits<ImageIORegion::SizeValueType>::max())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Requested region size in pixels overflows.");
+  }
+
+  double dSpacing0X = 1.0, dSpacing0Y = 1.0;
+  m_OpenSlideWrapper->GetLevelSpacing(0, dSpacing0X, dSpacing0Y);
+
+  // Tolerate rounding errors of physical coordinates on the pixel grid
+  const double dEpsilon = 1e-6;
+
+  int64_t i64Extent0X = 0, i64Extent0Y = 0, i64Extent0Width = 0, i64Extent0Height = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(0, i64Extent0X, i64Extent0Y, i64Extent0Width, i64Extent0Height) ||
+      clStart[0] < 0 || clStart[1] < 0 || clSize[0] == 0 || clSize[1] == 0 ||
+      (clStart[0] + clSize[0]) * a_dSpacing[0] > i64Extent0Width * dSpacing0X * (1.0 + dEpsilon) ||
+      (clStart[1] + clSize[1]) * a_dSpacing[1] > i64Extent0Height * dSpacing0Y * (1.0 + dEpsilon))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Region is outside of level 0 image.");
+  }
+
+  const int32_t i32Level = this->GetLevelForSpacing(a_dSpacing);
+
+  double dLevelSpacingX = dSpacing0X, dLevelSpacingY = dSpacing0Y;
+  m_OpenSlideWrapper->GetLevelSpacing(i32Level, dLevelSpacingX, dLevelSpacingY);
+
+  int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+  m_OpenSlideWrapper->GetLevelExtent(i32Level, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight);
+
+  // The region in level pixels (absolute level coordinates, like the level extent)
+  const double dOffsetX = (i64Extent0X * dSpacing0X + clStart[0] * a_dSpacing[0]) / dLevelSpacingX;
+  const double dOffsetY = (i64Extent0Y * dSpacing0Y + clStart[1] * a_dSpacing[1]) / dLevelSpacingY;
+  const double dScaleX = a_dSpacing[0] / dLevelSpacingX;
+  const double dScaleY = a_dSpacing[1] / dLevelSpacingY;
+
+  const bool bDecode = m_PixelConverter->NeedsDecodeBuffer();
+
+  OpenSlideDecodeBuffer clDecodeBuffer(m_BufferPool.GetPointer(), bDecode ? clRegion.GetNumberOfPixels() : 0);
+  if (bDecode)
+    p_u32Buffer = clDecodeBuffer.GetBuffer();
+
+  const int64_t i64RoundX = (int64_t)std::floor(dOffsetX + 0.5);
+  const int64_t i64RoundY = (int64_t)std::floor(dOffsetY + 0.5);
+  const char *  p_cError = NULL;
+
+  if (std::fabs(dScaleX - 1.0) < dEpsilon && std::fabs(dScaleY - 1.0) < dEpsilon &&
+      std::fabs(dOffsetX - i64RoundX) < 1e-3 && std::fabs(dOffsetY - i64RoundY) < 1e-3 && i64RoundX >= i64LevelX &&
+      i64RoundY >= i64LevelY && i64RoundX + (int64_t)clSize[0] <= i64LevelX + i64LevelWidth &&
+      i64RoundY + (int64_t)clSize[1] <= i64LevelY + i64LevelHeight)
+  {
+    // The level has the spacing of the grid, so its pixels are the output
+    p_cError = this->ReadLevelRegionInStrips(
+      i32Level, i64RoundX - i64LevelX, i64RoundY - i64LevelY, clSize[0], clSize[1], p_u32Buffer);
+  }
+  else
+  {
+    // The largest DCT scale the reduction allows, so the scaled pixels still have at least the output resolution
+    uint32_t ui32Scale = 1;
+    if (m_ResamplingMode == ResamplingEnum::ScaledDCT)
+    {
+      while (ui32Scale < 8 && 2.0 * ui32Scale <= std::min(dScaleX, dScaleY) * (1.0 + dEpsilon))
+        ui32Scale *= 2;
+    }
+
+    bool bScaled = false;
+
+    if (ui32Scale > 1)
+    {
+      // The scaled level pixels covering the region (scaled pixel x covers level pixels x * ui32Scale and on)
+      const double  dScaledOffsetX = dOffsetX / ui32Scale;
+      const double  dScaledOffsetY = dOffsetY / ui32Scale;
+      const int64_t i64X0 = std::max(i64LevelX / ui32Scale, (int64_t)std::floor(dScaledOffsetX + dEpsilon));
+      const int64_t i64Y0 = std::max(i64LevelY / ui32Scale, (int64_t)std::floor(dScaledOffsetY + dEpsilon));
+      const int64_t i64X1 = std::min((i64LevelX + i64LevelWidth + ui32Scale - 1) / ui32Scale,
+                                     (int64_t)std::ceil(dScaledOffsetX + clSize[0] * dScaleX / ui32Scale - dEpsilon));
+      const int64_t i64Y1 = std::min((i64LevelY + i64LevelHeight + ui32Scale - 1) / ui32Scale,
+                                     (int64_t)std::ceil(dScaledOffsetY + clSize[1] * dScaleY / ui32Scale - dEpsilon));
+      const int64_t i64Width = std::max<int64_t>(1, i64X1 - i64X0);
+      const int64_t i64Height = std::max<int64_t>(1, i64Y1 - i64Y0);
+
+      std::vector<uint32_t> vScaledPixels(i64Width * i64Height);
+
+      bScaled = this->ReadScaledLevelRegion(
+        i32Level, ui32Scale, i64X0, i64Y0, i64Width, i64Height, vScaledPixels.data(), p_cError);
+
+      if (bScaled && p_cError == NULL)
+      {
+        OpenSlideAreaFilter::Resample(vScaledPixels.data(),
+                                      i64Width,
+                                      i64Height,
+                                      dScaledOffsetX - i64X0,
+                                      dScaledOffsetY - i64Y0,
+                                      dScaleX / ui32Scale,
+                                      dScaleY / ui32Scale,
+                                      p_u32Buffer,
+                                      clSize[0],
+                                      clSize[1]);
+      }
+    }
+
+    if (!bScaled)
+    {
+      const int64_t i64X0 = std::max(i64LevelX, (int64_t)std::floor(dOffsetX + dEpsilon));
+      const int64_t i64Y0 = std::max(i64LevelY, (int64_t)std::floor(dOffsetY + dEpsilon));
+      const int64_t i64X1 =
+        std::min(i64LevelX + i64LevelWidth, (int64_t)std::ceil(dOffsetX + clSize[0] * dScaleX - dEpsilon));
+      const int64_t i64Y1 =
+        std::min(i64LevelY + i64LevelHeight, (int64_t)std::ceil(dOffsetY + clSize[1] * dScaleY - dEpsilon));
+      const int64_t i64Width = std::max<int64_t>(1, i64X1 - i64X0);
+      const int64_t i64Height = std::max<int64_t>(1, i64Y1 - i64Y0);
+
+      std::vector<uint32_t> vLevelPixels(i64Width * i64Height);
+
+      p_cError = this->ReadLevelRegionInStrips(
+        i32Level, i64X0 - i64LevelX, i64Y0 - i64LevelY, i64Width, i64Height, vLevelPixels.data());
+
+      if (p_cError == NULL)
+      {
+        OpenSlideAreaFilter::Resample(vLevelPixels.data(),
+                                      i64Width,
+                                      i64Height,
+                                      dOffsetX - i64X0,
+                                      dOffsetY - i64Y0,
+                                      dScaleX,
+                                      dScaleY,
+                                      p_u32Buffer,
+                                      clSize[0],
+                                      clSize[1]);
+      }
+    }
+  }
+
+  if (p_cError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read region: " << this->GetFileName() << std::endl
+                                                                       << "Reason: " << p_cError);
+  }
+
+  if (m_ComputeStatistics)
+    this->AccumulateStatistics(p_u32Buffer, clRegion.GetNumberOfPixels(), false);
+
+  m_PixelConverter->Convert(p_u32Buffer, buffer, clRegion.GetNumberOfPixels(), false);
+
+  return i32Level;
+}
+
+int
+OpenSlideImageIO::GetLevelForSpacing(const double a_dSpacing[2]) const
+{
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+    return -1;
+
+  for (int32_t i = m_OpenSlideWrapper->GetLevelCount() - 1; i > 0; --i)
+  {
+    double dSpacingX = 0.0, dSpacingY = 0.0;
+    m_OpenSlideWrapper->GetLevelSpacing(i, dSpacingX, dSpacingY);
+
+    if (dSpacingX <= a_dSpacing[0] * (1.0 + 1e-3) && dSpacingY <= a_dSpacing[1] * (1.0 + 1e-3))
+      return i;
+  }
+
+  return 0;
+}
+
+/** Sets how ReadRegionAtSpacing() reduces a level to a coarser spacing. */
+void
+OpenSlideImageIO::SetResamplingMode(ResamplingEnum eResamplingMode)
+{
+  m_ResamplingMode = eResamplingMode;
+}
+
+/** Returns how ReadRegionAtSpacing() reduces a level to a coarser spacing. */
+OpenSlideImageIO::ResamplingEnum
+OpenSlideImageIO::GetResamplingMode() const
+{
+  return m_ResamplingMode;
+}
+
+void
+OpenSlideImageIO::ComputeReadStrips(int                    iLevel,
+                                    int64_t                i64Y,
+                                    int64_t                i64Height,
+                                    std::vector<int64_t> & vStripRows) const
+{
+  vStripRows.assign(1, i64Y);
+
+  int64_t i64MinWidth = 0, i64MinHeight = 0;
+  if (!m_OpenSlideWrapper->ComputeMinimumStreamableRegionSize(iLevel, i64MinWidth, i64MinHeight) ||
+      i64MinHeight <= 0)
+  {
+    vStripRows.push_back(i64Y + i64Height);
+    return;
+  }
+
+  int64_t i64LevelX = 0, i64LevelY = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+  m_OpenSlideWrapper->GetLevelExtent(iLevel, i64LevelX, i64LevelY, i64LevelWidth, i64LevelHeight);
+
+  // Strips of about 256 rows between lines of the grid of exactly streamable regions (absolute level coordinates),
+  // so the first strip is shorter if the region starts off the grid
+  const int64_t i64StripHeight = std::max<int64_t>(1, (256 + i64MinHeight - 1) / i64MinHeight) * i64MinHeight;
+  const int64_t i64GridY = i64Y - (i64LevelY + i64Y) % i64MinHeight;
+
+  for (int64_t i64StripY = i64GridY + i64StripHeight; i64StripY < i64Y + i64Height; i64StripY += i64StripHeight)
+    vStripRows.push_back(i64StripY);
+
+  vStripRows.push_back(i64Y + i64Height);
+}
+
+const char *
+OpenSlideImageIO::ReadLevelRegionInStrips(int        iLevel,
+                                          int64_t    i64X,
+                                          int64_t    i64Y,
+                                          int64_t    i64Width,
+                                          int64_t    i64Height,
+                                          uint32_t * p_u32Dest) const
+{
+  std::vector<int64_t> vStripRows;
+  this->ComputeReadStrips(iLevel, i64Y, i64Height, vStripRows);
+
+  const char * p_cError = NULL;
+  std::mutex   clErrorMutex;
+
+  OpenSlideThreader::ParallelizeArray(
+    (int64_t)vStripRows.size() - 1,
+    [&](int64_t i64Strip) {
+      const int64_t      i64StripY = vStripRows[i64Strip];
+      const char * const p_cStripError =
+        m_OpenSlideWrapper->ReadLevelRegion(p_u32Dest + (i64StripY - i64Y) * i64Width,
+                                            iLevel,
+                                            i64X,
+                                            i64StripY,
+                                            i64Width,
+                                            vStripRows[i64Strip + 1] - i64StripY);
+
+      if (p_cStripError != NULL)
+      {
+        std::lock_guard<std::mutex> clLock(clErrorMutex);
+        p_cError = p_cStripError;
+      }
+    },
+    false);
+
+  return p_cError;
+}
+
+bool
+OpenSlideImageIO::ReadScaledLevelRegion(int           iLevel,
+                                        uint32_t      ui32Scale,
+                                        int64_t       i64X,
+                                        int64_t       i64Y,
+                                        int64_t       i64Width,
+                                        int64_t       i64Height,
+                                        uint32_t *    p_u32Dest,
+                                        const char *& p_cError) const
+{
+  const OpenSlideTiffTiles * const p_clTiffTiles = m_OpenSlideWrapper->GetTiffTiles();
+  if (p_clTiffTiles == NULL || !p_clTiffTiles->CanDecode(iLevel, ui32Scale))
+    return false;
+
+  // Strips of whole tile rows, so no tile is decoded twice
+  const int64_t i64StripHeight = p_clTiffTiles->GetLevel(iLevel)->m_TileHeight / ui32Scale;
+  const int64_t i64FirstStrip = i64Y / i64StripHeight;
+  const int64_t i64NumStrips = (i64Y + i64Height + i64StripHeight - 1) / i64StripHeight - i64FirstStrip;
+
+  std::mutex clErrorMutex;
+  p_cError = NULL;
+
+  OpenSlideThreader::ParallelizeArray(
+    i64NumStrips,
+    [&](int64_t i64StripIndex) {
+      const int64_t      i64Strip = i64FirstStrip + i64StripIndex;
+      const int64_t      i64StripY0 = std::max(i64Y, i64Strip * i64StripHeight);
+      const int64_t      i64StripY1 = std::min(i64Y + i64Height, (i64Strip + 1) * i64StripHeight);
+      const char * const p_cStripError = p_clTiffTiles->DecodeRegion(iLevel,
+                                                                     ui32Scale,
+                                                                     i64X,
+                                                                     i64StripY0,
+                                                                     i64Width,
+                                                                     i64StripY1 - i64StripY0,
+                                                                     OpenSlideTileFormatEnum::ARGB,
+                                                                     p_u32Dest + (i64StripY0 - i64Y) * i64Width);
+
+      if (p_cStripError != NULL)
+      {
+        std::lock_guard<std::mutex> clLock(clErrorMutex);
+        p_cError = p_cStripError;
+      }
+    },
+    false);
+
+  return true;
+}
+
+bool
+OpenSlideImageIO::CanWriteFile(const char * /*name*/)
+{
+  return false;
+}
+
+void
+OpenSlideImageIO ::WriteImageInformation(void)
+{
+  // add writing here
+}
+
+
+/**
+ *
+ */
+void
+OpenSlideImageIO::Write(const void * /*buffer*/)
+{}
+
+/** Given a requested region, determine what could be the region that we can
+ * read from the file. This is called the streamable region, which will be
+ * smaller than the LargestPossibleRegion and greater or equal to the
+RequestedRegion */
+ImageIORegion
+OpenSlideImageIO::GenerateStreamableReadRegionFromRequestedRegion(const ImageIORegion & requested) const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return requested;
+
+  ImageIORegion::SizeType  clSize = requested.GetSize();
+  ImageIORegion::IndexType clStart = requested.GetIndex();
+
+  int64_t i64X = clStart[0];
+  int64_t i64Y = clStart[1];
+
+  int64_t i64Width = clSize[0];
+  int64_t i64Height = clSize[1];
+
+  if (!m_OpenSlideWrapper->AlignReadRegion(i64X, i64Y, i64Width, i64Height))
+    return requested;
+
+  clStart[0] = (SizeValueType)i64X;
+  clStart[1] = (SizeValueType)i64Y;
+
+  clSize[0] = (SizeValueType)i64Width;
+  clSize[1] = (SizeValueType)i64Height;
+
+  ImageIORegion clNewRegion(requested);
+
+  clNewRegion.SetSize(clSize);
+  clNewRegion.SetIndex(clStart);
+
+  return clNewRegion;
+}
+
+/** Closes the file handles of the slide but keeps the header. */
+void
+OpenSlideImageIO::ReleaseSlide()
+{
+  if (m_OpenSlideWrapper != NULL)
+    m_OpenSlideWrapper->ReleaseContext();
+}
+
+/** Get underlying OpenSlide library version */
+std::string
+OpenSlideImageIO::GetOpenSlideVersion() const
+{
+  const char * const p_cVersion = OpenSlideWrapper::GetVersion();
+  return p_cVersion != NULL ? std::string(p_cVersion) : std::string();
+}
+
+/** Detect the vendor of the current file. */
+std::string
+OpenSlideImageIO::GetVendor() const
+{
+  // Avoid detecting the vendor again (this opens the file) when the header is already known
+  if (m_OpenSlideWrapper != NULL && m_OpenSlideWrapper->IsOpened() && !m_OpenSlideWrapper->GetVendor().empty())
+    return m_OpenSlideWrapper->GetVendor();
+
+  const char * const p_cVendor = OpenSlideWrapper::DetectVendor(this->GetFileName());
+  return p_cVendor != NULL ? std::string(p_cVendor) : std::string();
+}
+
+/** Sets the level to read. Level 0 (default) is the highest resolution level.
+ * This method overrides any previously selected associated image.
+ * Call ReadImageInformation() again after calling this function. */
+void
+OpenSlideImageIO::SetLevel(int iLevel)
+{
+  if (m_OpenSlideWrapper == NULL)
+    return;
+
+  m_OpenSlideWrapper->SetLevel(iLevel);
+}
+
+/** Returns the currently selected level. */
+int
+OpenSlideImageIO::GetLevel() const
+{
   if (m_OpenSlideWrapper == NULL)
-    return requested;
+    return -1;
+
+  return m_OpenSlideWrapper->GetLevel();
+}
+
+/** Returns the number of available levels. */
+int
+OpenSlideImageIO::GetLevelCount() const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return -1;
+
+  return m_OpenSlideWrapper->GetLevelCount();
+}
+
+/** Sets the associated image to extract.
+ * This method overrides any previously selected level.
+ * Call ReadImageInformation() again after calling this function. */
+void
+OpenSlideImageIO::SetAssociatedImageName(const std::string & strName)
+{
+  if (m_OpenSlideWrapper == NULL)
+    return;
+
+  m_OpenSlideWrapper->SetAssociatedImageName(strName);
+}
+
+/** Returns the currently selected associated image name (empty string if none). */
+std::string
+OpenSlideImageIO::GetAssociatedImageName() const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return std::string();
+
+  return m_OpenSlideWrapper->GetAssociatedImageName();
+}
+
+/** Sets the best level to read for the given downsample factor.
+ * This method overrides any previously selected associated image.
+ * Call ReadImageInformation() again after calling this function. */
+bool
+OpenSlideImageIO::SetLevelForDownsampleFactor(double dDownsampleFactor)
+{
+  if (m_OpenSlideWrapper == NULL)
+    return false;
+
+  return m_OpenSlideWrapper->SetBestLevelForDownsample(dDownsampleFactor);
+}
+
+/** Returns all associated image names stored in the file. */
+OpenSlideImageIO::AssociatedImageNameContainer
+OpenSlideImageIO::GetAssociatedImageNames() const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return AssociatedImageNameContainer();
+
+  return m_OpenSlideWrapper->GetAssociatedImageNames();
+}
+
+/** Returns the dimensions of the given level without selecting it. */
+bool
+OpenSlideImageIO::GetLevelDimensions(int iLevel, SizeValueType & width, SizeValueType & height) const
+{
+  width = height = 0;
+
+  if (m_OpenSlideWrapper == NULL)
+    return false;
+
+  int64_t i64X = 0, i64Y = 0, i64Width = 0, i64Height = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(iLevel, i64X, i64Y, i64Width, i64Height))
+    return false;
+
+  width = (SizeValueType)i64Width;
+  height = (SizeValueType)i64Height;
+
+  return true;
+}
+
+/** Turn on/off decoding the JPEG tiles of TIFF-based slides directly. */
+void
+OpenSlideImageIO::SetDirectTileDecoding(bool bDirectTileDecoding)
+{
+  if (m_OpenSlideWrapper != NULL)
+    m_OpenSlideWrapper->SetDirectTileDecoding(bDirectTileDecoding);
+}
+
+/** Returns whether the JPEG tiles of TIFF-based slides are decoded directly. */
+bool
+OpenSlideImageIO::GetDirectTileDecoding() const
+{
+  return m_OpenSlideWrapper != NULL && m_OpenSlideWrapper->GetDirectTileDecoding();
+}
+
+/** Returns the number of tiles decoded directly since ReadImageInformation(). */
+uint64_t
+OpenSlideImageIO::GetNumberOfDirectlyDecodedTiles() const
+{
+  return m_OpenSlideWrapper != NULL ? m_OpenSlideWrapper->GetNumberOfDirectlyDecodedTiles() : 0;
+}
+
+/** Returns the layout of the compressed tiles of the given level. */
+bool
+OpenSlideImageIO::GetRawTileLayout(int iLevel, RawTileLayout & clLayout) const
+{
+  clLayout = RawTileLayout();
+
+  if (m_OpenSlideWrapper == NULL)
+    return false;
+
+  const OpenSlideTiffTiles * const p_clTiffTiles = m_OpenSlideWrapper->GetTiffTiles();
+  if (p_clTiffTiles == NULL)
+    return false;
+
+  const OpenSlideTiffTiles::Level * const p_clLevel = p_clTiffTiles->GetLevel(iLevel);
+  if (p_clLevel == NULL)
+    return false;
+
+  clLayout.m_Width = p_clLevel->m_Width;
+  clLayout.m_Height = p_clLevel->m_Height;
+  clLayout.m_TileWidth = p_clLevel->m_TileWidth;
+  clLayout.m_TileHeight = p_clLevel->m_TileHeight;
+  clLayout.m_TilesAcross = (p_clLevel->m_Width + p_clLevel->m_TileWidth - 1) / p_clLevel->m_TileWidth;
+  clLayout.m_TilesDown = (p_clLevel->m_Height + p_clLevel->m_TileHeight - 1) / p_clLevel->m_TileHeight;
+  clLayout.m_Directory = p_clLevel->m_Directory;
+  clLayout.m_Compression = p_clLevel->m_Compression;
+  clLayout.m_Photometric = p_clLevel->m_Photometric;
+  clLayout.m_SamplesPerPixel = p_clLevel->m_SamplesPerPixel;
+  clLayout.m_BitsPerSample = p_clLevel->m_BitsPerSample;
+  clLayout.m_JPEGTables = p_clLevel->m_JPEGTables;
+
+  return true;
+}
+
+void
+OpenSlideImageIO::ReadRawTile(int                          iLevel,
+                              SizeValueType                tileX,
+                              SizeValueType                tileY,
+                              std::vector<unsigned char> & buffer) const
+{
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read raw tile: " << this->GetFileName() << std::endl
+                                                                         << "Reason: OpenSlide context is not opened.");
+  }
+
+  const OpenSlideTiffTiles * const p_clTiffTiles = m_OpenSlideWrapper->GetTiffTiles();
+  if (p_clTiffTiles == NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read raw tile: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Slide is not read from tiled TIFF directories.");
+  }
+
+  const char * const p_cError = p_clTiffTiles->ReadTile(iLevel, tileX, tileY, buffer);
+  if (p_cError != NULL)
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read raw tile: " << this->GetFileName() << std::endl
+                                                                         << "Reason: " << p_cError);
+  }
+}
+
+/** Returns the downsample factor of the given level relative to level 0 (-1 on failure). */
+double
+OpenSlideImageIO::GetLevelDownsample(int iLevel) const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return -1.0;
+
+  return m_OpenSlideWrapper->GetLevelDownsample(iLevel);
+}
+
+/** Returns the dimensions of the given associated image without selecting it. */
+bool
+OpenSlideImageIO::GetAssociatedImageDimensions(const std::string & strName,
+                                               SizeValueType &     width,
+                                               SizeValueType &     height) const
+{
+  width = height = 0;
+
+  if (m_OpenSlideWrapper == NULL)
+    return false;
+
+  int64_t i64Width = 0, i64Height = 0;
+  if (!m_OpenSlideWrapper->GetAssociatedImageDimensions(strName, i64Width, i64Height))
+    return false;
+
+  width = (SizeValueType)i64Width;
+  height = (SizeValueType)i64Height;
+
+  return true;
+}
+
+/** Returns the absolute maximum number of streamable regions (tiles). */
+int64_t
+OpenSlideImageIO::ComputeMaximumNumberOfStreamableRegions() const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return -1;
+
+  return m_OpenSlideWrapper->ComputeMaximumNumberOfStreamableRegions();
+}
+
+/** Returns the maximum number of streamable regions similar (but >=) to the given region. */
+int64_t
+OpenSlideImageIO::ComputeMaximumNumberOfStreamableRegions(const ImageIORegion & clRegion) const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return -1;
+
+  ImageIORegion::IndexType clStart = clRegion.GetIndex();
+  ImageIORegion::SizeType  clSize = clRegion.GetSize();
+
+  if (clStart.size() != 2 || clSize.size() != 2)
+    return -1;
+
+  return m_OpenSlideWrapper->ComputeMaximumNumberOfStreamableRegions(clStart[0], clStart[1], clSize[0], clSize[1]);
+}
+
+/** Returns the minimum streamable region. */
+ImageIORegion
+OpenSlideImageIO::GetMinimumStreamableRegion() const
+{
+  if (m_OpenSlideWrapper == NULL)
+    return ImageIORegion();
+
+  ImageIORegion            clRegion;
+  ImageIORegion::SizeType  clSize(2);
+  ImageIORegion::IndexType clIndex(2, 0);
+
+  int64_t i64Width = 0, i64Height = 0;
+  if (!m_OpenSlideWrapper->ComputeMinimumStreamableRegionSize(i64Width, i64Height))
+    return ImageIORegion();
+
+  // XXX: Could overflow
+  clSize[0] = (SizeValueType)i64Width;
+  clSize[1] = (SizeValueType)i64Height;
+
+  clRegion.SetIndex(clIndex);
+  clRegion.SetSize(clSize);
+
+  return clRegion;
+}
+
+/** Turn on/off approximate streaming. This only affects streaming level images other than level 0. */
+void
+OpenSlideImageIO::SetApproximateStreaming(bool bApproximateStreaming)
+{
+  if (m_OpenSlideWrapper != NULL)
+    m_OpenSlideWrapper->SetApproximateStreaming(bApproximateStreaming);
+}
+
+/** Returns weather approximate streaming is enabled or not. */
+bool
+OpenSlideImageIO::GetApproximateStreaming() const
+{
+  return m_OpenSlideWrapper != NULL && m_OpenSlideWrapper->GetApproximateStreaming();
+}
+
+/** Turn on/off restricting level images to the bounds of the scanned area. */
+void
+OpenSlideImageIO::SetUseBounds(bool bUseBounds)
+{
+  if (m_OpenSlideWrapper != NULL)
+    m_OpenSlideWrapper->SetUseBounds(bUseBounds);
+}
+
+/** Returns whether level images are restricted to the bounds of the scanned area. */
+bool
+OpenSlideImageIO::GetUseBounds() const
+{
+  return m_OpenSlideWrapper != NULL && m_OpenSlideWrapper->GetUseBounds();
+}
+
+/** Returns how many pixels of the selected level are not read because they are outside the bounds. */
+uint64_t
+OpenSlideImageIO::GetNumberOfPixelsSkippedByBounds() const
+{
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened() || !GetAssociatedImageName().empty())
+    return 0;
+
+  const int iLevel = GetLevel();
+
+  int64_t i64X = 0, i64Y = 0, i64Width = 0, i64Height = 0, i64LevelWidth = 0, i64LevelHeight = 0;
+  if (!m_OpenSlideWrapper->GetLevelExtent(iLevel, i64X, i64Y, i64Width, i64Height) ||
+      !m_OpenSlideWrapper->GetLevelDimensions(iLevel, i64LevelWidth, i64LevelHeight))
+    return 0;
+
+  return (uint64_t)(i64LevelWidth * i64LevelHeight - i64Width * i64Height);
+}
+
+/** Sets the directory of the persistent header cache (empty string disables the cache). */
+void
+OpenSlideImageIO::SetHeaderCacheDirectory(const std::string & strDirectory)
+{
+  m_HeaderCacheDirectory = strDirectory;
+}
+
+/** Returns the directory of the persistent header cache (empty string if disabled). */
+std::string
+OpenSlideImageIO::GetHeaderCacheDirectory() const
+{
+  return m_HeaderCacheDirectory;
+}
+
+/** Sets the directory of the persistent tile cache (empty string disables the cache). */
+void
+OpenSlideImageIO::SetTileCacheDirectory(const std::string & strDirectory)
+{
+  m_TileCacheDirectory = strDirectory;
+}
+
+/** Returns the directory of the persistent tile cache (empty string if disabled). */
+std::string
+OpenSlideImageIO::GetTileCacheDirectory() const
+{
+  return m_TileCacheDirectory;
+}
+
+/** Sets the size limit of the tile cache directory in bytes (0 for no limit). */
+void
+OpenSlideImageIO::SetTileCacheSize(uint64_t ui64Bytes)
+{
+  m_TileCacheSize = ui64Bytes;
+}
+
+/** Returns the size limit of the tile cache directory in bytes. */
+uint64_t
+OpenSlideImageIO::GetTileCacheSize() const
+{
+  return m_TileCacheSize;
+}
+
+/** Returns the number of tiles read from the tile cache. */
+uint64_t
+OpenSlideImageIO::GetTileCacheHits() const
+{
+  return m_OpenSlideWrapper != NULL ? m_OpenSlideWrapper->GetTileCache().GetHits() : 0;
+}
+
+/** Returns the number of tiles that had to be decoded with the tile cache. */
+uint64_t
+OpenSlideImageIO::GetTileCacheMisses() const
+{
+  return m_OpenSlideWrapper != NULL ? m_OpenSlideWrapper->GetTileCache().GetMisses() : 0;
+}
+
+/** Sets the pool of the decode buffers. */
+void
+OpenSlideImageIO::SetBufferPool(OpenSlideBufferPool * p_clBufferPool)
+{
+  m_BufferPool = p_clBufferPool;
+}
+
+/** Returns the pool of the decode buffers. */
+OpenSlideBufferPool *
+OpenSlideImageIO::GetBufferPool() const
+{
+  return m_BufferPool.GetPointer();
+}
+
+/** Turn on/off reusing the overlap with the previous piece. */
+void
+OpenSlideImageIO::SetReuseStreamingBorders(bool bReuseStreamingBorders)
+{
+  m_ReuseStreamingBorders = bReuseStreamingBorders;
+
+  if (!m_ReuseStreamingBorders)
+    std::vector<uint32_t>().swap(m_BorderPixels);
+}
+
+/** Returns whether Read() reuses the overlap with the previous piece. */
+bool
+OpenSlideImageIO::GetReuseStreamingBorders() const
+{
+  return m_ReuseStreamingBorders;
+}
+
+/** Sets how pixels outside of the image are filled. */
+void
+OpenSlideImageIO::SetPaddingMode(PaddingEnum ePaddingMode)
+{
+  m_PaddingMode = ePaddingMode;
+}
 
-  ImageIORegion::SizeType  clSize = requested.GetSize();
-  ImageIORegion::IndexType clStart = requested.GetIndex();
+/** Returns how pixels outside of the image are filled. */
+OpenSlideImageIO::PaddingEnum
+OpenSlideImageIO::GetPaddingMode() const
+{
+  return m_PaddingMode;
+}
 
-  int64_t i64X = clStart[0];
-  int64_t i64Y = clStart[1];
+/** Returns the number of pixels copied from the previous piece. */
+uint64_t
+OpenSlideImageIO::GetNumberOfReusedPixels() const
+{
+  return m_NumberOfReusedPixels;
+}
 
-  int64_t i64Width = clSize[0];
-  int64_t i64Height = clSize[1];
+/** Returns the number of pixels filled as padding. */
+uint64_t
+OpenSlideImageIO::GetNumberOfPaddedPixels() const
+{
+  return m_NumberOfPaddedPixels;
+}
 
-  if (!m_OpenSlideWrapper->AlignReadRegion(i64X, i64Y, i64Width, i64Height))
-    return requested;
+/** Turn on/off accumulating statistics while reading. */
+void
+OpenSlideImageIO::SetComputeStatistics(bool bComputeStatistics)
+{
+  m_ComputeStatistics = bComputeStatistics;
+}
 
-  clStart[0] = (SizeValueType)i64X;
-  clStart[1] = (SizeValueType)i64Y;
+/** Returns whether statistics are accumulated while reading. */
+bool
+OpenSlideImageIO::GetComputeStatistics() const
+{
+  return m_ComputeStatistics;
+}
 
-  clSize[0] = (SizeValueType)i64Width;
-  clSize[1] = (SizeValueType)i64Height;
+/** Sets the minimum saturation of tissue pixels. */
+void
+OpenSlideImageIO::SetTissueSaturationThreshold(unsigned int uiThreshold)
+{
+  m_TissueSaturationThreshold = uiThreshold;
+}
 
-  ImageIORegion clNewRegion(requested);
+/** Returns the minimum saturation of tissue pixels. */
+unsigned int
+OpenSlideImageIO::GetTissueSaturationThreshold() const
+{
+  return m_TissueSaturationThreshold;
+}
 
-  clNewRegion.SetSize(clSize);
-  clNewRegion.SetIndex(clStart);
+/** Clears the accumulated statistics. */
+void
+OpenSlideImageIO::ResetStatistics()
+{
+  m_Statistics->Reset();
+}
 
-  return clNewRegion;
+void
+OpenSlideImageIO::ReadStatistics()
+{
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->IsOpened())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read statistics: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: OpenSlide context is not opened.");
+  }
+
+  if (!m_OpenSlideWrapper->GetAssociatedImageName().empty())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read statistics: "
+                      << this->GetFileName() << std::endl
+                      << "Reason: Statistics are only read from level images.");
+  }
+
+  ImageIORegion clRegion = this->GetIORegion();
+
+  if (clRegion.GetImageDimension() != 2 || clRegion.GetNumberOfPixels() == 0)
+  {
+    clRegion = ImageIORegion(2);
+    clRegion.SetSize(0, m_Dimensions[0]);
+    clRegion.SetSize(1, m_Dimensions[1]);
+  }
+
+  const int32_t i32Level = m_OpenSlideWrapper->GetLevel();
+  const int64_t i64X = clRegion.GetIndex(0);
+  const int64_t i64Y = clRegion.GetIndex(1);
+  const int64_t i64Width = clRegion.GetSize(0);
+  const int64_t i64Height = clRegion.GetSize(1);
+
+  std::vector<int64_t> vStripRows;
+  this->ComputeReadStrips(i32Level, i64Y, i64Height, vStripRows);
+
+  std::string strError;
+  std::mutex  clErrorMutex;
+
+  OpenSlideThreader::ParallelizeArray(
+    (int64_t)vStripRows.size() - 1,
+    [&](int64_t i64Strip) {
+      const int64_t         i64StripY = vStripRows[i64Strip];
+      const int64_t         i64StripHeight = vStripRows[i64Strip + 1] - i64StripY;
+      std::vector<uint32_t> vStrip(i64Width * i64StripHeight);
+
+      const char * const p_cError =
+        m_OpenSlideWrapper->ReadLevelRegion(vStrip.data(), i32Level, i64X, i64StripY, i64Width, i64StripHeight);
+
+      if (p_cError != NULL)
+      {
+        std::lock_guard<std::mutex> clLock(clErrorMutex);
+        strError = p_cError;
+        return;
+      }
+
+      OpenSlideStatistics clPartial;
+      clPartial.Accumulate(vStrip.data(), (int64_t)vStrip.size(), m_TissueSaturationThreshold);
+      m_Statistics->Merge(clPartial);
+    },
+    false);
+
+  if (!strError.empty())
+  {
+    itkExceptionMacro("Error OpenSlideImageIO could not read statistics: " << this->GetFileName() << std::endl
+                                                                           << "Reason: " << strError);
+  }
 }
 
-/** Get underlying OpenSlide library version */
-std::string
-OpenSlideImageIO::GetOpenSlideVersion() const
+/** Returns the number of pixels the statistics were accumulated over. */
+uint64_t
+OpenSlideImageIO::GetNumberOfStatisticsPixels() const
 {
-  const char * const p_cVersion = OpenSlideWrapper::GetVersion();
-  return p_cVersion != NULL ? std::string(p_cVersion) : std::string();
+  return m_Statistics->GetNumberOfPixels();
 }
 
-/** Detect the vendor of the current file. */
-std::string
-OpenSlideImageIO::GetVendor() const
+/** Returns the histogram of the given channel. */
+OpenSlideImageIO::HistogramType
+OpenSlideImageIO::GetHistogram(unsigned int uiChannel) const
 {
-  const char * const p_cVendor = OpenSlideWrapper::DetectVendor(this->GetFileName());
-  return p_cVendor != NULL ? std::string(p_cVendor) : std::string();
+  return uiChannel < 4 ? m_Statistics->GetHistogram(uiChannel) : HistogramType();
 }
 
-/** Sets the level to read. Level 0 (default) is the highest resolution level.
- * This method overrides any previously selected associated image.
+/** Returns the mean of the given channel. */
+double
+OpenSlideImageIO::GetMean(unsigned int uiChannel) const
+{
+  return uiChannel < 4 ? m_Statistics->GetMean(uiChannel) : 0.0;
+}
+
+/** Returns the fraction of tissue pixels. */
+double
+OpenSlideImageIO::GetTissueFraction() const
+{
+  return m_Statistics->GetTissueFraction();
+}
+
+/** Sets the memory layout of the pixels that are read.
  * Call ReadImageInformation() again after calling this function. */
 void
-OpenSlideImageIO::SetLevel(int iLevel)
+OpenSlideImageIO::SetOutputLayout(OutputLayoutEnum eLayout)
 {
-  if (m_OpenSlideWrapper == NULL)
-    return;
+  m_PixelConverter->SetOutputLayout(eLayout);
+}
 
-  m_OpenSlideWrapper->SetLevel(iLevel);
+/** Returns the memory layout of the pixels that are read. */
+OpenSlideImageIO::OutputLayoutEnum
+OpenSlideImageIO::GetOutputLayout() const
+{
+  return m_PixelConverter->GetOutputLayout();
 }
 
-/** Returns the currently selected level. */
-int
-OpenSlideImageIO::GetLevel() const
+/** Sets the component type of the pixels that are read.
+ * Call ReadImageInformation() again after calling this function. */
+void
+OpenSlideImageIO::SetOutputComponentType(OutputComponentEnum eComponentType)
 {
-  if (m_OpenSlideWrapper == NULL)
-    return -1;
+  m_PixelConverter->SetOutputComponentType(eComponentType);
+}
 
-  return m_OpenSlideWrapper->GetLevel();
+/** Returns the component type of the pixels that are read. */
+OpenSlideImageIO::OutputComponentEnum
+OpenSlideImageIO::GetOutputComponentType() const
+{
+  return m_PixelConverter->GetOutputComponentType();
 }
 
-/** Returns the number of available levels. */
-int
-OpenSlideImageIO::GetLevelCount() const
+/** Sets the per-channel normalization of Float and Half components. */
+void
+OpenSlideImageIO::SetNormalization(double dScale, const double a_dMean[4], const double a_dStdDev[4])
 {
-  if (m_OpenSlideWrapper == NULL)
-    return -1;
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    if (a_dStdDev[c] == 0.0)
+    {
+      itkExceptionMacro("Error OpenSlideImageIO invalid normalization." << std::endl
+                                                                         << "Reason: Standard deviation of channel "
+                                                                         << c << " is 0.");
+    }
+  }
 
-  return m_OpenSlideWrapper->GetLevelCount();
+  m_PixelConverter->SetNormalization(dScale, a_dMean, a_dStdDev);
 }
 
-/** Sets the associated image to extract.
- * This method overrides any previously selected level.
- * Call ReadImageInformation() again after calling this function. */
+/** Returns the per-channel normalization of Float and Half components. */
 void
-OpenSlideImageIO::SetAssociatedImageName(const std::string & strName)
+OpenSlideImageIO::GetNormalization(double & dScale, double a_dMean[4], double a_dStdDev[4]) const
 {
-  if (m_OpenSlideWrapper == NULL)
-    return;
-
-  m_OpenSlideWrapper->SetAssociatedImageName(strName);
+  m_PixelConverter->GetNormalization(dScale, a_dMean, a_dStdDev);
 }
 
-/** Returns the currently selected associated image name (empty string if none). */
-std::string
-OpenSlideImageIO::GetAssociatedImageName() const
+/** Sets the memory budget (in bytes) for streaming plans (0 for no limit, the default). */
+void
+OpenSlideImageIO::SetMemoryBudget(uint64_t ui64Bytes)
 {
-  if (m_OpenSlideWrapper == NULL)
-    return std::string();
+  m_MemoryBudget = ui64Bytes;
+}
 
-  return m_OpenSlideWrapper->GetAssociatedImageName();
+/** Returns the memory budget (in bytes) for streaming plans. */
+uint64_t
+OpenSlideImageIO::GetMemoryBudget() const
+{
+  return m_MemoryBudget;
 }
 
-/** Sets the best level to read for the given downsample factor.
- * This method overrides any previously selected associated image.
- * Call ReadImageInformation() again after calling this function. */
 bool
-OpenSlideImageIO::SetLevelForDownsampleFactor(double dDownsampleFactor)
+OpenSlideImageIO::ComputeStreamingSteps(int64_t & i64MinWidth,
+                                        int64_t & i64MinHeight,
+                                        int64_t & i64ColumnStep,
+                                        int64_t & i64RowStep) const
 {
-  if (m_OpenSlideWrapper == NULL)
+  const int64_t i64Width = m_Dimensions.size() > 1 ? (int64_t)m_Dimensions[0] : 0;
+  const int64_t i64Height = m_Dimensions.size() > 1 ? (int64_t)m_Dimensions[1] : 0;
+
+  if (m_OpenSlideWrapper == NULL || !m_OpenSlideWrapper->CanStreamRead() ||
+      !m_OpenSlideWrapper->ComputeMinimumStreamableRegionSize(i64MinWidth, i64MinHeight))
     return false;
 
-  return m_OpenSlideWrapper->SetBestLevelForDownsample(dDownsampleFactor);
-}
+  // Pieces that end on native tile boundaries do not decode the tiles they share with their neighbors twice
+  int64_t i64TileWidth = 0, i64TileHeight = 0;
+  if (!m_OpenSlideWrapper->GetLevelTileSize(this->GetLevel(), i64TileWidth, i64TileHeight))
+  {
+    i64TileWidth = i64MinWidth;
+    i64TileHeight = i64MinHeight;
+  }
 
-/** Returns all associated image names stored in the file. */
-OpenSlideImageIO::AssociatedImageNameContainer
-OpenSlideImageIO::GetAssociatedImageNames() const
-{
-  if (m_OpenSlideWrapper == NULL)
-    return AssociatedImageNameContainer();
+  i64RowStep = i64MinHeight / (int64_t)OpenSlideWrapper::GCD(i64MinHeight, i64TileHeight) * i64TileHeight;
+  if (i64RowStep > i64Height)
+    i64RowStep = i64MinHeight;
 
-  return m_OpenSlideWrapper->GetAssociatedImageNames();
+  i64ColumnStep = i64MinWidth / (int64_t)OpenSlideWrapper::GCD(i64MinWidth, i64TileWidth) * i64TileWidth;
+  if (i64ColumnStep > i64Width)
+    i64ColumnStep = i64MinWidth;
+
+  return true;
 }
 
-/** Returns the absolute maximum number of streamable regions (tiles). */
-int64_t
-OpenSlideImageIO::ComputeMaximumNumberOfStreamableRegions() const
+/** Computes the piece size and number of pieces that keep streaming within the memory budget. */
+bool
+OpenSlideImageIO::ComputeStreamingPlan(double          dDownstreamBytesPerPixel,
+                                       SizeValueType & pieceWidth,
+                                       SizeValueType & pieceHeight,
+                                       SizeValueType & numberOfPieces) const
 {
-  if (m_OpenSlideWrapper == NULL)
-    return -1;
+  // OpenSlide's tile cache (32 MiB by default) is resident no matter how the image is streamed
+  const double dFixedBytes = 32.0 * 1024.0 * 1024.0;
 
-  return m_OpenSlideWrapper->ComputeMaximumNumberOfStreamableRegions();
+  const int64_t i64Width = m_Dimensions.size() > 1 ? (int64_t)m_Dimensions[0] : 0;
+  const int64_t i64Height = m_Dimensions.size() > 1 ? (int64_t)m_Dimensions[1] : 0;
+
+  pieceWidth = (SizeValueType)i64Width;
+  pieceHeight = (SizeValueType)i64Height;
+  numberOfPieces = 1;
+
+  // Output pixels, the ARGB decode buffer for converted outputs and whatever the downstream filters keep per pixel
+  const bool   bDecodeBuffer = m_PixelConverter->NeedsDecodeBuffer();
+  const double dBytesPerPixel = m_PixelConverter->GetOutputPixelSize() + (bDecodeBuffer ? sizeof(uint32_t) : 0) +
+                                std::max(0.0, dDownstreamBytesPerPixel);
+
+  if (m_MemoryBudget == 0 || i64Width <= 0 || i64Height <= 0 ||
+      dFixedBytes + dBytesPerPixel * i64Width * i64Height <= (double)m_MemoryBudget)
+    return true;
+
+  int64_t i64MinWidth = 0, i64MinHeight = 0, i64ColumnStep = 0, i64RowStep = 0;
+  if (!this->ComputeStreamingSteps(i64MinWidth, i64MinHeight, i64ColumnStep, i64RowStep))
+    return false;
+
+  const double  dAvailablePixels = std::max(0.0, (double)m_MemoryBudget - dFixedBytes) / dBytesPerPixel;
+  const int64_t i64Rows = (int64_t)(dAvailablePixels / i64Width);
+
+  int64_t i64PieceWidth = i64Width;
+  int64_t i64PieceHeight = 0;
+
+  if (i64Rows >= i64RowStep)
+  {
+    // Strips of full rows (what ImageFileWriter and StreamingImageFilter produce by default)
+    i64PieceHeight = i64Rows / i64RowStep * i64RowStep;
+  }
+  else if (i64Rows >= i64MinHeight)
+  {
+    i64PieceHeight = i64Rows / i64MinHeight * i64MinHeight;
+  }
+  else
+  {
+    // Not even the thinnest strip fits: use tiles
+    i64PieceHeight = std::min(i64RowStep, std::max<int64_t>(i64MinHeight, (int64_t)std::sqrt(dAvailablePixels)));
+    i64PieceHeight = std::max<int64_t>(i64MinHeight, i64PieceHeight / i64MinHeight * i64MinHeight);
+
+    const int64_t i64Columns = (int64_t)(dAvailablePixels / i64PieceHeight);
+
+    if (i64Columns >= i64ColumnStep)
+      i64PieceWidth = i64Columns / i64ColumnStep * i64ColumnStep;
+    else
+      i64PieceWidth = std::max<int64_t>(1, i64Columns / i64MinWidth) * i64MinWidth;
+  }
+
+  i64PieceWidth = std::min(i64PieceWidth, i64Width);
+  i64PieceHeight = std::min(i64PieceHeight, i64Height);
+
+  pieceWidth = (SizeValueType)i64PieceWidth;
+  pieceHeight = (SizeValueType)i64PieceHeight;
+  numberOfPieces = (SizeValueType)(((i64Width + i64PieceWidth - 1) / i64PieceWidth) *
+                                   ((i64Height + i64PieceHeight - 1) / i64PieceHeight));
+
+  return dFixedBytes + dBytesPerPixel * i64PieceWidth * i64PieceHeight <= (double)m_MemoryBudget;
 }
 
-/** Returns the maximum number of streamable regions similar (but >=) to the given region. */
-int64_t
-OpenSlideImageIO::ComputeMaximumNumberOfStreamableRegions(const ImageIORegion & clRegion) const
+/** Returns the number of stream divisions that keeps streaming within the memory budget (0 if none does). */
+OpenSlideImageIO::SizeValueType
+OpenSlideImageIO::ComputeNumberOfStreamDivisions(double dDownstreamBytesPerPixel) const
 {
-  if (m_OpenSlideWrapper == NULL)
-    return -1;
+  SizeValueType pieceWidth = 0, pieceHeight = 0, numberOfPieces = 1;
+  if (!this->ComputeStreamingPlan(dDownstreamBytesPerPixel, pieceWidth, pieceHeight, numberOfPieces))
+    return 0;
 
-  ImageIORegion::IndexType clStart = clRegion.GetIndex();
-  ImageIORegion::SizeType  clSize = clRegion.GetSize();
+  if (numberOfPieces == 1)
+    return 1;
 
-  if (clStart.size() != 2 || clSize.size() != 2)
-    return -1;
+  // Tiles cannot be requested through a number of stream divisions
+  if (pieceWidth < m_Dimensions[0])
+    return 0;
 
-  return m_OpenSlideWrapper->ComputeMaximumNumberOfStreamableRegions(clStart[0], clStart[1], clSize[0], clSize[1]);
+  int64_t i64MinWidth = 0, i64MinHeight = 0, i64ColumnStep = 0, i64RowStep = 0;
+  if (!this->ComputeStreamingSteps(i64MinWidth, i64MinHeight, i64ColumnStep, i64RowStep))
+    return 0;
+
+  // ImageRegionSplitterSlowDimension cuts N divisions into strips of ceil(H / N) rows. Take the fewest divisions whose
+  // strips fit in the planned strip height and end on native tile boundaries too, or else only on the streamable grid.
+  const int64_t i64Height = (int64_t)m_Dimensions[1];
+
+  for (const int64_t i64Step : { i64RowStep, i64MinHeight })
+  {
+    for (int64_t i64Strip = (int64_t)pieceHeight / i64Step * i64Step; i64Strip >= i64Step; i64Strip -= i64Step)
+    {
+      const int64_t i64Divisions = (i64Height + i64Strip - 1) / i64Strip;
+
+      if ((i64Height + i64Divisions - 1) / i64Divisions == i64Strip)
+        return (SizeValueType)i64Divisions;
+    }
+  }
+
+  // Strips off the streamable grid are enlarged to it when read, which the budget does not allow for
+  return 0;
 }
 
-/** Returns the minimum streamable region. */
-ImageIORegion
-OpenSlideImageIO::GetMinimumStreamableRegion() const
+/** Sets the color transform applied while reading.
+ * Call ReadImageInformation() again after calling this function. */
+void
+OpenSlideImageIO::SetColorTransform(ColorTransformEnum eColorTransform)
 {
-  if (m_OpenSlideWrapper == NULL)
-    return ImageIORegion();
+  m_PixelConverter->SetColorTransform(eColorTransform);
+}
 
-  ImageIORegion            clRegion;
-  ImageIORegion::SizeType  clSize(2);
-  ImageIORegion::IndexType clIndex(2, 0);
+/** Returns the color transform applied while reading. */
+OpenSlideImageIO::ColorTransformEnum
+OpenSlideImageIO::GetColorTransform() const
+{
+  return m_PixelConverter->GetColorTransform();
+}
 
-  int64_t i64Width = 0, i64Height = 0;
-  if (!m_OpenSlideWrapper->ComputeMinimumStreamableRegionSize(i64Width, i64Height))
-    return ImageIORegion();
+/** Sets the optical density vectors of the 3 stains, one stain per row. */
+void
+OpenSlideImageIO::SetStainMatrix(const double a_dStains[9])
+{
+  if (!m_PixelConverter->SetStainMatrix(a_dStains))
+  {
+    itkExceptionMacro("Error OpenSlideImageIO invalid stain matrix." << std::endl
+                                                                      << "Reason: Stains are not linearly independent.");
+  }
+}
 
-  // XXX: Could overflow
-  clSize[0] = (SizeValueType)i64Width;
-  clSize[1] = (SizeValueType)i64Height;
+/** Returns the normalized stain vectors, one stain per row. */
+void
+OpenSlideImageIO::GetStainMatrix(double a_dStains[9]) const
+{
+  m_PixelConverter->GetStainMatrix(a_dStains);
+}
 
-  clRegion.SetIndex(clIndex);
-  clRegion.SetSize(clSize);
+/** Sets the target statistics for Reinhard color normalization. */
+void
+OpenSlideImageIO::SetReinhardTarget(const double a_dMean[3], const double a_dStdDev[3])
+{
+  m_PixelConverter->SetReinhardTarget(a_dMean, a_dStdDev);
+}
 
-  return clRegion;
+/** Returns the target statistics for Reinhard color normalization. */
+void
+OpenSlideImageIO::GetReinhardTarget(double a_dMean[3], double a_dStdDev[3]) const
+{
+  m_PixelConverter->GetReinhardTarget(a_dMean, a_dStdDev);
 }
 
-/** Turn on/off approximate streaming. This only affects streaming level images other than level 0. */
+/** Returns the statistics of the slide for Reinhard color normalization. */
 void
-OpenSlideImageIO::SetApproximateStreaming(bool bApproximateStreaming)
+OpenSlideImageIO::GetReinhardSource(double a_dMean[3], double a_dStdDev[3]) const
 {
-  if (m_OpenSlideWrapper != NULL)
-    m_OpenSlideWrapper->SetApproximateStreaming(bApproximateStreaming);
+  m_PixelConverter->GetReinhardSource(a_dMean, a_dStdDev);
 }
 
-/** Returns weather approximate streaming is enabled or not. */
-bool
-OpenSlideImageIO::GetApproximateStreaming() const
+/** Returns the number of channels (3 or 4) of the given output layout. */
+unsigned int
+OpenSlideImageIO::GetNumberOfLayoutComponents(OutputLayoutEnum eLayout)
 {
-  return m_OpenSlideWrapper != NULL && m_OpenSlideWrapper->GetApproximateStreaming();
+  return OpenSlidePixelConverter::GetNumberOfComponents(eLayout);
+}
+
+void
+OpenSlideImageIO::UpdatePixelTypeInfo()
+{
+  const OutputLayoutEnum    eLayout = m_PixelConverter->GetOutputLayout();
+  const OutputComponentEnum eComponentType = m_PixelConverter->GetOutputComponentType();
+
+  if (eComponentType != OutputComponentEnum::UnsignedChar)
+  {
+    switch (eLayout)
+    {
+      case OutputLayoutEnum::RGBA:
+        this->SetPixelType(IOPixelEnum::RGBA);
+        break;
+      case OutputLayoutEnum::RGB:
+        this->SetPixelType(IOPixelEnum::RGB);
+        break;
+      default:
+        this->SetPixelType(IOPixelEnum::VECTOR);
+        break;
+    }
+
+    this->SetComponentType(eComponentType == OutputComponentEnum::Float ? IOComponentEnum::FLOAT
+                                                                         : IOComponentEnum::USHORT);
+    this->SetNumberOfComponents(GetNumberOfLayoutComponents(eLayout));
+    return;
+  }
+
+  switch (eLayout)
+  {
+    case OutputLayoutEnum::RGBA:
+    {
+      RGBAPixel<unsigned char> clPixel;
+      this->SetPixelTypeInfo(&clPixel);
+    }
+    break;
+    case OutputLayoutEnum::RGB:
+    {
+      RGBPixel<unsigned char> clPixel;
+      this->SetPixelTypeInfo(&clPixel);
+    }
+    break;
+    default:
+      this->SetPixelType(IOPixelEnum::VECTOR);
+      this->SetComponentType(IOComponentEnum::UCHAR);
+      this->SetNumberOfComponents(GetNumberOfLayoutComponents(eLayout));
+      break;
+  }
+}
+
+void
+OpenSlideImageIO::AccumulateStatistics(const uint32_t * p_u32Source, int64_t i64Count, bool bSerial) const
+{
+  // Chunks of 1M pixels, each accumulated into its own partial statistics
+  const int64_t i64ChunkSize = 1 << 20;
+  const int64_t i64NumChunks = (i64Count + i64ChunkSize - 1) / i64ChunkSize;
+
+  OpenSlideThreader::ParallelizeArray(
+    i64NumChunks,
+    [&](int64_t i64Chunk) {
+      const int64_t i64Begin = i64Chunk * i64ChunkSize;
+
+      OpenSlideStatistics clPartial;
+      clPartial.Accumulate(
+        p_u32Source + i64Begin, std::min(i64ChunkSize, i64Count - i64Begin), m_TissueSaturationThreshold);
+      m_Statistics->Merge(clPartial);
+    },
+    bSerial);
 }
 
 } // end namespace itk
@@ -0,0 +1,685 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include "itkOpenSlidePatchLoader.h"
+
+namespace itk
+{
+
+namespace
+{
+
+// Patches drawn around tissue pixels before the one with the most tissue is taken
+const unsigned int maximumNumberOfAttempts = 32;
+
+} // end anonymous namespace
+
+OpenSlidePatchLoader::OpenSlidePatchLoader()
+{
+  m_Level = 0;
+  m_PatchSize = 256;
+  m_MinimumTissueFraction = 0.0;
+  m_TissueSaturationThreshold = 20;
+  m_MaskSize = 1024;
+  m_OutputLayout = ImageIOType::OutputLayoutEnum::RGB;
+  m_OutputComponentType = ImageIOType::OutputComponentEnum::UnsignedChar;
+  m_NormalizationScale = 1.0;
+  std::fill(m_NormalizationMean, m_NormalizationMean + 4, 0.0);
+  std::fill(m_NormalizationStdDev, m_NormalizationStdDev + 4, 1.0);
+  m_MaximumNumberOfOpenSlides = 16;
+  m_Seed = 0;
+  m_UseCounter = 0;
+  m_NumberOfOpenSlides = 0;
+  m_NumberOfOpenedSlides = 0;
+  m_NumberOfDetectedForks = 0;
+  m_ProcessId = GetProcessId();
+  m_Generator.seed(m_Seed);
+}
+
+OpenSlidePatchLoader::~OpenSlidePatchLoader()
+{
+  // A forked process leaks the slides of its parent instead of closing them
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  this->CheckProcess();
+}
+
+void
+OpenSlidePatchLoader::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Number Of Slides: " << this->GetNumberOfSlides() << '\n';
+  os << indent << "Level: " << m_Level << '\n';
+  os << indent << "Patch Size: " << m_PatchSize << '\n';
+  os << indent << "Minimum Tissue Fraction: " << m_MinimumTissueFraction << '\n';
+  os << indent << "Tissue Saturation Threshold: " << m_TissueSaturationThreshold << '\n';
+  os << indent << "Mask Size: " << m_MaskSize << '\n';
+  os << indent << "Output Layout: " << static_cast<int>(m_OutputLayout) << '\n';
+  os << indent << "Output Component Type: " << static_cast<int>(m_OutputComponentType) << '\n';
+  os << indent << "Header Cache Directory: " << m_HeaderCacheDirectory << '\n';
+  os << indent << "Maximum Number Of Open Slides: " << m_MaximumNumberOfOpenSlides << '\n';
+  os << indent << "Seed: " << m_Seed << '\n';
+  os << indent << "Opened Slides: " << this->GetNumberOfOpenedSlides() << '\n';
+  os << indent << "Detected Forks: " << this->GetNumberOfDetectedForks() << '\n';
+}
+
+/** Adds a slide and returns its index. */
+unsigned int
+OpenSlidePatchLoader::AddSlide(const std::string & strFileName)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  SlideInformation clSlide;
+  clSlide.m_FileName = strFileName;
+  clSlide.m_HasInformation = false;
+  clSlide.m_Width = clSlide.m_Height = 0;
+  clSlide.m_TissueMask = ImageIOType::TissueMask();
+
+  m_Slides.push_back(clSlide);
+  m_ImageIOs.push_back(nullptr);
+  m_LastUse.push_back(0);
+  this->Modified();
+
+  return (unsigned int)(m_Slides.size() - 1);
+}
+
+/** Removes all slides. */
+void
+OpenSlidePatchLoader::ClearSlides()
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  this->CheckProcess();
+  this->CloseSlides();
+  m_Slides.clear();
+  m_ImageIOs.clear();
+  m_LastUse.clear();
+  this->Modified();
+}
+
+/** Returns the number of slides. */
+unsigned int
+OpenSlidePatchLoader::GetNumberOfSlides() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return (unsigned int)m_Slides.size();
+}
+
+/** Returns a copy of the file name of the given slide (another thread may add or clear slides). */
+std::string
+OpenSlidePatchLoader::GetSlideFileName(unsigned int uiSlide) const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  if (uiSlide >= m_Slides.size())
+  {
+    itkExceptionMacro("Error OpenSlidePatchLoader could not get slide file name: "
+                      << uiSlide << std::endl
+                      << "Reason: There are only " << m_Slides.size() << " slides.");
+  }
+
+  return m_Slides[uiSlide].m_FileName;
+}
+
+/** Sets the level patches are read from. */
+void
+OpenSlidePatchLoader::SetLevel(int iLevel)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_Level = iLevel;
+  this->ResetSlideInformation();
+  this->Modified();
+}
+
+/** Returns the level patches are read from. */
+int
+OpenSlidePatchLoader::GetLevel() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_Level;
+}
+
+/** Sets the width and height of the patches. */
+void
+OpenSlidePatchLoader::SetPatchSize(SizeValueType patchSize)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_PatchSize = patchSize;
+  this->Modified();
+}
+
+/** Returns the width and height of the patches. */
+SizeValueType
+OpenSlidePatchLoader::GetPatchSize() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_PatchSize;
+}
+
+/** Sets the minimum fraction of tissue of a sampled patch. */
+void
+OpenSlidePatchLoader::SetMinimumTissueFraction(double dMinimumTissueFraction)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_MinimumTissueFraction = dMinimumTissueFraction;
+  this->ResetSlideInformation();
+  this->Modified();
+}
+
+/** Returns the minimum fraction of tissue of a sampled patch. */
+double
+OpenSlidePatchLoader::GetMinimumTissueFraction() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_MinimumTissueFraction;
+}
+
+/** Sets the minimum saturation of tissue pixels in the mask. */
+void
+OpenSlidePatchLoader::SetTissueSaturationThreshold(unsigned int uiThreshold)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_TissueSaturationThreshold = uiThreshold;
+  this->ResetSlideInformation();
+  this->Modified();
+}
+
+/** Returns the minimum saturation of tissue pixels in the mask. */
+unsigned int
+OpenSlidePatchLoader::GetTissueSaturationThreshold() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_TissueSaturationThreshold;
+}
+
+/** Sets the maximum width and height of the tissue masks. */
+void
+OpenSlidePatchLoader::SetMaskSize(SizeValueType maskSize)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_MaskSize = maskSize;
+  this->ResetSlideInformation();
+  this->Modified();
+}
+
+/** Returns the maximum width and height of the tissue masks. */
+SizeValueType
+OpenSlidePatchLoader::GetMaskSize() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_MaskSize;
+}
+
+/** Sets the output layout of the patches. */
+void
+OpenSlidePatchLoader::SetOutputLayout(ImageIOType::OutputLayoutEnum eLayout)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_OutputLayout = eLayout;
+  this->CheckProcess();
+  this->CloseSlides();
+  this->Modified();
+}
+
+/** Returns the output layout of the patches. */
+OpenSlideImageIO::OutputLayoutEnum
+OpenSlidePatchLoader::GetOutputLayout() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_OutputLayout;
+}
+
+/** Sets the component type of the patches. */
+void
+OpenSlidePatchLoader::SetOutputComponentType(ImageIOType::OutputComponentEnum eComponentType)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_OutputComponentType = eComponentType;
+  this->CheckProcess();
+  this->CloseSlides();
+  this->Modified();
+}
+
+/** Returns the component type of the patches. */
+OpenSlideImageIO::OutputComponentEnum
+OpenSlidePatchLoader::GetOutputComponentType() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_OutputComponentType;
+}
+
+/** Sets the normalization of float and half patches. */
+void
+OpenSlidePatchLoader::SetNormalization(double dScale, const double a_dMean[4], const double a_dStdDev[4])
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_NormalizationScale = dScale;
+  std::copy(a_dMean, a_dMean + 4, m_NormalizationMean);
+  std::copy(a_dStdDev, a_dStdDev + 4, m_NormalizationStdDev);
+  this->CheckProcess();
+  this->CloseSlides();
+  this->Modified();
+}
+
+/** Sets the header cache directory of the slides. */
+void
+OpenSlidePatchLoader::SetHeaderCacheDirectory(const std::string & strDirectory)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_HeaderCacheDirectory = strDirectory;
+  this->CheckProcess();
+  this->CloseSlides();
+  this->Modified();
+}
+
+/** Returns the header cache directory of the slides. */
+std::string
+OpenSlidePatchLoader::GetHeaderCacheDirectory() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_HeaderCacheDirectory;
+}
+
+/** Sets how many slides each process keeps open. */
+void
+OpenSlidePatchLoader::SetMaximumNumberOfOpenSlides(unsigned int uiMaximumNumberOfOpenSlides)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  m_MaximumNumberOfOpenSlides = std::max(1u, uiMaximumNumberOfOpenSlides);
+  this->Modified();
+}
+
+/** Returns how many slides each process keeps open. */
+unsigned int
+OpenSlidePatchLoader::GetMaximumNumberOfOpenSlides() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_MaximumNumberOfOpenSlides;
+}
+
+/** Seeds the random generator of this process. */
+void
+OpenSlidePatchLoader::SetSeed(uint64_t ui64Seed)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  this->CheckProcess();
+  m_Seed = ui64Seed;
+  m_Generator.seed(m_Seed);
+  this->Modified();
+}
+
+/** Returns the seed of the random generator. */
+uint64_t
+OpenSlidePatchLoader::GetSeed() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_Seed;
+}
+
+/** Returns the size in bytes of one patch. */
+size_t
+OpenSlidePatchLoader::GetPatchBufferSize() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  size_t componentSize = 1;
+
+  switch (m_OutputComponentType)
+  {
+    case ImageIOType::OutputComponentEnum::Float:
+      componentSize = sizeof(float);
+      break;
+    case ImageIOType::OutputComponentEnum::Half:
+      componentSize = sizeof(uint16_t);
+      break;
+    default:
+      break;
+  }
+
+  return componentSize * ImageIOType::GetNumberOfLayoutComponents(m_OutputLayout) * m_PatchSize * m_PatchSize;
+}
+
+void
+OpenSlidePatchLoader::PrepareSlides()
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  this->CheckProcess();
+
+  for (unsigned int i = 0; i < m_Slides.size(); ++i)
+    this->UpdateSlideInformation(i);
+}
+
+void
+OpenSlidePatchLoader::SamplePatches(SizeValueType numberOfPatches, PatchContainer & vPatches)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  this->CheckProcess();
+
+  // Slides that are large enough for a patch
+  std::vector<unsigned int> vSlides;
+
+  for (unsigned int i = 0; i < m_Slides.size(); ++i)
+  {
+    this->UpdateSlideInformation(i);
+
+    if (m_Slides[i].m_Width >= m_PatchSize && m_Slides[i].m_Height >= m_PatchSize && m_PatchSize > 0)
+      vSlides.push_back(i);
+  }
+
+  if (vSlides.empty())
+  {
+    itkExceptionMacro("Error OpenSlidePatchLoader could not sample patches: "
+                      << m_Slides.size() << " slides" << std::endl
+                      << "Reason: No slide has level " << m_Level << " of at least " << m_PatchSize << " x "
+                      << m_PatchSize << " pixels.");
+  }
+
+  // Draw the slides first, so the patches can be ordered by slide
+  std::vector<SizeValueType>                  vCounts(m_Slides.size(), 0);
+  std::uniform_int_distribution<unsigned int> clSlideDistribution(0, (unsigned int)vSlides.size() - 1);
+
+  for (SizeValueType i = 0; i < numberOfPatches; ++i)
+    ++vCounts[vSlides[clSlideDistribution(m_Generator)]];
+
+  vPatches.clear();
+  vPatches.reserve(numberOfPatches);
+
+  for (unsigned int i = 0; i < m_Slides.size(); ++i)
+  {
+    for (SizeValueType j = 0; j < vCounts[i]; ++j)
+      vPatches.push_back(this->SamplePatch(i));
+  }
+}
+
+void
+OpenSlidePatchLoader::ReadPatches(const PatchContainer & vPatches, void * buffer)
+{
+  const size_t patchBytes = this->GetPatchBufferSize();
+
+  unsigned char * const p_ucBuffer = (unsigned char *)buffer;
+
+  // Patches of one slide in a row are read with one call
+  for (size_t begin = 0; begin < vPatches.size();)
+  {
+    const unsigned int uiSlide = vPatches[begin].m_Slide;
+
+    size_t end = begin + 1;
+    while (end < vPatches.size() && vPatches[end].m_Slide == uiSlide)
+      ++end;
+
+    ImageIOType::Pointer         p_clImageIO;
+    int                          iLevel = 0;
+    ImageIOType::RegionContainer vRegions(end - begin, ImageIORegion(2));
+
+    {
+      std::lock_guard<std::mutex> clLock(m_Mutex);
+      this->CheckProcess();
+
+      if (uiSlide >= m_Slides.size())
+      {
+        itkExceptionMacro("Error OpenSlidePatchLoader could not read patches: "
+                          << uiSlide << std::endl
+                          << "Reason: There are only " << m_Slides.size() << " slides.");
+      }
+
+      // Keep a reference, so another thread may close the slide while it is read
+      p_clImageIO = this->GetImageIO(uiSlide);
+      iLevel = m_Level;
+
+      for (size_t i = begin; i < end; ++i)
+      {
+        vRegions[i - begin].SetIndex(0, vPatches[i].m_X);
+        vRegions[i - begin].SetIndex(1, vPatches[i].m_Y);
+        vRegions[i - begin].SetSize(0, m_PatchSize);
+        vRegions[i - begin].SetSize(1, m_PatchSize);
+      }
+    }
+
+    p_clImageIO->ReadRegions(iLevel, vRegions, p_ucBuffer + begin * patchBytes);
+
+    begin = end;
+  }
+}
+
+void
+OpenSlidePatchLoader::ReadBatch(SizeValueType numberOfPatches, void * buffer, PatchContainer & vPatches)
+{
+  this->SamplePatches(numberOfPatches, vPatches);
+  this->ReadPatches(vPatches, buffer);
+}
+
+/** Returns the number of slides this process opened. */
+uint64_t
+OpenSlidePatchLoader::GetNumberOfOpenedSlides() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_ProcessId == GetProcessId() ? m_NumberOfOpenedSlides : 0;
+}
+
+/** Returns the number of detected forks. */
+unsigned int
+OpenSlidePatchLoader::GetNumberOfDetectedForks() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_NumberOfDetectedForks;
+}
+
+void
+OpenSlidePatchLoader::CheckProcess()
+{
+  const int64_t i64ProcessId = GetProcessId();
+
+  if (i64ProcessId == m_ProcessId)
+    return;
+
+  // The handles of the parent are leaked rather than closed: closing them could wait forever on a lock another
+  // thread of the parent held when it forked
+  for (size_t i = 0; i < m_ImageIOs.size(); ++i)
+  {
+    if (m_ImageIOs[i])
+    {
+      m_ImageIOs[i]->Register();
+      m_ImageIOs[i] = nullptr;
+    }
+  }
+
+  m_NumberOfOpenSlides = 0;
+  m_NumberOfOpenedSlides = 0;
+  ++m_NumberOfDetectedForks;
+  m_ProcessId = i64ProcessId;
+
+  // Workers forked from the same parent must not draw the same patches
+  m_Generator.seed(m_Seed ^ ((uint64_t)i64ProcessId * 0x9e3779b97f4a7c15ULL));
+}
+
+void
+OpenSlidePatchLoader::CloseSlides()
+{
+  std::fill(m_ImageIOs.begin(), m_ImageIOs.end(), nullptr);
+  m_NumberOfOpenSlides = 0;
+}
+
+OpenSlideImageIO::Pointer
+OpenSlidePatchLoader::GetImageIO(unsigned int uiSlide)
+{
+  if (m_ImageIOs[uiSlide])
+  {
+    m_LastUse[uiSlide] = ++m_UseCounter;
+    return m_ImageIOs[uiSlide];
+  }
+
+  // Close the least recently used slide
+  if (m_NumberOfOpenSlides >= m_MaximumNumberOfOpenSlides)
+  {
+    size_t oldest = m_ImageIOs.size();
+
+    for (size_t i = 0; i < m_ImageIOs.size(); ++i)
+    {
+      if (m_ImageIOs[i] && (oldest == m_ImageIOs.size() || m_LastUse[i] < m_LastUse[oldest]))
+        oldest = i;
+    }
+
+    if (oldest < m_ImageIOs.size())
+    {
+      m_ImageIOs[oldest] = nullptr;
+      --m_NumberOfOpenSlides;
+    }
+  }
+
+  ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+  p_clImageIO->SetFileName(m_Slides[uiSlide].m_FileName);
+  p_clImageIO->SetOutputLayout(m_OutputLayout);
+  p_clImageIO->SetOutputComponentType(m_OutputComponentType);
+  p_clImageIO->SetNormalization(m_NormalizationScale, m_NormalizationMean, m_NormalizationStdDev);
+  p_clImageIO->SetHeaderCacheDirectory(m_HeaderCacheDirectory);
+  p_clImageIO->ReadImageInformation();
+
+  m_ImageIOs[uiSlide] = p_clImageIO;
+  m_LastUse[uiSlide] = ++m_UseCounter;
+  ++m_NumberOfOpenSlides;
+  ++m_NumberOfOpenedSlides;
+
+  return p_clImageIO;
+}
+
+void
+OpenSlidePatchLoader::UpdateSlideInformation(unsigned int uiSlide)
+{
+  SlideInformation & clSlide = m_Slides[uiSlide];
+
+  if (clSlide.m_HasInformation)
+    return;
+
+  ImageIOType::Pointer p_clImageIO = this->GetImageIO(uiSlide);
+
+  SizeValueType width = 0, height = 0;
+  if (!p_clImageIO->GetLevelDimensions(m_Level, width, height))
+    width = height = 0;
+
+  clSlide.m_Width = width;
+  clSlide.m_Height = height;
+  clSlide.m_TissueMask = ImageIOType::TissueMask();
+  clSlide.m_TissuePixels.clear();
+
+  if (m_MinimumTissueFraction > 0.0 && width > 0 && height > 0)
+    p_clImageIO->ReadTissueMask(m_MaskSize, m_MaskSize, m_TissueSaturationThreshold, clSlide.m_TissueMask);
+
+  const std::vector<unsigned char> & vMask = clSlide.m_TissueMask.m_Pixels;
+
+  for (size_t i = 0; i < vMask.size(); ++i)
+  {
+    if (vMask[i] != 0)
+      clSlide.m_TissuePixels.push_back(i);
+  }
+
+  clSlide.m_HasInformation = true;
+}
+
+void
+OpenSlidePatchLoader::ResetSlideInformation()
+{
+  for (size_t i = 0; i < m_Slides.size(); ++i)
+  {
+    m_Slides[i].m_HasInformation = false;
+    m_Slides[i].m_TissueMask = ImageIOType::TissueMask();
+    m_Slides[i].m_TissuePixels.clear();
+  }
+}
+
+OpenSlidePatchLoader::Patch
+OpenSlidePatchLoader::SamplePatch(unsigned int uiSlide)
+{
+  const SlideInformation & clSlide = m_Slides[uiSlide];
+
+  std::uniform_int_distribution<SizeValueType> clXDistribution(0, clSlide.m_Width - m_PatchSize);
+  std::uniform_int_distribution<SizeValueType> clYDistribution(0, clSlide.m_Height - m_PatchSize);
+
+  Patch clPatch = { uiSlide, 0, 0, 1.0 };
+
+  if (!(m_MinimumTissueFraction > 0.0))
+  {
+    clPatch.m_X = clXDistribution(m_Generator);
+    clPatch.m_Y = clYDistribution(m_Generator);
+    return clPatch;
+  }
+
+  if (clSlide.m_TissuePixels.empty())
+  {
+    clPatch.m_X = clXDistribution(m_Generator);
+    clPatch.m_Y = clYDistribution(m_Generator);
+    clPatch.m_TissueFraction = 0.0;
+    return clPatch;
+  }
+
+  std::uniform_int_distribution<size_t>  clTissueDistribution(0, clSlide.m_TissuePixels.size() - 1);
+  std::uniform_real_distribution<double> clOffsetDistribution(0.0, 1.0);
+
+  const ImageIOType::TissueMask & clMask = clSlide.m_TissueMask;
+
+  const double dScaleX = (double)clSlide.m_Width / clMask.m_Width;
+  const double dScaleY = (double)clSlide.m_Height / clMask.m_Height;
+
+  clPatch.m_TissueFraction = -1.0;
+
+  for (unsigned int uiAttempt = 0; uiAttempt < maximumNumberOfAttempts; ++uiAttempt)
+  {
+    // A patch centered on a random point of a random tissue pixel of the mask
+    const SizeValueType pixel = clSlide.m_TissuePixels[clTissueDistribution(m_Generator)];
+    const double        dCenterX = (pixel % clMask.m_Width + clOffsetDistribution(m_Generator)) * dScaleX;
+    const double        dCenterY = (pixel / clMask.m_Width + clOffsetDistribution(m_Generator)) * dScaleY;
+
+    const SizeValueType x = (SizeValueType)std::min<double>(
+      (double)(clSlide.m_Width - m_PatchSize), std::max(0.0, std::floor(dCenterX - 0.5 * m_PatchSize)));
+    const SizeValueType y = (SizeValueType)std::min<double>(
+      (double)(clSlide.m_Height - m_PatchSize), std::max(0.0, std::floor(dCenterY - 0.5 * m_PatchSize)));
+
+    const double dTissueFraction =
+      clMask.ComputeTissueFraction(clSlide.m_Width, clSlide.m_Height, x, y, m_PatchSize, m_PatchSize);
+
+    if (dTissueFraction > clPatch.m_TissueFraction)
+    {
+      clPatch.m_X = x;
+      clPatch.m_Y = y;
+      clPatch.m_TissueFraction = dTissueFraction;
+    }
+
+    if (dTissueFraction >= m_MinimumTissueFraction)
+      break;
+  }
+
+  return clPatch;
+}
+
+int64_t
+OpenSlidePatchLoader::GetProcessId()
+{
+#if defined(_WIN32)
+  return (int64_t)_getpid();
+#else
+  return (int64_t)getpid();
+#endif // _WIN32
+}
+
+} // end namespace itk
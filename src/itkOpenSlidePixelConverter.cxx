@@ -0,0 +1,788 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "itkOpenSlidePixelConverter.h"
+#include "itkOpenSlideThreader.h"
+#include "itkRGBAPixel.h"
+
+namespace itk
+{
+
+namespace
+{
+
+// 2^x for floats in [-126, 126] without calls or branches so that compilers can vectorize it (relative error below
+// 1e-6). Clamp x in a separate loop, GCC does not if-convert clamps followed by arithmetic.
+inline float
+FastExp2(float fValue)
+{
+  // 2^x = 2^n * 2^f with the integer n and 0 <= f < 1
+  const int32_t i32Truncated = (int32_t)fValue;
+  const int32_t i32Floor = i32Truncated - (fValue < (float)i32Truncated ? 1 : 0);
+  const float   fF = fValue - (float)i32Floor;
+
+  // Taylor series of 2^f = exp(f ln(2))
+  const float fPower =
+    1.0f +
+    fF * (0.693147181f +
+          fF * (0.240226507f +
+                fF * (0.0555041087f +
+                      fF * (0.00961812911f + fF * (0.00133335581f + fF * (0.000154035304f + fF * 1.52527338e-05f))))));
+
+  const int32_t i32Bits = (i32Floor + 127) << 23;
+  float         fScale = 0.0f;
+  std::memcpy(&fScale, &i32Bits, sizeof(fScale));
+
+  return fPower * fScale;
+}
+
+// Eigenvalues and eigenvectors (columns of a_dVectors) of a symmetric 3 x 3 matrix with Jacobi rotations
+void
+ComputeSymmetricEigensystem(const double a_dMatrix[9], double a_dValues[3], double a_dVectors[9])
+{
+  double a_dA[9];
+  std::copy(a_dMatrix, a_dMatrix + 9, a_dA);
+
+  for (unsigned int k = 0; k < 9; ++k)
+    a_dVectors[k] = (k % 4 == 0) ? 1.0 : 0.0;
+
+  static const unsigned int a_uiPairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+  for (unsigned int uiSweep = 0; uiSweep < 50; ++uiSweep)
+  {
+    if (a_dA[1] * a_dA[1] + a_dA[2] * a_dA[2] + a_dA[5] * a_dA[5] < 1e-30)
+      break;
+
+    for (unsigned int r = 0; r < 3; ++r)
+    {
+      const unsigned int p = a_uiPairs[r][0], q = a_uiPairs[r][1];
+      const double       dApq = a_dA[3 * p + q];
+
+      if (dApq == 0.0)
+        continue;
+
+      // Rotate so that A[p][q] becomes 0
+      const double dTheta = (a_dA[3 * q + q] - a_dA[3 * p + p]) / (2.0 * dApq);
+      const double dT = (dTheta >= 0.0 ? 1.0 : -1.0) / (std::fabs(dTheta) + std::sqrt(dTheta * dTheta + 1.0));
+      const double dC = 1.0 / std::sqrt(dT * dT + 1.0);
+      const double dS = dT * dC;
+
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        const double dAkp = a_dA[3 * k + p], dAkq = a_dA[3 * k + q];
+        a_dA[3 * k + p] = dC * dAkp - dS * dAkq;
+        a_dA[3 * k + q] = dS * dAkp + dC * dAkq;
+      }
+
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        const double dApk = a_dA[3 * p + k], dAqk = a_dA[3 * q + k];
+        a_dA[3 * p + k] = dC * dApk - dS * dAqk;
+        a_dA[3 * q + k] = dS * dApk + dC * dAqk;
+      }
+
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        const double dVkp = a_dVectors[3 * k + p], dVkq = a_dVectors[3 * k + q];
+        a_dVectors[3 * k + p] = dC * dVkp - dS * dVkq;
+        a_dVectors[3 * k + q] = dS * dVkp + dC * dVkq;
+      }
+    }
+  }
+
+  for (unsigned int k = 0; k < 3; ++k)
+    a_dValues[k] = a_dA[4 * k];
+}
+
+} // end anonymous namespace
+
+OpenSlidePixelConverter::OpenSlidePixelConverter()
+{
+  m_OutputLayout = OutputLayoutEnum::RGBA;
+  m_OutputComponentType = OutputComponentEnum::UnsignedChar;
+  m_ColorTransform = ColorTransformEnum::None;
+
+  {
+    const double a_dMean[4] = { 0.0, 0.0, 0.0, 0.0 };
+    const double a_dStdDev[4] = { 1.0, 1.0, 1.0, 1.0 };
+    this->SetNormalization(1.0, a_dMean, a_dStdDev);
+  }
+
+  {
+    // Ruifrok and Johnston's hematoxylin, eosin and DAB
+    const double a_dStains[9] = { 0.650, 0.704, 0.286, 0.072, 0.990, 0.105, 0.268, 0.570, 0.776 };
+    this->SetStainMatrix(a_dStains);
+  }
+
+  {
+    // Typical H&E statistics (natural logarithm l-alpha-beta)
+    const double a_dMean[3] = { 8.63234435, -0.11501964, 0.03868433 };
+    const double a_dStdDev[3] = { 0.57506023, 0.10403329, 0.01364062 };
+    std::copy(a_dMean, a_dMean + 3, m_ReinhardSourceMean);
+    std::copy(a_dStdDev, a_dStdDev + 3, m_ReinhardSourceStdDev);
+    this->SetReinhardTarget(a_dMean, a_dStdDev);
+  }
+
+  m_OpticalDensityTable.resize(256);
+  for (unsigned int v = 0; v < 256; ++v)
+    m_OpticalDensityTable[v] = (float)-std::log10(std::max(v, 1u) / 255.0);
+
+  // The LMS cone responses of 8-bit RGB are at most 255 (and clamped to at least 1 like RGBToLab())
+  m_LogTable.resize(255 * 16 + 1);
+  for (size_t i = 0; i < m_LogTable.size(); ++i)
+    m_LogTable[i] = (float)std::log2(std::max(i / 16.0, 1.0));
+}
+
+void
+OpenSlidePixelConverter::SetOutputLayout(OutputLayoutEnum eLayout)
+{
+  m_OutputLayout = eLayout;
+}
+
+OpenSlidePixelConverter::OutputLayoutEnum
+OpenSlidePixelConverter::GetOutputLayout() const
+{
+  return m_OutputLayout;
+}
+
+void
+OpenSlidePixelConverter::SetOutputComponentType(OutputComponentEnum eComponentType)
+{
+  m_OutputComponentType = eComponentType;
+}
+
+OpenSlidePixelConverter::OutputComponentEnum
+OpenSlidePixelConverter::GetOutputComponentType() const
+{
+  return m_OutputComponentType;
+}
+
+bool
+OpenSlidePixelConverter::SetNormalization(double dScale, const double a_dMean[4], const double a_dStdDev[4])
+{
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    if (a_dStdDev[c] == 0.0)
+      return false;
+  }
+
+  m_NormalizationScale = dScale;
+  std::copy(a_dMean, a_dMean + 4, m_NormalizationMean);
+  std::copy(a_dStdDev, a_dStdDev + 4, m_NormalizationStdDev);
+
+  // There are only 256 input values per channel, so the normalization is a table lookup
+  m_FloatTable.resize(4 * 256);
+  m_HalfTable.resize(4 * 256);
+
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    for (unsigned int v = 0; v < 256; ++v)
+    {
+      const float fValue = (float)((v * m_NormalizationScale - m_NormalizationMean[c]) / m_NormalizationStdDev[c]);
+      m_FloatTable[256 * c + v] = fValue;
+      m_HalfTable[256 * c + v] = FloatToHalf(fValue);
+    }
+  }
+
+  return true;
+}
+
+void
+OpenSlidePixelConverter::GetNormalization(double & dScale, double a_dMean[4], double a_dStdDev[4]) const
+{
+  dScale = m_NormalizationScale;
+  std::copy(m_NormalizationMean, m_NormalizationMean + 4, a_dMean);
+  std::copy(m_NormalizationStdDev, m_NormalizationStdDev + 4, a_dStdDev);
+}
+
+void
+OpenSlidePixelConverter::SetColorTransform(ColorTransformEnum eColorTransform)
+{
+  m_ColorTransform = eColorTransform;
+}
+
+OpenSlidePixelConverter::ColorTransformEnum
+OpenSlidePixelConverter::GetColorTransform() const
+{
+  return m_ColorTransform;
+}
+
+bool
+OpenSlidePixelConverter::SetStainMatrix(const double a_dStains[9])
+{
+  double a_dMatrix[9];
+  std::copy(a_dStains, a_dStains + 9, a_dMatrix);
+
+  if (a_dMatrix[6] == 0.0 && a_dMatrix[7] == 0.0 && a_dMatrix[8] == 0.0)
+  {
+    a_dMatrix[6] = a_dMatrix[1] * a_dMatrix[5] - a_dMatrix[2] * a_dMatrix[4];
+    a_dMatrix[7] = a_dMatrix[2] * a_dMatrix[3] - a_dMatrix[0] * a_dMatrix[5];
+    a_dMatrix[8] = a_dMatrix[0] * a_dMatrix[4] - a_dMatrix[1] * a_dMatrix[3];
+  }
+
+  for (unsigned int r = 0; r < 3; ++r)
+  {
+    double * const p_dRow = a_dMatrix + 3 * r;
+    const double   dNorm = std::sqrt(p_dRow[0] * p_dRow[0] + p_dRow[1] * p_dRow[1] + p_dRow[2] * p_dRow[2]);
+
+    if (dNorm > 0.0)
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+        p_dRow[k] /= dNorm;
+    }
+  }
+
+  // The optical density of a pixel is sum_s c_s * stain_s, i.e. OD = S^T c. So c = (S^T)^-1 OD.
+  double a_dTransposed[9];
+  for (unsigned int r = 0; r < 3; ++r)
+  {
+    for (unsigned int k = 0; k < 3; ++k)
+      a_dTransposed[3 * r + k] = a_dMatrix[3 * k + r];
+  }
+
+  const double * const m = a_dTransposed;
+  const double         dDeterminant =
+    m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+
+  if (std::fabs(dDeterminant) < 1e-9)
+    return false;
+
+  std::copy(a_dMatrix, a_dMatrix + 9, m_StainMatrix);
+
+  m_InverseStainMatrix[0] = (m[4] * m[8] - m[5] * m[7]) / dDeterminant;
+  m_InverseStainMatrix[1] = (m[2] * m[7] - m[1] * m[8]) / dDeterminant;
+  m_InverseStainMatrix[2] = (m[1] * m[5] - m[2] * m[4]) / dDeterminant;
+  m_InverseStainMatrix[3] = (m[5] * m[6] - m[3] * m[8]) / dDeterminant;
+  m_InverseStainMatrix[4] = (m[0] * m[8] - m[2] * m[6]) / dDeterminant;
+  m_InverseStainMatrix[5] = (m[2] * m[3] - m[0] * m[5]) / dDeterminant;
+  m_InverseStainMatrix[6] = (m[3] * m[7] - m[4] * m[6]) / dDeterminant;
+  m_InverseStainMatrix[7] = (m[1] * m[6] - m[0] * m[7]) / dDeterminant;
+  m_InverseStainMatrix[8] = (m[0] * m[4] - m[1] * m[3]) / dDeterminant;
+
+  return true;
+}
+
+void
+OpenSlidePixelConverter::GetStainMatrix(double a_dStains[9]) const
+{
+  std::copy(m_StainMatrix, m_StainMatrix + 9, a_dStains);
+}
+
+void
+OpenSlidePixelConverter::SetReinhardTarget(const double a_dMean[3], const double a_dStdDev[3])
+{
+  std::copy(a_dMean, a_dMean + 3, m_ReinhardTargetMean);
+  std::copy(a_dStdDev, a_dStdDev + 3, m_ReinhardTargetStdDev);
+  this->UpdateReinhard();
+}
+
+void
+OpenSlidePixelConverter::GetReinhardTarget(double a_dMean[3], double a_dStdDev[3]) const
+{
+  std::copy(m_ReinhardTargetMean, m_ReinhardTargetMean + 3, a_dMean);
+  std::copy(m_ReinhardTargetStdDev, m_ReinhardTargetStdDev + 3, a_dStdDev);
+}
+
+void
+OpenSlidePixelConverter::SetReinhardSource(const double a_dMean[3], const double a_dStdDev[3])
+{
+  std::copy(a_dMean, a_dMean + 3, m_ReinhardSourceMean);
+  std::copy(a_dStdDev, a_dStdDev + 3, m_ReinhardSourceStdDev);
+  this->UpdateReinhard();
+}
+
+void
+OpenSlidePixelConverter::GetReinhardSource(double a_dMean[3], double a_dStdDev[3]) const
+{
+  std::copy(m_ReinhardSourceMean, m_ReinhardSourceMean + 3, a_dMean);
+  std::copy(m_ReinhardSourceStdDev, m_ReinhardSourceStdDev + 3, a_dStdDev);
+}
+
+void
+OpenSlidePixelConverter::UpdateReinhard()
+{
+  // l-alpha-beta is the orthonormal transform T of the logarithms of LMS (see RGBToLab()). So the transfer
+  // lab' = lab * gain + bias is log(LMS)' = T^T diag(gain) T log(LMS) + T^T bias. ApplyReinhard() uses base 2
+  // logarithms, which only scales the bias.
+  const double dA = 1.0 / std::sqrt(3.0), dB = 1.0 / std::sqrt(6.0), dC = 1.0 / std::sqrt(2.0);
+  const double a_dT[9] = { dA, dA, dA, dB, dB, -2.0 * dB, dC, -dC, 0.0 };
+
+  double a_dGain[3], a_dBias[3];
+
+  for (unsigned int c = 0; c < 3; ++c)
+  {
+    a_dGain[c] = m_ReinhardSourceStdDev[c] > 0.0 ? m_ReinhardTargetStdDev[c] / m_ReinhardSourceStdDev[c] : 1.0;
+    a_dBias[c] = m_ReinhardTargetMean[c] - m_ReinhardSourceMean[c] * a_dGain[c];
+  }
+
+  for (unsigned int r = 0; r < 3; ++r)
+  {
+    double dBias = 0.0;
+
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      double dValue = 0.0;
+
+      for (unsigned int c = 0; c < 3; ++c)
+        dValue += a_dT[3 * c + r] * a_dGain[c] * a_dT[3 * c + k];
+
+      m_ReinhardMatrix[3 * r + k] = (float)dValue;
+      dBias += a_dT[3 * k + r] * a_dBias[k];
+    }
+
+    m_ReinhardBias[r] = (float)(dBias / std::log(2.0));
+  }
+}
+
+bool
+OpenSlidePixelConverter::NeedsDecodeBuffer() const
+{
+  return m_OutputLayout != OutputLayoutEnum::RGBA || m_OutputComponentType != OutputComponentEnum::UnsignedChar;
+}
+
+const char *
+OpenSlidePixelConverter::CheckOutput() const
+{
+  if ((m_ColorTransform == ColorTransformEnum::StainDeconvolution || m_ColorTransform == ColorTransformEnum::Macenko) &&
+      m_OutputComponentType == OutputComponentEnum::UnsignedChar)
+  {
+    return "Stain deconvolution requires Float or Half output components.";
+  }
+
+  return NULL;
+}
+
+size_t
+OpenSlidePixelConverter::GetOutputPixelSize() const
+{
+  size_t componentSize = 1;
+
+  switch (m_OutputComponentType)
+  {
+    case OutputComponentEnum::Float:
+      componentSize = sizeof(float);
+      break;
+    case OutputComponentEnum::Half:
+      componentSize = sizeof(uint16_t);
+      break;
+    default:
+      break;
+  }
+
+  return componentSize * GetNumberOfComponents(m_OutputLayout);
+}
+
+unsigned int
+OpenSlidePixelConverter::GetNumberOfComponents(OutputLayoutEnum eLayout)
+{
+  switch (eLayout)
+  {
+    case OutputLayoutEnum::RGB:
+    case OutputLayoutEnum::PlanarRGB:
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+bool
+OpenSlidePixelConverter::Convert(uint32_t * p_ui32Source, void * p_vDest, int64_t i64Count, bool bSerial) const
+{
+  // Stain concentrations do not fit in the 4 bytes of unsigned char pixels
+  if (this->CheckOutput() != NULL)
+    return false;
+
+  const unsigned int uiComponents = GetNumberOfComponents(m_OutputLayout);
+  const bool         bPlanar =
+    m_OutputLayout == OutputLayoutEnum::PlanarRGB || m_OutputLayout == OutputLayoutEnum::PlanarRGBA;
+
+  if (m_ColorTransform == ColorTransformEnum::Reinhard)
+  {
+    // Chunks of 1M pixels in parallel
+    const int64_t i64ChunkSize = 1 << 20;
+    const int64_t i64NumChunks = (i64Count + i64ChunkSize - 1) / i64ChunkSize;
+
+    OpenSlideThreader::ParallelizeArray(
+      i64NumChunks,
+      [&](int64_t i64Chunk) {
+        const int64_t i64Begin = i64Chunk * i64ChunkSize;
+        this->ApplyReinhard(p_ui32Source + i64Begin, std::min(i64ChunkSize, i64Count - i64Begin));
+      },
+      bSerial);
+  }
+  else if (m_ColorTransform == ColorTransformEnum::StainDeconvolution ||
+           m_ColorTransform == ColorTransformEnum::Macenko)
+  {
+    // Fold the normalization of the channels R, G and B into the inverse stain matrix
+    float a_fMatrix[9], a_fBias[3];
+
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      const double dGain = m_NormalizationScale / m_NormalizationStdDev[c];
+
+      for (unsigned int k = 0; k < 3; ++k)
+        a_fMatrix[3 * c + k] = (float)(m_InverseStainMatrix[3 * c + k] * dGain);
+
+      a_fBias[c] = (float)(-m_NormalizationMean[c] / m_NormalizationStdDev[c]);
+    }
+
+    if (m_OutputComponentType == OutputComponentEnum::Half)
+    {
+      ConvertARGBToStains(p_ui32Source,
+                          (uint16_t *)p_vDest,
+                          i64Count,
+                          uiComponents,
+                          bPlanar,
+                          m_OpticalDensityTable.data(),
+                          a_fMatrix,
+                          a_fBias,
+                          m_HalfTable.data() + 3 * 256,
+                          [](float fValue) { return FloatToHalf(fValue); });
+    }
+    else
+    {
+      ConvertARGBToStains(p_ui32Source,
+                          (float *)p_vDest,
+                          i64Count,
+                          uiComponents,
+                          bPlanar,
+                          m_OpticalDensityTable.data(),
+                          a_fMatrix,
+                          a_fBias,
+                          m_FloatTable.data() + 3 * 256,
+                          [](float fValue) { return fValue; });
+    }
+
+    return true;
+  }
+
+  switch (m_OutputComponentType)
+  {
+    case OutputComponentEnum::Float:
+      ConvertARGBWithTable(p_ui32Source, (float *)p_vDest, i64Count, uiComponents, bPlanar, m_FloatTable.data());
+      return true;
+    case OutputComponentEnum::Half:
+      ConvertARGBWithTable(p_ui32Source, (uint16_t *)p_vDest, i64Count, uiComponents, bPlanar, m_HalfTable.data());
+      return true;
+    default:
+      break;
+  }
+
+  switch (m_OutputLayout)
+  {
+    case OutputLayoutEnum::RGBA:
+      // Re-order the bytes (ARGB -> RGBA)
+      ConvertARGBToRGBA(p_ui32Source, i64Count);
+      break;
+    case OutputLayoutEnum::RGB:
+      ConvertARGBToRGB(p_ui32Source, (unsigned char *)p_vDest, i64Count);
+      break;
+    case OutputLayoutEnum::PlanarRGB:
+      ConvertARGBToPlanar(p_ui32Source, (unsigned char *)p_vDest, i64Count, false);
+      break;
+    case OutputLayoutEnum::PlanarRGBA:
+      ConvertARGBToPlanar(p_ui32Source, (unsigned char *)p_vDest, i64Count, true);
+      break;
+  }
+
+  return true;
+}
+
+void
+OpenSlidePixelConverter::ConvertARGBToRGBA(uint32_t * p_ui32Buffer, int64_t i64Count)
+{
+  for (int64_t i = 0; i < i64Count; ++i)
+  {
+    // XXX: Endianness?
+    RGBAPixel<unsigned char> clPixel;
+    clPixel.SetRed((p_ui32Buffer[i] >> 16) & 0xff);
+    clPixel.SetGreen((p_ui32Buffer[i] >> 8) & 0xff);
+    clPixel.SetBlue(p_ui32Buffer[i] & 0xff);
+    clPixel.SetAlpha((p_ui32Buffer[i] >> 24) & 0xff);
+
+    p_ui32Buffer[i] = *reinterpret_cast<uint32_t *>(clPixel.GetDataPointer());
+  }
+}
+
+void
+OpenSlidePixelConverter::ConvertARGBToRGB(const uint32_t * p_ui32Buffer, unsigned char * p_ucDest, int64_t i64Count)
+{
+  for (int64_t i = 0; i < i64Count; ++i)
+  {
+    const uint32_t ui32Pixel = p_ui32Buffer[i];
+    p_ucDest[3 * i] = (ui32Pixel >> 16) & 0xff;
+    p_ucDest[3 * i + 1] = (ui32Pixel >> 8) & 0xff;
+    p_ucDest[3 * i + 2] = ui32Pixel & 0xff;
+  }
+}
+
+void
+OpenSlidePixelConverter::ConvertARGBToPlanar(const uint32_t * p_ui32Buffer,
+                                             unsigned char *  p_ucDest,
+                                             int64_t          i64Count,
+                                             bool             bAlpha)
+{
+  unsigned char * const p_ucRed = p_ucDest;
+  unsigned char * const p_ucGreen = p_ucDest + i64Count;
+  unsigned char * const p_ucBlue = p_ucDest + 2 * i64Count;
+
+  for (int64_t i = 0; i < i64Count; ++i)
+    p_ucRed[i] = (p_ui32Buffer[i] >> 16) & 0xff;
+
+  for (int64_t i = 0; i < i64Count; ++i)
+    p_ucGreen[i] = (p_ui32Buffer[i] >> 8) & 0xff;
+
+  for (int64_t i = 0; i < i64Count; ++i)
+    p_ucBlue[i] = p_ui32Buffer[i] & 0xff;
+
+  if (bAlpha)
+  {
+    unsigned char * const p_ucAlpha = p_ucDest + 3 * i64Count;
+
+    for (int64_t i = 0; i < i64Count; ++i)
+      p_ucAlpha[i] = (p_ui32Buffer[i] >> 24) & 0xff;
+  }
+}
+
+uint16_t
+OpenSlidePixelConverter::FloatToHalf(float fValue)
+{
+  uint32_t ui32Bits = 0;
+  std::memcpy(&ui32Bits, &fValue, sizeof(ui32Bits));
+
+  const uint16_t ui16Sign = (ui32Bits >> 16) & 0x8000;
+  const int32_t  i32Exponent = (int32_t)((ui32Bits >> 23) & 0xff) - 127 + 15;
+  uint32_t       ui32Mantissa = ui32Bits & 0x7fffff;
+
+  if (((ui32Bits >> 23) & 0xff) == 0xff) // Inf or NaN
+    return ui16Sign | 0x7c00 | (ui32Mantissa != 0 ? 0x200 : 0);
+
+  if (i32Exponent >= 31) // Overflow
+    return ui16Sign | 0x7c00;
+
+  if (i32Exponent <= 0) // Subnormal or zero
+  {
+    if (i32Exponent < -10)
+      return ui16Sign;
+
+    ui32Mantissa |= 0x800000;
+
+    const uint32_t ui32Shift = 14 - i32Exponent;
+    uint32_t       ui32Half = ui32Mantissa >> ui32Shift;
+    const uint32_t ui32Rest = ui32Mantissa & ((1u << ui32Shift) - 1);
+    const uint32_t ui32HalfWay = 1u << (ui32Shift - 1);
+
+    if (ui32Rest > ui32HalfWay || (ui32Rest == ui32HalfWay && (ui32Half & 1)))
+      ++ui32Half;
+
+    return ui16Sign | (uint16_t)ui32Half;
+  }
+
+  uint32_t       ui32Half = ((uint32_t)i32Exponent << 10) | (ui32Mantissa >> 13);
+  const uint32_t ui32Rest = ui32Mantissa & 0x1fff;
+
+  // A carry into the exponent is still correctly rounded (up to infinity)
+  if (ui32Rest > 0x1000 || (ui32Rest == 0x1000 && (ui32Half & 1)))
+    ++ui32Half;
+
+  return ui16Sign | (uint16_t)ui32Half;
+}
+
+void
+OpenSlidePixelConverter::RGBToLab(double dR, double dG, double dB, double a_dLab[3])
+{
+  const double dLogL = std::log(std::max(0.3811 * dR + 0.5783 * dG + 0.0402 * dB, 1.0));
+  const double dLogM = std::log(std::max(0.1967 * dR + 0.7244 * dG + 0.0782 * dB, 1.0));
+  const double dLogS = std::log(std::max(0.0241 * dR + 0.1288 * dG + 0.8444 * dB, 1.0));
+
+  a_dLab[0] = (dLogL + dLogM + dLogS) / std::sqrt(3.0);
+  a_dLab[1] = (dLogL + dLogM - 2.0 * dLogS) / std::sqrt(6.0);
+  a_dLab[2] = (dLogL - dLogM) / std::sqrt(2.0);
+}
+
+void
+OpenSlidePixelConverter::ApplyReinhard(uint32_t * p_ui32Buffer, int64_t i64Count) const
+{
+  const float * const p_fLog2 = m_LogTable.data();
+  const float * const m = m_ReinhardMatrix;
+  const float * const b = m_ReinhardBias;
+
+  // Blocks of pixels are transformed in 2 passes over arrays of the transferred logarithms so that both vectorize
+  const int64_t i64BlockSize = 256;
+  float         a_fLog2L[i64BlockSize], a_fLog2M[i64BlockSize], a_fLog2S[i64BlockSize];
+
+  for (int64_t i64Begin = 0; i64Begin < i64Count; i64Begin += i64BlockSize)
+  {
+    uint32_t * const p_ui32Block = p_ui32Buffer + i64Begin;
+    const int64_t    i64Size = std::min(i64BlockSize, i64Count - i64Begin);
+
+    for (int64_t i = 0; i < i64Size; ++i)
+    {
+      const uint32_t ui32Pixel = p_ui32Block[i];
+      const float    fR = (float)((ui32Pixel >> 16) & 0xff);
+      const float    fG = (float)((ui32Pixel >> 8) & 0xff);
+      const float    fB = (float)(ui32Pixel & 0xff);
+
+      const float fLog2L = p_fLog2[(int32_t)((0.3811f * fR + 0.5783f * fG + 0.0402f * fB) * 16.0f + 0.5f)];
+      const float fLog2M = p_fLog2[(int32_t)((0.1967f * fR + 0.7244f * fG + 0.0782f * fB) * 16.0f + 0.5f)];
+      const float fLog2S = p_fLog2[(int32_t)((0.0241f * fR + 0.1288f * fG + 0.8444f * fB) * 16.0f + 0.5f)];
+
+      a_fLog2L[i] = std::min(126.0f, std::max(-126.0f, m[0] * fLog2L + m[1] * fLog2M + m[2] * fLog2S + b[0]));
+      a_fLog2M[i] = std::min(126.0f, std::max(-126.0f, m[3] * fLog2L + m[4] * fLog2M + m[5] * fLog2S + b[1]));
+      a_fLog2S[i] = std::min(126.0f, std::max(-126.0f, m[6] * fLog2L + m[7] * fLog2M + m[8] * fLog2S + b[2]));
+    }
+
+    for (int64_t i = 0; i < i64Size; ++i)
+    {
+      const float fL = FastExp2(a_fLog2L[i]);
+      const float fM = FastExp2(a_fLog2M[i]);
+      const float fS = FastExp2(a_fLog2S[i]);
+
+      // Rounded (the 0.5 is added before clamping for the same reason as in FastExp2())
+      const float fR = std::min(255.0f, std::max(0.0f, 4.4679f * fL - 3.5873f * fM + 0.1193f * fS + 0.5f));
+      const float fG = std::min(255.0f, std::max(0.0f, -1.2186f * fL + 2.3809f * fM - 0.1624f * fS + 0.5f));
+      const float fB = std::min(255.0f, std::max(0.0f, 0.0497f * fL - 0.2439f * fM + 1.2045f * fS + 0.5f));
+
+      const uint32_t ui32Pixel = p_ui32Block[i];
+      const uint32_t ui32Transferred = (ui32Pixel & 0xff000000) | ((uint32_t)(int32_t)fR << 16) |
+                                       ((uint32_t)(int32_t)fG << 8) | (uint32_t)(int32_t)fB;
+
+      p_ui32Block[i] = (ui32Pixel >> 24) != 0 ? ui32Transferred : ui32Pixel;
+    }
+  }
+}
+
+bool
+OpenSlidePixelConverter::EstimateMacenkoStains(const std::vector<uint32_t> & vPixels, double a_dStains[9])
+{
+  // Macenko et al. use an optical density threshold of 0.15 and the 1st and 99th percentiles
+  const double dMinimumDensity = 0.15;
+  const double dPercentile = 0.01;
+
+  double a_dTable[256];
+  for (unsigned int v = 0; v < 256; ++v)
+    a_dTable[v] = -std::log10(std::max(v, 1u) / 255.0);
+
+  // Optical densities of the stained pixels (all channels above the threshold)
+  std::vector<double> vDensities;
+  vDensities.reserve(3 * vPixels.size());
+
+  double a_dSum[3] = { 0.0, 0.0, 0.0 };
+
+  for (uint32_t ui32Pixel : vPixels)
+  {
+    const double a_dOD[3] = { a_dTable[(ui32Pixel >> 16) & 0xff],
+                              a_dTable[(ui32Pixel >> 8) & 0xff],
+                              a_dTable[ui32Pixel & 0xff] };
+
+    if (a_dOD[0] < dMinimumDensity || a_dOD[1] < dMinimumDensity || a_dOD[2] < dMinimumDensity)
+      continue;
+
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      vDensities.push_back(a_dOD[c]);
+      a_dSum[c] += a_dOD[c];
+    }
+  }
+
+  const size_t numDensities = vDensities.size() / 3;
+
+  if (numDensities < 100)
+    return false;
+
+  // Covariance of the optical densities
+  double a_dCovariance[9] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+  for (size_t i = 0; i < numDensities; ++i)
+  {
+    const double * const p_dOD = &vDensities[3 * i];
+
+    for (unsigned int r = 0; r < 3; ++r)
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+        a_dCovariance[3 * r + k] += (p_dOD[r] - a_dSum[r] / numDensities) * (p_dOD[k] - a_dSum[k] / numDensities);
+    }
+  }
+
+  double a_dValues[3], a_dVectors[9];
+  ComputeSymmetricEigensystem(a_dCovariance, a_dValues, a_dVectors);
+
+  // The plane of the 2 principal directions (the eigenvectors of the largest eigenvalues), oriented like the
+  // (positive) optical densities
+  unsigned int a_uiOrder[3] = { 0, 1, 2 };
+  std::sort(a_uiOrder, a_uiOrder + 3, [&](unsigned int a, unsigned int b) { return a_dValues[a] > a_dValues[b]; });
+
+  double a_dPlane[2][3];
+
+  for (unsigned int d = 0; d < 2; ++d)
+  {
+    const unsigned int k = a_uiOrder[d];
+    const double       dSign = a_dVectors[k] + a_dVectors[3 + k] + a_dVectors[6 + k] < 0.0 ? -1.0 : 1.0;
+
+    for (unsigned int c = 0; c < 3; ++c)
+      a_dPlane[d][c] = dSign * a_dVectors[3 * c + k];
+  }
+
+  // Angles of the projections onto the plane
+  std::vector<double> vAngles(numDensities);
+
+  for (size_t i = 0; i < numDensities; ++i)
+  {
+    const double * const p_dOD = &vDensities[3 * i];
+    const double         dX = p_dOD[0] * a_dPlane[1][0] + p_dOD[1] * a_dPlane[1][1] + p_dOD[2] * a_dPlane[1][2];
+    const double         dY = p_dOD[0] * a_dPlane[0][0] + p_dOD[1] * a_dPlane[0][1] + p_dOD[2] * a_dPlane[0][2];
+
+    vAngles[i] = std::atan2(dY, dX);
+  }
+
+  const size_t minIndex = (size_t)(dPercentile * (numDensities - 1));
+  const size_t maxIndex = (size_t)((1.0 - dPercentile) * (numDensities - 1));
+
+  std::nth_element(vAngles.begin(), vAngles.begin() + minIndex, vAngles.end());
+  const double dMinAngle = vAngles[minIndex];
+
+  std::nth_element(vAngles.begin(), vAngles.begin() + maxIndex, vAngles.end());
+  const double dMaxAngle = vAngles[maxIndex];
+
+  double a_dMin[3], a_dMax[3];
+
+  for (unsigned int c = 0; c < 3; ++c)
+  {
+    a_dMin[c] = a_dPlane[1][c] * std::cos(dMinAngle) + a_dPlane[0][c] * std::sin(dMinAngle);
+    a_dMax[c] = a_dPlane[1][c] * std::cos(dMaxAngle) + a_dPlane[0][c] * std::sin(dMaxAngle);
+  }
+
+  // Hematoxylin absorbs more red than eosin
+  const double * const p_dHematoxylin = a_dMin[0] > a_dMax[0] ? a_dMin : a_dMax;
+  const double * const p_dEosin = a_dMin[0] > a_dMax[0] ? a_dMax : a_dMin;
+
+  for (unsigned int c = 0; c < 3; ++c)
+  {
+    a_dStains[c] = p_dHematoxylin[c];
+    a_dStains[3 + c] = p_dEosin[c];
+    a_dStains[6 + c] = 0.0;
+  }
+
+  return true;
+}
+
+} // end namespace itk
@@ -0,0 +1,245 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlidePixelConverter_h
+#define itkOpenSlidePixelConverter_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+
+namespace itk
+{
+
+// Conversion of OpenSlide's ARGB pixels to the output pixels of the ImageIO
+// The layout, component type, normalization and color transform are applied in one pass. The per-channel
+// normalization is folded into 4 x 256 lookup tables since there are only 256 input values per channel.
+class OpenSlidePixelConverter
+{
+public:
+  using OutputLayoutEnum = OpenSlideImageIO::OutputLayoutEnum;
+  using OutputComponentEnum = OpenSlideImageIO::OutputComponentEnum;
+  using ColorTransformEnum = OpenSlideImageIO::ColorTransformEnum;
+
+  OpenSlidePixelConverter();
+
+  void
+  SetOutputLayout(OutputLayoutEnum eLayout);
+
+  OutputLayoutEnum
+  GetOutputLayout() const;
+
+  void
+  SetOutputComponentType(OutputComponentEnum eComponentType);
+
+  OutputComponentEnum
+  GetOutputComponentType() const;
+
+  // Sets the per-channel normalization of Float and Half components. Returns false if a standard deviation is 0.
+  bool
+  SetNormalization(double dScale, const double a_dMean[4], const double a_dStdDev[4]);
+
+  void
+  GetNormalization(double & dScale, double a_dMean[4], double a_dStdDev[4]) const;
+
+  void
+  SetColorTransform(ColorTransformEnum eColorTransform);
+
+  ColorTransformEnum
+  GetColorTransform() const;
+
+  // Sets the optical density vectors of the 3 stains, one stain per row. Returns false if the stains are not linearly
+  // independent (the stain matrix is left alone then).
+  bool
+  SetStainMatrix(const double a_dStains[9]);
+
+  void
+  GetStainMatrix(double a_dStains[9]) const;
+
+  void
+  SetReinhardTarget(const double a_dMean[3], const double a_dStdDev[3]);
+
+  void
+  GetReinhardTarget(double a_dMean[3], double a_dStdDev[3]) const;
+
+  // Sets the statistics of the slide that Reinhard color normalization maps to the target
+  void
+  SetReinhardSource(const double a_dMean[3], const double a_dStdDev[3]);
+
+  void
+  GetReinhardSource(double a_dMean[3], double a_dStdDev[3]) const;
+
+  // Returns whether the output pixels are converted from a separate buffer of ARGB pixels. Only unsigned char RGBA
+  // has the size of OpenSlide's ARGB pixels and is converted in place.
+  bool
+  NeedsDecodeBuffer() const;
+
+  // Returns NULL if the color transform can be written in the output component type, otherwise the reason why not
+  // (stain concentrations need Float or Half components)
+  const char *
+  CheckOutput() const;
+
+  // Returns the size in bytes of one output pixel
+  size_t
+  GetOutputPixelSize() const;
+
+  // Returns the number of channels (3 or 4) of the given output layout
+  static unsigned int
+  GetNumberOfComponents(OutputLayoutEnum eLayout);
+
+  // Converts ARGB pixels to the output pixels (in place for unsigned char RGBA). p_ui32Source is modified by the
+  // Reinhard transform. Large buffers are converted in parallel unless bSerial is set (see OpenSlideThreader).
+  // Returns false without writing anything if CheckOutput() fails.
+  bool
+  Convert(uint32_t * p_ui32Source, void * p_vDest, int64_t i64Count, bool bSerial) const;
+
+  // Re-order the bytes of OpenSlide's pixels in place (ARGB -> RGBA)
+  static void
+  ConvertARGBToRGBA(uint32_t * p_ui32Buffer, int64_t i64Count);
+
+  // Converts ARGB pixels to interleaved RGB bytes (p_ucDest must not overlap p_ui32Buffer)
+  static void
+  ConvertARGBToRGB(const uint32_t * p_ui32Buffer, unsigned char * p_ucDest, int64_t i64Count);
+
+  // Converts ARGB pixels to R, G, B (and A) planes of i64Count bytes each (p_ucDest must not overlap p_ui32Buffer).
+  // Each plane is written by a separate simple loop so that compilers can vectorize the deinterleave.
+  static void
+  ConvertARGBToPlanar(const uint32_t * p_ui32Buffer, unsigned char * p_ucDest, int64_t i64Count, bool bAlpha);
+
+  // Converts ARGB pixels to uiComponents channels (R, G, B and optionally A) looked up in a 4 x 256 table.
+  // This fuses the cast and any per-channel affine transform into the layout conversion.
+  template <typename TComponent>
+  static void
+  ConvertARGBWithTable(const uint32_t *   p_ui32Buffer,
+                       TComponent *       p_Dest,
+                       int64_t            i64Count,
+                       unsigned int       uiComponents,
+                       bool               bPlanar,
+                       const TComponent * p_Table)
+  {
+    static const unsigned int a_uiShifts[4] = { 16, 8, 0, 24 };
+
+    for (unsigned int c = 0; c < uiComponents; ++c)
+    {
+      const unsigned int       uiShift = a_uiShifts[c];
+      const TComponent * const p_ChannelTable = p_Table + 256 * c;
+
+      if (bPlanar)
+      {
+        TComponent * const p_Plane = p_Dest + c * i64Count;
+
+        for (int64_t i = 0; i < i64Count; ++i)
+          p_Plane[i] = p_ChannelTable[(p_ui32Buffer[i] >> uiShift) & 0xff];
+      }
+      else
+      {
+        for (int64_t i = 0; i < i64Count; ++i)
+          p_Dest[i * uiComponents + c] = p_ChannelTable[(p_ui32Buffer[i] >> uiShift) & 0xff];
+      }
+    }
+  }
+
+  // Converts a float to IEEE 754 half-precision bits (round to nearest even)
+  static uint16_t
+  FloatToHalf(float fValue);
+
+  // Converts RGB (0-255) to Reinhard's l-alpha-beta space (natural logarithm of the LMS cone responses)
+  static void
+  RGBToLab(double dR, double dG, double dB, double a_dLab[3]);
+
+  // Applies Reinhard color transfer from the source to the target statistics to ARGB pixels in place.
+  // Fully transparent pixels (outside of the scanned area) are left alone.
+  void
+  ApplyReinhard(uint32_t * p_ui32Buffer, int64_t i64Count) const;
+
+  // Estimates the stain vectors of hematoxylin and eosin from ARGB pixels of tissue with Macenko's method: the
+  // optical densities of the stained pixels are projected onto the plane of their 2 principal directions and the
+  // directions at the 1st and 99th percentiles of their angles in that plane are the stains. The stains are written
+  // to the first 2 rows of a_dStains (hematoxylin first) and the third row is set to 0 (see SetStainMatrix()).
+  // Returns false if there are too few stained pixels.
+  static bool
+  EstimateMacenkoStains(const std::vector<uint32_t> & vPixels, double a_dStains[9]);
+
+  // Converts ARGB pixels to stain concentrations with color deconvolution: the optical densities (looked up in
+  // p_fODTable) are multiplied with the 3 x 3 matrix a_fMatrix (the inverse stain matrix with the normalization gain
+  // folded in) and offset by a_fBias. Alpha, if requested, is looked up in p_AlphaTable.
+  template <typename TComponent, typename TConvert>
+  static void
+  ConvertARGBToStains(const uint32_t *   p_ui32Buffer,
+                      TComponent *       p_Dest,
+                      int64_t            i64Count,
+                      unsigned int       uiComponents,
+                      bool               bPlanar,
+                      const float *      p_fODTable,
+                      const float        a_fMatrix[9],
+                      const float        a_fBias[3],
+                      const TComponent * p_AlphaTable,
+                      TConvert           clConvert)
+  {
+    const int64_t i64ChannelStride = bPlanar ? i64Count : 1;
+    const int64_t i64PixelStride = bPlanar ? 1 : uiComponents;
+
+    for (int64_t i = 0; i < i64Count; ++i)
+    {
+      const uint32_t ui32Pixel = p_ui32Buffer[i];
+      const float    fODR = p_fODTable[(ui32Pixel >> 16) & 0xff];
+      const float    fODG = p_fODTable[(ui32Pixel >> 8) & 0xff];
+      const float    fODB = p_fODTable[ui32Pixel & 0xff];
+
+      TComponent * const p_Pixel = p_Dest + i * i64PixelStride;
+
+      for (int c = 0; c < 3; ++c)
+      {
+        p_Pixel[c * i64ChannelStride] =
+          clConvert(a_fMatrix[3 * c] * fODR + a_fMatrix[3 * c + 1] * fODG + a_fMatrix[3 * c + 2] * fODB + a_fBias[c]);
+      }
+
+      if (uiComponents > 3)
+        p_Pixel[3 * i64ChannelStride] = p_AlphaTable[(ui32Pixel >> 24) & 0xff];
+    }
+  }
+
+private:
+  OutputLayoutEnum      m_OutputLayout;
+  OutputComponentEnum   m_OutputComponentType;
+  double                m_NormalizationScale;
+  double                m_NormalizationMean[4];
+  double                m_NormalizationStdDev[4];
+  std::vector<float>    m_FloatTable; // 4 x 256 normalized values (R, G, B, A)
+  std::vector<uint16_t> m_HalfTable;  // The same values as half-precision floats
+  ColorTransformEnum    m_ColorTransform;
+  double                m_StainMatrix[9];
+  double                m_InverseStainMatrix[9]; // Optical densities to stain concentrations
+  std::vector<float>    m_OpticalDensityTable;   // 256 optical densities
+  double                m_ReinhardTargetMean[3];
+  double                m_ReinhardTargetStdDev[3];
+  double                m_ReinhardSourceMean[3];
+  double                m_ReinhardSourceStdDev[3];
+  float                 m_ReinhardMatrix[9];  // Logarithms of the LMS cone responses to the transferred logarithms
+  float                 m_ReinhardBias[3];
+  std::vector<float>    m_LogTable; // Logarithms of the LMS cone responses in steps of 1/16
+
+  // Folds the Reinhard transfer in l-alpha-beta space into m_ReinhardMatrix and m_ReinhardBias
+  void
+  UpdateReinhard();
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlidePixelConverter_h
@@ -0,0 +1,488 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+#include "itkOpenSlideSeriesImageIO.h"
+#include "itkMetaDataObject.h"
+#include "itkOpenSlideThreader.h"
+#include "itkRGBAPixel.h"
+
+namespace itk
+{
+
+OpenSlideSeriesImageIO::OpenSlideSeriesImageIO()
+{
+  using PixelType = RGBAPixel<unsigned char>;
+  PixelType clPixel;
+
+  m_Level = 0;
+  m_TargetSpacing = 0.0;
+  m_SliceThickness = 1.0;
+  m_SpacingTolerance = 0.01;
+  m_MaximumNumberOfOpenSlides = 16;
+  m_NumberOfOpenSlides = 0;
+  m_UseCounter = 0;
+
+  this->SetNumberOfDimensions(3);
+  this->SetPixelTypeInfo(&clPixel);
+
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    m_Spacing[i] = 1.0;
+    m_Origin[i] = 0.0;
+    m_Dimensions[i] = 0;
+  }
+}
+
+OpenSlideSeriesImageIO::~OpenSlideSeriesImageIO() {}
+
+void
+OpenSlideSeriesImageIO::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Number of Slides: " << m_FileNames.size() << '\n';
+  os << indent << "Level: " << m_Level << '\n';
+  os << indent << "Target Spacing: " << m_TargetSpacing << '\n';
+  os << indent << "Slice Thickness: " << m_SliceThickness << '\n';
+  os << indent << "Spacing Tolerance: " << m_SpacingTolerance << '\n';
+  os << indent << "Maximum Number Of Open Slides: " << m_MaximumNumberOfOpenSlides << '\n';
+}
+
+bool
+OpenSlideSeriesImageIO::CanReadFile(const char * filename)
+{
+  OpenSlideImageIO::Pointer p_clIO = OpenSlideImageIO::New();
+  return p_clIO->CanReadFile(filename);
+}
+
+bool
+OpenSlideSeriesImageIO::CanStreamRead()
+{
+  return true;
+}
+
+void
+OpenSlideSeriesImageIO::ReadImageInformation()
+{
+  using PixelType = RGBAPixel<unsigned char>;
+  PixelType clPixel;
+
+  this->SetNumberOfDimensions(3);
+  this->SetPixelTypeInfo(&clPixel);
+
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    m_Spacing[i] = 1.0;
+    m_Origin[i] = 0.0;
+    m_Dimensions[i] = 0;
+  }
+
+  m_SliceIOs.clear();
+  m_SliceLevels.clear();
+
+  if (m_FileNames.empty())
+  {
+    itkExceptionMacro("Error OpenSlideSeriesImageIO has no slides." << std::endl
+                                                                    << "Reason: Call SetFileNames() first.");
+  }
+
+  if (m_Level < 0)
+  {
+    itkExceptionMacro("Error OpenSlideSeriesImageIO could not select level " << m_Level << '.' << std::endl
+                                                                             << "Reason: Levels start at 0.");
+  }
+
+  const size_t numberOfSlides = m_FileNames.size();
+
+  m_SliceIOs.assign(numberOfSlides, nullptr);
+  m_SliceLevels.assign(numberOfSlides, 0);
+  m_SliceLastUse.assign(numberOfSlides, 0);
+  m_NumberOfOpenSlides = 0;
+
+  std::vector<std::string> vErrors(numberOfSlides);
+
+  // Headers are read concurrently. Slides beyond the budget of open slides are released right away, so at most the
+  // budget plus the number of workers are open at a time.
+  OpenSlideThreader::ParallelizeArray(
+    numberOfSlides,
+    [&](int64_t i64Slice) {
+      try
+      {
+        m_SliceIOs[i64Slice] = this->ReadSliceInformation(i64Slice);
+
+        if (i64Slice >= (int64_t)m_MaximumNumberOfOpenSlides)
+          m_SliceIOs[i64Slice]->ReleaseSlide();
+      }
+      catch (ExceptionObject & e)
+      {
+        vErrors[i64Slice] = e.GetDescription();
+      }
+    },
+    false);
+
+  // Report the first failing slide (as a sequential loop would)
+  for (size_t i = 0; i < numberOfSlides; ++i)
+  {
+    if (!vErrors[i].empty())
+    {
+      m_SliceIOs.clear();
+      m_SliceLevels.clear();
+      m_SliceLastUse.clear();
+
+      itkExceptionMacro("Error OpenSlideSeriesImageIO could not read: " << m_FileNames[i] << std::endl
+                                                                        << "Reason: " << vErrors[i]);
+    }
+  }
+
+  for (size_t i = 0; i < numberOfSlides; ++i)
+  {
+    OpenSlideImageIO * const p_clSliceIO = m_SliceIOs[i].GetPointer();
+
+    m_Dimensions[0] = std::max(m_Dimensions[0], p_clSliceIO->GetDimensions(0));
+    m_Dimensions[1] = std::max(m_Dimensions[1], p_clSliceIO->GetDimensions(1));
+
+    if (i == 0)
+    {
+      m_Spacing[0] = p_clSliceIO->GetSpacing(0);
+      m_Spacing[1] = p_clSliceIO->GetSpacing(1);
+      this->SetMetaDataDictionary(p_clSliceIO->GetMetaDataDictionary());
+    }
+
+    // Slices are not resampled, so they must have the in-plane spacing of the volume
+    for (unsigned int d = 0; d < 2; ++d)
+    {
+      if (std::fabs(p_clSliceIO->GetSpacing(d) - m_Spacing[d]) > m_SpacingTolerance * m_Spacing[d])
+      {
+        itkExceptionMacro("Error OpenSlideSeriesImageIO could not stack: "
+                          << m_FileNames[i] << std::endl
+                          << "Reason: Its spacing " << p_clSliceIO->GetSpacing(0) << " x "
+                          << p_clSliceIO->GetSpacing(1) << " differs from the spacing " << m_Spacing[0] << " x "
+                          << m_Spacing[1] << " of the first slide by more than the tolerance.");
+      }
+    }
+
+    m_SliceLevels[i] = p_clSliceIO->GetLevel();
+
+    if (i < m_MaximumNumberOfOpenSlides)
+    {
+      m_SliceLastUse[i] = ++m_UseCounter;
+      ++m_NumberOfOpenSlides;
+    }
+  }
+
+  m_Dimensions[2] = m_FileNames.size();
+  m_Spacing[2] = m_SliceThickness;
+}
+
+void
+OpenSlideSeriesImageIO::Read(void * buffer)
+{
+  using PixelType = RGBAPixel<unsigned char>;
+
+  PixelType * const p_clBuffer = (PixelType *)buffer;
+
+  if (m_SliceIOs.size() != m_FileNames.size() || m_SliceIOs.empty())
+  {
+    itkExceptionMacro("Error OpenSlideSeriesImageIO could not read region." << std::endl
+                                                                           << "Reason: Call ReadImageInformation() first.");
+  }
+
+  const ImageIORegion            clRegionToRead = this->GetIORegion();
+  const ImageIORegion::SizeType  clSize = clRegionToRead.GetSize();
+  const ImageIORegion::IndexType clStart = clRegionToRead.GetIndex();
+
+  // The reader's image may be 2D, in which case only the first slice is requested
+  const int64_t i64X = clStart[0];
+  const int64_t i64Y = clStart[1];
+  const int64_t i64Width = clSize[0];
+  const int64_t i64Height = clSize[1];
+  const int64_t i64Z = clStart.size() > 2 ? clStart[2] : 0;
+  const int64_t i64Depth = clSize.size() > 2 ? clSize[2] : 1;
+
+  if (i64Z < 0 || i64Z + i64Depth > (int64_t)m_SliceIOs.size())
+  {
+    itkExceptionMacro("Error OpenSlideSeriesImageIO could not read region." << std::endl
+                                                                           << "Reason: Slices are out of range.");
+  }
+
+  const size_t slicePixels = (size_t)i64Width * (size_t)i64Height;
+
+  std::mutex  clErrorMutex;
+  std::string strError;
+
+  // Slices are read in batches that fit into the budget of open slides, one work item per slice, each writing to its
+  // own part of the buffer
+  const int64_t i64BatchSize = std::min<int64_t>(i64Depth, m_MaximumNumberOfOpenSlides);
+
+  for (int64_t i64First = 0; i64First < i64Depth && strError.empty(); i64First += i64BatchSize)
+  {
+    const int64_t i64Count = std::min(i64BatchSize, i64Depth - i64First);
+
+    this->AcquireSlices(i64Z + i64First, i64Count);
+
+    OpenSlideThreader::ParallelizeArray(
+      i64Count,
+      [&](int64_t i64BatchSlice) {
+        const int64_t                  i64Slice = i64First + i64BatchSlice;
+        const OpenSlideImageIO * const p_clSliceIO = m_SliceIOs[i64Z + i64Slice].GetPointer();
+        const int                      iLevel = m_SliceLevels[i64Z + i64Slice];
+        PixelType * const              p_clDest = p_clBuffer + i64Slice * slicePixels;
+
+        // Intersect the requested rectangle with this slice (slices may be smaller than the volume)
+        const int64_t i64SliceWidth = p_clSliceIO->GetDimensions(0);
+        const int64_t i64SliceHeight = p_clSliceIO->GetDimensions(1);
+        const int64_t i64ReadWidth = std::max<int64_t>(0, std::min(i64X + i64Width, i64SliceWidth) - i64X);
+        const int64_t i64ReadHeight = std::max<int64_t>(0, std::min(i64Y + i64Height, i64SliceHeight) - i64Y);
+
+        if (i64ReadWidth != i64Width || i64ReadHeight != i64Height)
+        {
+          PixelType clZero;
+          clZero.Fill(0);
+          std::fill(p_clDest, p_clDest + slicePixels, clZero);
+        }
+
+        if (i64ReadWidth <= 0 || i64ReadHeight <= 0)
+          return;
+
+        ImageIORegion clSliceRegion(2);
+        clSliceRegion.SetIndex(0, i64X);
+        clSliceRegion.SetIndex(1, i64Y);
+        clSliceRegion.SetSize(0, i64ReadWidth);
+        clSliceRegion.SetSize(1, i64ReadHeight);
+
+        try
+        {
+          if (i64ReadWidth == i64Width)
+          {
+            // Rows are contiguous in the volume buffer
+            p_clSliceIO->ReadRegion(iLevel, clSliceRegion, p_clDest);
+          }
+          else
+          {
+            std::vector<PixelType> vSliceBuffer(i64ReadWidth * i64ReadHeight);
+            p_clSliceIO->ReadRegion(iLevel, clSliceRegion, &vSliceBuffer[0]);
+
+            for (int64_t y = 0; y < i64ReadHeight; ++y)
+            {
+              std::memcpy(
+                p_clDest + y * i64Width, &vSliceBuffer[y * i64ReadWidth], i64ReadWidth * sizeof(PixelType));
+            }
+          }
+        }
+        catch (ExceptionObject & e)
+        {
+          std::lock_guard<std::mutex> clLock(clErrorMutex);
+          strError = e.GetDescription();
+        }
+      },
+      false);
+  }
+
+  if (!strError.empty())
+  {
+    itkExceptionMacro("Error OpenSlideSeriesImageIO could not read region." << std::endl
+                                                                           << "Reason: " << strError);
+  }
+}
+
+OpenSlideImageIO::Pointer
+OpenSlideSeriesImageIO::ReadSliceInformation(size_t slice) const
+{
+  OpenSlideImageIO::Pointer p_clSliceIO = OpenSlideImageIO::New();
+
+  p_clSliceIO->SetFileName(m_FileNames[slice]);
+
+  // With a target spacing, the level is selected from the header read at level 0 (which every slide has)
+  p_clSliceIO->SetLevel(m_TargetSpacing > 0.0 ? 0 : m_Level);
+
+  try
+  {
+    p_clSliceIO->ReadImageInformation();
+
+    if (m_TargetSpacing > 0.0)
+    {
+      std::string strMPP;
+      double      dMPP = 0.0;
+
+      if (!ExposeMetaData<std::string>(p_clSliceIO->GetMetaDataDictionary(), "openslide.mpp-x", strMPP) ||
+          !(std::stringstream(strMPP) >> dMPP) || dMPP <= 0.0 ||
+          !p_clSliceIO->SetLevelForDownsampleFactor(m_TargetSpacing / dMPP))
+      {
+        p_clSliceIO->SetLevel(m_Level);
+      }
+
+      if (p_clSliceIO->GetLevel() != 0)
+        p_clSliceIO->ReadImageInformation();
+    }
+  }
+  catch (ExceptionObject &)
+  {
+    // A missing level fails like an unreadable slide, the level count of the header tells them apart
+    const int iLevelCount = p_clSliceIO->GetLevelCount();
+    if (iLevelCount <= 0 || p_clSliceIO->GetLevel() < iLevelCount)
+      throw;
+
+    itkExceptionMacro("Error OpenSlideSeriesImageIO could not select level "
+                      << p_clSliceIO->GetLevel() << " of: " << m_FileNames[slice] << std::endl
+                      << "Reason: The slide has " << iLevelCount << " levels.");
+  }
+
+  return p_clSliceIO;
+}
+
+void
+OpenSlideSeriesImageIO::AcquireSlices(size_t firstSlice, size_t numberOfSlices)
+{
+  for (size_t i = firstSlice; i < firstSlice + numberOfSlices; ++i)
+  {
+    if (m_SliceLastUse[i] == 0)
+      ++m_NumberOfOpenSlides;
+
+    m_SliceLastUse[i] = ++m_UseCounter;
+  }
+
+  // The acquired slices were used last, so the least recently used slides are never among them
+  while (m_NumberOfOpenSlides > m_MaximumNumberOfOpenSlides)
+  {
+    size_t oldest = m_SliceLastUse.size();
+
+    for (size_t i = 0; i < m_SliceLastUse.size(); ++i)
+    {
+      if (m_SliceLastUse[i] != 0 && (oldest == m_SliceLastUse.size() || m_SliceLastUse[i] < m_SliceLastUse[oldest]))
+        oldest = i;
+    }
+
+    m_SliceIOs[oldest]->ReleaseSlide();
+    m_SliceLastUse[oldest] = 0;
+    --m_NumberOfOpenSlides;
+  }
+}
+
+bool
+OpenSlideSeriesImageIO::CanWriteFile(const char * /*name*/)
+{
+  return false;
+}
+
+void
+OpenSlideSeriesImageIO::WriteImageInformation()
+{}
+
+void
+OpenSlideSeriesImageIO::Write(const void * /*buffer*/)
+{}
+
+/** Sets the ordered list of slides. */
+void
+OpenSlideSeriesImageIO::SetFileNames(const FileNamesContainer & vFileNames)
+{
+  m_FileNames = vFileNames;
+  this->SetFileName(m_FileNames.empty() ? std::string() : m_FileNames[0]);
+  this->Modified();
+}
+
+/** Returns the ordered list of slides. */
+const OpenSlideSeriesImageIO::FileNamesContainer &
+OpenSlideSeriesImageIO::GetFileNames() const
+{
+  return m_FileNames;
+}
+
+/** Sets the level to read from every slide. */
+void
+OpenSlideSeriesImageIO::SetLevel(int iLevel)
+{
+  m_Level = iLevel;
+}
+
+/** Returns the level to read from every slide. */
+int
+OpenSlideSeriesImageIO::GetLevel() const
+{
+  return m_Level;
+}
+
+/** Sets the in-plane spacing (in microns) the levels are selected for. */
+void
+OpenSlideSeriesImageIO::SetTargetSpacing(double dSpacing)
+{
+  m_TargetSpacing = dSpacing;
+}
+
+/** Returns the target in-plane spacing (0 if disabled). */
+double
+OpenSlideSeriesImageIO::GetTargetSpacing() const
+{
+  return m_TargetSpacing;
+}
+
+/** Sets the spacing along z. */
+void
+OpenSlideSeriesImageIO::SetSliceThickness(double dThickness)
+{
+  m_SliceThickness = dThickness;
+}
+
+/** Returns the spacing along z. */
+double
+OpenSlideSeriesImageIO::GetSliceThickness() const
+{
+  return m_SliceThickness;
+}
+
+/** Sets the largest relative difference of the in-plane spacing of a slide from that of the first slide. */
+void
+OpenSlideSeriesImageIO::SetSpacingTolerance(double dTolerance)
+{
+  m_SpacingTolerance = dTolerance;
+}
+
+/** Returns the largest relative difference of the in-plane spacings. */
+double
+OpenSlideSeriesImageIO::GetSpacingTolerance() const
+{
+  return m_SpacingTolerance;
+}
+
+/** Sets how many slides are kept open. */
+void
+OpenSlideSeriesImageIO::SetMaximumNumberOfOpenSlides(unsigned int uiMaximumNumberOfOpenSlides)
+{
+  m_MaximumNumberOfOpenSlides = std::max(1u, uiMaximumNumberOfOpenSlides);
+}
+
+/** Returns how many slides are kept open. */
+unsigned int
+OpenSlideSeriesImageIO::GetMaximumNumberOfOpenSlides() const
+{
+  return m_MaximumNumberOfOpenSlides;
+}
+
+/** Returns the level read from the given slide. */
+int
+OpenSlideSeriesImageIO::GetSliceLevel(unsigned int uiSlice) const
+{
+  return uiSlice < m_SliceLevels.size() ? m_SliceLevels[uiSlice] : -1;
+}
+
+} // end namespace itk
@@ -0,0 +1,119 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+
+#include "itkOpenSlideStatistics.h"
+
+namespace itk
+{
+
+OpenSlideStatistics::OpenSlideStatistics()
+{
+  Clear();
+}
+
+void
+OpenSlideStatistics::Clear()
+{
+  std::fill(&m_Histograms[0][0], &m_Histograms[0][0] + 4 * 256, 0);
+  m_NumberOfPixels = 0;
+  m_NumberOfTissuePixels = 0;
+}
+
+void
+OpenSlideStatistics::Accumulate(const uint32_t * p_ui32Pixels, int64_t i64Count, unsigned int uiTissueThreshold)
+{
+  for (int64_t i = 0; i < i64Count; ++i)
+  {
+    const uint32_t ui32Pixel = p_ui32Pixels[i];
+    const uint32_t ui32Alpha = ui32Pixel >> 24;
+    const uint32_t ui32Red = (ui32Pixel >> 16) & 0xff;
+    const uint32_t ui32Green = (ui32Pixel >> 8) & 0xff;
+    const uint32_t ui32Blue = ui32Pixel & 0xff;
+
+    ++m_Histograms[0][ui32Red];
+    ++m_Histograms[1][ui32Green];
+    ++m_Histograms[2][ui32Blue];
+    ++m_Histograms[3][ui32Alpha];
+
+    m_NumberOfTissuePixels += IsTissue(ui32Pixel, uiTissueThreshold);
+  }
+
+  m_NumberOfPixels += i64Count;
+}
+
+void
+OpenSlideStatistics::Merge(const OpenSlideStatistics & clPartial)
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  for (int c = 0; c < 4; ++c)
+  {
+    for (int i = 0; i < 256; ++i)
+      m_Histograms[c][i] += clPartial.m_Histograms[c][i];
+  }
+
+  m_NumberOfPixels += clPartial.m_NumberOfPixels;
+  m_NumberOfTissuePixels += clPartial.m_NumberOfTissuePixels;
+}
+
+void
+OpenSlideStatistics::Reset()
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  Clear();
+}
+
+uint64_t
+OpenSlideStatistics::GetNumberOfPixels() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_NumberOfPixels;
+}
+
+std::vector<uint64_t>
+OpenSlideStatistics::GetHistogram(unsigned int uiChannel) const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return std::vector<uint64_t>(m_Histograms[uiChannel], m_Histograms[uiChannel] + 256);
+}
+
+double
+OpenSlideStatistics::GetMean(unsigned int uiChannel) const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+
+  if (m_NumberOfPixels == 0)
+    return 0.0;
+
+  double dSum = 0.0;
+  for (int i = 0; i < 256; ++i)
+    dSum += (double)i * m_Histograms[uiChannel][i];
+
+  return dSum / m_NumberOfPixels;
+}
+
+double
+OpenSlideStatistics::GetTissueFraction() const
+{
+  std::lock_guard<std::mutex> clLock(m_Mutex);
+  return m_NumberOfPixels > 0 ? (double)m_NumberOfTissuePixels / m_NumberOfPixels : 0.0;
+}
+
+} // end namespace itk
@@ -0,0 +1,87 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideStatistics_h
+#define itkOpenSlideStatistics_h
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace itk
+{
+
+// Statistics of ARGB pixels
+// Partial statistics are accumulated without locking (e.g. per thread or per read) and merged into the total.
+class OpenSlideStatistics
+{
+public:
+  OpenSlideStatistics();
+
+  void
+  Clear();
+
+  // Returns whether an ARGB pixel is tissue: not transparent and at least uiTissueThreshold apart in its largest and
+  // smallest color channel (background is close to gray, stained tissue is not)
+  static bool
+  IsTissue(uint32_t ui32Pixel, unsigned int uiTissueThreshold)
+  {
+    const uint32_t ui32Red = (ui32Pixel >> 16) & 0xff;
+    const uint32_t ui32Green = (ui32Pixel >> 8) & 0xff;
+    const uint32_t ui32Blue = ui32Pixel & 0xff;
+
+    const uint32_t ui32Saturation =
+      std::max(ui32Red, std::max(ui32Green, ui32Blue)) - std::min(ui32Red, std::min(ui32Green, ui32Blue));
+
+    return (ui32Pixel >> 24) != 0 && ui32Saturation >= uiTissueThreshold;
+  }
+
+  // Adds ARGB pixels (not thread safe)
+  void
+  Accumulate(const uint32_t * p_ui32Pixels, int64_t i64Count, unsigned int uiTissueThreshold);
+
+  // Adds partial statistics (thread safe)
+  void
+  Merge(const OpenSlideStatistics & clPartial);
+
+  void
+  Reset();
+
+  uint64_t
+  GetNumberOfPixels() const;
+
+  std::vector<uint64_t>
+  GetHistogram(unsigned int uiChannel) const;
+
+  double
+  GetMean(unsigned int uiChannel) const;
+
+  double
+  GetTissueFraction() const;
+
+private:
+  uint64_t           m_Histograms[4][256]; // R, G, B and A
+  uint64_t           m_NumberOfPixels;
+  uint64_t           m_NumberOfTissuePixels;
+  mutable std::mutex m_Mutex;
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideStatistics_h
@@ -0,0 +1,43 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkOpenSlideThreader.h"
+#include "itkMultiThreaderBase.h"
+
+namespace itk
+{
+
+void
+OpenSlideThreader::ParallelizeArray(int64_t i64Count, const std::function<void(int64_t)> & clBody, bool bSerial)
+{
+  if (bSerial || i64Count <= 1)
+  {
+    for (int64_t i = 0; i < i64Count; ++i)
+      clBody(i);
+
+    return;
+  }
+
+  // One per calling thread, since some threaders keep the method they run on the object
+  static thread_local const MultiThreaderBase::Pointer p_clThreader = MultiThreaderBase::New();
+
+  p_clThreader->ParallelizeArray(
+    0, (SizeValueType)i64Count, [&clBody](SizeValueType uiIndex) { clBody((int64_t)uiIndex); }, nullptr);
+}
+
+} // end namespace itk
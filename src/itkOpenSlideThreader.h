@@ -0,0 +1,43 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideThreader_h
+#define itkOpenSlideThreader_h
+
+#include <cstdint>
+#include <functional>
+
+namespace itk
+{
+
+// The threaders that the parallel loops of the module share
+// Creating a threader per loop allocates an object and sets it up each time, which adds up when many small regions
+// are read. Each calling thread creates one threader on first use (with the global default number of work units)
+// and reuses it. Work that already runs on a worker (e.g. one region of ReadRegions()) passes bSerial so that nested
+// loops run in the calling thread instead of waiting for workers that are all busy.
+class OpenSlideThreader
+{
+public:
+  // Calls clBody for each index of 0 to i64Count - 1, in parallel unless bSerial is set
+  static void
+  ParallelizeArray(int64_t i64Count, const std::function<void(int64_t)> & clBody, bool bSerial);
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideThreader_h
@@ -0,0 +1,500 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cerrno>
+#include <csetjmp>
+#include <cstdio>
+#include <algorithm>
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <fcntl.h>
+#  include <io.h>
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include "itkOpenSlideTiffTiles.h"
+
+// libtiff
+#include "itk_tiff.h"
+
+// libjpeg
+#include "itk_jpeg.h"
+
+namespace itk
+{
+
+namespace
+{
+
+struct JPEGErrorManager
+{
+  jpeg_error_mgr m_Manager;
+  jmp_buf        m_Jump;
+};
+
+void
+JPEGErrorExit(j_common_ptr p_clInfo)
+{
+  longjmp(((JPEGErrorManager *)p_clInfo->err)->m_Jump, 1);
+}
+
+void
+JPEGOutputMessage(j_common_ptr)
+{}
+
+// Reads ui64Bytes at ui64Offset of the file without moving a shared file position, so that threads can read at once
+bool
+ReadAt(int iFile, uint64_t ui64Offset, unsigned char * p_ucDest, uint64_t ui64Bytes)
+{
+  while (ui64Bytes > 0)
+  {
+    const uint64_t ui64Chunk = std::min<uint64_t>(ui64Bytes, 1 << 30);
+
+#if defined(_WIN32)
+    // Reads with an offset do not depend on (or race for) the file pointer
+    OVERLAPPED clOverlapped = {};
+    clOverlapped.Offset = (DWORD)ui64Offset;
+    clOverlapped.OffsetHigh = (DWORD)(ui64Offset >> 32);
+
+    DWORD dwRead = 0;
+    if (!ReadFile((HANDLE)_get_osfhandle(iFile), p_ucDest, (DWORD)ui64Chunk, &dwRead, &clOverlapped) || dwRead == 0)
+      return false;
+
+    const uint64_t ui64Read = dwRead;
+#else
+    const ssize_t iRead = pread(iFile, p_ucDest, (size_t)ui64Chunk, (off_t)ui64Offset);
+    if (iRead < 0 && errno == EINTR)
+      continue;
+
+    if (iRead <= 0)
+      return false;
+
+    const uint64_t ui64Read = (uint64_t)iRead;
+#endif // _WIN32
+
+    ui64Offset += ui64Read;
+    p_ucDest += ui64Read;
+    ui64Bytes -= ui64Read;
+  }
+
+  return true;
+}
+
+// Decodes a JPEG tile (an abbreviated stream when the level has shared tables) into RGB bytes of the tile size
+// divided by ui32Scale
+bool
+DecodeTile(const OpenSlideTiffTiles::Level &  clLevel,
+           uint32_t                           ui32Scale,
+           const std::vector<unsigned char> & vCompressed,
+           std::vector<unsigned char> &       vTile)
+{
+  const uint32_t ui32Width = clLevel.m_TileWidth / ui32Scale;
+  const uint32_t ui32Height = clLevel.m_TileHeight / ui32Scale;
+
+  vTile.resize(3 * (size_t)ui32Width * ui32Height);
+
+  jpeg_decompress_struct clInfo;
+  JPEGErrorManager       clError;
+
+  clInfo.err = jpeg_std_error(&clError.m_Manager);
+  clError.m_Manager.error_exit = &JPEGErrorExit;
+  clError.m_Manager.output_message = &JPEGOutputMessage;
+
+  // NOTE: Nothing between here and jpeg_destroy_decompress() may need a destructor
+  if (setjmp(clError.m_Jump))
+  {
+    jpeg_destroy_decompress(&clInfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&clInfo);
+
+  if (!clLevel.m_JPEGTables.empty())
+  {
+    jpeg_mem_src(&clInfo, (unsigned char *)clLevel.m_JPEGTables.data(), (unsigned long)clLevel.m_JPEGTables.size());
+    jpeg_read_header(&clInfo, FALSE);
+  }
+
+  jpeg_mem_src(&clInfo, (unsigned char *)vCompressed.data(), (unsigned long)vCompressed.size());
+
+  if (jpeg_read_header(&clInfo, TRUE) != JPEG_HEADER_OK || clInfo.num_components != 3)
+  {
+    jpeg_destroy_decompress(&clInfo);
+    return false;
+  }
+
+  // The TIFF tags decide the color space (Aperio writes RGB JPEG without a marker saying so)
+  clInfo.jpeg_color_space = clLevel.m_Photometric == PHOTOMETRIC_YCBCR ? JCS_YCbCr : JCS_RGB;
+  clInfo.out_color_space = JCS_RGB;
+  clInfo.scale_num = 1;
+  clInfo.scale_denom = ui32Scale;
+
+  jpeg_start_decompress(&clInfo);
+
+  if (clInfo.output_width != ui32Width || clInfo.output_height != ui32Height ||
+      clInfo.output_components != 3)
+  {
+    jpeg_destroy_decompress(&clInfo);
+    return false;
+  }
+
+  while (clInfo.output_scanline < clInfo.output_height)
+  {
+    JSAMPROW p_ucRow = vTile.data() + 3 * (size_t)clInfo.output_scanline * clInfo.output_width;
+    jpeg_read_scanlines(&clInfo, &p_ucRow, 1);
+  }
+
+  jpeg_finish_decompress(&clInfo);
+  jpeg_destroy_decompress(&clInfo);
+
+  return true;
+}
+
+// Writes i64Count RGB pixels (transparent if p_ucSource is NULL) to pixel i64Offset of p_vDest
+void
+WriteRow(const unsigned char *   p_ucSource,
+         int64_t                 i64Count,
+         OpenSlideTileFormatEnum eFormat,
+         void *                  p_vDest,
+         int64_t                 i64Offset)
+{
+  switch (eFormat)
+  {
+    case OpenSlideTileFormatEnum::ARGB:
+    {
+      uint32_t * const p_ui32Dest = (uint32_t *)p_vDest + i64Offset;
+
+      if (p_ucSource == NULL)
+      {
+        std::fill(p_ui32Dest, p_ui32Dest + i64Count, 0);
+        break;
+      }
+
+      for (int64_t i = 0; i < i64Count; ++i)
+      {
+        p_ui32Dest[i] = 0xff000000u | ((uint32_t)p_ucSource[3 * i] << 16) | ((uint32_t)p_ucSource[3 * i + 1] << 8) |
+                        p_ucSource[3 * i + 2];
+      }
+      break;
+    }
+    case OpenSlideTileFormatEnum::RGBA:
+    {
+      unsigned char * const p_ucDest = (unsigned char *)p_vDest + 4 * i64Offset;
+
+      if (p_ucSource == NULL)
+      {
+        std::fill(p_ucDest, p_ucDest + 4 * i64Count, 0);
+        break;
+      }
+
+      for (int64_t i = 0; i < i64Count; ++i)
+      {
+        p_ucDest[4 * i] = p_ucSource[3 * i];
+        p_ucDest[4 * i + 1] = p_ucSource[3 * i + 1];
+        p_ucDest[4 * i + 2] = p_ucSource[3 * i + 2];
+        p_ucDest[4 * i + 3] = 255;
+      }
+      break;
+    }
+    case OpenSlideTileFormatEnum::RGB:
+    {
+      unsigned char * const p_ucDest = (unsigned char *)p_vDest + 3 * i64Offset;
+
+      if (p_ucSource == NULL)
+        std::fill(p_ucDest, p_ucDest + 3 * i64Count, 0);
+      else
+        std::copy(p_ucSource, p_ucSource + 3 * i64Count, p_ucDest);
+
+      break;
+    }
+  }
+}
+
+// Reads the tile layout of the current directory
+bool
+ReadLevel(TIFF * p_clTiff, uint32_t ui32Directory, OpenSlideTiffTiles::Level & clLevel)
+{
+  clLevel = OpenSlideTiffTiles::Level();
+  clLevel.m_Directory = ui32Directory;
+
+  uint64_t * p_ui64Offsets = NULL;
+  uint64_t * p_ui64ByteCounts = NULL;
+
+  if (!TIFFGetField(p_clTiff, TIFFTAG_IMAGEWIDTH, &clLevel.m_Width) ||
+      !TIFFGetField(p_clTiff, TIFFTAG_IMAGELENGTH, &clLevel.m_Height) ||
+      !TIFFGetField(p_clTiff, TIFFTAG_TILEWIDTH, &clLevel.m_TileWidth) ||
+      !TIFFGetField(p_clTiff, TIFFTAG_TILELENGTH, &clLevel.m_TileHeight) ||
+      !TIFFGetFieldDefaulted(p_clTiff, TIFFTAG_COMPRESSION, &clLevel.m_Compression) ||
+      !TIFFGetField(p_clTiff, TIFFTAG_PHOTOMETRIC, &clLevel.m_Photometric) ||
+      !TIFFGetFieldDefaulted(p_clTiff, TIFFTAG_SAMPLESPERPIXEL, &clLevel.m_SamplesPerPixel) ||
+      !TIFFGetFieldDefaulted(p_clTiff, TIFFTAG_BITSPERSAMPLE, &clLevel.m_BitsPerSample) ||
+      !TIFFGetField(p_clTiff, TIFFTAG_TILEOFFSETS, &p_ui64Offsets) ||
+      !TIFFGetField(p_clTiff, TIFFTAG_TILEBYTECOUNTS, &p_ui64ByteCounts) || clLevel.m_TileWidth == 0 ||
+      clLevel.m_TileHeight == 0 || p_ui64Offsets == NULL || p_ui64ByteCounts == NULL)
+    return false;
+
+  const uint64_t ui64NumTiles = TIFFNumberOfTiles(p_clTiff);
+  const uint64_t ui64Expected = (uint64_t)((clLevel.m_Width + clLevel.m_TileWidth - 1) / clLevel.m_TileWidth) *
+                                ((clLevel.m_Height + clLevel.m_TileHeight - 1) / clLevel.m_TileHeight);
+
+  if (ui64NumTiles != ui64Expected)
+    return false;
+
+  clLevel.m_Offsets.assign(p_ui64Offsets, p_ui64Offsets + ui64NumTiles);
+  clLevel.m_ByteCounts.assign(p_ui64ByteCounts, p_ui64ByteCounts + ui64NumTiles);
+
+  uint32_t ui32TablesSize = 0;
+  void *   p_vTables = NULL;
+
+  if (clLevel.m_Compression == COMPRESSION_JPEG &&
+      TIFFGetField(p_clTiff, TIFFTAG_JPEGTABLES, &ui32TablesSize, &p_vTables) && p_vTables != NULL)
+  {
+    clLevel.m_JPEGTables.assign((const unsigned char *)p_vTables, (const unsigned char *)p_vTables + ui32TablesSize);
+  }
+
+  return true;
+}
+
+} // end anonymous namespace
+
+bool
+OpenSlideTiffTiles::IsSupportedVendor(const std::string & strVendor)
+{
+  return strVendor == "aperio" || strVendor == "generic-tiff";
+}
+
+OpenSlideTiffTiles::OpenSlideTiffTiles()
+  : m_File(-1)
+  , m_DecodedTiles(0)
+{}
+
+OpenSlideTiffTiles::~OpenSlideTiffTiles()
+{
+  Close();
+}
+
+bool
+OpenSlideTiffTiles::Open(const std::string &          strFileName,
+                         const std::vector<int64_t> & vLevelWidths,
+                         const std::vector<int64_t> & vLevelHeights)
+{
+  Close();
+
+  TIFF * const p_clTiff = TIFFOpen(strFileName.c_str(), "r");
+  if (p_clTiff == NULL)
+    return false;
+
+  m_Levels.assign(vLevelWidths.size(), Level());
+  std::vector<bool> vFound(vLevelWidths.size(), false);
+
+  uint32_t ui32Directory = 0;
+  do
+  {
+    uint32_t ui32Width = 0, ui32Height = 0;
+    uint16_t ui16PlanarConfig = PLANARCONFIG_CONTIG;
+
+    if (TIFFIsTiled(p_clTiff) && TIFFGetField(p_clTiff, TIFFTAG_IMAGEWIDTH, &ui32Width) &&
+        TIFFGetField(p_clTiff, TIFFTAG_IMAGELENGTH, &ui32Height) &&
+        TIFFGetFieldDefaulted(p_clTiff, TIFFTAG_PLANARCONFIG, &ui16PlanarConfig) &&
+        ui16PlanarConfig == PLANARCONFIG_CONTIG)
+    {
+      for (size_t i = 0; i < m_Levels.size(); ++i)
+      {
+        if (vFound[i] || vLevelWidths[i] != ui32Width || vLevelHeights[i] != ui32Height)
+          continue;
+
+        vFound[i] = ReadLevel(p_clTiff, ui32Directory, m_Levels[i]);
+        break;
+      }
+    }
+
+    ++ui32Directory;
+  } while (TIFFReadDirectory(p_clTiff));
+
+  TIFFClose(p_clTiff);
+
+  // Levels without a directory are marked by a zero width
+  for (size_t i = 0; i < m_Levels.size(); ++i)
+  {
+    if (!vFound[i])
+      m_Levels[i] = Level();
+  }
+
+#if defined(_WIN32)
+  m_File = _open(strFileName.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  m_File = open(strFileName.c_str(), O_RDONLY);
+#endif // _WIN32
+
+  if (m_File < 0 || std::find(vFound.begin(), vFound.end(), true) == vFound.end())
+  {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void
+OpenSlideTiffTiles::Close()
+{
+  m_Levels.clear();
+
+  if (m_File >= 0)
+  {
+#if defined(_WIN32)
+    _close(m_File);
+#else
+    close(m_File);
+#endif // _WIN32
+    m_File = -1;
+  }
+
+  m_DecodedTiles = 0;
+}
+
+bool
+OpenSlideTiffTiles::CanDecode(int32_t i32Level, uint32_t ui32Scale) const
+{
+  const Level * const p_clLevel = GetLevel(i32Level);
+
+  return p_clLevel != NULL && p_clLevel->m_Compression == COMPRESSION_JPEG && p_clLevel->m_SamplesPerPixel == 3 &&
+         p_clLevel->m_BitsPerSample == 8 &&
+         (p_clLevel->m_Photometric == PHOTOMETRIC_RGB || p_clLevel->m_Photometric == PHOTOMETRIC_YCBCR) &&
+         (ui32Scale == 1 || ui32Scale == 2 || ui32Scale == 4 || ui32Scale == 8) &&
+         p_clLevel->m_TileWidth % ui32Scale == 0 && p_clLevel->m_TileHeight % ui32Scale == 0;
+}
+
+const char *
+OpenSlideTiffTiles::DecodeRegion(int32_t                 i32Level,
+                                 uint32_t                ui32Scale,
+                                 int64_t                 i64X,
+                                 int64_t                 i64Y,
+                                 int64_t                 i64Width,
+                                 int64_t                 i64Height,
+                                 OpenSlideTileFormatEnum eFormat,
+                                 void *                  p_vDest) const
+{
+  if (!CanDecode(i32Level, ui32Scale))
+    return "Level cannot be decoded directly.";
+
+  const Level & clLevel = m_Levels[i32Level];
+  const int64_t i64TileWidth = clLevel.m_TileWidth / ui32Scale;
+  const int64_t i64TileHeight = clLevel.m_TileHeight / ui32Scale;
+
+  if (i64X < 0 || i64Y < 0 || i64X + i64Width > ((int64_t)clLevel.m_Width + ui32Scale - 1) / ui32Scale ||
+      i64Y + i64Height > ((int64_t)clLevel.m_Height + ui32Scale - 1) / ui32Scale)
+    return "Region is outside of level image.";
+
+  std::vector<unsigned char> vCompressed;
+  std::vector<unsigned char> vTile;
+
+  for (int64_t i64TileY = i64Y / i64TileHeight; i64TileY * i64TileHeight < i64Y + i64Height; ++i64TileY)
+  {
+    const int64_t i64Y0 = std::max(i64Y, i64TileY * i64TileHeight);
+    const int64_t i64Y1 = std::min(i64Y + i64Height, (i64TileY + 1) * i64TileHeight);
+
+    for (int64_t i64TileX = i64X / i64TileWidth; i64TileX * i64TileWidth < i64X + i64Width; ++i64TileX)
+    {
+      const int64_t i64X0 = std::max(i64X, i64TileX * i64TileWidth);
+      const int64_t i64X1 = std::min(i64X + i64Width, (i64TileX + 1) * i64TileWidth);
+
+      const char * p_cError = ReadTile(i32Level, i64TileX, i64TileY, vCompressed);
+      if (p_cError != NULL)
+        return p_cError;
+
+      if (!vCompressed.empty())
+      {
+        if (!DecodeTile(clLevel, ui32Scale, vCompressed, vTile))
+          return "Could not decode JPEG tile.";
+
+        ++m_DecodedTiles;
+      }
+
+      for (int64_t y = i64Y0; y < i64Y1; ++y)
+      {
+        const unsigned char * const p_ucSource =
+          vCompressed.empty()
+            ? NULL
+            : vTile.data() + 3 * ((y - i64TileY * i64TileHeight) * i64TileWidth + (i64X0 - i64TileX * i64TileWidth));
+
+        WriteRow(p_ucSource, i64X1 - i64X0, eFormat, p_vDest, (y - i64Y) * i64Width + (i64X0 - i64X));
+      }
+    }
+  }
+
+  return NULL;
+}
+
+uint64_t
+OpenSlideTiffTiles::GetNumberOfDecodedTiles() const
+{
+  return m_DecodedTiles;
+}
+
+const OpenSlideTiffTiles::Level *
+OpenSlideTiffTiles::GetLevel(int32_t i32Level) const
+{
+  if (i32Level < 0 || (size_t)i32Level >= m_Levels.size() || m_Levels[i32Level].m_Width == 0)
+    return NULL;
+
+  return &m_Levels[i32Level];
+}
+
+const char *
+OpenSlideTiffTiles::ReadTile(int32_t                      i32Level,
+                             uint64_t                     ui64TileX,
+                             uint64_t                     ui64TileY,
+                             std::vector<unsigned char> & vBuffer) const
+{
+  vBuffer.clear();
+
+  const Level * const p_clLevel = GetLevel(i32Level);
+  if (p_clLevel == NULL)
+    return "Level has no tiled TIFF directory.";
+
+  const uint64_t ui64TilesAcross = (p_clLevel->m_Width + p_clLevel->m_TileWidth - 1) / p_clLevel->m_TileWidth;
+  const uint64_t ui64TilesDown = (p_clLevel->m_Height + p_clLevel->m_TileHeight - 1) / p_clLevel->m_TileHeight;
+
+  if (ui64TileX >= ui64TilesAcross || ui64TileY >= ui64TilesDown)
+    return "Tile is outside of level image.";
+
+  const uint64_t ui64Tile = ui64TileY * ui64TilesAcross + ui64TileX;
+  const uint64_t ui64Bytes = p_clLevel->m_ByteCounts[ui64Tile];
+
+  if (ui64Bytes == 0)
+    return NULL;
+
+  vBuffer.resize(ui64Bytes);
+
+  if (!ReadAt(m_File, p_clLevel->m_Offsets[ui64Tile], vBuffer.data(), ui64Bytes))
+  {
+    vBuffer.clear();
+    return "Could not read tile from file.";
+  }
+
+  return NULL;
+}
+
+} // end namespace itk
@@ -0,0 +1,120 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideTiffTiles_h
+#define itkOpenSlideTiffTiles_h
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+// Pixel formats tiles can be decoded into directly: OpenSlide's ARGB words, RGBA bytes (alpha 255) and RGB bytes
+enum class OpenSlideTileFormatEnum : uint8_t
+{
+  ARGB,
+  RGBA,
+  RGB
+};
+
+// Direct access to the compressed tiles of TIFF-based slides
+// OpenSlide reads Aperio and generic tiled TIFF slides from a pyramid of tiled TIFF directories. Each level is matched
+// to the first tiled directory with its dimensions. The tile offsets, byte counts and JPEG tables are read once with
+// libtiff and compressed tiles are then read from the file as they are, without libtiff or OpenSlide. Tiles are read
+// with positional reads of one shared file descriptor, so threads read them concurrently.
+class OpenSlideTiffTiles
+{
+public:
+  struct Level
+  {
+    uint32_t                   m_Directory;
+    uint32_t                   m_Width;
+    uint32_t                   m_Height;
+    uint32_t                   m_TileWidth;
+    uint32_t                   m_TileHeight;
+    uint16_t                   m_Compression;
+    uint16_t                   m_Photometric;
+    uint16_t                   m_SamplesPerPixel;
+    uint16_t                   m_BitsPerSample;
+    std::vector<uint64_t>      m_Offsets; // Row major, m_Offsets.size() tiles
+    std::vector<uint64_t>      m_ByteCounts;
+    std::vector<unsigned char> m_JPEGTables; // Empty unless JPEG compressed with shared tables
+  };
+
+  // Returns whether OpenSlide reads slides of this vendor from plain tiled TIFF directories
+  static bool
+  IsSupportedVendor(const std::string & strVendor);
+
+  OpenSlideTiffTiles();
+  ~OpenSlideTiffTiles();
+
+  OpenSlideTiffTiles(const OpenSlideTiffTiles &) = delete;
+  OpenSlideTiffTiles & operator=(const OpenSlideTiffTiles &) = delete;
+
+  // Reads the tile layout of the levels with the given dimensions. Returns false if no level has a tiled directory.
+  bool
+  Open(const std::string &          strFileName,
+       const std::vector<int64_t> & vLevelWidths,
+       const std::vector<int64_t> & vLevelHeights);
+
+  void
+  Close();
+
+  // Returns whether the tiles of the given level can be decoded directly (8 bit RGB or YCbCr JPEG) at 1 / ui32Scale
+  // of their size. libjpeg scales by 1, 2, 4 or 8 in the DCT domain, which must divide the tile size.
+  bool
+  CanDecode(int32_t i32Level, uint32_t ui32Scale = 1) const;
+
+  // Decodes a region of the given level scaled down by ui32Scale (absolute coordinates of the scaled level, whose
+  // pixel (x, y) covers level pixels x * ui32Scale to (x + 1) * ui32Scale - 1, inside of the scaled level image)
+  // from the tiles it overlaps into p_vDest. Tiles the slide does not store are transparent. Returns NULL for success.
+  const char *
+  DecodeRegion(int32_t                 i32Level,
+               uint32_t                ui32Scale,
+               int64_t                 i64X,
+               int64_t                 i64Y,
+               int64_t                 i64Width,
+               int64_t                 i64Height,
+               OpenSlideTileFormatEnum eFormat,
+               void *                  p_vDest) const;
+
+  // Returns the number of tiles decoded by DecodeRegion() since Open()
+  uint64_t
+  GetNumberOfDecodedTiles() const;
+
+  // Returns the tile layout of the given level (NULL if the level has no tiled directory)
+  const Level *
+  GetLevel(int32_t i32Level) const;
+
+  // Reads the compressed bytes of a tile (thread safe). Tiles a slide does not store (zero byte count) give an empty
+  // buffer. Returns NULL for success.
+  const char *
+  ReadTile(int32_t i32Level, uint64_t ui64TileX, uint64_t ui64TileY, std::vector<unsigned char> & vBuffer) const;
+
+private:
+  std::vector<Level>            m_Levels;
+  int                           m_File; // -1 if closed
+  mutable std::atomic<uint64_t> m_DecodedTiles;
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideTiffTiles_h
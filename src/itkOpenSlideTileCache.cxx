@@ -0,0 +1,376 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "itkOpenSlideTileCache.h"
+#include "itkOpenSlideHeaderCache.h"
+#include "itksys/Directory.hxx"
+#include "itksys/SystemTools.hxx"
+
+namespace itk
+{
+
+namespace
+{
+
+// Hits only refresh the modification time of tiles older than this (in seconds)
+const long int g_iTouchInterval = 60;
+
+} // end anonymous namespace
+
+OpenSlideTileCache::OpenSlideTileCache()
+  : m_MaximumBytes(0)
+  , m_CurrentBytes(0)
+  , m_Hits(0)
+  , m_Misses(0)
+  , m_ListTime(0)
+  , m_AccessCount(0)
+{}
+
+bool
+OpenSlideTileCache::Open(const std::string & strDirectory, uint64_t ui64MaximumBytes, const std::string & strFileName)
+{
+  Close();
+
+  std::string strPath, strKey;
+  if (!OpenSlideHeaderCache::GetKey(strFileName, strPath, strKey) ||
+      !itksys::SystemTools::MakeDirectory(strDirectory))
+    return false;
+
+  std::stringstream keyStream;
+  keyStream << std::hex << std::setw(16) << std::setfill('0') << OpenSlideHeaderCache::Hash(strKey);
+
+  m_Directory = strDirectory;
+  m_SlideKey = keyStream.str();
+  m_MaximumBytes = ui64MaximumBytes;
+
+  std::vector<TileFile> vFiles;
+  const uint64_t        ui64Bytes = ListTiles(vFiles);
+
+  std::lock_guard<std::mutex> clLock(m_BytesMutex);
+  m_CurrentBytes = ui64Bytes;
+
+  return true;
+}
+
+void
+OpenSlideTileCache::Close()
+{
+  m_Directory.clear();
+  m_SlideKey.clear();
+  m_Hits = 0;
+  m_Misses = 0;
+
+  {
+    std::lock_guard<std::mutex> clEvictLock(m_EvictMutex);
+    m_EvictionCandidates.clear();
+    m_ListTime = 0;
+  }
+
+  {
+    std::lock_guard<std::mutex> clBytesLock(m_BytesMutex);
+    m_CurrentBytes = 0;
+  }
+
+  std::lock_guard<std::mutex> clLock(m_AccessMutex);
+  m_AccessCount = 0;
+  m_LastAccess.clear();
+}
+
+bool
+OpenSlideTileCache::IsOpened() const
+{
+  return !m_Directory.empty();
+}
+
+bool
+OpenSlideTileCache::Load(int32_t    i32Level,
+                         int64_t    i64TileWidth,
+                         int64_t    i64TileHeight,
+                         int64_t    i64TileX,
+                         int64_t    i64TileY,
+                         uint32_t * p_ui32Dest) const
+{
+  const int64_t     i64Count = i64TileWidth * i64TileHeight;
+  const std::string strTileFileName = GetTileFileName(i32Level, i64TileWidth, i64TileHeight, i64TileX, i64TileY);
+
+  std::ifstream tileStream(strTileFileName.c_str(), std::ios::binary);
+  if (tileStream)
+  {
+    tileStream.seekg(0, std::ios::end);
+    const int64_t i64Bytes = (int64_t)tileStream.tellg();
+    tileStream.seekg(0, std::ios::beg);
+
+    bool bLoaded = false;
+    if (i64Bytes == (int64_t)sizeof(uint32_t))
+    {
+      uint32_t ui32Pixel = 0;
+      bLoaded = (bool)tileStream.read((char *)&ui32Pixel, sizeof(ui32Pixel));
+      std::fill(p_ui32Dest, p_ui32Dest + i64Count, ui32Pixel);
+    }
+    else if (i64Bytes == i64Count * (int64_t)sizeof(uint32_t))
+    {
+      bLoaded = (bool)tileStream.read((char *)p_ui32Dest, i64Bytes);
+    }
+
+    if (bLoaded)
+    {
+      tileStream.close();
+
+      // Least recently used across processes (this process' own accesses order the tiles in between)
+      const long int iNow = (long int)std::time(nullptr);
+      if (iNow - itksys::SystemTools::ModifiedTime(strTileFileName) >= g_iTouchInterval)
+        itksys::SystemTools::Touch(strTileFileName, false);
+
+      RecordAccess(strTileFileName, iNow);
+      ++m_Hits;
+      return true;
+    }
+  }
+
+  ++m_Misses;
+  return false;
+}
+
+void
+OpenSlideTileCache::Store(int32_t          i32Level,
+                          int64_t          i64TileWidth,
+                          int64_t          i64TileHeight,
+                          int64_t          i64TileX,
+                          int64_t          i64TileY,
+                          const uint32_t * p_ui32Tile) const
+{
+  const int64_t i64Count = i64TileWidth * i64TileHeight;
+  const bool    bUniform = std::find_if(p_ui32Tile, p_ui32Tile + i64Count, [p_ui32Tile](uint32_t ui32Pixel) {
+                          return ui32Pixel != p_ui32Tile[0];
+                        }) == p_ui32Tile + i64Count;
+  const int64_t i64Bytes = (bUniform ? 1 : i64Count) * (int64_t)sizeof(uint32_t);
+
+  const std::string strTileFileName = GetTileFileName(i32Level, i64TileWidth, i64TileHeight, i64TileX, i64TileY);
+
+  std::stringstream tmpNameStream;
+  tmpNameStream << strTileFileName << ".tmp" << std::hex << std::random_device()();
+  const std::string strTmpFileName = tmpNameStream.str();
+
+  {
+    std::ofstream tileStream(strTmpFileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!tileStream.write((const char *)p_ui32Tile, i64Bytes))
+    {
+      tileStream.close();
+      itksys::SystemTools::RemoveFile(strTmpFileName);
+      return;
+    }
+  }
+
+  // Another thread or process may have stored the same tile already (replacing it does not change the size)
+  const bool bReplaced = itksys::SystemTools::FileExists(strTileFileName, true);
+
+  if (!itksys::SystemTools::RenameFile(strTmpFileName, strTileFileName))
+  {
+    itksys::SystemTools::RemoveFile(strTmpFileName);
+    return;
+  }
+
+  RecordAccess(strTileFileName, (long int)std::time(nullptr));
+
+  if (!bReplaced && m_MaximumBytes > 0 && AdjustCurrentBytes(i64Bytes) > m_MaximumBytes)
+    Evict();
+}
+
+uint64_t
+OpenSlideTileCache::GetHits() const
+{
+  return m_Hits;
+}
+
+uint64_t
+OpenSlideTileCache::GetMisses() const
+{
+  return m_Misses;
+}
+
+void
+OpenSlideTileCache::RecordAccess(const std::string & strTileFileName, long int iTime) const
+{
+  if (m_MaximumBytes == 0)
+    return; // Nothing is ever evicted
+
+  std::lock_guard<std::mutex> clLock(m_AccessMutex);
+  TileAccess &                clAccess = m_LastAccess[strTileFileName];
+  clAccess.m_Order = ++m_AccessCount;
+  clAccess.m_Time = iTime;
+}
+
+std::string
+OpenSlideTileCache::GetTileFileName(int32_t i32Level,
+                                    int64_t i64TileWidth,
+                                    int64_t i64TileHeight,
+                                    int64_t i64TileX,
+                                    int64_t i64TileY) const
+{
+  std::stringstream nameStream;
+  nameStream << m_Directory << '/' << m_SlideKey << '_' << i32Level << '_' << i64TileWidth << 'x' << i64TileHeight
+             << '_' << i64TileX << '_' << i64TileY << ".ostile";
+  return nameStream.str();
+}
+
+uint64_t
+OpenSlideTileCache::ListTiles(std::vector<TileFile> & vFiles) const
+{
+  vFiles.clear();
+
+  itksys::Directory clDirectory;
+  if (!clDirectory.Load(m_Directory))
+    return 0;
+
+  uint64_t ui64Bytes = 0;
+
+  for (unsigned long i = 0; i < clDirectory.GetNumberOfFiles(); ++i)
+  {
+    const std::string strName = clDirectory.GetFile(i);
+
+    if (strName.size() < 7 || strName.compare(strName.size() - 7, 7, ".ostile") != 0)
+      continue;
+
+    TileFile clFile;
+    clFile.m_FileName = m_Directory + '/' + strName;
+    clFile.m_ModifiedTime = itksys::SystemTools::ModifiedTime(clFile.m_FileName);
+    clFile.m_LastAccess = 0;
+    clFile.m_Bytes = itksys::SystemTools::FileLength(clFile.m_FileName);
+
+    ui64Bytes += clFile.m_Bytes;
+    vFiles.push_back(clFile);
+  }
+
+  return ui64Bytes;
+}
+
+uint64_t
+OpenSlideTileCache::AdjustCurrentBytes(int64_t i64Bytes) const
+{
+  std::lock_guard<std::mutex> clLock(m_BytesMutex);
+
+  if (i64Bytes < 0)
+    m_CurrentBytes -= std::min(m_CurrentBytes, (uint64_t)-i64Bytes);
+  else
+    m_CurrentBytes += (uint64_t)i64Bytes;
+
+  return m_CurrentBytes;
+}
+
+void
+OpenSlideTileCache::ListEvictionCandidates() const
+{
+  m_ListTime = (long int)std::time(nullptr);
+
+  const uint64_t ui64Tally = AdjustCurrentBytes(0);
+  const uint64_t ui64Bytes = ListTiles(m_EvictionCandidates);
+
+  // Tiles stored during the listing may be counted twice, which only evicts a little early
+  AdjustCurrentBytes((int64_t)ui64Bytes - (int64_t)ui64Tally);
+
+  {
+    std::lock_guard<std::mutex> clAccessLock(m_AccessMutex);
+
+    // Only the accesses of tiles still in the directory are kept
+    std::unordered_map<std::string, TileAccess> clLastAccess;
+
+    for (TileFile & clFile : m_EvictionCandidates)
+    {
+      const auto itr = m_LastAccess.find(clFile.m_FileName);
+      if (itr == m_LastAccess.end())
+        continue;
+
+      clFile.m_ModifiedTime = std::max(clFile.m_ModifiedTime, itr->second.m_Time);
+      clFile.m_LastAccess = itr->second.m_Order;
+      clLastAccess.insert(*itr);
+    }
+
+    m_LastAccess.swap(clLastAccess);
+  }
+
+  // Most recently used first, so that the least recently used tile is popped from the back. Within the same second
+  // the tiles are ordered by this process' accesses.
+  std::sort(m_EvictionCandidates.begin(),
+            m_EvictionCandidates.end(),
+            [](const TileFile & clA, const TileFile & clB) {
+              return clA.m_ModifiedTime != clB.m_ModifiedTime ? clA.m_ModifiedTime > clB.m_ModifiedTime
+                                                              : clA.m_LastAccess > clB.m_LastAccess;
+            });
+}
+
+void
+OpenSlideTileCache::Evict() const
+{
+  std::unique_lock<std::mutex> clLock(m_EvictMutex, std::try_to_lock);
+  if (!clLock.owns_lock())
+    return; // Another thread is already evicting
+
+  const uint64_t ui64Target = m_MaximumBytes / 4 * 3;
+  bool           bListed = false;
+
+  if (m_EvictionCandidates.empty())
+  {
+    ListEvictionCandidates();
+    bListed = true;
+  }
+
+  while (AdjustCurrentBytes(0) > ui64Target)
+  {
+    if (m_EvictionCandidates.empty())
+    {
+      if (bListed)
+        break; // Everything listed is gone or in use
+
+      // The tally may be off by the tiles of other processes, the listing corrects it
+      ListEvictionCandidates();
+      bListed = true;
+      continue;
+    }
+
+    const TileFile clFile = m_EvictionCandidates.back();
+    m_EvictionCandidates.pop_back();
+
+    {
+      std::lock_guard<std::mutex> clAccessLock(m_AccessMutex);
+
+      // Used by this process since the listing
+      const auto itr = m_LastAccess.find(clFile.m_FileName);
+      if (itr != m_LastAccess.end() && itr->second.m_Order > clFile.m_LastAccess)
+        continue;
+
+      m_LastAccess.erase(clFile.m_FileName);
+    }
+
+    // Refreshed or replaced by another process since the listing (a removed tile reports 0)
+    if (itksys::SystemTools::ModifiedTime(clFile.m_FileName) > std::max(clFile.m_ModifiedTime, m_ListTime))
+      continue;
+
+    // Another process may have removed it already
+    if (itksys::SystemTools::RemoveFile(clFile.m_FileName))
+      AdjustCurrentBytes(-(int64_t)clFile.m_Bytes);
+  }
+}
+
+} // end namespace itk
@@ -0,0 +1,143 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideTileCache_h
+#define itkOpenSlideTileCache_h
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace itk
+{
+
+// Persistent cache of decoded tiles on disk
+// Tiles are stored as raw ARGB pixels in one file per tile named after the slide (its path, size and modification
+// time), level, tile size and tile index. The tile size depends on the streaming settings of the reader (see
+// OpenSlideWrapper::GetCacheTileSize()), so the same index is a different tile in another tile grid. Uniform tiles
+// (e.g. background) are stored as a single pixel. Files are written to a temporary file and renamed, so several
+// processes can share the directory. Hits refresh the modification time of the file when it is older than a minute
+// (touching it on every hit costs a metadata write), and this process' own accesses order the tiles in between. Once
+// the tally of bytes exceeds the size limit, the least recently used tiles are removed in one batch down to three
+// quarters of the limit. The directory is only listed again when the candidates of the previous listing are used up, so
+// evictions do not stat every tile.
+class OpenSlideTileCache
+{
+public:
+  OpenSlideTileCache();
+
+  // Sets up the cache for the given slide. Returns false if the directory cannot be used.
+  bool
+  Open(const std::string & strDirectory, uint64_t ui64MaximumBytes, const std::string & strFileName);
+
+  void
+  Close();
+
+  bool
+  IsOpened() const;
+
+  // Loads a tile of i64TileWidth x i64TileHeight pixels. Returns false on a miss.
+  bool
+  Load(int32_t    i32Level,
+       int64_t    i64TileWidth,
+       int64_t    i64TileHeight,
+       int64_t    i64TileX,
+       int64_t    i64TileY,
+       uint32_t * p_ui32Dest) const;
+
+  // Stores a tile of i64TileWidth x i64TileHeight pixels (failures are ignored, the tile is just not cached)
+  void
+  Store(int32_t          i32Level,
+        int64_t          i64TileWidth,
+        int64_t          i64TileHeight,
+        int64_t          i64TileX,
+        int64_t          i64TileY,
+        const uint32_t * p_ui32Tile) const;
+
+  uint64_t
+  GetHits() const;
+
+  uint64_t
+  GetMisses() const;
+
+private:
+  struct TileFile
+  {
+    std::string m_FileName;
+    long int    m_ModifiedTime;
+    uint64_t    m_LastAccess; // 0 if not used by this process
+    uint64_t    m_Bytes;
+  };
+
+  struct TileAccess
+  {
+    uint64_t m_Order;
+    long int m_Time;
+  };
+
+  std::string                                         m_Directory;
+  std::string                                         m_SlideKey;
+  uint64_t                                            m_MaximumBytes;
+  mutable std::mutex                                  m_BytesMutex;
+  mutable uint64_t                                    m_CurrentBytes; // Estimate (other processes add and remove tiles)
+  mutable std::atomic<uint64_t>                       m_Hits;
+  mutable std::atomic<uint64_t>                       m_Misses;
+  mutable std::mutex                                  m_EvictMutex;
+  mutable std::vector<TileFile>                       m_EvictionCandidates; // Least recently used last
+  mutable long int                                    m_ListTime;
+  mutable std::mutex                                  m_AccessMutex;
+  mutable uint64_t                                    m_AccessCount;
+  mutable std::unordered_map<std::string, TileAccess> m_LastAccess; // In-process accesses of listed and new tiles
+
+  std::string
+  GetTileFileName(int32_t i32Level,
+                  int64_t i64TileWidth,
+                  int64_t i64TileHeight,
+                  int64_t i64TileX,
+                  int64_t i64TileY) const;
+
+  // Records an access to the tile file in the in-process least recently used order
+  void
+  RecordAccess(const std::string & strTileFileName, long int iTime) const;
+
+  // Lists the tiles of all slides in the directory and returns their total size
+  uint64_t
+  ListTiles(std::vector<TileFile> & vFiles) const;
+
+  // Adds to the tally of bytes (under m_BytesMutex, so that concurrent stores and evictions are all counted) and
+  // returns the new tally
+  uint64_t
+  AdjustCurrentBytes(int64_t i64Bytes) const;
+
+  // Lists the directory into the eviction candidates and drops the accesses of tiles that are gone. The tally is
+  // corrected by the difference between the listed size and the tally before the listing, which keeps the tiles that
+  // were stored meanwhile.
+  void
+  ListEvictionCandidates() const;
+
+  // Removes the least recently used tiles until the tally is at three quarters of the size limit
+  void
+  Evict() const;
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideTileCache_h
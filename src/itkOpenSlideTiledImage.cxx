@@ -0,0 +1,402 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "itkOpenSlideTiledImage.h"
+
+namespace itk
+{
+
+namespace
+{
+
+std::atomic<uint64_t> NextInstanceId(1);
+
+} // end anonymous namespace
+
+OpenSlideTiledImage::OpenSlideTiledImage()
+{
+  m_Level = 0;
+  m_TileSize = 512;
+  m_MemoryBudget = 256ULL << 20;
+  m_NumberOfTilesX = 0;
+  m_InstanceId = NextInstanceId++;
+  m_Generation = 0;
+  m_NumberOfTileReads = 0;
+
+  m_Spacing.Fill(1.0);
+  m_Origin.Fill(0.0);
+}
+
+OpenSlideTiledImage::~OpenSlideTiledImage() {}
+
+void
+OpenSlideTiledImage::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Level: " << m_Level << '\n';
+  os << indent << "Tile Size: " << m_TileSize << '\n';
+  os << indent << "Memory Budget: " << m_MemoryBudget << '\n';
+  os << indent << "Largest Possible Region: " << m_LargestPossibleRegion << '\n';
+  os << indent << "Resident Tiles: " << this->GetNumberOfResidentTiles() << '\n';
+  os << indent << "Tile Reads: " << this->GetNumberOfTileReads() << '\n';
+}
+
+/** Sets the ImageIO to read from. */
+void
+OpenSlideTiledImage::SetImageIO(OpenSlideImageIO * p_clImageIO)
+{
+  m_ImageIO = p_clImageIO;
+  this->Modified();
+}
+
+/** Returns the ImageIO to read from. */
+OpenSlideImageIO *
+OpenSlideTiledImage::GetImageIO() const
+{
+  return m_ImageIO.GetPointer();
+}
+
+/** Sets the level to give access to. */
+void
+OpenSlideTiledImage::SetLevel(int iLevel)
+{
+  m_Level = iLevel;
+  this->Modified();
+}
+
+/** Returns the level to give access to. */
+int
+OpenSlideTiledImage::GetLevel() const
+{
+  return m_Level;
+}
+
+/** Sets the width and height of the tiles that are read. */
+void
+OpenSlideTiledImage::SetTileSize(SizeValueType tileSize)
+{
+  m_TileSize = std::max<SizeValueType>(1, tileSize);
+  this->Modified();
+}
+
+/** Returns the width and height of the tiles that are read. */
+SizeValueType
+OpenSlideTiledImage::GetTileSize() const
+{
+  return m_TileSize;
+}
+
+/** Sets the memory budget in bytes for resident tiles (at least one tile is kept). */
+void
+OpenSlideTiledImage::SetMemoryBudget(uint64_t ui64Bytes)
+{
+  m_MemoryBudget = ui64Bytes;
+  this->Modified();
+}
+
+/** Returns the memory budget in bytes for resident tiles. */
+uint64_t
+OpenSlideTiledImage::GetMemoryBudget() const
+{
+  return m_MemoryBudget;
+}
+
+void
+OpenSlideTiledImage::Initialize()
+{
+  this->ReleaseTiles();
+
+  if (m_ImageIO.IsNull())
+  {
+    itkExceptionMacro("Error OpenSlideTiledImage could not initialize." << std::endl << "Reason: No ImageIO set.");
+  }
+
+  m_ImageIO->SetLevel(m_Level);
+  m_ImageIO->ReadImageInformation();
+
+  if (m_ImageIO->GetOutputLayout() != OpenSlideImageIO::OutputLayoutEnum::RGBA ||
+      m_ImageIO->GetOutputComponentType() != OpenSlideImageIO::OutputComponentEnum::UnsignedChar)
+  {
+    itkExceptionMacro("Error OpenSlideTiledImage could not initialize: "
+                      << m_ImageIO->GetFileName() << std::endl
+                      << "Reason: ImageIO does not read RGBA pixels with unsigned char components.");
+  }
+
+  SizeType clSize;
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    clSize[i] = m_ImageIO->GetDimensions(i);
+    m_Spacing[i] = m_ImageIO->GetSpacing(i);
+    m_Origin[i] = m_ImageIO->GetOrigin(i);
+  }
+
+  m_LargestPossibleRegion = RegionType(clSize);
+  m_NumberOfTilesX = (clSize[0] + m_TileSize - 1) / m_TileSize;
+
+  std::lock_guard<std::mutex> clLock(m_TileMutex);
+  m_NumberOfTileReads = 0;
+}
+
+/** Returns the region of the level image. */
+const OpenSlideTiledImage::RegionType &
+OpenSlideTiledImage::GetLargestPossibleRegion() const
+{
+  return m_LargestPossibleRegion;
+}
+
+/** Returns the spacing of the level image. */
+const OpenSlideTiledImage::SpacingType &
+OpenSlideTiledImage::GetSpacing() const
+{
+  return m_Spacing;
+}
+
+/** Returns the origin of the level image. */
+const OpenSlideTiledImage::PointType &
+OpenSlideTiledImage::GetOrigin() const
+{
+  return m_Origin;
+}
+
+OpenSlideTiledImage::PixelType
+OpenSlideTiledImage::GetPixel(const IndexType & clIndex) const
+{
+  if (!m_LargestPossibleRegion.IsInside(clIndex))
+  {
+    itkExceptionMacro("Error OpenSlideTiledImage could not get pixel." << std::endl
+                                                                        << "Reason: Index " << clIndex
+                                                                        << " is outside of the image.");
+  }
+
+  // The last tile this thread used (of any tiled image)
+  struct LastTile
+  {
+    uint64_t    m_InstanceId;
+    uint64_t    m_Generation;
+    TilePointer m_Tile;
+  };
+
+  static thread_local LastTile clLastTile = { 0, 0, TilePointer() };
+
+  if (clLastTile.m_InstanceId != m_InstanceId || clLastTile.m_Generation != m_Generation ||
+      !clLastTile.m_Tile->m_Region.IsInside(clIndex))
+  {
+    clLastTile.m_Tile = this->GetTile(clIndex[0], clIndex[1]);
+    clLastTile.m_InstanceId = m_InstanceId;
+    clLastTile.m_Generation = m_Generation;
+  }
+
+  const Tile &        clTile = *clLastTile.m_Tile;
+  const IndexType &   clTileIndex = clTile.m_Region.GetIndex();
+  const SizeValueType tileWidth = clTile.m_Region.GetSize(0);
+
+  return clTile.m_Pixels[(clIndex[1] - clTileIndex[1]) * tileWidth + (clIndex[0] - clTileIndex[0])];
+}
+
+void
+OpenSlideTiledImage::ReadRegion(const RegionType & clRegion, PixelType * p_clBuffer) const
+{
+  if (!m_LargestPossibleRegion.IsInside(clRegion) || clRegion.GetNumberOfPixels() == 0)
+  {
+    itkExceptionMacro("Error OpenSlideTiledImage could not read region." << std::endl
+                                                                          << "Reason: Region is outside of the image.");
+  }
+
+  const IndexValueType tileSize = (IndexValueType)m_TileSize;
+  const IndexType      clStart = clRegion.GetIndex();
+  const SizeType       clSize = clRegion.GetSize();
+  IndexType            clEnd;
+
+  clEnd[0] = clStart[0] + (IndexValueType)clSize[0];
+  clEnd[1] = clStart[1] + (IndexValueType)clSize[1];
+
+  for (IndexValueType ty = clStart[1] / tileSize; ty <= (clEnd[1] - 1) / tileSize; ++ty)
+  {
+    for (IndexValueType tx = clStart[0] / tileSize; tx <= (clEnd[0] - 1) / tileSize; ++tx)
+    {
+      const TilePointer p_clTile = this->GetTile(tx * tileSize, ty * tileSize);
+      const Tile &      clTile = *p_clTile;
+      const IndexType & clTileIndex = clTile.m_Region.GetIndex();
+      const SizeType &  clTileSize = clTile.m_Region.GetSize();
+
+      // Copy the part of the tile inside the region
+      const IndexValueType x0 = std::max(clStart[0], clTileIndex[0]);
+      const IndexValueType x1 = std::min(clEnd[0], clTileIndex[0] + (IndexValueType)clTileSize[0]);
+      const IndexValueType y0 = std::max(clStart[1], clTileIndex[1]);
+      const IndexValueType y1 = std::min(clEnd[1], clTileIndex[1] + (IndexValueType)clTileSize[1]);
+
+      for (IndexValueType y = y0; y < y1; ++y)
+      {
+        std::memcpy(p_clBuffer + (y - clStart[1]) * clSize[0] + (x0 - clStart[0]),
+                    &clTile.m_Pixels[(y - clTileIndex[1]) * clTileSize[0] + (x0 - clTileIndex[0])],
+                    (x1 - x0) * sizeof(PixelType));
+      }
+    }
+  }
+}
+
+OpenSlideTiledImage::ImageType::Pointer
+OpenSlideTiledImage::GetRegion(const RegionType & clRegion) const
+{
+  ImageType::Pointer p_clImage = ImageType::New();
+
+  p_clImage->SetRegions(clRegion);
+  p_clImage->SetSpacing(m_Spacing);
+  p_clImage->SetOrigin(m_Origin);
+  p_clImage->Allocate();
+
+  this->ReadRegion(clRegion, p_clImage->GetBufferPointer());
+
+  return p_clImage;
+}
+
+bool
+OpenSlideTiledImage::TransformPhysicalPointToIndex(const PointType & clPoint, IndexType & clIndex) const
+{
+  for (unsigned int i = 0; i < 2; ++i)
+    clIndex[i] = (IndexValueType)std::floor((clPoint[i] - m_Origin[i]) / m_Spacing[i] + 0.5);
+
+  return m_LargestPossibleRegion.IsInside(clIndex);
+}
+
+/** Releases all resident tiles. */
+void
+OpenSlideTiledImage::ReleaseTiles()
+{
+  std::lock_guard<std::mutex> clLock(m_TileMutex);
+  m_Tiles.clear();
+  m_TileMap.clear();
+  ++m_Generation;
+}
+
+/** Returns the number of tiles currently resident. */
+SizeValueType
+OpenSlideTiledImage::GetNumberOfResidentTiles() const
+{
+  std::lock_guard<std::mutex> clLock(m_TileMutex);
+  return m_Tiles.size();
+}
+
+/** Returns the number of tiles read since Initialize(). */
+SizeValueType
+OpenSlideTiledImage::GetNumberOfTileReads() const
+{
+  std::lock_guard<std::mutex> clLock(m_TileMutex);
+  return m_NumberOfTileReads;
+}
+
+OpenSlideTiledImage::TilePointer
+OpenSlideTiledImage::GetTile(IndexValueType x, IndexValueType y) const
+{
+  const IndexValueType tileSize = (IndexValueType)m_TileSize;
+  const IndexValueType tx = x / tileSize;
+  const IndexValueType ty = y / tileSize;
+  const int64_t        i64Key = ty * (int64_t)m_NumberOfTilesX + tx;
+
+  {
+    std::unique_lock<std::mutex> clLock(m_TileMutex);
+
+    while (true)
+    {
+      auto itr = m_TileMap.find(i64Key);
+
+      if (itr != m_TileMap.end())
+      {
+        // Most recently used
+        m_Tiles.splice(m_Tiles.begin(), m_Tiles, itr->second);
+        return m_Tiles.front();
+      }
+
+      // Read it in this thread unless another thread is already reading it
+      if (m_TilesBeingRead.insert(i64Key).second)
+        break;
+
+      m_TileRead.wait(clLock);
+    }
+  }
+
+  std::shared_ptr<Tile> p_clTile = std::make_shared<Tile>();
+  p_clTile->m_Key = i64Key;
+
+  IndexType clTileIndex;
+  SizeType  clTileSize;
+  clTileIndex[0] = tx * tileSize;
+  clTileIndex[1] = ty * tileSize;
+
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    const IndexValueType end = (IndexValueType)m_LargestPossibleRegion.GetSize(i);
+    clTileSize[i] = (SizeValueType)std::min(tileSize, end - clTileIndex[i]);
+  }
+
+  p_clTile->m_Region = RegionType(clTileIndex, clTileSize);
+
+  ImageIORegion clIORegion(2);
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    clIORegion.SetIndex(i, clTileIndex[i]);
+    clIORegion.SetSize(i, clTileSize[i]);
+  }
+
+  try
+  {
+    p_clTile->m_Pixels.resize(p_clTile->m_Region.GetNumberOfPixels());
+    m_ImageIO->ReadRegion(m_Level, clIORegion, &p_clTile->m_Pixels[0]);
+  }
+  catch (...)
+  {
+    // Let a waiting thread try again
+    {
+      std::lock_guard<std::mutex> clLock(m_TileMutex);
+      m_TilesBeingRead.erase(i64Key);
+    }
+
+    m_TileRead.notify_all();
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> clLock(m_TileMutex);
+
+    m_TilesBeingRead.erase(i64Key);
+    ++m_NumberOfTileReads;
+
+    // Release the least recently used tiles to stay within the budget (keeping at least the new tile)
+    const uint64_t ui64TileBytes = (uint64_t)m_TileSize * m_TileSize * sizeof(PixelType);
+    const size_t   maxTiles = (size_t)std::max<uint64_t>(1, m_MemoryBudget / ui64TileBytes);
+
+    while (m_Tiles.size() >= maxTiles)
+    {
+      m_TileMap.erase(m_Tiles.back()->m_Key);
+      m_Tiles.pop_back();
+    }
+
+    m_Tiles.push_front(p_clTile);
+    m_TileMap[i64Key] = m_Tiles.begin();
+  }
+
+  m_TileRead.notify_all();
+
+  return p_clTile;
+}
+
+} // end namespace itk
@@ -0,0 +1,1021 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <algorithm>
+
+#include "itkOpenSlideWrapper.h"
+#include "itkOpenSlideHeaderCache.h"
+#include "itkOpenSlidePixelConverter.h"
+#include "itkMetaDataObject.h"
+
+// OpenSlide
+#include "openslide.h"
+
+namespace itk
+{
+
+uint64_t
+OpenSlideWrapper::GCD(uint64_t ui64A, uint64_t ui64B)
+{
+  if (ui64A == 0)
+    return ui64B;
+
+  if (ui64B == 0)
+    return ui64A;
+
+  if (ui64A == 1 || ui64B == 1)
+    return 1;
+
+  if (ui64A == ui64B)
+    return ui64A;
+
+  unsigned int uiExp = 0;
+  while ((ui64A & 1) == 0 && (ui64B & 1) == 0)
+  {
+    ui64A >>= 1;
+    ui64B >>= 1;
+    ++uiExp;
+  }
+
+  while (ui64A != ui64B)
+  {
+    if ((ui64A & 1) == 0)
+      ui64A >>= 1;
+    else if ((ui64B & 1) == 0)
+      ui64B >>= 1;
+    else if (ui64A > ui64B)
+      ui64A = (ui64A - ui64B) >> 1;
+    else
+      ui64B = (ui64B - ui64A) >> 1;
+  }
+
+  return ui64A << uiExp;
+}
+
+const char *
+OpenSlideWrapper::DetectVendor(const char * p_cFileName)
+{
+  return openslide_detect_vendor(p_cFileName);
+}
+
+bool
+OpenSlideWrapper::CanReadFile(const char * p_cFileName)
+{
+  return DetectVendor(p_cFileName) != NULL;
+}
+
+const char *
+OpenSlideWrapper::GetVersion()
+{
+  return openslide_get_version();
+}
+
+OpenSlideWrapper::OpenSlideWrapper()
+{
+  m_Osr = NULL;
+  m_HasHeader = false;
+  m_Level = 0;
+  m_ApproximateStreaming = false;
+  m_UseBounds = false;
+  m_TiffTilesChecked = false;
+  m_HasTiffTiles = false;
+  m_DirectTileDecoding = false;
+}
+
+OpenSlideWrapper::OpenSlideWrapper(const char * p_cFileName)
+{
+  m_Osr = NULL;
+  m_HasHeader = false;
+  m_Level = 0;
+  m_ApproximateStreaming = false;
+  m_UseBounds = false;
+  m_TiffTilesChecked = false;
+  m_HasTiffTiles = false;
+  m_DirectTileDecoding = false;
+  Open(p_cFileName);
+}
+
+OpenSlideWrapper::~OpenSlideWrapper()
+{
+  Close();
+}
+
+void
+OpenSlideWrapper::SetApproximateStreaming(bool bApproximateStreaming)
+{
+  m_ApproximateStreaming = bApproximateStreaming;
+}
+
+bool
+OpenSlideWrapper::GetApproximateStreaming() const
+{
+  return m_ApproximateStreaming;
+}
+
+void
+OpenSlideWrapper::SetUseBounds(bool bUseBounds)
+{
+  m_UseBounds = bUseBounds;
+}
+
+bool
+OpenSlideWrapper::GetUseBounds() const
+{
+  return m_UseBounds;
+}
+
+bool
+OpenSlideWrapper::GetBounds(int64_t & i64X, int64_t & i64Y, int64_t & i64Width, int64_t & i64Height) const
+{
+  i64X = i64Y = i64Width = i64Height = 0;
+
+  if (!GetPropertyValue(OPENSLIDE_PROPERTY_NAME_BOUNDS_X, i64X) ||
+      !GetPropertyValue(OPENSLIDE_PROPERTY_NAME_BOUNDS_Y, i64Y) ||
+      !GetPropertyValue(OPENSLIDE_PROPERTY_NAME_BOUNDS_WIDTH, i64Width) ||
+      !GetPropertyValue(OPENSLIDE_PROPERTY_NAME_BOUNDS_HEIGHT, i64Height))
+    return false;
+
+  return i64X >= 0 && i64Y >= 0 && i64Width > 0 && i64Height > 0;
+}
+
+bool
+OpenSlideWrapper::CanStreamRead() const
+{
+  if (m_AssociatedImage.size() > 0)
+    return false;
+
+  // XXX: ITK streams along X. Shouldn't we check if the minimum spacing in Y is not the size of the whole image?
+  return m_ApproximateStreaming || ComputeMaximumNumberOfStreamableRegions() > 1;
+}
+
+void
+OpenSlideWrapper::Close()
+{
+  if (m_Osr != NULL)
+  {
+    openslide_close(m_Osr);
+    m_Osr = NULL;
+  }
+
+  m_HasHeader = false;
+  m_Header.Clear();
+  m_FileName.clear();
+  m_TileCache.Close();
+
+  std::lock_guard<std::mutex> clLock(m_TiffTilesMutex);
+  m_TiffTiles.Close();
+  m_TiffTilesChecked = false;
+  m_HasTiffTiles = false;
+}
+
+void
+OpenSlideWrapper::ReleaseContext()
+{
+  {
+    std::lock_guard<std::mutex> clLock(m_OpenMutex);
+
+    if (m_Osr != NULL)
+    {
+      openslide_close(m_Osr);
+      m_Osr = NULL;
+    }
+  }
+
+  std::lock_guard<std::mutex> clLock(m_TiffTilesMutex);
+  m_TiffTiles.Close();
+  m_TiffTilesChecked = false;
+  m_HasTiffTiles = false;
+}
+
+const OpenSlideTiffTiles *
+OpenSlideWrapper::GetTiffTiles() const
+{
+  std::lock_guard<std::mutex> clLock(m_TiffTilesMutex);
+
+  if (!m_TiffTilesChecked && m_HasHeader)
+  {
+    m_TiffTilesChecked = true;
+    m_HasTiffTiles = OpenSlideTiffTiles::IsSupportedVendor(m_Header.m_Vendor) &&
+                     m_TiffTiles.Open(m_FileName, m_Header.m_LevelWidths, m_Header.m_LevelHeights);
+  }
+
+  return m_HasTiffTiles ? &m_TiffTiles : NULL;
+}
+
+void
+OpenSlideWrapper::SetDirectTileDecoding(bool bDirectTileDecoding)
+{
+  m_DirectTileDecoding = bDirectTileDecoding;
+}
+
+bool
+OpenSlideWrapper::GetDirectTileDecoding() const
+{
+  return m_DirectTileDecoding;
+}
+
+uint64_t
+OpenSlideWrapper::GetNumberOfDirectlyDecodedTiles() const
+{
+  std::lock_guard<std::mutex> clLock(m_TiffTilesMutex);
+  return m_HasTiffTiles ? m_TiffTiles.GetNumberOfDecodedTiles() : 0;
+}
+
+bool
+OpenSlideWrapper::DecodeLevelRegion(void *                  p_vDest,
+                                    OpenSlideTileFormatEnum eFormat,
+                                    int32_t                 i32Level,
+                                    int64_t                 i64X,
+                                    int64_t                 i64Y,
+                                    int64_t                 i64Width,
+                                    int64_t                 i64Height,
+                                    const char *&           p_cError) const
+{
+  if (!m_DirectTileDecoding)
+    return false;
+
+  const OpenSlideTiffTiles * const p_clTiffTiles = GetTiffTiles();
+  if (p_clTiffTiles == NULL || !p_clTiffTiles->CanDecode(i32Level))
+    return false;
+
+  int64_t i64ExtentX = 0, i64ExtentY = 0, i64ExtentWidth = 0, i64ExtentHeight = 0;
+  if (!GetLevelExtent(i32Level, i64ExtentX, i64ExtentY, i64ExtentWidth, i64ExtentHeight))
+    return false;
+
+  p_cError = p_clTiffTiles->DecodeRegion(
+    i32Level, 1, i64X + i64ExtentX, i64Y + i64ExtentY, i64Width, i64Height, eFormat, p_vDest);
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::SetTileCache(const std::string & strDirectory, uint64_t ui64MaximumBytes)
+{
+  m_TileCache.Close();
+
+  if (strDirectory.empty())
+    return true;
+
+  return m_HasHeader && m_TileCache.Open(strDirectory, ui64MaximumBytes, m_FileName);
+}
+
+const OpenSlideTileCache &
+OpenSlideWrapper::GetTileCache() const
+{
+  return m_TileCache;
+}
+
+bool
+OpenSlideWrapper::IsOpened() const
+{
+  return m_HasHeader;
+}
+
+bool
+OpenSlideWrapper::Open(const char * p_cFileName)
+{
+  Close();
+  m_Osr = openslide_open(p_cFileName);
+
+  if (m_Osr == NULL || openslide_get_error(m_Osr) != NULL)
+    return m_Osr != NULL; // Let the caller query the error
+
+  m_FileName = p_cFileName;
+  LoadHeader();
+  return true;
+}
+
+bool
+OpenSlideWrapper::Open(const char * p_cFileName, const std::string & strHeaderCacheDirectory)
+{
+  Close();
+
+  if (OpenSlideHeaderCache::Load(strHeaderCacheDirectory, p_cFileName, m_Header))
+  {
+    m_FileName = p_cFileName;
+    m_HasHeader = true;
+    return true;
+  }
+
+  if (!Open(p_cFileName))
+    return false;
+
+  if (m_HasHeader)
+    OpenSlideHeaderCache::Save(strHeaderCacheDirectory, p_cFileName, m_Header);
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::EnsureOpened() const
+{
+  std::lock_guard<std::mutex> clLock(m_OpenMutex);
+
+  if (m_Osr != NULL)
+    return true;
+
+  if (!m_HasHeader)
+    return false;
+
+  m_Osr = openslide_open(m_FileName.c_str());
+
+  return m_Osr != NULL;
+}
+
+const char *
+OpenSlideWrapper::GetError() const
+{
+  if (m_Osr == NULL)
+    return m_HasHeader ? "OpenSlideWrapper could not open the file." : "OpenSlideWrapper has no file open.";
+
+  return openslide_get_error(m_Osr);
+}
+
+std::string
+OpenSlideWrapper::GetVendor() const
+{
+  return m_Header.m_Vendor;
+}
+
+void
+OpenSlideWrapper::SetLevel(int32_t i32Level)
+{
+  m_Level = i32Level;
+  m_AssociatedImage.clear();
+}
+
+int32_t
+OpenSlideWrapper::GetLevel() const
+{
+  return m_Level;
+}
+
+void
+OpenSlideWrapper::SetAssociatedImageName(const std::string & strImageName)
+{
+  m_AssociatedImage = strImageName;
+  m_Level = 0;
+}
+
+const std::string &
+OpenSlideWrapper::GetAssociatedImageName() const
+{
+  return m_AssociatedImage;
+}
+
+int32_t
+OpenSlideWrapper::GetBestLevelForDownsample(double dDownsample) const
+{
+  if (!m_HasHeader || m_Header.m_LevelDownsamples.empty())
+    return -1;
+
+  const std::vector<double> & vDownsamples = m_Header.m_LevelDownsamples;
+
+  if (dDownsample < vDownsamples[0])
+    return 0;
+
+  for (size_t i = 1; i < vDownsamples.size(); ++i)
+  {
+    if (dDownsample >= vDownsamples[i - 1] && dDownsample < vDownsamples[i])
+      return (int32_t)i - 1;
+  }
+
+  return (int32_t)vDownsamples.size() - 1;
+}
+
+bool
+OpenSlideWrapper::SetBestLevelForDownsample(double dDownsample)
+{
+  const int32_t i32Level = GetBestLevelForDownsample(dDownsample);
+
+  if (i32Level < 0)
+    return false;
+
+  SetLevel(i32Level);
+
+  return true;
+}
+
+double
+OpenSlideWrapper::GetLevelDownsample(int32_t i32Level) const
+{
+  if (!m_HasHeader || i32Level < 0 || i32Level >= (int32_t)m_Header.m_LevelDownsamples.size())
+    return -1.0;
+
+  return m_Header.m_LevelDownsamples[i32Level];
+}
+
+bool
+OpenSlideWrapper::GetAssociatedImageDimensions(const std::string & strImageName,
+                                               int64_t &           i64Width,
+                                               int64_t &           i64Height) const
+{
+  i64Width = i64Height = 0;
+
+  if (!m_HasHeader)
+    return false;
+
+  const std::vector<std::string> & vNames = m_Header.m_AssociatedImageNames;
+  const size_t i = std::find(vNames.begin(), vNames.end(), strImageName) - vNames.begin();
+
+  if (i >= vNames.size())
+    return false;
+
+  i64Width = m_Header.m_AssociatedImageWidths[i];
+  i64Height = m_Header.m_AssociatedImageHeights[i];
+
+  return i64Width > 0 && i64Height > 0;
+}
+
+int32_t
+OpenSlideWrapper::GetLevelCount() const
+{
+  if (!m_HasHeader)
+    return -1;
+
+  return (int32_t)m_Header.m_LevelWidths.size();
+}
+
+const char *
+OpenSlideWrapper::ReadRegion(uint32_t * p_ui32Dest,
+                             int64_t    i64X,
+                             int64_t    i64Y,
+                             int64_t    i64Width,
+                             int64_t    i64Height) const
+{
+  if (m_AssociatedImage.size() > 0)
+  {
+    if (!EnsureOpened())
+      return GetError();
+
+    openslide_read_associated_image(m_Osr, m_AssociatedImage.c_str(), p_ui32Dest);
+    return openslide_get_error(m_Osr);
+  }
+
+  return ReadLevelRegion(p_ui32Dest, m_Level, i64X, i64Y, i64Width, i64Height);
+}
+
+const char *
+OpenSlideWrapper::ReadAssociatedImage(const std::string & strImageName, uint32_t * p_ui32Dest) const
+{
+  if (!EnsureOpened())
+    return GetError();
+
+  openslide_read_associated_image(m_Osr, strImageName.c_str(), p_ui32Dest);
+
+  return openslide_get_error(m_Osr);
+}
+
+const char *
+OpenSlideWrapper::ReadLevelRegion(uint32_t * p_ui32Dest,
+                                  int32_t    i32Level,
+                                  int64_t    i64X,
+                                  int64_t    i64Y,
+                                  int64_t    i64Width,
+                                  int64_t    i64Height) const
+{
+  const char * p_cError = NULL;
+  if (DecodeLevelRegion(
+        p_ui32Dest, OpenSlideTileFormatEnum::ARGB, i32Level, i64X, i64Y, i64Width, i64Height, p_cError))
+    return p_cError;
+
+  const double dDownsampleFactor = GetLevelDownsample(i32Level);
+
+  if (dDownsampleFactor <= 0.0)
+    return "Could not get downsample factor.";
+
+  int64_t i64ExtentX = 0, i64ExtentY = 0, i64ExtentWidth = 0, i64ExtentHeight = 0;
+  if (!GetLevelExtent(i32Level, i64ExtentX, i64ExtentY, i64ExtentWidth, i64ExtentHeight))
+    return "Could not get level dimensions.";
+
+  i64X += i64ExtentX;
+  i64Y += i64ExtentY;
+
+  int64_t i64TileWidth = 0, i64TileHeight = 0;
+  if (m_TileCache.IsOpened() && GetCacheTileSize(i32Level, i64TileWidth, i64TileHeight))
+  {
+    return ReadCachedRegion(
+      p_ui32Dest, i32Level, i64TileWidth, i64TileHeight, dDownsampleFactor, i64X, i64Y, i64Width, i64Height);
+  }
+
+  if (!EnsureOpened())
+    return GetError();
+
+  // NOTE: API expects level 0 coordinates. So we upsample the coordinates.
+  // XXX: This can subtly change the image compared to reading all at once.
+  //      The handling of coordinates internally in OpenSlide is quite similar!
+  i64X = (int64_t)(i64X * dDownsampleFactor);
+  i64Y = (int64_t)(i64Y * dDownsampleFactor);
+
+  openslide_read_region(m_Osr, p_ui32Dest, i64X, i64Y, i32Level, i64Width, i64Height);
+
+  return openslide_get_error(m_Osr);
+}
+
+bool
+OpenSlideWrapper::ForEachTissuePixel(const std::function<void(uint32_t)> & clFunction) const
+{
+  const int32_t i32Level = GetLevelCount() - 1;
+
+  int64_t i64X = 0, i64Y = 0, i64Width = 0, i64Height = 0;
+  if (i32Level < 0 || !GetLevelExtent(i32Level, i64X, i64Y, i64Width, i64Height) || i64Width <= 0)
+    return false;
+
+  // Read in strips to bound the memory for unusually large lowest resolution levels
+  const int64_t         i64StripHeight = std::max<int64_t>(1, std::min<int64_t>(i64Height, (1 << 22) / i64Width));
+  std::vector<uint32_t> vStrip(i64Width * i64StripHeight);
+
+  for (int64_t y = 0; y < i64Height; y += i64StripHeight)
+  {
+    const int64_t i64Rows = std::min(i64StripHeight, i64Height - y);
+
+    if (ReadLevelRegion(vStrip.data(), i32Level, 0, y, i64Width, i64Rows) != NULL)
+      return false;
+
+    for (int64_t i = 0; i < i64Width * i64Rows; ++i)
+    {
+      const uint32_t ui32Pixel = vStrip[i];
+      const uint32_t ui32R = (ui32Pixel >> 16) & 0xff, ui32G = (ui32Pixel >> 8) & 0xff, ui32B = ui32Pixel & 0xff;
+
+      if ((ui32Pixel >> 24) != 0 && (ui32R <= 215 || ui32G <= 215 || ui32B <= 215))
+        clFunction(ui32Pixel);
+    }
+  }
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::ComputeLabStatistics(double a_dMean[3], double a_dStdDev[3]) const
+{
+  double   a_dSum[3] = { 0.0, 0.0, 0.0 };
+  double   a_dSumSquares[3] = { 0.0, 0.0, 0.0 };
+  uint64_t ui64Count = 0;
+
+  const bool bRead = ForEachTissuePixel([&](uint32_t ui32Pixel) {
+    double a_dLab[3];
+    OpenSlidePixelConverter::RGBToLab((ui32Pixel >> 16) & 0xff, (ui32Pixel >> 8) & 0xff, ui32Pixel & 0xff, a_dLab);
+
+    for (int c = 0; c < 3; ++c)
+    {
+      a_dSum[c] += a_dLab[c];
+      a_dSumSquares[c] += a_dLab[c] * a_dLab[c];
+    }
+
+    ++ui64Count;
+  });
+
+  if (!bRead || ui64Count == 0)
+    return false;
+
+  for (int c = 0; c < 3; ++c)
+  {
+    a_dMean[c] = a_dSum[c] / ui64Count;
+    a_dStdDev[c] = std::sqrt(std::max(0.0, a_dSumSquares[c] / ui64Count - a_dMean[c] * a_dMean[c]));
+  }
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::EstimateMacenkoStains(double a_dStains[9]) const
+{
+  std::vector<uint32_t> vTissue;
+
+  if (!ForEachTissuePixel([&](uint32_t ui32Pixel) { vTissue.push_back(ui32Pixel); }))
+    return false;
+
+  return OpenSlidePixelConverter::EstimateMacenkoStains(vTissue, a_dStains);
+}
+
+bool
+OpenSlideWrapper::GetSpacing(double & dSpacingX, double & dSpacingY) const
+{
+  dSpacingX = dSpacingY = 1.0;
+
+  if (m_AssociatedImage.size() > 0)
+    return false;
+
+  return GetLevelSpacing(m_Level, dSpacingX, dSpacingY);
+}
+
+bool
+OpenSlideWrapper::GetLevelSpacing(int32_t i32Level, double & dSpacingX, double & dSpacingY) const
+{
+  dSpacingX = dSpacingY = 1.0;
+
+  if (!m_HasHeader)
+    return false;
+
+  const double dDownsample = GetLevelDownsample(i32Level);
+
+  if (dDownsample <= 0.0)
+    return false;
+
+  if (!GetPropertyValue(OPENSLIDE_PROPERTY_NAME_MPP_X, dSpacingX) ||
+      !GetPropertyValue(OPENSLIDE_PROPERTY_NAME_MPP_Y, dSpacingY))
+  {
+    dSpacingX = dSpacingY = dDownsample;
+    return false;
+  }
+
+  dSpacingX *= dDownsample;
+  dSpacingY *= dDownsample;
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::GetDimensions(int64_t & i64Width, int64_t & i64Height) const
+{
+  i64Width = i64Height = 0;
+
+  if (m_AssociatedImage.size() > 0)
+    return GetAssociatedImageDimensions(m_AssociatedImage, i64Width, i64Height);
+
+  int64_t i64X = 0, i64Y = 0;
+  return GetLevelExtent(m_Level, i64X, i64Y, i64Width, i64Height);
+}
+
+void
+OpenSlideWrapper::GetOrigin(double & dOriginX, double & dOriginY) const
+{
+  dOriginX = dOriginY = 0.0;
+
+  if (m_AssociatedImage.size() > 0)
+    return;
+
+  int64_t i64X = 0, i64Y = 0, i64Width = 0, i64Height = 0;
+  if (!GetLevelExtent(m_Level, i64X, i64Y, i64Width, i64Height))
+    return;
+
+  double dSpacingX = 1.0, dSpacingY = 1.0;
+  GetSpacing(dSpacingX, dSpacingY);
+
+  dOriginX = i64X * dSpacingX;
+  dOriginY = i64Y * dSpacingY;
+}
+
+bool
+OpenSlideWrapper::GetLevelExtent(int32_t   i32Level,
+                                 int64_t & i64X,
+                                 int64_t & i64Y,
+                                 int64_t & i64Width,
+                                 int64_t & i64Height) const
+{
+  i64X = i64Y = 0;
+
+  if (!GetLevelDimensions(i32Level, i64Width, i64Height))
+    return false;
+
+  int64_t i64BoundsX = 0, i64BoundsY = 0, i64BoundsWidth = 0, i64BoundsHeight = 0;
+  if (!m_UseBounds || !GetBounds(i64BoundsX, i64BoundsY, i64BoundsWidth, i64BoundsHeight))
+    return true;
+
+  const double dDownsample = GetLevelDownsample(i32Level);
+  int64_t      i64MinWidth = 0, i64MinHeight = 0;
+
+  if (dDownsample <= 0.0 || !ComputeMinimumStreamableRegionSize(i32Level, i64MinWidth, i64MinHeight))
+    return true;
+
+  int64_t i64XLower = (int64_t)std::floor(i64BoundsX / dDownsample);
+  int64_t i64YLower = (int64_t)std::floor(i64BoundsY / dDownsample);
+  int64_t i64XUpper = (int64_t)std::ceil((i64BoundsX + i64BoundsWidth) / dDownsample);
+  int64_t i64YUpper = (int64_t)std::ceil((i64BoundsY + i64BoundsHeight) / dDownsample);
+
+  // Snap outwards to the grid of exactly streamable regions. The grid starts at 0 and its spacing
+  // W_L / gcd(W_0, W_L) (1 with approximate streaming) divides the level dimension W_L, so the upper bounds
+  // clamped to the level are still on the grid.
+  i64XLower -= i64XLower % i64MinWidth;
+  i64YLower -= i64YLower % i64MinHeight;
+  i64XUpper = std::min(i64Width, (i64XUpper + i64MinWidth - 1) / i64MinWidth * i64MinWidth);
+  i64YUpper = std::min(i64Height, (i64YUpper + i64MinHeight - 1) / i64MinHeight * i64MinHeight);
+
+  if (i64XLower >= i64XUpper || i64YLower >= i64YUpper)
+    return true; // Bogus bounds, use the whole level
+
+  i64X = i64XLower;
+  i64Y = i64YLower;
+  i64Width = i64XUpper - i64XLower;
+  i64Height = i64YUpper - i64YLower;
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::GetLevelDimensions(int32_t i32Level, int64_t & i64Width, int64_t & i64Height) const
+{
+  i64Width = i64Height = 0;
+
+  if (!m_HasHeader || i32Level < 0 || i32Level >= (int32_t)m_Header.m_LevelWidths.size())
+    return false;
+
+  i64Width = m_Header.m_LevelWidths[i32Level];
+  i64Height = m_Header.m_LevelHeights[i32Level];
+
+  return i64Width > 0 && i64Height > 0;
+}
+
+std::vector<std::string>
+OpenSlideWrapper::GetAssociatedImageNames() const
+{
+  return m_Header.m_AssociatedImageNames;
+}
+
+MetaDataDictionary
+OpenSlideWrapper::GetMetaDataDictionary() const
+{
+  MetaDataDictionary clTags;
+
+  for (std::map<std::string, std::string>::const_iterator itr = m_Header.m_Properties.begin();
+       itr != m_Header.m_Properties.end();
+       ++itr)
+  {
+    EncapsulateMetaData<std::string>(clTags, itr->first, itr->second);
+  }
+
+  return clTags;
+}
+
+bool
+OpenSlideWrapper::GetPropertyValue(const char * p_cKey, std::string & strValue) const
+{
+  std::map<std::string, std::string>::const_iterator itr = m_Header.m_Properties.find(p_cKey);
+  if (itr == m_Header.m_Properties.end())
+    return false;
+
+  strValue = itr->second;
+  return true;
+}
+
+bool
+OpenSlideWrapper::ComputeMinimumStreamableRegionSize(int64_t & i64Width, int64_t & i64Height) const
+{
+  return ComputeMinimumStreamableRegionSize(m_Level, i64Width, i64Height);
+}
+
+bool
+OpenSlideWrapper::ComputeMinimumStreamableRegionSize(int32_t i32Level, int64_t & i64Width, int64_t & i64Height) const
+{
+  i64Width = i64Height = 0;
+
+  if (!m_HasHeader)
+    return false;
+
+  if (i32Level == 0 || m_ApproximateStreaming)
+  { // Nothing to do
+    i64Width = i64Height = 1;
+    return true;
+  }
+
+  int64_t i64WidthLevel0 = 0, i64HeightLevel0 = 0;
+  int64_t i64WidthLevelL = 0, i64HeightLevelL = 0;
+
+  if (!GetLevelDimensions(0, i64WidthLevel0, i64HeightLevel0) ||
+      !GetLevelDimensions(i32Level, i64WidthLevelL, i64HeightLevelL))
+    return false;
+
+  i64Width = i64WidthLevelL / (int64_t)GCD(i64WidthLevel0, i64WidthLevelL);
+  i64Height = i64HeightLevelL / (int64_t)GCD(i64HeightLevel0, i64HeightLevelL);
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::GetLevelTileSize(int32_t i32Level, int64_t & i64Width, int64_t & i64Height) const
+{
+  i64Width = i64Height = 0;
+
+  std::stringstream widthKey, heightKey;
+  widthKey << "openslide.level[" << i32Level << "].tile-width";
+  heightKey << "openslide.level[" << i32Level << "].tile-height";
+
+  return GetPropertyValue(widthKey.str().c_str(), i64Width) && GetPropertyValue(heightKey.str().c_str(), i64Height) &&
+         i64Width > 0 && i64Height > 0;
+}
+
+int64_t
+OpenSlideWrapper::ComputeMaximumNumberOfStreamableRegions() const
+{
+  int64_t i64RegionWidth = 0, i64RegionHeight = 0;
+
+  if (!ComputeMinimumStreamableRegionSize(i64RegionWidth, i64RegionHeight))
+    return -1;
+
+  int64_t i64X = 0, i64Y = 0, i64Width = 0, i64Height = 0;
+
+  if (!GetLevelExtent(m_Level, i64X, i64Y, i64Width, i64Height))
+    return -1;
+
+  // NOTE: The width and height are multiplies of region width and height
+  return (i64Width / i64RegionWidth) * (i64Height / i64RegionHeight);
+}
+
+int64_t
+OpenSlideWrapper::ComputeMaximumNumberOfStreamableRegions(int64_t i64X,
+                                                          int64_t i64Y,
+                                                          int64_t i64Width,
+                                                          int64_t i64Height) const
+{
+  int64_t i64ImageX = 0, i64ImageY = 0, i64ImageWidth = 0, i64ImageHeight = 0;
+
+  if (!GetLevelExtent(m_Level, i64ImageX, i64ImageY, i64ImageWidth, i64ImageHeight))
+    return -1;
+
+  if (!AlignReadRegion(i64X, i64Y, i64Width, i64Height))
+    return -1;
+
+  return (i64ImageWidth + i64Width - 1) / i64Width * (i64ImageHeight + i64Height - 1) / i64Height;
+}
+
+bool
+OpenSlideWrapper::AlignReadRegion(int64_t & i64X, int64_t & i64Y, int64_t & i64Width, int64_t & i64Height) const
+{
+  if (!m_HasHeader)
+    return false;
+
+  if (m_Level == 0 || m_ApproximateStreaming) // Nothing to do
+    return true;
+
+  int64_t i64MinWidth = 0, i64MinHeight = 0;
+
+  if (!ComputeMinimumStreamableRegionSize(i64MinWidth, i64MinHeight))
+    return false;
+
+  int64_t i64XUpper = i64X + i64Width;
+  int64_t i64YUpper = i64Y + i64Height;
+
+  // Align X and Y to be on the grid with spacing MinWidth and MinHeight
+  int64_t r = (i64X % i64MinWidth);
+  i64X -= r;
+
+  r = (i64Y % i64MinHeight);
+  i64Y -= r;
+
+  // Align the upper coordinates (remove remainder and add one full spacing)
+  r = (i64XUpper % i64MinWidth);
+  if (r != 0)
+    i64XUpper += i64MinWidth - r;
+
+  r = (i64YUpper % i64MinHeight);
+  if (r != 0)
+    i64YUpper += i64MinHeight - r;
+
+  // Update width and height
+  i64Width = i64XUpper - i64X;
+  i64Height = i64YUpper - i64Y;
+
+  return true;
+}
+
+bool
+OpenSlideWrapper::GetCacheTileSize(int32_t i32Level, int64_t & i64TileWidth, int64_t & i64TileHeight) const
+{
+  int64_t i64MinWidth = 0, i64MinHeight = 0;
+  if (!ComputeMinimumStreamableRegionSize(i32Level, i64MinWidth, i64MinHeight))
+    return false;
+
+  if (!GetLevelTileSize(i32Level, i64TileWidth, i64TileHeight))
+    i64TileWidth = i64TileHeight = 256;
+
+  // Round up to the streamable grid and give up on levels that are hardly streamable
+  i64TileWidth = (i64TileWidth + i64MinWidth - 1) / i64MinWidth * i64MinWidth;
+  i64TileHeight = (i64TileHeight + i64MinHeight - 1) / i64MinHeight * i64MinHeight;
+
+  return i64TileWidth <= 4096 && i64TileHeight <= 4096;
+}
+
+const char *
+OpenSlideWrapper::ReadCachedRegion(uint32_t * p_ui32Dest,
+                                   int32_t    i32Level,
+                                   int64_t    i64TileWidth,
+                                   int64_t    i64TileHeight,
+                                   double     dDownsampleFactor,
+                                   int64_t    i64X,
+                                   int64_t    i64Y,
+                                   int64_t    i64Width,
+                                   int64_t    i64Height) const
+{
+  std::vector<uint32_t> vTile(i64TileWidth * i64TileHeight);
+
+  const int64_t i64FirstTileX = FloorDivide(i64X, i64TileWidth);
+  const int64_t i64FirstTileY = FloorDivide(i64Y, i64TileHeight);
+  const int64_t i64LastTileX = FloorDivide(i64X + i64Width - 1, i64TileWidth);
+  const int64_t i64LastTileY = FloorDivide(i64Y + i64Height - 1, i64TileHeight);
+
+  for (int64_t i64TileY = i64FirstTileY; i64TileY <= i64LastTileY; ++i64TileY)
+  {
+    for (int64_t i64TileX = i64FirstTileX; i64TileX <= i64LastTileX; ++i64TileX)
+    {
+      const int64_t i64TileLeft = i64TileX * i64TileWidth;
+      const int64_t i64TileTop = i64TileY * i64TileHeight;
+
+      if (!m_TileCache.Load(i32Level, i64TileWidth, i64TileHeight, i64TileX, i64TileY, vTile.data()))
+      {
+        if (!EnsureOpened())
+          return GetError();
+
+        openslide_read_region(m_Osr,
+                              vTile.data(),
+                              (int64_t)(i64TileLeft * dDownsampleFactor),
+                              (int64_t)(i64TileTop * dDownsampleFactor),
+                              i32Level,
+                              i64TileWidth,
+                              i64TileHeight);
+
+        const char * const p_cError = openslide_get_error(m_Osr);
+        if (p_cError != NULL)
+          return p_cError;
+
+        m_TileCache.Store(i32Level, i64TileWidth, i64TileHeight, i64TileX, i64TileY, vTile.data());
+      }
+
+      // Copy the part of the tile inside the region
+      const int64_t i64Left = std::max(i64X, i64TileLeft);
+      const int64_t i64Right = std::min(i64X + i64Width, i64TileLeft + i64TileWidth);
+      const int64_t i64Top = std::max(i64Y, i64TileTop);
+      const int64_t i64Bottom = std::min(i64Y + i64Height, i64TileTop + i64TileHeight);
+
+      for (int64_t y = i64Top; y < i64Bottom; ++y)
+      {
+        std::copy(vTile.begin() + (y - i64TileTop) * i64TileWidth + (i64Left - i64TileLeft),
+                  vTile.begin() + (y - i64TileTop) * i64TileWidth + (i64Right - i64TileLeft),
+                  p_ui32Dest + (y - i64Y) * i64Width + (i64Left - i64X));
+      }
+    }
+  }
+
+  return NULL;
+}
+
+int64_t
+OpenSlideWrapper::FloorDivide(int64_t i64A, int64_t i64B)
+{
+  return i64A >= 0 ? i64A / i64B : -((-i64A + i64B - 1) / i64B);
+}
+
+void
+OpenSlideWrapper::LoadHeader()
+{
+  m_Header.Clear();
+
+  const char * const p_cVendor = openslide_get_property_value(m_Osr, OPENSLIDE_PROPERTY_NAME_VENDOR);
+  if (p_cVendor != NULL)
+    m_Header.m_Vendor = p_cVendor;
+
+  const int32_t i32LevelCount = openslide_get_level_count(m_Osr);
+  for (int32_t i = 0; i < i32LevelCount; ++i)
+  {
+    int64_t i64Width = 0, i64Height = 0;
+    openslide_get_level_dimensions(m_Osr, i, &i64Width, &i64Height);
+
+    m_Header.m_LevelWidths.push_back(i64Width);
+    m_Header.m_LevelHeights.push_back(i64Height);
+    m_Header.m_LevelDownsamples.push_back(openslide_get_level_downsample(m_Osr, i));
+  }
+
+  const char * const * p_cNames = openslide_get_property_names(m_Osr);
+  if (p_cNames != NULL)
+  {
+    for (int i = 0; p_cNames[i] != NULL; ++i)
+    {
+      const char * const p_cValue = openslide_get_property_value(m_Osr, p_cNames[i]);
+      if (p_cValue != NULL)
+        m_Header.m_Properties[p_cNames[i]] = p_cValue;
+    }
+  }
+
+  p_cNames = openslide_get_associated_image_names(m_Osr);
+  if (p_cNames != NULL)
+  {
+    for (int i = 0; p_cNames[i] != NULL; ++i)
+    {
+      int64_t i64Width = 0, i64Height = 0;
+      openslide_get_associated_image_dimensions(m_Osr, p_cNames[i], &i64Width, &i64Height);
+
+      m_Header.m_AssociatedImageNames.push_back(p_cNames[i]);
+      m_Header.m_AssociatedImageWidths.push_back(i64Width);
+      m_Header.m_AssociatedImageHeights.push_back(i64Height);
+    }
+  }
+
+  m_HasHeader = openslide_get_error(m_Osr) == NULL;
+}
+
+} // end namespace itk
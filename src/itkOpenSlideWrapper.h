@@ -0,0 +1,409 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkOpenSlideWrapper_h
+#define itkOpenSlideWrapper_h
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "itkMetaDataDictionary.h"
+#include "itkOpenSlideHeaderCache.h"
+#include "itkOpenSlideTiffTiles.h"
+#include "itkOpenSlideTileCache.h"
+
+// OpenSlide (only needed by itkOpenSlideWrapper.cxx)
+typedef struct _openslide openslide_t;
+
+namespace itk
+{
+
+// OpenSlide wrapper class
+// This is responsible for freeing the OpenSlide context on destruction
+// It also allows for seamless access to various levels and associated images through one set of functions (as opposed
+// to two)
+class OpenSlideWrapper
+{
+public:
+  // GCD Algorithm from wikipedia pseudo code:
+  // https://en.wikipedia.org/wiki/Greatest_common_divisor#Binary_method
+  //
+  // NOTE: While vnl_rational can do this too, vnl_rational is defined for long integers (32 bit integers on amd64).
+  //       Slides can be extremely large. It would ideal to work with 64 bit integers.
+  static uint64_t
+  GCD(uint64_t ui64A, uint64_t ui64B);
+
+  // Detects the vendor. Should return NULL if the file is not readable.
+  static const char *
+  DetectVendor(const char * p_cFileName);
+
+  // Weak check if the file can be read
+  static bool
+  CanReadFile(const char * p_cFileName);
+
+  // Returns version of OpenSlide library
+  static const char *
+  GetVersion();
+
+  // Constructors
+  OpenSlideWrapper();
+
+  OpenSlideWrapper(const char * p_cFileName);
+
+  // Destructor
+  ~OpenSlideWrapper();
+
+  // Set whether streaming should be approximate or exact
+  void
+  SetApproximateStreaming(bool bApproximateStreaming);
+
+  // Determine whether streaming is exact or approximate
+  bool
+  GetApproximateStreaming() const;
+
+  // Set whether level images are restricted to the bounds of the scanned area (openslide.bounds-* properties)
+  void
+  SetUseBounds(bool bUseBounds);
+
+  // Determine whether level images are restricted to the bounds of the scanned area
+  bool
+  GetUseBounds() const;
+
+  // Retrieves the level 0 bounding box of the scanned area. Returns false if the slide does not report it.
+  bool
+  GetBounds(int64_t & i64X, int64_t & i64Y, int64_t & i64Width, int64_t & i64Height) const;
+
+  // Tells the ImageIO if the wrapper is in a state where stream reading can occur.
+  // While OpenSlide supports reading regions of level images, it does not for associated images.
+  bool
+  CanStreamRead() const;
+
+  // Closes the currently opened file
+  void
+  Close();
+
+  // Closes the openslide_t context and the TIFF tiles but keeps the header. They are opened again on the next read.
+  // This must not be called concurrently with reads.
+  void
+  ReleaseContext();
+
+  // Returns direct access to the compressed tiles, reading their layout on first use (NULL if the slide is not read
+  // from tiled TIFF directories). This is safe to call concurrently.
+  const OpenSlideTiffTiles *
+  GetTiffTiles() const;
+
+  // Set whether JPEG tiles of TIFF-based slides are decoded directly instead of by OpenSlide
+  void
+  SetDirectTileDecoding(bool bDirectTileDecoding);
+
+  // Determine whether JPEG tiles of TIFF-based slides are decoded directly
+  bool
+  GetDirectTileDecoding() const;
+
+  // Returns the number of tiles decoded directly since the slide was opened
+  uint64_t
+  GetNumberOfDirectlyDecodedTiles() const;
+
+  // Decodes a region of the given level straight from the JPEG tiles of a TIFF-based slide, bypassing OpenSlide.
+  // The coordinates are relative to the level extent (see GetLevelExtent()). Returns false if direct decoding is off
+  // or does not support the level (p_vDest is not touched then). Otherwise sets p_cError (NULL for success).
+  // This is safe to call concurrently like ReadLevelRegion().
+  bool
+  DecodeLevelRegion(void *                  p_vDest,
+                    OpenSlideTileFormatEnum eFormat,
+                    int32_t                 i32Level,
+                    int64_t                 i64X,
+                    int64_t                 i64Y,
+                    int64_t                 i64Width,
+                    int64_t                 i64Height,
+                    const char *&           p_cError) const;
+
+  // Enables the persistent tile cache for the opened slide (an empty directory disables it)
+  bool
+  SetTileCache(const std::string & strDirectory, uint64_t ui64MaximumBytes);
+
+  const OpenSlideTileCache &
+  GetTileCache() const;
+
+  // Checks weather a slide file is currently opened
+  // NOTE: When the header came from the header cache, the openslide_t context is only created on the first read.
+  bool
+  IsOpened() const;
+
+  // Opens a slide file
+  bool
+  Open(const char * p_cFileName);
+
+  // Opens a slide file using the header cache in the given directory.
+  // On a cache hit, the slide itself is not opened until pixels are read.
+  // On a cache miss, the slide is opened and its header is added to the cache.
+  bool
+  Open(const char * p_cFileName, const std::string & strHeaderCacheDirectory);
+
+  // Creates the openslide_t context if the header was loaded from the cache.
+  // This is safe to call concurrently.
+  bool
+  EnsureOpened() const;
+
+  // Get error string, NULL if there is no error
+  const char *
+  GetError() const;
+
+  // Returns the vendor recorded in the header (empty string if no file is opened)
+  std::string
+  GetVendor() const;
+
+  // Sets the level that is accessible with ReadRegion, GetDimensions, GetSpacing.
+  // Clears any associated image context.
+  void
+  SetLevel(int32_t i32Level);
+
+  // Returns the currently selected level
+  int32_t
+  GetLevel() const;
+
+  // Sets the associated image that is accessible with ReadRegion, GetDimensions
+  void
+  SetAssociatedImageName(const std::string & strImageName);
+
+  // Returns the currently selected associated image
+  const std::string &
+  GetAssociatedImageName() const;
+
+  // Given a downsample factor, determine the best level to use.
+  // This follows openslide_get_best_level_for_downsample() but works from the header.
+  int32_t
+  GetBestLevelForDownsample(double dDownsample) const;
+
+  // Given a downsample factor, determine the best level to use and select it.
+  bool
+  SetBestLevelForDownsample(double dDownsample);
+
+  // Returns the downsample factor of the given level (-1 on failure)
+  double
+  GetLevelDownsample(int32_t i32Level) const;
+
+  // Returns the dimensions of the given associated image (regardless of the selected level or associated image)
+  bool
+  GetAssociatedImageDimensions(const std::string & strImageName, int64_t & i64Width, int64_t & i64Height) const;
+
+  // Returns the number of levels in this file
+  int32_t
+  GetLevelCount() const;
+
+  // Returns NULL for success
+  // NOTE: When reading associated images, x, y, width and height are ignored.
+  const char *
+  ReadRegion(uint32_t * p_ui32Dest, int64_t i64X, int64_t i64Y, int64_t i64Width, int64_t i64Height) const;
+
+  // Reads the given associated image (regardless of the selected level or associated image). Returns NULL for success.
+  // This can be called concurrently like ReadLevelRegion().
+  const char *
+  ReadAssociatedImage(const std::string & strImageName, uint32_t * p_ui32Dest) const;
+
+  // Reads a region of the given level. Returns NULL for success.
+  // The coordinates are relative to the level extent (see GetLevelExtent()).
+  // This only touches the immutable openslide_t context (which OpenSlide guarantees to be thread safe) and not the
+  // selected level or associated image. So it can be called concurrently as long as the file is not reopened or closed.
+  const char *
+  ReadLevelRegion(uint32_t * p_ui32Dest,
+                  int32_t     i32Level,
+                  int64_t     i64X,
+                  int64_t     i64Y,
+                  int64_t     i64Width,
+                  int64_t     i64Height) const;
+
+  // Computes the mean and standard deviation of the l-alpha-beta channels of the tissue in the lowest resolution
+  // level. Transparent and near white (background) pixels are skipped. Returns false if there is no tissue.
+  bool
+  ComputeLabStatistics(double a_dMean[3], double a_dStdDev[3]) const;
+
+  // Estimates the hematoxylin and eosin stain vectors of the tissue in the lowest resolution level with Macenko's
+  // method (see OpenSlidePixelConverter::EstimateMacenkoStains()). Returns false if there is too little tissue.
+  bool
+  EstimateMacenkoStains(double a_dStains[9]) const;
+
+  // Computes the spacing depending on selected level
+  // Default spacing is relative to 1 MPP if the function fails to detect spacing information (downsample factor is
+  // considered)
+  bool
+  GetSpacing(double & dSpacingX, double & dSpacingY) const;
+
+  // Computes the spacing of the given level (regardless of the selected level or associated image)
+  bool
+  GetLevelSpacing(int32_t i32Level, double & dSpacingX, double & dSpacingY) const;
+
+  // Returns the dimension of the level or associated image
+  bool
+  GetDimensions(int64_t & i64Width, int64_t & i64Height) const;
+
+  // Computes the physical origin depending on selected level (non-zero only when restricted to bounds)
+  void
+  GetOrigin(double & dOriginX, double & dOriginY) const;
+
+  // Returns the region of the given level that is exposed in level coordinates.
+  // This is the whole level unless bounds are used and the slide reports them. In that case the region is the
+  // bounding box of the scanned area, enlarged to lie on the grid of exactly streamable regions.
+  bool
+  GetLevelExtent(int32_t i32Level, int64_t & i64X, int64_t & i64Y, int64_t & i64Width, int64_t & i64Height) const;
+
+  // Returns the dimension of the given level (regardless of the selected level or associated image)
+  bool
+  GetLevelDimensions(int32_t i32Level, int64_t & i64Width, int64_t & i64Height) const;
+
+  // Retrieves associated image names from the open slide and places them into a std::vector
+  std::vector<std::string>
+  GetAssociatedImageNames() const;
+
+  // Forms an ITK MetaDataDictionary
+  MetaDataDictionary
+  GetMetaDataDictionary() const;
+
+  // Templated functions for accessing and casting property values
+  template <typename ValueType>
+  bool
+  GetPropertyValue(const char * p_cKey, ValueType & value) const
+  {
+    std::string strValue;
+    if (!GetPropertyValue(p_cKey, strValue))
+      return false;
+
+    std::stringstream valueStream;
+
+    valueStream << strValue;
+    valueStream >> value;
+
+    return !valueStream.fail() && !valueStream.bad();
+  }
+
+  bool
+  GetPropertyValue(const char * p_cKey, std::string & strValue) const;
+
+  // Compute the minimum streamable region size
+  // Explanation:
+  // OpenSlide expects level 0 coordinates in openslide_read_region(). This is OK if we're reading level 0 images.
+  // However, if we're reading level L images with L > 0, this becomes problematic. This can be seen with a little math.
+  // First, note the equation relating level 0 and level L coordinates:
+  //
+  // x_0 = D * x_L
+  //
+  // Here D is the downsample factor and is a real number (openslide_get_level_downsample() returns double).
+  // From OpenSlide's source code, OpenSlide downsamples x_0 to x_L with a floor operation:
+  //
+  // x_L = floor(x_0 / D)
+  //
+  // Likewise, OpenSlide upsamples x_0 with a floor operation
+  //
+  // x_0 = floor(x_L * D)
+  //
+  // In this implementation, ITK works with coordinates at the selected level. When L > 0, it becomes challenging
+  // to pick coordinates x_0 that identify x_L exactly. We derive x_0 by upsampling as above. But several values of x_0
+  // will map to x_L. We need to pick x_L so that it is invariant to an upsample and subsequent downsample. In math we
+  // want x_L so that:
+  //
+  // x_L = Downsample(Upsample(x_L)) = floor(floor(x_L * D) / D)
+  //
+  // D is known to be a rational number A/B since it is computed by dividing the dimensions of level 0 and level L
+  // images. If A/B is a reduced fraction, we would like to determine x_L so that it is divisible by B. When B divides
+  // x_L we have the identity:
+  //
+  // Upsample(x_L) = D * x_L
+  //
+  // A subsequent downsample gives:
+  //
+  // Downsample(D * x_L) = x_L
+  //
+  // Which is what we wanted. Consequently, if dimensions are coprime, the image cannot technically be streamed.
+  // In that case the ImageIORegion would reflect entire level L image.
+  // This wrapper also supports approximate streaming (ignoring this issue).
+  bool
+  ComputeMinimumStreamableRegionSize(int64_t & i64Width, int64_t & i64Height) const;
+
+  bool
+  ComputeMinimumStreamableRegionSize(int32_t i32Level, int64_t & i64Width, int64_t & i64Height) const;
+
+  // Returns the native tile size of the given level (OpenSlide 3.4 and newer report it as a property)
+  bool
+  GetLevelTileSize(int32_t i32Level, int64_t & i64Width, int64_t & i64Height) const;
+
+  // Compute absolute maximum number of streamable regions
+  int64_t
+  ComputeMaximumNumberOfStreamableRegions() const;
+
+  // After alignment, what's the maximum number of streamable regions of this size?
+  int64_t
+  ComputeMaximumNumberOfStreamableRegions(int64_t i64X, int64_t i64Y, int64_t i64Width, int64_t i64Height) const;
+
+  // Align X, Y and region dimensions to be on the grid of points invariant to upsample/downsample
+  bool
+  AlignReadRegion(int64_t & i64X, int64_t & i64Y, int64_t & i64Width, int64_t & i64Height) const;
+
+private:
+  mutable openslide_t *      m_Osr;
+  mutable std::mutex         m_OpenMutex;
+  std::string                m_FileName;
+  OpenSlideHeader            m_Header;
+  bool                       m_HasHeader;
+  int32_t                    m_Level;
+  std::string                m_AssociatedImage;
+  bool                       m_ApproximateStreaming;
+  bool                       m_UseBounds;
+  OpenSlideTileCache         m_TileCache;
+  mutable OpenSlideTiffTiles m_TiffTiles;
+  mutable std::mutex         m_TiffTilesMutex;
+  mutable bool               m_TiffTilesChecked;
+  mutable bool               m_HasTiffTiles;
+  bool                       m_DirectTileDecoding;
+
+  // Returns the size of the tiles the tile cache stores for the given level (false if the level is not cached).
+  // Each tile must be an exactly streamable region, so reading it gives the same pixels as reading a larger region.
+  bool
+  GetCacheTileSize(int32_t i32Level, int64_t & i64TileWidth, int64_t & i64TileHeight) const;
+
+  // Reads a region (in level coordinates, including the extent offset) tile by tile through the tile cache.
+  // The slide is only opened if a tile is missing.
+  const char *
+  ReadCachedRegion(uint32_t * p_ui32Dest,
+                   int32_t    i32Level,
+                   int64_t    i64TileWidth,
+                   int64_t    i64TileHeight,
+                   double     dDownsampleFactor,
+                   int64_t    i64X,
+                   int64_t    i64Y,
+                   int64_t    i64Width,
+                   int64_t    i64Height) const;
+
+  // Calls clFunction for the ARGB pixels of the tissue in the lowest resolution level (read in strips). Transparent
+  // and near white (background) pixels are skipped. Returns false if the level cannot be read.
+  bool
+  ForEachTissuePixel(const std::function<void(uint32_t)> & clFunction) const;
+
+  static int64_t
+  FloorDivide(int64_t i64A, int64_t i64B);
+
+  // Gathers everything queried by the ImageIO from the openslide_t context
+  void
+  LoadHeader();
+};
+
+} // end namespace itk
+
+#endif // itkOpenSlideWrapper_h
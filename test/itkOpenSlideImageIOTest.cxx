@@ -86,7 +86,9 @@ itkOpenSlideImageIOTest(int argc, char * argv[])
   bool         bShouldFail = false;
   bool         bUseCompression = false;
   bool         bApproximateStreaming = false;
+  bool         bUseBounds = false;
   unsigned int uiNumStreams = 0; // 0 means no streaming
+  uint64_t     ui64MemoryBudget = 0; // 0 means no budget
   int          iLevel = 0;
   std::string  strAssociatedImageName;
   double       dDownsampleFactor = 0.0; // 0 means no down sample
@@ -114,6 +116,10 @@ itkOpenSlideImageIOTest(int argc, char * argv[])
     {
       bApproximateStreaming = true;
     }
+    else if (strCommand == "useBounds")
+    {
+      bUseBounds = true;
+    }
     else if (strCommand == "level")
     {
       if (strValue.empty())
@@ -172,6 +178,22 @@ itkOpenSlideImageIOTest(int argc, char * argv[])
         return EXIT_FAILURE;
       }
     }
+    else if (strCommand == "memoryBudget")
+    {
+      if (strValue.empty())
+      {
+        std::cerr << "Error: Expected memory budget." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      char * p = NULL;
+      ui64MemoryBudget = strtoull(strValue.c_str(), &p, 10);
+      if (*p != '\0')
+      {
+        std::cerr << "Error: Could not parse memory budget '" << strValue << "'." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
     else
     {
       std::cout << "Error: Unknown command '" << argv[i] << "'." << std::endl;
@@ -188,7 +210,9 @@ itkOpenSlideImageIOTest(int argc, char * argv[])
   std::cout << "shouldFail = " << std::boolalpha << bShouldFail << std::endl;
   std::cout << "compress = " << std::boolalpha << bUseCompression << std::endl;
   std::cout << "approximateStreaming = " << std::boolalpha << bApproximateStreaming << std::endl;
+  std::cout << "useBounds = " << std::boolalpha << bUseBounds << std::endl;
   std::cout << "stream = " << uiNumStreams << std::endl;
+  std::cout << "memoryBudget = " << ui64MemoryBudget << std::endl;
   std::cout << "level = " << iLevel << std::endl;
   std::cout << "associatedImage = '" << strAssociatedImageName << '\'' << std::endl;
   std::cout << "downsample = " << dDownsampleFactor << std::endl;
@@ -223,6 +247,52 @@ itkOpenSlideImageIOTest(int argc, char * argv[])
   if (dDownsampleFactor > 0.0 && !p_clImageIO->SetLevelForDownsampleFactor(dDownsampleFactor))
     return iFailCode;
 
+  if (bUseBounds)
+  {
+    p_clImageIO->SetUseBounds(true);
+
+    try
+    {
+      p_clImageIO->ReadImageInformation();
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return iFailCode;
+    }
+
+    std::cout << "Pixels skipped by bounds = " << p_clImageIO->GetNumberOfPixelsSkippedByBounds() << std::endl;
+  }
+
+  if (ui64MemoryBudget > 0)
+  {
+    try
+    {
+      p_clImageIO->ReadImageInformation();
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return iFailCode;
+    }
+
+    // The writer streams, so the reader's output is all that is kept per pixel
+    ReaderIOType::SizeValueType pieceWidth = 0, pieceHeight = 0, numberOfPieces = 0;
+
+    p_clImageIO->SetMemoryBudget(ui64MemoryBudget);
+    if (!p_clImageIO->ComputeStreamingPlan(0.0, pieceWidth, pieceHeight, numberOfPieces))
+      return iFailCode;
+
+    // The writer cuts its stream divisions into strips, which must also keep within the budget
+    uiNumStreams = (unsigned int)p_clImageIO->ComputeNumberOfStreamDivisions(0.0);
+
+    std::cout << "Streaming plan = " << numberOfPieces << " pieces of " << pieceWidth << " x " << pieceHeight << ", "
+              << uiNumStreams << " stream divisions" << std::endl;
+
+    if (uiNumStreams == 0)
+      return iFailCode;
+  }
+
   if (uiNumStreams > 0)
   {
     if (!p_clImageIO->CanStreamRead())
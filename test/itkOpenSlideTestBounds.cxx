@@ -0,0 +1,263 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+#include "itksys/Directory.hxx"
+#include "itksys/SystemTools.hxx"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+using PixelType = itk::RGBAPixel<unsigned char>;
+
+// None of the test slides reports bounds, so they are added to the header cache entry of the slide
+bool
+AddBoundsToHeaderCache(const std::string & strCacheDirectory, const int64_t a_i64Bounds[4])
+{
+  itksys::Directory clDirectory;
+  if (!clDirectory.Load(strCacheDirectory))
+    return false;
+
+  for (unsigned long i = 0; i < clDirectory.GetNumberOfFiles(); ++i)
+  {
+    const std::string strFileName = strCacheDirectory + '/' + clDirectory.GetFile(i);
+
+    if (itksys::SystemTools::GetFilenameLastExtension(strFileName) != ".oshdr")
+      continue;
+
+    std::vector<std::string> vLines;
+    {
+      std::ifstream cacheStream(strFileName.c_str(), std::ios::binary);
+      std::string   strLine;
+
+      while (std::getline(cacheStream, strLine))
+        vLines.push_back(strLine);
+    }
+
+    if (vLines.empty() || vLines.back() != "end")
+      return false;
+
+    static const char * const a_cNames[4] = { "x", "y", "width", "height" };
+
+    std::ofstream cacheStream(strFileName.c_str(), std::ios::binary | std::ios::trunc);
+    for (size_t j = 0; j + 1 < vLines.size(); ++j)
+      cacheStream << vLines[j] << '\n';
+
+    for (int j = 0; j < 4; ++j)
+      cacheStream << "property\topenslide.bounds-" << a_cNames[j] << '\t' << a_i64Bounds[j] << '\n';
+
+    cacheStream << "end\n";
+
+    return !cacheStream.fail();
+  }
+
+  return false;
+}
+
+// Checks the extent of the selected level against the level 0 bounds and compares a region of it with the same
+// region of the unbounded level
+bool
+CheckLevel(ImageIOType * p_clBoundedIO, ImageIOType * p_clFullIO, int iLevel, const int64_t a_i64Bounds[4])
+{
+  p_clBoundedIO->SetLevel(iLevel);
+  p_clBoundedIO->ReadImageInformation();
+
+  ImageIOType::SizeValueType fullWidth = 0, fullHeight = 0;
+  p_clFullIO->GetLevelDimensions(iLevel, fullWidth, fullHeight);
+
+  const double             dDownsample = p_clFullIO->GetLevelDownsample(iLevel);
+  const itk::ImageIORegion clGrid = p_clBoundedIO->GetMinimumStreamableRegion();
+  const int64_t            a_i64Full[2] = { (int64_t)fullWidth, (int64_t)fullHeight };
+
+  int64_t a_i64Offset[2] = { 0, 0 };
+
+  for (unsigned int d = 0; d < 2; ++d)
+  {
+    // The origin is the physical position of the extent in the level
+    const double  dOffset = p_clBoundedIO->GetOrigin(d) / p_clBoundedIO->GetSpacing(d);
+    const int64_t i64Lower = (int64_t)std::floor(dOffset + 0.5);
+    const int64_t i64Upper = i64Lower + (int64_t)p_clBoundedIO->GetDimensions(d);
+    const int64_t i64Step = (int64_t)clGrid.GetSize(d);
+
+    const int64_t i64BoundsLower = (int64_t)std::floor(a_i64Bounds[d] / dDownsample);
+    const int64_t i64BoundsUpper =
+      std::min(a_i64Full[d], (int64_t)std::ceil((a_i64Bounds[d] + a_i64Bounds[d + 2]) / dDownsample));
+
+    std::cout << "Level " << iLevel << " dimension " << d << ": extent [" << i64Lower << ", " << i64Upper
+              << "), bounds [" << i64BoundsLower << ", " << i64BoundsUpper << "), grid " << i64Step << std::endl;
+
+    if (std::fabs(dOffset - i64Lower) > 1e-6)
+    {
+      std::cerr << "Error: The origin is not on a pixel of level " << iLevel << "." << std::endl;
+      return false;
+    }
+
+    if (i64Lower > i64BoundsLower || i64Upper < i64BoundsUpper || i64Lower < 0 || i64Upper > a_i64Full[d])
+    {
+      std::cerr << "Error: The extent of level " << iLevel << " does not cover the bounds." << std::endl;
+      return false;
+    }
+
+    // The extent is the smallest one on the grid of exactly streamable regions
+    if (i64Step <= 0 || i64Lower % i64Step != 0 || (i64Upper % i64Step != 0 && i64Upper != a_i64Full[d]) ||
+        i64Lower + i64Step <= i64BoundsLower || i64Upper - i64Step >= i64BoundsUpper)
+    {
+      std::cerr << "Error: The extent of level " << iLevel << " is not snapped to the grid." << std::endl;
+      return false;
+    }
+
+    a_i64Offset[d] = i64Lower;
+  }
+
+  const uint64_t ui64Skipped =
+    (uint64_t)a_i64Full[0] * a_i64Full[1] - (uint64_t)p_clBoundedIO->GetDimensions(0) * p_clBoundedIO->GetDimensions(1);
+
+  std::cout << "Level " << iLevel
+            << ": pixels skipped by bounds = " << p_clBoundedIO->GetNumberOfPixelsSkippedByBounds() << std::endl;
+
+  if (p_clBoundedIO->GetNumberOfPixelsSkippedByBounds() != ui64Skipped)
+  {
+    std::cerr << "Error: Expected " << ui64Skipped << " pixels skipped by bounds." << std::endl;
+    return false;
+  }
+
+  // Level 0 is always on the grid, so its bounds must skip pixels
+  if (iLevel == 0 && ui64Skipped == 0)
+  {
+    std::cerr << "Error: No pixels skipped by bounds." << std::endl;
+    return false;
+  }
+
+  // Pixel (0, 0) of the extent is pixel (offset x, offset y) of the level, with ReadRegion() and Read()
+  const itk::SizeValueType width = std::min<itk::SizeValueType>(256, p_clBoundedIO->GetDimensions(0));
+  const itk::SizeValueType height = std::min<itk::SizeValueType>(256, p_clBoundedIO->GetDimensions(1));
+
+  itk::ImageIORegion clBoundedRegion(2), clFullRegion(2);
+  clBoundedRegion.SetSize(0, width);
+  clBoundedRegion.SetSize(1, height);
+  clFullRegion.SetIndex(0, a_i64Offset[0]);
+  clFullRegion.SetIndex(1, a_i64Offset[1]);
+  clFullRegion.SetSize(0, width);
+  clFullRegion.SetSize(1, height);
+
+  std::vector<PixelType> vBounded(width * height), vRead(width * height), vFull(width * height);
+
+  p_clBoundedIO->ReadRegion(iLevel, clBoundedRegion, &vBounded[0]);
+  p_clFullIO->ReadRegion(iLevel, clFullRegion, &vFull[0]);
+
+  p_clBoundedIO->SetIORegion(clBoundedRegion);
+  p_clBoundedIO->Read(&vRead[0]);
+
+  if (std::memcmp(&vBounded[0], &vFull[0], vFull.size() * sizeof(PixelType)) != 0 ||
+      std::memcmp(&vRead[0], &vFull[0], vFull.size() * sizeof(PixelType)) != 0)
+  {
+    std::cerr << "Error: Pixels of the extent of level " << iLevel << " differ from the level." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+} // End anonymous namespace
+
+// Restricts the levels to bounds that are added to the cached header of a slide without bounds and checks the
+// extents, origins, skipped pixels and pixels against the unbounded levels.
+int
+itkOpenSlideTestBounds(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile cacheDirectory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string strCacheDirectory = argv[2];
+
+  // Start from an empty cache so that the bounds are added exactly once
+  itksys::SystemTools::RemoveADirectory(strCacheDirectory);
+
+  ImageIOType::Pointer p_clFullIO = ImageIOType::New();
+  ImageIOType::Pointer p_clBoundedIO = ImageIOType::New();
+
+  p_clFullIO->SetFileName(argv[1]);
+  p_clBoundedIO->SetFileName(argv[1]);
+  p_clBoundedIO->SetHeaderCacheDirectory(strCacheDirectory);
+  p_clBoundedIO->SetUseBounds(true);
+
+  try
+  {
+    p_clFullIO->ReadImageInformation();
+    p_clBoundedIO->ReadImageInformation(); // Writes the header cache entry
+
+    if (p_clFullIO->GetNumberOfPixelsSkippedByBounds() != 0 || p_clBoundedIO->GetNumberOfPixelsSkippedByBounds() != 0)
+    {
+      std::cerr << "Error: Pixels skipped without bounds." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Odd bounds in the middle of level 0 that are not on the grid of the other levels
+    const int64_t a_i64Bounds[4] = { (int64_t)p_clFullIO->GetDimensions(0) / 5 + 3,
+                                     (int64_t)p_clFullIO->GetDimensions(1) / 4 + 7,
+                                     (int64_t)p_clFullIO->GetDimensions(0) / 2 + 1,
+                                     (int64_t)p_clFullIO->GetDimensions(1) / 3 + 5 };
+
+    if (!AddBoundsToHeaderCache(strCacheDirectory, a_i64Bounds))
+    {
+      std::cerr << "Error: Could not add bounds to the header cache." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (int iLevel = 0; iLevel < std::min(2, p_clFullIO->GetLevelCount()); ++iLevel)
+    {
+      if (!CheckLevel(p_clBoundedIO, p_clFullIO, iLevel, a_i64Bounds))
+        return EXIT_FAILURE;
+    }
+
+    // Without bounds the cached header gives the whole level again
+    p_clBoundedIO->SetUseBounds(false);
+    p_clBoundedIO->SetLevel(0);
+    p_clBoundedIO->ReadImageInformation();
+
+    if (p_clBoundedIO->GetDimensions(0) != p_clFullIO->GetDimensions(0) ||
+        p_clBoundedIO->GetDimensions(1) != p_clFullIO->GetDimensions(1) || p_clBoundedIO->GetOrigin(0) != 0.0 ||
+        p_clBoundedIO->GetOrigin(1) != 0.0 || p_clBoundedIO->GetNumberOfPixelsSkippedByBounds() != 0)
+    {
+      std::cerr << "Error: Turning bounds off does not give the whole level." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
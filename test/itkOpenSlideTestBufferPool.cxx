@@ -0,0 +1,183 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideBufferPool.h"
+#include "itkOpenSlideRegionReader.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads patches into pooled images and checks that buffers are recycled and the pixels match ReadPatch().
+int
+itkOpenSlideTestBufferPool(int argc, char * argv[])
+{
+  using PixelType = itk::RGBAPixel<unsigned char>;
+  using FloatPixelType = itk::RGBAPixel<float>;
+  using RegionReaderType = itk::OpenSlideRegionReader<PixelType>;
+  using FloatRegionReaderType = itk::OpenSlideRegionReader<FloatPixelType>;
+  using PoolType = itk::OpenSlideBufferPool;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const       p_cSlideFile = argv[1];
+  const itk::SizeValueType patchSize = 128;
+  const int                iNumPatches = 50;
+
+  PoolType::Pointer p_clPool = PoolType::New();
+  p_clPool->SetBufferSize(patchSize * patchSize * sizeof(FloatPixelType));
+
+  void * const p_Buffer = p_clPool->AcquireBuffer(100);
+  if (((uintptr_t)p_Buffer) % p_clPool->GetAlignment() != 0)
+  {
+    std::cerr << "Error: Buffer is not aligned." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  p_clPool->ReleaseBuffer(p_Buffer);
+
+  if (p_clPool->GetNumberOfFreeBuffers() != 1 || p_clPool->GetNumberOfBuffersInUse() != 0)
+  {
+    std::cerr << "Error: Released buffer is not free." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  RegionReaderType::Pointer      p_clReader = RegionReaderType::New();
+  FloatRegionReaderType::Pointer p_clFloatReader = FloatRegionReaderType::New();
+  std::vector<PixelType>         vPatch(patchSize * patchSize);
+
+  p_clReader->SetFileName(p_cSlideFile);
+  p_clReader->SetBufferPool(p_clPool);
+  p_clFloatReader->SetFileName(p_cSlideFile);
+  p_clFloatReader->SetBufferPool(p_clPool);
+
+  try
+  {
+    p_clReader->Open();
+    p_clFloatReader->Open();
+
+    p_clPool->ResetCounters();
+
+    // Each image returns its buffer before the next patch is read, so one buffer serves all of them
+    for (int i = 0; i < iNumPatches; ++i)
+    {
+      const itk::IndexValueType x = 37 * i, y = 23 * i;
+
+      RegionReaderType::ImagePointer p_clImage = p_clReader->ReadPatchImage(0, x, y, patchSize, patchSize);
+      p_clReader->ReadPatch(0, x, y, patchSize, patchSize, vPatch.data());
+
+      if (std::memcmp(p_clImage->GetBufferPointer(), vPatch.data(), vPatch.size() * sizeof(PixelType)) != 0)
+      {
+        std::cerr << "Error: Pooled patch " << i << " differs." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    std::cout << "Unsigned char: " << p_clPool->GetNumberOfAcquisitions() << " acquisitions, "
+              << p_clPool->GetNumberOfAllocations() << " allocations" << std::endl;
+
+    if (p_clPool->GetNumberOfAcquisitions() != iNumPatches || p_clPool->GetNumberOfAllocations() != 0 ||
+        p_clPool->GetNumberOfBuffersInUse() != 0)
+    {
+      std::cerr << "Error: Buffers were not recycled." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Float pixels also take a decode buffer from the pool
+    p_clPool->ResetCounters();
+
+    for (int i = 0; i < iNumPatches; ++i)
+    {
+      const itk::IndexValueType x = 41 * i, y = 19 * i;
+
+      FloatRegionReaderType::ImagePointer p_clImage = p_clFloatReader->ReadPatchImage(0, x, y, patchSize, patchSize);
+      p_clReader->ReadPatch(0, x, y, patchSize, patchSize, vPatch.data());
+
+      const FloatPixelType * const p_clPixels = p_clImage->GetBufferPointer();
+
+      for (size_t j = 0; j < vPatch.size(); ++j)
+      {
+        for (unsigned int c = 0; c < 4; ++c)
+        {
+          if (p_clPixels[j][c] != vPatch[j][c])
+          {
+            std::cerr << "Error: Pooled float patch " << i << " differs." << std::endl;
+            return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+
+    std::cout << "Float: " << p_clPool->GetNumberOfAcquisitions() << " acquisitions, "
+              << p_clPool->GetNumberOfAllocations() << " allocations" << std::endl;
+
+    if (p_clPool->GetNumberOfAcquisitions() != 2 * iNumPatches || p_clPool->GetNumberOfAllocations() != 1 ||
+        p_clPool->GetNumberOfBuffersInUse() != 0)
+    {
+      std::cerr << "Error: Buffers were not recycled." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Images that are alive hold their buffers
+    {
+      RegionReaderType::ImagePointer p_clImage1 = p_clReader->ReadPatchImage(0, 0, 0, patchSize, patchSize);
+      RegionReaderType::ImagePointer p_clImage2 = p_clReader->ReadPatchImage(0, 0, 0, patchSize, patchSize);
+      RegionReaderType::ImagePointer p_clImage3 = p_clReader->ReadPatchImage(0, 0, 0, patchSize, patchSize);
+
+      if (p_clPool->GetNumberOfBuffersInUse() != 3 || p_clPool->GetNumberOfAllocations() != 2)
+      {
+        std::cerr << "Error: Images do not hold their buffers." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    // Patches larger than the buffers are allocated normally
+    p_clPool->ResetCounters();
+    p_clReader->ReadPatchImage(0, 0, 0, 4 * patchSize, 2 * patchSize);
+
+    if (p_clPool->GetNumberOfAcquisitions() != 0 || p_clPool->GetNumberOfFreeBuffers() != 3)
+    {
+      std::cerr << "Error: Large patch was taken from the pool." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Free buffers no longer fit once buffers are backed by huge pages
+  p_clPool->SetUseHugePages(true);
+
+  if (p_clPool->GetNumberOfFreeBuffers() != 0 || p_clPool->GetNumberOfDeallocations() != 3)
+  {
+    std::cerr << "Error: Free buffers were not deallocated." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
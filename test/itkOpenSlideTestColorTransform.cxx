@@ -0,0 +1,337 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+using PixelType = itk::RGBAPixel<unsigned char>;
+
+bool
+ReadPatch(ImageIOType * p_clIO, const itk::ImageIORegion & clRegion, void * buffer)
+{
+  try
+  {
+    p_clIO->ReadImageInformation();
+    p_clIO->ReadRegion(0, clRegion, buffer);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Reinhard's transfer of RGB (0-255) from the source to the target l-alpha-beta statistics in double precision
+void
+TransferReinhard(const double a_dRGB[3],
+                 const double a_dSourceMean[3],
+                 const double a_dSourceStdDev[3],
+                 const double a_dTargetMean[3],
+                 const double a_dTargetStdDev[3],
+                 double       a_dResult[3])
+{
+  const double dLogL = std::log(std::max(0.3811 * a_dRGB[0] + 0.5783 * a_dRGB[1] + 0.0402 * a_dRGB[2], 1.0));
+  const double dLogM = std::log(std::max(0.1967 * a_dRGB[0] + 0.7244 * a_dRGB[1] + 0.0782 * a_dRGB[2], 1.0));
+  const double dLogS = std::log(std::max(0.0241 * a_dRGB[0] + 0.1288 * a_dRGB[1] + 0.8444 * a_dRGB[2], 1.0));
+
+  double a_dLab[3] = { (dLogL + dLogM + dLogS) / std::sqrt(3.0),
+                       (dLogL + dLogM - 2.0 * dLogS) / std::sqrt(6.0),
+                       (dLogL - dLogM) / std::sqrt(2.0) };
+
+  for (unsigned int c = 0; c < 3; ++c)
+    a_dLab[c] = (a_dLab[c] - a_dSourceMean[c]) * a_dTargetStdDev[c] / a_dSourceStdDev[c] + a_dTargetMean[c];
+
+  const double dL = a_dLab[0] / std::sqrt(3.0), dAlpha = a_dLab[1] / std::sqrt(6.0), dBeta = a_dLab[2] / std::sqrt(2.0);
+  const double dLMSL = std::exp(dL + dAlpha + dBeta);
+  const double dLMSM = std::exp(dL + dAlpha - dBeta);
+  const double dLMSS = std::exp(dL - 2.0 * dAlpha);
+
+  a_dResult[0] = std::min(255.0, std::max(0.0, 4.4679 * dLMSL - 3.5873 * dLMSM + 0.1193 * dLMSS));
+  a_dResult[1] = std::min(255.0, std::max(0.0, -1.2186 * dLMSL + 2.3809 * dLMSM - 0.1624 * dLMSS));
+  a_dResult[2] = std::min(255.0, std::max(0.0, 0.0497 * dLMSL - 0.2439 * dLMSM + 1.2045 * dLMSS));
+}
+
+} // End anonymous namespace
+
+// Checks that stain concentrations reproduce the optical densities of the pixels (with the default and the Macenko
+// stains), that Reinhard normalization to the slide's own statistics leaves the colors (almost) unchanged and that
+// Reinhard normalization to another target matches the transfer in double precision.
+int
+itkOpenSlideTestColorTransform(int argc, char * argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const p_cSlideFile = argv[1];
+  const size_t       patchSize = 128;
+
+  ImageIOType::Pointer p_clRefIO = ImageIOType::New();
+  p_clRefIO->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clRefIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t width = std::min<size_t>(patchSize, p_clRefIO->GetDimensions(0));
+  const size_t height = std::min<size_t>(patchSize, p_clRefIO->GetDimensions(1));
+  const size_t numPixels = width * height;
+
+  itk::ImageIORegion clRegion(2);
+  clRegion.SetIndex(0, (p_clRefIO->GetDimensions(0) - width) / 2);
+  clRegion.SetIndex(1, (p_clRefIO->GetDimensions(1) - height) / 2);
+  clRegion.SetSize(0, width);
+  clRegion.SetSize(1, height);
+
+  std::vector<PixelType> vReference(numPixels);
+
+  if (!ReadPatch(p_clRefIO, clRegion, &vReference[0]))
+    return EXIT_FAILURE;
+
+  // Stain deconvolution
+  {
+    ImageIOType::Pointer p_clStainIO = ImageIOType::New();
+    p_clStainIO->SetFileName(p_cSlideFile);
+    p_clStainIO->SetColorTransform(ImageIOType::ColorTransformEnum::StainDeconvolution);
+
+    // Unsigned char components must be rejected
+    bool bThrown = false;
+    try
+    {
+      p_clStainIO->ReadImageInformation();
+    }
+    catch (itk::ExceptionObject &)
+    {
+      bThrown = true;
+    }
+
+    if (!bThrown)
+    {
+      std::cerr << "Error: Stain deconvolution with unsigned char components did not throw." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    p_clStainIO->SetOutputComponentType(ImageIOType::OutputComponentEnum::Float);
+    p_clStainIO->SetOutputLayout(ImageIOType::OutputLayoutEnum::PlanarRGB);
+
+    std::vector<float> vStains(numPixels * 3);
+
+    if (!ReadPatch(p_clStainIO, clRegion, &vStains[0]))
+      return EXIT_FAILURE;
+
+    double a_dStains[9];
+    p_clStainIO->GetStainMatrix(a_dStains);
+
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        const double dOD = -std::log10(std::max<int>(vReference[i][k], 1) / 255.0);
+        double       dReconstructed = 0.0;
+
+        for (unsigned int s = 0; s < 3; ++s)
+          dReconstructed += vStains[s * numPixels + i] * a_dStains[3 * s + k];
+
+        if (std::fabs(dReconstructed - dOD) > 1e-3)
+        {
+          std::cerr << "Error: Stain concentrations do not reproduce the optical density of pixel " << i << " ("
+                    << dReconstructed << " != " << dOD << ")." << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+
+    // Also after ReadImageInformation(): the stains do not fit in unsigned char RGBA pixels
+    p_clStainIO->SetOutputComponentType(ImageIOType::OutputComponentEnum::UnsignedChar);
+    p_clStainIO->SetOutputLayout(ImageIOType::OutputLayoutEnum::RGBA);
+
+    std::vector<PixelType> vPixels(numPixels);
+
+    bThrown = false;
+    try
+    {
+      p_clStainIO->ReadRegion(0, clRegion, &vPixels[0]);
+    }
+    catch (itk::ExceptionObject &)
+    {
+      bThrown = true;
+    }
+
+    if (!bThrown)
+    {
+      std::cerr << "Error: Reading stains into unsigned char components did not throw." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Macenko stain estimation
+  {
+    ImageIOType::Pointer p_clMacenkoIO = ImageIOType::New();
+    p_clMacenkoIO->SetFileName(p_cSlideFile);
+    p_clMacenkoIO->SetColorTransform(ImageIOType::ColorTransformEnum::Macenko);
+    p_clMacenkoIO->SetOutputComponentType(ImageIOType::OutputComponentEnum::Float);
+    p_clMacenkoIO->SetOutputLayout(ImageIOType::OutputLayoutEnum::PlanarRGB);
+
+    double a_dDefaultStains[9];
+    p_clMacenkoIO->GetStainMatrix(a_dDefaultStains);
+
+    std::vector<float> vStains(numPixels * 3);
+
+    if (!ReadPatch(p_clMacenkoIO, clRegion, &vStains[0]))
+      return EXIT_FAILURE;
+
+    double a_dStains[9];
+    p_clMacenkoIO->GetStainMatrix(a_dStains);
+
+    std::cout << "Macenko hematoxylin = " << a_dStains[0] << ", " << a_dStains[1] << ", " << a_dStains[2]
+              << ", eosin = " << a_dStains[3] << ", " << a_dStains[4] << ", " << a_dStains[5] << std::endl;
+
+    if (std::equal(a_dStains, a_dStains + 9, a_dDefaultStains))
+    {
+      std::cerr << "Error: Macenko did not estimate the stains." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Both stains absorb in all channels and hematoxylin absorbs more red than eosin
+    for (unsigned int k = 0; k < 6; ++k)
+    {
+      if (a_dStains[k] <= 0.0)
+      {
+        std::cerr << "Error: Macenko stain vector component " << k << " is not positive." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (a_dStains[0] <= a_dStains[3])
+    {
+      std::cerr << "Error: Macenko stains are not ordered hematoxylin, eosin." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        const double dOD = -std::log10(std::max<int>(vReference[i][k], 1) / 255.0);
+        double       dReconstructed = 0.0;
+
+        for (unsigned int s = 0; s < 3; ++s)
+          dReconstructed += vStains[s * numPixels + i] * a_dStains[3 * s + k];
+
+        if (std::fabs(dReconstructed - dOD) > 1e-3)
+        {
+          std::cerr << "Error: Macenko stain concentrations do not reproduce the optical density of pixel " << i
+                    << " (" << dReconstructed << " != " << dOD << ")." << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  // Reinhard normalization to the slide's own statistics
+  {
+    ImageIOType::Pointer p_clReinhardIO = ImageIOType::New();
+    p_clReinhardIO->SetFileName(p_cSlideFile);
+    p_clReinhardIO->SetColorTransform(ImageIOType::ColorTransformEnum::Reinhard);
+
+    try
+    {
+      p_clReinhardIO->ReadImageInformation();
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    double a_dMean[3], a_dStdDev[3];
+    p_clReinhardIO->GetReinhardSource(a_dMean, a_dStdDev);
+    p_clReinhardIO->SetReinhardTarget(a_dMean, a_dStdDev);
+
+    std::cout << "Reinhard source mean = " << a_dMean[0] << ", " << a_dMean[1] << ", " << a_dMean[2]
+              << ", standard deviation = " << a_dStdDev[0] << ", " << a_dStdDev[1] << ", " << a_dStdDev[2] << std::endl;
+
+    std::vector<PixelType> vNormalized(numPixels);
+
+    if (!ReadPatch(p_clReinhardIO, clRegion, &vNormalized[0]))
+      return EXIT_FAILURE;
+
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+      for (unsigned int k = 0; k < 4; ++k)
+      {
+        if (std::abs((int)vNormalized[i][k] - (int)vReference[i][k]) > 3)
+        {
+          std::cerr << "Error: Identity Reinhard normalization changed pixel " << i << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+
+    // Reinhard normalization to another target
+    const double a_dTargetMean[3] = { 8.5, -0.1, 0.05 };
+    const double a_dTargetStdDev[3] = { 0.6, 0.12, 0.02 };
+    p_clReinhardIO->SetReinhardTarget(a_dTargetMean, a_dTargetStdDev);
+
+    if (!ReadPatch(p_clReinhardIO, clRegion, &vNormalized[0]))
+      return EXIT_FAILURE;
+
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+      if (vReference[i][3] == 0)
+        continue;
+
+      const double a_dRGB[3] = { (double)vReference[i][0], (double)vReference[i][1], (double)vReference[i][2] };
+      double       a_dExpected[3];
+      TransferReinhard(a_dRGB, a_dMean, a_dStdDev, a_dTargetMean, a_dTargetStdDev, a_dExpected);
+
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        if (std::fabs(vNormalized[i][k] - a_dExpected[k]) > 1.0)
+        {
+          std::cerr << "Error: Reinhard normalization of pixel " << i << " channel " << k << " is "
+                    << (int)vNormalized[i][k] << " instead of " << a_dExpected[k] << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
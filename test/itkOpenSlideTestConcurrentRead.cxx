@@ -0,0 +1,156 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkImageFileReader.h"
+#include "itkImage.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads random regions of one level from several threads sharing a single OpenSlideImageIO
+// and compares them against the level image read through the usual ImageFileReader path.
+int
+itkOpenSlideTestConcurrentRead(int argc, char * argv[])
+{
+  using PixelType = itk::RGBAPixel<unsigned char>;
+  using ImageType = itk::Image<PixelType, 2>;
+  using ImageIOType = itk::OpenSlideImageIO;
+  using ReaderType = itk::ImageFileReader<ImageType>;
+
+  if (argc < 2 || argc > 5)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile [level] [numberOfThreads] [readsPerThread]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const p_cSlideFile = argv[1];
+  const int          iLevel = argc > 2 ? atoi(argv[2]) : 0;
+  const unsigned int uiNumThreads = argc > 3 ? (unsigned int)atoi(argv[3]) : 8;
+  const unsigned int uiReadsPerThread = argc > 4 ? (unsigned int)atoi(argv[4]) : 50;
+
+  // Reference image
+  ImageIOType::Pointer p_clRefIO = ImageIOType::New();
+  ReaderType::Pointer  p_clReader = ReaderType::New();
+
+  p_clRefIO->SetLevel(iLevel);
+  p_clReader->SetImageIO(p_clRefIO);
+  p_clReader->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clReader->Update();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ImageType::Pointer        p_clRefImage = p_clReader->GetOutput();
+  const ImageType::SizeType clRefSize = p_clRefImage->GetLargestPossibleRegion().GetSize();
+  const PixelType * const   p_clRefBuffer = p_clRefImage->GetBufferPointer();
+
+  std::cout << "Level " << iLevel << " dimensions = " << clRefSize << std::endl;
+
+  // Shared ImageIO
+  ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+  p_clImageIO->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clImageIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const ImageIOType * const p_clSharedIO = p_clImageIO.GetPointer();
+
+  std::atomic<unsigned int> uiNumMismatches(0);
+  std::atomic<unsigned int> uiNumErrors(0);
+
+  std::vector<std::thread> vThreads;
+
+  for (unsigned int t = 0; t < uiNumThreads; ++t)
+  {
+    vThreads.push_back(std::thread([&, t]() {
+      std::mt19937                          clGenerator(1234 + t);
+      std::uniform_int_distribution<size_t> clSizeDist(1, 256);
+      std::vector<PixelType>                vBuffer;
+
+      for (unsigned int r = 0; r < uiReadsPerThread; ++r)
+      {
+        const size_t width = std::min<size_t>(clSizeDist(clGenerator), clRefSize[0]);
+        const size_t height = std::min<size_t>(clSizeDist(clGenerator), clRefSize[1]);
+        const size_t x = std::uniform_int_distribution<size_t>(0, clRefSize[0] - width)(clGenerator);
+        const size_t y = std::uniform_int_distribution<size_t>(0, clRefSize[1] - height)(clGenerator);
+
+        itk::ImageIORegion clRegion(2);
+        clRegion.SetIndex(0, x);
+        clRegion.SetIndex(1, y);
+        clRegion.SetSize(0, width);
+        clRegion.SetSize(1, height);
+
+        vBuffer.resize(width * height);
+
+        try
+        {
+          p_clSharedIO->ReadRegion(iLevel, clRegion, &vBuffer[0]);
+        }
+        catch (itk::ExceptionObject & e)
+        {
+          std::cerr << "Error: " << e << std::endl;
+          ++uiNumErrors;
+          continue;
+        }
+
+        for (size_t j = 0; j < height; ++j)
+        {
+          const PixelType * const p_clRefRow = p_clRefBuffer + (y + j) * clRefSize[0] + x;
+
+          if (std::memcmp(p_clRefRow, &vBuffer[j * width], width * sizeof(PixelType)) != 0)
+          {
+            std::cerr << "Error: Region mismatch at x = " << x << ", y = " << y << ", width = " << width
+                      << ", height = " << height << '.' << std::endl;
+            ++uiNumMismatches;
+            break;
+          }
+        }
+      }
+    }));
+  }
+
+  for (size_t t = 0; t < vThreads.size(); ++t)
+    vThreads[t].join();
+
+  std::cout << "Threads = " << uiNumThreads << ", reads per thread = " << uiReadsPerThread
+            << ", errors = " << uiNumErrors << ", mismatches = " << uiNumMismatches << std::endl;
+
+  return uiNumErrors == 0 && uiNumMismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkTimeProbe.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+
+// Reads the region with both ImageIOs, compares the buffers and adds the time of each read to the probes
+template <typename TComponent>
+bool
+CompareRegion(ImageIOType *               p_clReferenceIO,
+              ImageIOType *               p_clDirectIO,
+              int                         iLevel,
+              const itk::ImageIORegion &  clRegion,
+              double                      dTolerance,
+              itk::TimeProbe &            clReferenceProbe,
+              itk::TimeProbe &            clDirectProbe)
+{
+  const size_t numComponents = p_clReferenceIO->GetNumberOfComponents();
+
+  std::vector<TComponent> vReference(clRegion.GetNumberOfPixels() * numComponents);
+  std::vector<TComponent> vDirect(vReference.size());
+
+  clReferenceProbe.Start();
+  p_clReferenceIO->ReadRegion(iLevel, clRegion, &vReference[0]);
+  clReferenceProbe.Stop();
+
+  clDirectProbe.Start();
+  p_clDirectIO->ReadRegion(iLevel, clRegion, &vDirect[0]);
+  clDirectProbe.Stop();
+
+  for (size_t i = 0; i < vReference.size(); ++i)
+  {
+    const double dDiff = static_cast<double>(vReference[i]) - static_cast<double>(vDirect[i]);
+
+    if (dDiff > dTolerance || dDiff < -dTolerance)
+    {
+      std::cerr << "Error: Level " << iLevel << " region " << clRegion.GetIndex(0) << ", " << clRegion.GetIndex(1)
+                << " differs at component " << i << " (" << static_cast<double>(vReference[i]) << " vs "
+                << static_cast<double>(vDirect[i]) << ")." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // End anonymous namespace
+
+// Reads regions of every level with and without direct tile decoding in several output layouts and compares them.
+// Both decode the same JPEG tiles, so pixels may only differ by the rounding of the decoders. Levels other than 0
+// are compared at their origin only since OpenSlide may shift other regions by a fraction of a pixel.
+int
+itkOpenSlideTestDirectDecode(int argc, char * argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  struct Configuration
+  {
+    ImageIOType::OutputLayoutEnum    eLayout;
+    ImageIOType::OutputComponentEnum eComponentType;
+  };
+
+  const Configuration a_clConfigurations[] = {
+    { ImageIOType::OutputLayoutEnum::RGBA, ImageIOType::OutputComponentEnum::UnsignedChar },
+    { ImageIOType::OutputLayoutEnum::RGB, ImageIOType::OutputComponentEnum::UnsignedChar },
+    { ImageIOType::OutputLayoutEnum::RGB, ImageIOType::OutputComponentEnum::Float }
+  };
+
+  const double dTolerance = 2.0;
+
+  for (const Configuration & clConfiguration : a_clConfigurations)
+  {
+    ImageIOType::Pointer p_clReferenceIO = ImageIOType::New();
+    ImageIOType::Pointer p_clDirectIO = ImageIOType::New();
+
+    p_clReferenceIO->SetFileName(argv[1]);
+    p_clReferenceIO->SetOutputLayout(clConfiguration.eLayout);
+    p_clReferenceIO->SetOutputComponentType(clConfiguration.eComponentType);
+
+    p_clDirectIO->SetFileName(argv[1]);
+    p_clDirectIO->SetOutputLayout(clConfiguration.eLayout);
+    p_clDirectIO->SetOutputComponentType(clConfiguration.eComponentType);
+    p_clDirectIO->SetDirectTileDecoding(true);
+
+    itk::TimeProbe clReferenceProbe;
+    itk::TimeProbe clDirectProbe;
+
+    try
+    {
+      p_clReferenceIO->ReadImageInformation();
+      p_clDirectIO->ReadImageInformation();
+
+      if (!p_clDirectIO->GetDirectTileDecoding())
+      {
+        std::cerr << "Error: Direct tile decoding was not turned on." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      for (int iLevel = 0; iLevel < p_clReferenceIO->GetLevelCount(); ++iLevel)
+      {
+        itk::SizeValueType width = 0;
+        itk::SizeValueType height = 0;
+
+        if (!p_clReferenceIO->GetLevelDimensions(iLevel, width, height))
+        {
+          std::cerr << "Error: Could not get the dimensions of level " << iLevel << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        const itk::SizeValueType regionWidth = std::min<itk::SizeValueType>(width, 512);
+        const itk::SizeValueType regionHeight = std::min<itk::SizeValueType>(height, 512);
+
+        // Origin, an unaligned interior region and the bottom right corner for level 0
+        std::vector<itk::ImageIORegion> vRegions(1, itk::ImageIORegion(2));
+        vRegions[0].SetSize(0, regionWidth);
+        vRegions[0].SetSize(1, regionHeight);
+
+        if (iLevel == 0)
+        {
+          vRegions.push_back(vRegions[0]);
+          vRegions.back().SetIndex(0, (width - regionWidth) / 3 + 1);
+          vRegions.back().SetIndex(1, (height - regionHeight) / 3 + 1);
+
+          vRegions.push_back(vRegions[0]);
+          vRegions.back().SetIndex(0, width - regionWidth);
+          vRegions.back().SetIndex(1, height - regionHeight);
+        }
+
+        // Float components are normalized like (pixel * dScale - mean) / stddev, which scales the rounding too
+        double dScale = 1.0, a_dMean[4], a_dStdDev[4];
+        p_clReferenceIO->GetNormalization(dScale, a_dMean, a_dStdDev);
+
+        const double dFloatTolerance =
+          dTolerance * dScale / *std::min_element(a_dStdDev, a_dStdDev + p_clReferenceIO->GetNumberOfComponents());
+
+        for (const itk::ImageIORegion & clRegion : vRegions)
+        {
+          const bool bEqual =
+            clConfiguration.eComponentType == ImageIOType::OutputComponentEnum::Float
+              ? CompareRegion<float>(p_clReferenceIO, p_clDirectIO, iLevel, clRegion, dFloatTolerance,
+                                     clReferenceProbe, clDirectProbe)
+              : CompareRegion<unsigned char>(p_clReferenceIO, p_clDirectIO, iLevel, clRegion, dTolerance,
+                                             clReferenceProbe, clDirectProbe);
+
+          if (!bEqual)
+            return EXIT_FAILURE;
+        }
+      }
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const bool bDirect = clConfiguration.eComponentType == ImageIOType::OutputComponentEnum::UnsignedChar;
+
+    // Unsigned char outputs are written straight from the tiles, the others are decoded to RGBA and converted
+    if (p_clDirectIO->GetNumberOfDirectlyDecodedTiles() == 0)
+    {
+      std::cerr << "Error: Layout " << static_cast<int>(clConfiguration.eLayout) << " with component type "
+                << static_cast<int>(clConfiguration.eComponentType) << " decoded no tile directly." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::cout << "Layout " << static_cast<int>(clConfiguration.eLayout) << ", component type "
+              << static_cast<int>(clConfiguration.eComponentType) << (bDirect ? " (direct)" : " (wrapper)")
+              << ": OpenSlide " << clReferenceProbe.GetTotal() << " s, direct decoding " << clDirectProbe.GetTotal()
+              << " s, " << p_clDirectIO->GetNumberOfDirectlyDecodedTiles() << " tiles decoded directly." << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
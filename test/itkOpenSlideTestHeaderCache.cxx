@@ -0,0 +1,204 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkMetaDataObject.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+
+// Compares everything ReadImageInformation() and the level/associated image queries report
+bool
+CompareInformation(ImageIOType * p_clIO1, ImageIOType * p_clIO2)
+{
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    if (p_clIO1->GetDimensions(i) != p_clIO2->GetDimensions(i) || p_clIO1->GetSpacing(i) != p_clIO2->GetSpacing(i))
+    {
+      std::cerr << "Error: Dimensions or spacing differ." << std::endl;
+      return false;
+    }
+  }
+
+  if (p_clIO1->GetVendor() != p_clIO2->GetVendor())
+  {
+    std::cerr << "Error: Vendors differ." << std::endl;
+    return false;
+  }
+
+  if (p_clIO1->GetLevelCount() != p_clIO2->GetLevelCount())
+  {
+    std::cerr << "Error: Level counts differ." << std::endl;
+    return false;
+  }
+
+  for (int iLevel = 0; iLevel < p_clIO1->GetLevelCount(); ++iLevel)
+  {
+    ImageIOType::SizeValueType width1 = 0, height1 = 0, width2 = 0, height2 = 0;
+
+    p_clIO1->GetLevelDimensions(iLevel, width1, height1);
+    p_clIO2->GetLevelDimensions(iLevel, width2, height2);
+
+    if (width1 != width2 || height1 != height2 ||
+        p_clIO1->GetLevelDownsample(iLevel) != p_clIO2->GetLevelDownsample(iLevel))
+    {
+      std::cerr << "Error: Level " << iLevel << " differs." << std::endl;
+      return false;
+    }
+  }
+
+  const ImageIOType::AssociatedImageNameContainer vNames1 = p_clIO1->GetAssociatedImageNames();
+  const ImageIOType::AssociatedImageNameContainer vNames2 = p_clIO2->GetAssociatedImageNames();
+
+  if (vNames1 != vNames2)
+  {
+    std::cerr << "Error: Associated image names differ." << std::endl;
+    return false;
+  }
+
+  for (size_t i = 0; i < vNames1.size(); ++i)
+  {
+    ImageIOType::SizeValueType width1 = 0, height1 = 0, width2 = 0, height2 = 0;
+
+    p_clIO1->GetAssociatedImageDimensions(vNames1[i], width1, height1);
+    p_clIO2->GetAssociatedImageDimensions(vNames1[i], width2, height2);
+
+    if (width1 != width2 || height1 != height2)
+    {
+      std::cerr << "Error: Associated image '" << vNames1[i] << "' differs." << std::endl;
+      return false;
+    }
+  }
+
+  const itk::MetaDataDictionary & clTags1 = p_clIO1->GetMetaDataDictionary();
+  const itk::MetaDataDictionary & clTags2 = p_clIO2->GetMetaDataDictionary();
+  const std::vector<std::string>  vKeys = clTags1.GetKeys();
+
+  if (vKeys != clTags2.GetKeys())
+  {
+    std::cerr << "Error: Meta data keys differ." << std::endl;
+    return false;
+  }
+
+  for (size_t i = 0; i < vKeys.size(); ++i)
+  {
+    std::string strValue1, strValue2;
+
+    if (!itk::ExposeMetaData(clTags1, vKeys[i], strValue1) || !itk::ExposeMetaData(clTags2, vKeys[i], strValue2) ||
+        strValue1 != strValue2)
+    {
+      std::cerr << "Error: Meta data '" << vKeys[i] << "' differs." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+ReadInformation(ImageIOType * p_clIO)
+{
+  try
+  {
+    p_clIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+} // End anonymous namespace
+
+int
+itkOpenSlideTestHeaderCache(int argc, char * argv[])
+{
+  using PixelType = itk::RGBAPixel<unsigned char>;
+
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile cacheDirectory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const p_cSlideFile = argv[1];
+  const char * const p_cCacheDirectory = argv[2];
+
+  ImageIOType::Pointer p_clDirectIO = ImageIOType::New();
+  ImageIOType::Pointer p_clMissIO = ImageIOType::New();
+  ImageIOType::Pointer p_clHitIO = ImageIOType::New();
+
+  p_clDirectIO->SetFileName(p_cSlideFile);
+
+  p_clMissIO->SetFileName(p_cSlideFile);
+  p_clMissIO->SetHeaderCacheDirectory(p_cCacheDirectory);
+
+  p_clHitIO->SetFileName(p_cSlideFile);
+  p_clHitIO->SetHeaderCacheDirectory(p_cCacheDirectory);
+
+  // The first cached IO writes the header (unless a previous run did), the second one reads it back
+  if (!ReadInformation(p_clDirectIO) || !ReadInformation(p_clMissIO) || !ReadInformation(p_clHitIO))
+    return EXIT_FAILURE;
+
+  if (!CompareInformation(p_clDirectIO, p_clMissIO) || !CompareInformation(p_clDirectIO, p_clHitIO))
+    return EXIT_FAILURE;
+
+  // Pixels read after a cache hit (which opens the slide on demand) must match
+  const ImageIOType::SizeValueType width = std::min<ImageIOType::SizeValueType>(256, p_clDirectIO->GetDimensions(0));
+  const ImageIOType::SizeValueType height = std::min<ImageIOType::SizeValueType>(256, p_clDirectIO->GetDimensions(1));
+
+  itk::ImageIORegion clRegion(2);
+  clRegion.SetIndex(0, (p_clDirectIO->GetDimensions(0) - width) / 2);
+  clRegion.SetIndex(1, (p_clDirectIO->GetDimensions(1) - height) / 2);
+  clRegion.SetSize(0, width);
+  clRegion.SetSize(1, height);
+
+  std::vector<PixelType> vBuffer1(width * height), vBuffer2(width * height);
+
+  try
+  {
+    p_clDirectIO->ReadRegion(0, clRegion, &vBuffer1[0]);
+    p_clHitIO->ReadRegion(0, clRegion, &vBuffer2[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (std::memcmp(&vBuffer1[0], &vBuffer2[0], vBuffer1.size() * sizeof(PixelType)) != 0)
+  {
+    std::cerr << "Error: Pixels read after a header cache hit differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkMetaDataObject.h"
+#include "itksys/Directory.hxx"
+#include "itksys/SystemTools.hxx"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+
+const char * const g_cMarkerKey = "itkopenslide.test-marker";
+
+// Adds a property to the cached header of the slide so that a cache hit can be told apart from a miss
+bool
+AddMarkerToHeaderCache(const std::string & strCacheDirectory)
+{
+  itksys::Directory clDirectory;
+  if (!clDirectory.Load(strCacheDirectory))
+    return false;
+
+  for (unsigned long i = 0; i < clDirectory.GetNumberOfFiles(); ++i)
+  {
+    const std::string strFileName = strCacheDirectory + '/' + clDirectory.GetFile(i);
+
+    if (itksys::SystemTools::GetFilenameLastExtension(strFileName) != ".oshdr")
+      continue;
+
+    std::vector<std::string> vLines;
+    {
+      std::ifstream cacheStream(strFileName.c_str(), std::ios::binary);
+      std::string   strLine;
+
+      while (std::getline(cacheStream, strLine))
+        vLines.push_back(strLine);
+    }
+
+    if (vLines.empty() || vLines.back() != "end")
+      return false;
+
+    std::ofstream cacheStream(strFileName.c_str(), std::ios::binary | std::ios::trunc);
+    for (size_t j = 0; j + 1 < vLines.size(); ++j)
+      cacheStream << vLines[j] << '\n';
+
+    cacheStream << "property\t" << g_cMarkerKey << "\t1\n";
+    cacheStream << "end\n";
+
+    return !cacheStream.fail();
+  }
+
+  return false;
+}
+
+// Reads the header through the cache and reports whether it came from the (marked) cache entry
+bool
+ReadMarker(const std::string & strSlideFile, const std::string & strCacheDirectory, bool & bMarked)
+{
+  ImageIOType::Pointer p_clIO = ImageIOType::New();
+  p_clIO->SetFileName(strSlideFile);
+  p_clIO->SetHeaderCacheDirectory(strCacheDirectory);
+
+  try
+  {
+    p_clIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return false;
+  }
+
+  std::string strValue;
+  bMarked = itk::ExposeMetaData(p_clIO->GetMetaDataDictionary(), g_cMarkerKey, strValue);
+
+  return true;
+}
+
+} // End anonymous namespace
+
+// Multi-file formats like MIRAX keep their header in a companion file (Slidedat.ini in a directory named like the
+// slide without extension). Changing it must invalidate the cached header even though the slide file is unchanged.
+int
+itkOpenSlideTestHeaderCacheCompanion(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile workDirectory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string strWorkDirectory = argv[2];
+  const std::string strSlideFile = strWorkDirectory + "/Slide" + itksys::SystemTools::GetFilenameLastExtension(argv[1]);
+  const std::string strCompanionFile = strWorkDirectory + "/Slide/Slidedat.ini";
+  const std::string strCacheDirectory = strWorkDirectory + "/Cache";
+
+  itksys::SystemTools::RemoveADirectory(strWorkDirectory);
+
+  if (!itksys::SystemTools::MakeDirectory(strWorkDirectory + "/Slide") ||
+      !itksys::SystemTools::CopyFileAlways(argv[1], strSlideFile))
+  {
+    std::cerr << "Error: Could not set up '" << strWorkDirectory << "'." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  {
+    std::ofstream companionStream(strCompanionFile.c_str(), std::ios::binary | std::ios::trunc);
+    companionStream << "[GENERAL]\n";
+  }
+
+  bool bMarked = false;
+
+  // Miss, writes the cached header
+  if (!ReadMarker(strSlideFile, strCacheDirectory, bMarked))
+    return EXIT_FAILURE;
+
+  if (!AddMarkerToHeaderCache(strCacheDirectory))
+  {
+    std::cerr << "Error: Could not modify the cached header." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!ReadMarker(strSlideFile, strCacheDirectory, bMarked))
+    return EXIT_FAILURE;
+
+  if (!bMarked)
+  {
+    std::cerr << "Error: The cached header was not used for an unchanged slide." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Changes the size of the companion file (and likely its modification time)
+  {
+    std::ofstream companionStream(strCompanionFile.c_str(), std::ios::binary | std::ios::app);
+    companionStream << "SLIDE_VERSION = 2\n";
+  }
+
+  if (!ReadMarker(strSlideFile, strCacheDirectory, bMarked))
+    return EXIT_FAILURE;
+
+  if (bMarked)
+  {
+    std::cerr << "Error: The cached header was used after its companion file changed." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
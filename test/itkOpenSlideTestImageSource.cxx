@@ -0,0 +1,184 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideImageSource.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Requests a region of the slide at the spacing of each level and at spacings between levels. The source must read
+// the cheapest level and match ReadRegion() at level spacings and ReadMultiResolutionRegion() otherwise. Also checks
+// that the grids of two spacings are aligned: a coarse pixel is centered on the fine pixels it covers.
+int
+itkOpenSlideTestImageSource(int argc, char * argv[])
+{
+  using ImageIOType = itk::OpenSlideImageIO;
+  using PixelType = itk::RGBAPixel<unsigned char>;
+  using SourceType = itk::OpenSlideImageSource<PixelType>;
+  using ImageType = SourceType::OutputImageType;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::SizeValueType regionSize = 256;
+
+  ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+  SourceType::Pointer  p_clSource = SourceType::New();
+
+  p_clImageIO->SetFileName(argv[1]);
+  p_clSource->SetFileName(argv[1]);
+
+  try
+  {
+    p_clImageIO->ReadImageInformation();
+
+    const double dSpacing0 = p_clImageIO->GetSpacing(0);
+
+    // Centers of fine pixels 0 to 3 and of the coarse pixel covering them (4 times the spacing)
+    {
+      SourceType::SpacingType clSpacing;
+      ImageType::IndexType    clIndex;
+      ImageType::PointType    clFirst, clLast, clCoarse;
+
+      clSpacing.Fill(dSpacing0);
+      p_clSource->SetOutputSpacing(clSpacing);
+      p_clSource->UpdateOutputInformation();
+
+      clIndex.Fill(0);
+      p_clSource->GetOutput()->TransformIndexToPhysicalPoint(clIndex, clFirst);
+      clIndex.Fill(3);
+      p_clSource->GetOutput()->TransformIndexToPhysicalPoint(clIndex, clLast);
+
+      clSpacing.Fill(4.0 * dSpacing0);
+      p_clSource->SetOutputSpacing(clSpacing);
+      p_clSource->UpdateOutputInformation();
+
+      clIndex.Fill(0);
+      p_clSource->GetOutput()->TransformIndexToPhysicalPoint(clIndex, clCoarse);
+
+      for (unsigned int i = 0; i < 2; ++i)
+      {
+        const double dExpected = 0.5 * (clFirst[i] + clLast[i]);
+
+        if (std::abs(clCoarse[i] - dExpected) > 1e-6 * dSpacing0)
+        {
+          std::cerr << "Error: Pixel 0 at spacing " << 4.0 * dSpacing0 << " is centered at " << clCoarse[i]
+                    << " instead of " << dExpected << " in dimension " << i << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+
+    // The spacing of each level (exact reads) and 1.5 times that (filtered from the same level)
+    for (int iLevel = 0; iLevel < p_clImageIO->GetLevelCount(); ++iLevel)
+    {
+      for (unsigned int k = 0; k < 2; ++k)
+      {
+        const double dSpacing = dSpacing0 * p_clImageIO->GetLevelDownsample(iLevel) * (k == 0 ? 1.0 : 1.5);
+
+        SourceType::SpacingType clSpacing;
+        clSpacing.Fill(dSpacing);
+
+        p_clSource->SetOutputSpacing(clSpacing);
+        p_clSource->UpdateOutputInformation();
+
+        ImageType * const         p_clOutput = p_clSource->GetOutput();
+        const ImageType::SizeType clSize = p_clOutput->GetLargestPossibleRegion().GetSize();
+
+        if (clSize[0] < regionSize || clSize[1] < regionSize)
+          continue;
+
+        // A region in the middle of the output
+        ImageType::RegionType clRequestedRegion;
+        clRequestedRegion.SetIndex(0, (clSize[0] - regionSize) / 2);
+        clRequestedRegion.SetIndex(1, (clSize[1] - regionSize) / 2);
+        clRequestedRegion.SetSize(0, regionSize);
+        clRequestedRegion.SetSize(1, regionSize);
+
+        p_clOutput->SetRequestedRegion(clRequestedRegion);
+        p_clOutput->Update();
+
+        std::cout << "Spacing " << dSpacing << ": " << clSize[0] << " x " << clSize[1] << " pixels, read level "
+                  << p_clSource->GetLastReadLevel() << std::endl;
+
+        if (p_clSource->GetLastReadLevel() != iLevel)
+        {
+          std::cerr << "Error: Expected level " << iLevel << " to be read." << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        if (p_clOutput->GetBufferedRegion() != clRequestedRegion)
+        {
+          std::cerr << "Error: Buffered region is not the requested region." << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        itk::ImageIORegion clRegion(2);
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+          clRegion.SetIndex(i, clRequestedRegion.GetIndex(i));
+          clRegion.SetSize(i, regionSize);
+        }
+
+        std::vector<unsigned char> vReference;
+
+        if (k == 0)
+        {
+          vReference.resize(regionSize * regionSize * sizeof(PixelType));
+          p_clImageIO->ReadRegion(iLevel, clRegion, vReference.data());
+        }
+        else
+        {
+          const double a_dOrigin[2] = { p_clImageIO->GetOrigin(0) + clRegion.GetIndex(0) * dSpacing,
+                                        p_clImageIO->GetOrigin(1) + clRegion.GetIndex(1) * dSpacing };
+          const double a_dSize[2] = { regionSize * dSpacing, regionSize * dSpacing };
+
+          ImageIOType::BufferContainer vBuffers;
+          ImageIOType::RegionContainer vRegions;
+          p_clImageIO->ReadMultiResolutionRegion(
+            a_dOrigin, a_dSize, ImageIOType::SpacingContainer(1, dSpacing), vBuffers, vRegions);
+
+          vReference = vBuffers[0];
+        }
+
+        if (vReference.size() != regionSize * regionSize * sizeof(PixelType) ||
+            std::memcmp(vReference.data(), p_clOutput->GetBufferPointer(), vReference.size()) != 0)
+        {
+          std::cerr << "Error: Pixels at spacing " << dSpacing << " differ." << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+using PixelType = itk::RGBAPixel<unsigned char>;
+
+// Returns the mean of channel c of RGBA pixels
+double
+ComputeMean(const std::vector<unsigned char> & vBuffer, unsigned int c)
+{
+  double dSum = 0.0;
+  for (size_t i = c; i < vBuffer.size(); i += 4)
+    dSum += vBuffer[i];
+
+  return dSum / (vBuffer.size() / 4);
+}
+
+// Reads a region off the pixel grid at 1 and 2 times the level 0 spacing. Its origin is snapped to an odd level 0
+// pixel at the level 0 spacing and to the even one before it at twice the spacing, so the output at twice the spacing
+// (filtered down from the level 0 output) starts one level 0 pixel before it. Each output must match
+// ReadRegionAtSpacing() of its grid region, except for the border pixels a filtered output may take from outside of
+// its source.
+bool
+CheckUnalignedRegion(ImageIOType * p_clImageIO)
+{
+  // 1001 level 0 pixels round up to 501 pixels at twice the spacing, so filtering the level 0 output is cheaper than
+  // filtering the 1002 level 0 pixels they cover
+  const size_t regionSize = 1001;
+  const double dSpacing = p_clImageIO->GetSpacing(0);
+
+  ImageIOType::SpacingContainer vSpacings;
+  ImageIOType::BufferContainer  vBuffers;
+  ImageIOType::RegionContainer  vRegions;
+
+  vSpacings.push_back(dSpacing);
+  vSpacings.push_back(2.0 * dSpacing);
+
+  const double a_dOrigin[2] = {
+    p_clImageIO->GetOrigin(0) + ((p_clImageIO->GetDimensions(0) - regionSize) / 4 * 2 + 0.7) * dSpacing,
+    p_clImageIO->GetOrigin(1) + ((p_clImageIO->GetDimensions(1) - regionSize) / 4 * 2 + 0.7) * dSpacing
+  };
+  const double a_dSize[2] = { regionSize * dSpacing, regionSize * dSpacing };
+
+  p_clImageIO->ReadMultiResolutionRegion(a_dOrigin, a_dSize, vSpacings, vBuffers, vRegions);
+
+  for (size_t k = 0; k < vSpacings.size(); ++k)
+  {
+    const double             a_dGridSpacing[2] = { vSpacings[k], vSpacings[k] };
+    const itk::SizeValueType width = vRegions[k].GetSize(0);
+    const itk::SizeValueType height = vRegions[k].GetSize(1);
+
+    std::vector<PixelType> vReference(vRegions[k].GetNumberOfPixels());
+    p_clImageIO->ReadRegionAtSpacing(a_dGridSpacing, vRegions[k], &vReference[0]);
+
+    std::cout << "Unaligned output " << k << ": " << vRegions[k] << std::endl;
+
+    if (vBuffers[k].size() != vReference.size() * sizeof(PixelType))
+    {
+      std::cerr << "Error: Unexpected size of unaligned output " << k << '.' << std::endl;
+      return false;
+    }
+
+    const PixelType * const p_clOutput = (const PixelType *)&vBuffers[k][0];
+
+    for (itk::SizeValueType y = 1; y + 1 < height; ++y)
+    {
+      for (itk::SizeValueType x = 1; x + 1 < width; ++x)
+      {
+        // Filtering twice may round differently
+        for (unsigned int c = 0; c < 4; ++c)
+        {
+          if (std::abs((int)p_clOutput[y * width + x][c] - (int)vReference[y * width + x][c]) > 1)
+          {
+            std::cerr << "Error: Unaligned output " << k << " differs from its grid region at (" << x << ", " << y
+                      << ")." << std::endl;
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+} // End anonymous namespace
+
+// Reads a region at 1, 2, 4 and 16 times the level 0 spacing in one call. The level 0 output must match ReadRegion()
+// exactly and the lower resolutions must have the expected sizes and colors. A region off the pixel grid must match
+// the grid regions its outputs report.
+int
+itkOpenSlideTestMultiResolution(int argc, char * argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const p_cSlideFile = argv[1];
+  const size_t       regionSize = 1024;
+
+  ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+  p_clImageIO->SetFileName(p_cSlideFile);
+
+  ImageIOType::SpacingContainer vSpacings;
+  ImageIOType::BufferContainer  vBuffers;
+  ImageIOType::RegionContainer  vRegions;
+  std::vector<PixelType>        vReference(regionSize * regionSize);
+  itk::ImageIORegion            clRegion(2);
+
+  try
+  {
+    p_clImageIO->ReadImageInformation();
+
+    if (p_clImageIO->GetDimensions(0) < regionSize || p_clImageIO->GetDimensions(1) < regionSize)
+    {
+      std::cerr << "Error: Slide is too small." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // A level 0 region in the middle on a 16 pixel grid
+    clRegion.SetIndex(0, (p_clImageIO->GetDimensions(0) - regionSize) / 32 * 16);
+    clRegion.SetIndex(1, (p_clImageIO->GetDimensions(1) - regionSize) / 32 * 16);
+    clRegion.SetSize(0, regionSize);
+    clRegion.SetSize(1, regionSize);
+
+    p_clImageIO->ReadRegion(0, clRegion, &vReference[0]);
+
+    const double dSpacing = p_clImageIO->GetSpacing(0);
+    const double a_dOrigin[2] = { p_clImageIO->GetOrigin(0) + clRegion.GetIndex(0) * dSpacing,
+                                  p_clImageIO->GetOrigin(1) + clRegion.GetIndex(1) * dSpacing };
+    const double a_dSize[2] = { regionSize * dSpacing, regionSize * dSpacing };
+
+    // Unordered on purpose
+    vSpacings.push_back(4.0 * dSpacing);
+    vSpacings.push_back(dSpacing);
+    vSpacings.push_back(16.0 * dSpacing);
+    vSpacings.push_back(2.0 * dSpacing);
+
+    p_clImageIO->ReadMultiResolutionRegion(a_dOrigin, a_dSize, vSpacings, vBuffers, vRegions);
+
+    if (!CheckUnalignedRegion(p_clImageIO))
+      return EXIT_FAILURE;
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vBuffers.size() != vSpacings.size() || vRegions.size() != vSpacings.size())
+  {
+    std::cerr << "Error: Expected " << vSpacings.size() << " outputs." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vBuffers[1].size() != vReference.size() * sizeof(PixelType) ||
+      std::memcmp(&vReference[0], &vBuffers[1][0], vBuffers[1].size()) != 0)
+  {
+    std::cerr << "Error: Level 0 output differs from ReadRegion()." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<unsigned char> vReferenceBytes(vBuffers[1]);
+
+  for (size_t k = 0; k < vSpacings.size(); ++k)
+  {
+    const size_t factor = (size_t)(vSpacings[k] / vSpacings[1] + 0.5);
+
+    std::cout << "Output " << k << ": " << vRegions[k] << std::endl;
+
+    if (vRegions[k].GetSize(0) != regionSize / factor || vRegions[k].GetSize(1) != regionSize / factor ||
+        vRegions[k].GetIndex(0) != (itk::IndexValueType)(clRegion.GetIndex(0) / factor) ||
+        vRegions[k].GetIndex(1) != (itk::IndexValueType)(clRegion.GetIndex(1) / factor) ||
+        vBuffers[k].size() != vRegions[k].GetNumberOfPixels() * sizeof(PixelType))
+    {
+      std::cerr << "Error: Unexpected region for output " << k << '.' << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Lower levels are compressed separately, so only compare colors
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      if (std::fabs(ComputeMean(vBuffers[k], c) - ComputeMean(vReferenceBytes, c)) > 3.0)
+      {
+        std::cerr << "Error: Mean of channel " << c << " differs for output " << k << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
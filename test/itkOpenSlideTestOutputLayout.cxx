@@ -0,0 +1,304 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkImageFileReader.h"
+#include "itkVectorImage.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+using PixelType = itk::RGBAPixel<unsigned char>;
+
+// Returns channel c of pixel i of patch n stored in the given layout
+unsigned char
+GetChannel(const std::vector<unsigned char> & vBuffer,
+           ImageIOType::OutputLayoutEnum      eLayout,
+           size_t                             patchPixels,
+           size_t                             n,
+           size_t                             i,
+           unsigned int                       c)
+{
+  const unsigned int uiComponents = ImageIOType::GetNumberOfLayoutComponents(eLayout);
+  const size_t       patchOffset = n * patchPixels * uiComponents;
+
+  switch (eLayout)
+  {
+    case ImageIOType::OutputLayoutEnum::PlanarRGB:
+    case ImageIOType::OutputLayoutEnum::PlanarRGBA:
+      return vBuffer[patchOffset + c * patchPixels + i];
+    default:
+      return vBuffer[patchOffset + i * uiComponents + c];
+  }
+}
+
+// Decodes IEEE 754 half-precision bits
+float
+HalfToFloat(uint16_t ui16Half)
+{
+  const float fSign = (ui16Half & 0x8000) ? -1.0f : 1.0f;
+  const int   iExponent = (ui16Half >> 10) & 0x1f;
+  const int   iMantissa = ui16Half & 0x3ff;
+
+  if (iExponent == 0)
+    return fSign * std::ldexp((float)iMantissa, -24);
+
+  return fSign * std::ldexp((float)(iMantissa | 0x400), iExponent - 25);
+}
+
+} // End anonymous namespace
+
+// Reads the same patches with every output layout and component type and compares them with the RGBA pixels
+int
+itkOpenSlideTestOutputLayout(int argc, char * argv[])
+{
+  using VectorImageType = itk::VectorImage<unsigned char, 2>;
+  using ReaderType = itk::ImageFileReader<VectorImageType>;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const p_cSlideFile = argv[1];
+  const size_t       patchSize = 64;
+
+  ImageIOType::Pointer p_clRefIO = ImageIOType::New();
+  p_clRefIO->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clRefIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t width = p_clRefIO->GetDimensions(0);
+  const size_t height = p_clRefIO->GetDimensions(1);
+
+  if (width < 2 * patchSize || height < 2 * patchSize)
+  {
+    std::cerr << "Error: Slide is too small." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Four patches (one per corner), read as RGBA and in every other layout
+  ImageIOType::RegionContainer vRegions;
+
+  for (size_t j = 0; j < 2; ++j)
+  {
+    for (size_t i = 0; i < 2; ++i)
+    {
+      itk::ImageIORegion clRegion(2);
+      clRegion.SetIndex(0, i * (width - patchSize));
+      clRegion.SetIndex(1, j * (height - patchSize));
+      clRegion.SetSize(0, patchSize);
+      clRegion.SetSize(1, patchSize);
+      vRegions.push_back(clRegion);
+    }
+  }
+
+  const size_t patchPixels = patchSize * patchSize;
+
+  std::vector<PixelType> vReference(vRegions.size() * patchPixels);
+
+  try
+  {
+    p_clRefIO->ReadRegions(0, vRegions, &vReference[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const ImageIOType::OutputLayoutEnum a_eLayouts[] = { ImageIOType::OutputLayoutEnum::RGB,
+                                                       ImageIOType::OutputLayoutEnum::PlanarRGB,
+                                                       ImageIOType::OutputLayoutEnum::PlanarRGBA };
+
+  for (const ImageIOType::OutputLayoutEnum eLayout : a_eLayouts)
+  {
+    const unsigned int uiComponents = ImageIOType::GetNumberOfLayoutComponents(eLayout);
+
+    ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+    p_clImageIO->SetFileName(p_cSlideFile);
+    p_clImageIO->SetOutputLayout(eLayout);
+
+    std::vector<unsigned char> vBuffer(vRegions.size() * patchPixels * uiComponents);
+
+    try
+    {
+      p_clImageIO->ReadImageInformation();
+      p_clImageIO->ReadRegions(0, vRegions, &vBuffer[0]);
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (p_clImageIO->GetNumberOfComponents() != uiComponents)
+    {
+      std::cerr << "Error: Layout " << static_cast<int>(eLayout) << " reports " << p_clImageIO->GetNumberOfComponents()
+                << " components." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (size_t n = 0; n < vRegions.size(); ++n)
+    {
+      for (size_t i = 0; i < patchPixels; ++i)
+      {
+        for (unsigned int c = 0; c < uiComponents; ++c)
+        {
+          if (GetChannel(vBuffer, eLayout, patchPixels, n, i, c) != vReference[n * patchPixels + i][c])
+          {
+            std::cerr << "Error: Layout " << static_cast<int>(eLayout) << " differs in patch " << n << " at pixel "
+                      << i << '.' << std::endl;
+            return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  }
+
+  // Normalized float and half planar patches
+  const double a_dMean[4] = { 0.485, 0.456, 0.406, 0.0 };
+  const double a_dStdDev[4] = { 0.229, 0.224, 0.225, 1.0 };
+  const double dScale = 1.0 / 255.0;
+
+  const ImageIOType::OutputComponentEnum a_eComponentTypes[] = { ImageIOType::OutputComponentEnum::Float,
+                                                                 ImageIOType::OutputComponentEnum::Half };
+
+  for (const ImageIOType::OutputComponentEnum eComponentType : a_eComponentTypes)
+  {
+    const bool bHalf = eComponentType == ImageIOType::OutputComponentEnum::Half;
+
+    ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+    p_clImageIO->SetFileName(p_cSlideFile);
+    p_clImageIO->SetOutputLayout(ImageIOType::OutputLayoutEnum::PlanarRGB);
+    p_clImageIO->SetOutputComponentType(eComponentType);
+    p_clImageIO->SetNormalization(dScale, a_dMean, a_dStdDev);
+
+    std::vector<float>    vFloatBuffer(vRegions.size() * patchPixels * 3);
+    std::vector<uint16_t> vHalfBuffer(vRegions.size() * patchPixels * 3);
+
+    try
+    {
+      p_clImageIO->ReadImageInformation();
+      p_clImageIO->ReadRegions(0, vRegions, bHalf ? (void *)&vHalfBuffer[0] : (void *)&vFloatBuffer[0]);
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const itk::IOComponentEnum eExpectedType = bHalf ? itk::IOComponentEnum::USHORT : itk::IOComponentEnum::FLOAT;
+    if (p_clImageIO->GetComponentType() != eExpectedType)
+    {
+      std::cerr << "Error: Unexpected component type for component type " << static_cast<int>(eComponentType) << '.'
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (size_t n = 0; n < vRegions.size(); ++n)
+    {
+      for (unsigned int c = 0; c < 3; ++c)
+      {
+        for (size_t i = 0; i < patchPixels; ++i)
+        {
+          const size_t j = (n * 3 + c) * patchPixels + i;
+          const float  fValue = bHalf ? HalfToFloat(vHalfBuffer[j]) : vFloatBuffer[j];
+          const double dExpected = (vReference[n * patchPixels + i][c] * dScale - a_dMean[c]) / a_dStdDev[c];
+          const double dTolerance = bHalf ? 4e-3 * std::max(1.0, std::fabs(dExpected)) : 1e-5;
+
+          if (std::fabs(fValue - dExpected) > dTolerance)
+          {
+            std::cerr << "Error: Component type " << static_cast<int>(eComponentType) << " differs in patch " << n
+                      << " at pixel " << i << " (" << fValue << " != " << dExpected << ")." << std::endl;
+            return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  }
+
+  // RGB pixels straight into a VectorImage through ImageFileReader
+  ImageIOType::Pointer p_clVectorIO = ImageIOType::New();
+  ReaderType::Pointer  p_clReader = ReaderType::New();
+
+  p_clVectorIO->SetOutputLayout(ImageIOType::OutputLayoutEnum::RGB);
+  p_clReader->SetImageIO(p_clVectorIO);
+  p_clReader->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clReader->Update();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  VectorImageType::Pointer p_clImage = p_clReader->GetOutput();
+
+  if (p_clImage->GetNumberOfComponentsPerPixel() != 3)
+  {
+    std::cerr << "Error: VectorImage has " << p_clImage->GetNumberOfComponentsPerPixel() << " components."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (size_t n = 0; n < vRegions.size(); ++n)
+  {
+    for (size_t y = 0; y < patchSize; ++y)
+    {
+      for (size_t x = 0; x < patchSize; ++x)
+      {
+        VectorImageType::IndexType clIndex;
+        clIndex[0] = vRegions[n].GetIndex(0) + x;
+        clIndex[1] = vRegions[n].GetIndex(1) + y;
+
+        const VectorImageType::PixelType clPixel = p_clImage->GetPixel(clIndex);
+        const PixelType &                clRefPixel = vReference[n * patchPixels + y * patchSize + x];
+
+        if (clPixel[0] != clRefPixel[0] || clPixel[1] != clRefPixel[1] || clPixel[2] != clRefPixel[2])
+        {
+          std::cerr << "Error: VectorImage differs at " << clIndex << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,246 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if !defined(_WIN32)
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlidePatchLoader.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using LoaderType = itk::OpenSlidePatchLoader;
+using ImageIOType = itk::OpenSlideImageIO;
+
+// Reads a batch and compares each patch with ReadRegion() of a separately opened ImageIO
+bool
+CheckBatch(LoaderType * p_clLoader, itk::SizeValueType numberOfPatches, double dMinimumTissueFraction)
+{
+  const size_t patchBytes = p_clLoader->GetPatchBufferSize();
+  const int    iLevel = p_clLoader->GetLevel();
+
+  std::vector<unsigned char> vBatch(numberOfPatches * patchBytes);
+  LoaderType::PatchContainer vPatches;
+
+  p_clLoader->ReadBatch(numberOfPatches, &vBatch[0], vPatches);
+
+  if (vPatches.size() != numberOfPatches)
+  {
+    std::cerr << "Error: Sampled " << vPatches.size() << " instead of " << numberOfPatches << " patches."
+              << std::endl;
+    return false;
+  }
+
+  std::vector<unsigned char> vPatch(patchBytes);
+
+  for (size_t i = 0; i < vPatches.size(); ++i)
+  {
+    if (i > 0 && vPatches[i].m_Slide < vPatches[i - 1].m_Slide)
+    {
+      std::cerr << "Error: Patches are not ordered by slide." << std::endl;
+      return false;
+    }
+
+    ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+    p_clImageIO->SetFileName(p_clLoader->GetSlideFileName(vPatches[i].m_Slide));
+    p_clImageIO->SetOutputLayout(p_clLoader->GetOutputLayout());
+    p_clImageIO->ReadImageInformation();
+
+    itk::ImageIORegion clRegion(2);
+    clRegion.SetIndex(0, vPatches[i].m_X);
+    clRegion.SetIndex(1, vPatches[i].m_Y);
+    clRegion.SetSize(0, p_clLoader->GetPatchSize());
+    clRegion.SetSize(1, p_clLoader->GetPatchSize());
+
+    p_clImageIO->ReadRegion(iLevel, clRegion, &vPatch[0]);
+
+    if (std::memcmp(&vPatch[0], &vBatch[i * patchBytes], patchBytes) != 0)
+    {
+      std::cerr << "Error: Patch " << i << " at " << vPatches[i].m_X << ", " << vPatches[i].m_Y << " of slide "
+                << vPatches[i].m_Slide << " differs from ReadRegion()." << std::endl;
+      return false;
+    }
+
+    if (dMinimumTissueFraction > 0.0 && vPatches[i].m_TissueFraction < dMinimumTissueFraction)
+    {
+      std::cout << "Patch " << i << " has a tissue fraction of only " << vPatches[i].m_TissueFraction << '.'
+                << std::endl;
+    }
+  }
+
+  return true;
+}
+
+} // End anonymous namespace
+
+// Samples batches of tissue patches, checks them against ReadRegion() and that equal seeds give equal patches. On
+// POSIX systems, forked workers must reopen the slides they inherited, and the throughput of 1, 2 and 4 workers is
+// printed.
+int
+itkOpenSlideTestPatchLoader(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile [slideFile ...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::SizeValueType patchSize = 64;
+  const itk::SizeValueType batchSize = 16;
+  const double             dMinimumTissueFraction = 0.5;
+
+  LoaderType::Pointer p_clLoader = LoaderType::New();
+
+  for (int i = 1; i < argc; ++i)
+    p_clLoader->AddSlide(argv[i]);
+
+  p_clLoader->SetPatchSize(patchSize);
+  p_clLoader->SetMinimumTissueFraction(dMinimumTissueFraction);
+  p_clLoader->SetMaximumNumberOfOpenSlides(1);
+  p_clLoader->SetSeed(42);
+
+  try
+  {
+    p_clLoader->PrepareSlides();
+
+    if (!CheckBatch(p_clLoader, batchSize, dMinimumTissueFraction))
+      return EXIT_FAILURE;
+
+    // Equal seeds draw equal patches
+    LoaderType::PatchContainer vPatches1, vPatches2;
+
+    p_clLoader->SetSeed(7);
+    p_clLoader->SamplePatches(batchSize, vPatches1);
+    p_clLoader->SetSeed(7);
+    p_clLoader->SamplePatches(batchSize, vPatches2);
+
+    for (size_t i = 0; i < vPatches1.size(); ++i)
+    {
+      if (vPatches1[i].m_Slide != vPatches2[i].m_Slide || vPatches1[i].m_X != vPatches2[i].m_X ||
+          vPatches1[i].m_Y != vPatches2[i].m_Y)
+      {
+        std::cerr << "Error: Equal seeds drew different patches." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Opened " << p_clLoader->GetNumberOfOpenedSlides() << " slides." << std::endl;
+
+#if !defined(_WIN32)
+  const unsigned int batchesPerWorker = 32;
+  const size_t       patchBytes = p_clLoader->GetPatchBufferSize();
+
+  for (unsigned int numberOfWorkers = 1; numberOfWorkers <= 4; numberOfWorkers *= 2)
+  {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<pid_t> vWorkers;
+
+    for (unsigned int w = 0; w < numberOfWorkers; ++w)
+    {
+      const pid_t pid = fork();
+
+      if (pid < 0)
+      {
+        std::cerr << "Error: Could not fork." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      if (pid == 0)
+      {
+        // Worker: the first batch is checked, the others only read
+        int iStatus = EXIT_SUCCESS;
+
+        try
+        {
+          if (!CheckBatch(p_clLoader, batchSize, dMinimumTissueFraction) ||
+              p_clLoader->GetNumberOfDetectedForks() != 1 || p_clLoader->GetNumberOfOpenedSlides() == 0)
+          {
+            std::cerr << "Error: Worker did not reopen the slides." << std::endl;
+            iStatus = EXIT_FAILURE;
+          }
+
+          std::vector<unsigned char> vBatch(batchSize * patchBytes);
+          LoaderType::PatchContainer vPatches;
+
+          for (unsigned int b = 1; b < batchesPerWorker && iStatus == EXIT_SUCCESS; ++b)
+            p_clLoader->ReadBatch(batchSize, &vBatch[0], vPatches);
+        }
+        catch (itk::ExceptionObject & e)
+        {
+          std::cerr << "Error: " << e << std::endl;
+          iStatus = EXIT_FAILURE;
+        }
+
+        _exit(iStatus);
+      }
+
+      vWorkers.push_back(pid);
+    }
+
+    bool bFailed = false;
+
+    for (size_t w = 0; w < vWorkers.size(); ++w)
+    {
+      int iStatus = 0;
+      if (waitpid(vWorkers[w], &iStatus, 0) != vWorkers[w] || !WIFEXITED(iStatus) ||
+          WEXITSTATUS(iStatus) != EXIT_SUCCESS)
+      {
+        bFailed = true;
+      }
+    }
+
+    if (bFailed)
+    {
+      std::cerr << "Error: A worker failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << numberOfWorkers << " workers: " << numberOfWorkers * batchesPerWorker * batchSize / dSeconds
+              << " patches/s" << std::endl;
+  }
+
+  // The parent still uses its own slides
+  if (p_clLoader->GetNumberOfDetectedForks() != 0)
+  {
+    std::cerr << "Error: The parent detected a fork." << std::endl;
+    return EXIT_FAILURE;
+  }
+#endif // _WIN32
+
+  return EXIT_SUCCESS;
+}
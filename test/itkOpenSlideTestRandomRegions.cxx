@@ -0,0 +1,199 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkTimeProbe.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+
+// Reads the regions with ReadRegions() and one ReadRegion() per region and compares the patches
+bool
+CompareRegions(ImageIOType *                       p_clImageIO,
+               int                                 iLevel,
+               const ImageIOType::RegionContainer & vRegions,
+               const std::vector<unsigned char> &  vBatch,
+               itk::TimeProbe &                    clSingleProbe)
+{
+  const size_t patchBytes = vBatch.size() / vRegions.size();
+
+  std::vector<unsigned char> vPatch(patchBytes);
+
+  for (size_t i = 0; i < vRegions.size(); ++i)
+  {
+    clSingleProbe.Start();
+    p_clImageIO->ReadRegion(iLevel, vRegions[i], &vPatch[0]);
+    clSingleProbe.Stop();
+
+    if (std::memcmp(&vPatch[0], &vBatch[i * patchBytes], patchBytes) != 0)
+    {
+      std::cerr << "Error: Level " << iLevel << " patch " << i << " at " << vRegions[i].GetIndex(0) << ", "
+                << vRegions[i].GetIndex(1) << " differs from ReadRegion()." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // End anonymous namespace
+
+// Reads random patches and overlapping patches (which share native tiles) of each level with ReadRandomRegions() and
+// ReadRegions() and compares them with ReadRegion(). Equal seeds must draw equal patches. A diagonal chain of
+// overlapping patches forms one group whose bounding box is too large, so it has to be split.
+int
+itkOpenSlideTestRandomRegions(int argc, char * argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::SizeValueType patchSize = 64;
+  const itk::SizeValueType numberOfPatches = 256;
+
+  ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+  p_clImageIO->SetFileName(argv[1]);
+  p_clImageIO->SetOutputLayout(ImageIOType::OutputLayoutEnum::RGB);
+
+  itk::TimeProbe clBatchProbe;
+  itk::TimeProbe clSingleProbe;
+
+  try
+  {
+    p_clImageIO->ReadImageInformation();
+
+    const size_t patchBytes = 3 * patchSize * patchSize;
+
+    for (int iLevel = 0; iLevel < p_clImageIO->GetLevelCount(); ++iLevel)
+    {
+      itk::SizeValueType width = 0, height = 0;
+      p_clImageIO->GetLevelDimensions(iLevel, width, height);
+
+      if (width < 8 * patchSize || height < 8 * patchSize)
+        continue;
+
+      // Random patches, twice with the same seed
+      ImageIOType::RegionContainer vRegions1, vRegions2;
+      std::vector<unsigned char>   vBatch1(numberOfPatches * patchBytes), vBatch2(vBatch1.size());
+
+      clBatchProbe.Start();
+      p_clImageIO->ReadRandomRegions(iLevel, patchSize, patchSize, numberOfPatches, 1234, vRegions1, &vBatch1[0]);
+      clBatchProbe.Stop();
+
+      p_clImageIO->ReadRandomRegions(iLevel, patchSize, patchSize, numberOfPatches, 1234, vRegions2, &vBatch2[0]);
+
+      if (vRegions1 != vRegions2 || vBatch1 != vBatch2)
+      {
+        std::cerr << "Error: Equal seeds read different patches of level " << iLevel << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      if (!CompareRegions(p_clImageIO, iLevel, vRegions1, vBatch1, clSingleProbe))
+        return EXIT_FAILURE;
+
+      // Overlapping patches of the middle of the level with half a patch stride, at odd offsets
+      ImageIOType::RegionContainer vRegions;
+
+      for (itk::SizeValueType j = 0; j < 8; ++j)
+      {
+        for (itk::SizeValueType i = 0; i < 8; ++i)
+        {
+          itk::ImageIORegion clRegion(2);
+          clRegion.SetIndex(0, width / 2 + i * patchSize / 2 + (i % 3));
+          clRegion.SetIndex(1, height / 2 - 4 * patchSize + j * patchSize / 2 + (j % 3));
+          clRegion.SetSize(0, patchSize);
+          clRegion.SetSize(1, patchSize);
+          vRegions.push_back(clRegion);
+        }
+      }
+
+      std::vector<unsigned char> vBatch(vRegions.size() * patchBytes);
+
+      clBatchProbe.Start();
+      p_clImageIO->ReadRegions(iLevel, vRegions, &vBatch[0]);
+      clBatchProbe.Stop();
+
+      if (!CompareRegions(p_clImageIO, iLevel, vRegions, vBatch, clSingleProbe))
+        return EXIT_FAILURE;
+
+      // A diagonal chain of patches, each overlapping the previous one
+      const itk::SizeValueType step = patchSize / 2 + 1;
+      const itk::SizeValueType chainLength =
+        std::min<itk::SizeValueType>(32, (std::min(width, height) - patchSize) / step + 1);
+
+      vRegions.clear();
+
+      for (itk::SizeValueType k = 0; k < chainLength; ++k)
+      {
+        itk::ImageIORegion clRegion(2);
+        clRegion.SetIndex(0, k * step);
+        clRegion.SetIndex(1, k * step);
+        clRegion.SetSize(0, patchSize);
+        clRegion.SetSize(1, patchSize);
+        vRegions.push_back(clRegion);
+      }
+
+      vBatch.assign(vRegions.size() * patchBytes, 0);
+
+      clBatchProbe.Start();
+      p_clImageIO->ReadRegions(iLevel, vRegions, &vBatch[0]);
+      clBatchProbe.Stop();
+
+      if (!CompareRegions(p_clImageIO, iLevel, vRegions, vBatch, clSingleProbe))
+        return EXIT_FAILURE;
+    }
+
+    // A region outside of the level must fail
+    ImageIOType::RegionContainer vOutside(1, itk::ImageIORegion(2));
+    vOutside[0].SetIndex(0, p_clImageIO->GetDimensions(0));
+    vOutside[0].SetSize(0, patchSize);
+    vOutside[0].SetSize(1, patchSize);
+
+    std::vector<unsigned char> vBatch(patchBytes);
+
+    try
+    {
+      p_clImageIO->ReadRegions(0, vOutside, &vBatch[0]);
+      std::cerr << "Error: Reading a region outside of the image did not fail." << std::endl;
+      return EXIT_FAILURE;
+    }
+    catch (itk::ExceptionObject &)
+    {}
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Batched reads " << clBatchProbe.GetTotal() << " s, single reads " << clSingleProbe.GetTotal() << " s"
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+// Checks for the start (FFD8) and end (FFD9) markers of a JPEG stream
+bool
+IsJPEGStream(const std::vector<unsigned char> & vBuffer)
+{
+  return vBuffer.size() >= 4 && vBuffer[0] == 0xFF && vBuffer[1] == 0xD8 && vBuffer[vBuffer.size() - 2] == 0xFF &&
+         vBuffer[vBuffer.size() - 1] == 0xD9;
+}
+
+} // End anonymous namespace
+
+// Reads the compressed tiles of every level of a TIFF-based slide and checks that they are JPEG streams covering the
+// level. A slide of another format must report no raw tiles.
+int
+itkOpenSlideTestRawTiles(int argc, char * argv[])
+{
+  using ImageIOType = itk::OpenSlideImageIO;
+
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " tiffSlideFile otherSlideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ImageIOType::Pointer p_clImageIO = ImageIOType::New();
+  p_clImageIO->SetFileName(argv[1]);
+
+  try
+  {
+    p_clImageIO->ReadImageInformation();
+
+    for (int iLevel = 0; iLevel < p_clImageIO->GetLevelCount(); ++iLevel)
+    {
+      ImageIOType::RawTileLayout clLayout;
+      if (!p_clImageIO->GetRawTileLayout(iLevel, clLayout))
+      {
+        std::cerr << "Error: Level " << iLevel << " has no raw tiles." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      itk::SizeValueType width = 0, height = 0;
+      p_clImageIO->GetLevelDimensions(iLevel, width, height);
+
+      std::cout << "Level " << iLevel << ": directory " << clLayout.m_Directory << ", " << clLayout.m_TilesAcross
+                << " x " << clLayout.m_TilesDown << " tiles of " << clLayout.m_TileWidth << " x "
+                << clLayout.m_TileHeight << ", compression " << clLayout.m_Compression << ", photometric "
+                << clLayout.m_Photometric << ", " << clLayout.m_JPEGTables.size() << " bytes of JPEG tables"
+                << std::endl;
+
+      if (clLayout.m_Width != width || clLayout.m_Height != height ||
+          clLayout.m_TilesAcross * clLayout.m_TileWidth < width ||
+          (clLayout.m_TilesAcross - 1) * clLayout.m_TileWidth >= width ||
+          clLayout.m_TilesDown * clLayout.m_TileHeight < height ||
+          (clLayout.m_TilesDown - 1) * clLayout.m_TileHeight >= height)
+      {
+        std::cerr << "Error: Tiles of level " << iLevel << " do not cover the level image." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      // JPEG (7)
+      if (clLayout.m_Compression != 7 || (!clLayout.m_JPEGTables.empty() && !IsJPEGStream(clLayout.m_JPEGTables)))
+      {
+        std::cerr << "Error: Level " << iLevel << " is not JPEG compressed." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      std::vector<unsigned char> vTile;
+      for (itk::SizeValueType tileY = 0; tileY < clLayout.m_TilesDown; ++tileY)
+      {
+        for (itk::SizeValueType tileX = 0; tileX < clLayout.m_TilesAcross; ++tileX)
+        {
+          p_clImageIO->ReadRawTile(iLevel, tileX, tileY, vTile);
+
+          if (!IsJPEGStream(vTile))
+          {
+            std::cerr << "Error: Tile (" << tileX << ", " << tileY << ") of level " << iLevel
+                      << " is not a JPEG stream." << std::endl;
+            return EXIT_FAILURE;
+          }
+        }
+      }
+
+      bool bThrown = false;
+      try
+      {
+        p_clImageIO->ReadRawTile(iLevel, clLayout.m_TilesAcross, 0, vTile);
+      }
+      catch (itk::ExceptionObject &)
+      {
+        bThrown = true;
+      }
+
+      if (!bThrown)
+      {
+        std::cerr << "Error: Reading a tile outside of level " << iLevel << " did not throw." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    p_clImageIO->SetFileName(argv[2]);
+    p_clImageIO->ReadImageInformation();
+
+    ImageIOType::RawTileLayout clLayout;
+    if (p_clImageIO->GetRawTileLayout(0, clLayout))
+    {
+      std::cerr << "Error: " << argv[2] << " (" << p_clImageIO->GetVendor() << ") reports raw tiles." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideRegionReader.h"
+#include "itkImageFileReader.h"
+#include "itkImage.h"
+#include "itkRGBAPixel.h"
+#include "itkTimeProbe.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads the same random patches with OpenSlideRegionReader and with a new ImageFileReader per patch (the usual
+// pipeline path), checks that the pixels are identical and reports the time per patch of both.
+int
+itkOpenSlideTestRegionReader(int argc, char * argv[])
+{
+  using PixelType = itk::RGBAPixel<unsigned char>;
+  using ImageType = itk::Image<PixelType, 2>;
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  using RegionReaderType = itk::OpenSlideRegionReader<PixelType>;
+
+  if (argc != 4)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile numberOfPatches patchSize" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const       p_cSlideFile = argv[1];
+  const int                iNumPatches = std::atoi(argv[2]);
+  const itk::SizeValueType patchSize = std::strtoul(argv[3], NULL, 10);
+
+  RegionReaderType::Pointer p_clRegionReader = RegionReaderType::New();
+  itk::SizeValueType        width = 0, height = 0;
+
+  p_clRegionReader->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clRegionReader->Open();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!p_clRegionReader->GetLevelDimensions(0, width, height) || width < patchSize || height < patchSize)
+  {
+    std::cerr << "Error: Slide is smaller than a patch." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937                                       clGenerator(42);
+  std::uniform_int_distribution<itk::IndexValueType> clXDistribution(0, width - patchSize);
+  std::uniform_int_distribution<itk::IndexValueType> clYDistribution(0, height - patchSize);
+
+  std::vector<ImageType::IndexType> vIndices(iNumPatches);
+  for (int i = 0; i < iNumPatches; ++i)
+  {
+    vIndices[i][0] = clXDistribution(clGenerator);
+    vIndices[i][1] = clYDistribution(clGenerator);
+  }
+
+  std::vector<PixelType> vPatches(iNumPatches * patchSize * patchSize);
+  itk::TimeProbe         clRegionReaderProbe, clPipelineProbe;
+
+  try
+  {
+    clRegionReaderProbe.Start();
+
+    for (int i = 0; i < iNumPatches; ++i)
+    {
+      p_clRegionReader->ReadPatch(
+        0, vIndices[i][0], vIndices[i][1], patchSize, patchSize, &vPatches[i * patchSize * patchSize]);
+    }
+
+    clRegionReaderProbe.Stop();
+
+    ImageType::SizeType clSize;
+    clSize.Fill(patchSize);
+
+    clPipelineProbe.Start();
+
+    for (int i = 0; i < iNumPatches; ++i)
+    {
+      ReaderType::Pointer p_clReader = ReaderType::New();
+      p_clReader->SetImageIO(itk::OpenSlideImageIO::New());
+      p_clReader->SetFileName(p_cSlideFile);
+      p_clReader->UpdateOutputInformation();
+      p_clReader->GetOutput()->SetRequestedRegion(ImageType::RegionType(vIndices[i], clSize));
+      p_clReader->Update();
+
+      // The reader may read a larger region, so compare row by row
+      ImageType::Pointer p_clImage = p_clReader->GetOutput();
+
+      for (itk::SizeValueType y = 0; y < patchSize; ++y)
+      {
+        ImageType::IndexType clIndex = vIndices[i];
+        clIndex[1] += y;
+
+        if (std::memcmp(p_clImage->GetBufferPointer() + p_clImage->ComputeOffset(clIndex),
+                        &vPatches[(i * patchSize + y) * patchSize],
+                        patchSize * sizeof(PixelType)) != 0)
+        {
+          std::cerr << "Error: Patch " << i << " differs in row " << y << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+
+    clPipelineProbe.Stop();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The pipeline time includes the comparison, which is negligible next to reading
+  std::cout << "OpenSlideRegionReader: " << 1000.0 * clRegionReaderProbe.GetTotal() / iNumPatches << " ms per patch"
+            << std::endl;
+  std::cout << "ImageFileReader: " << 1000.0 * clPipelineProbe.GetTotal() / iNumPatches << " ms per patch"
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
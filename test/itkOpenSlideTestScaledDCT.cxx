@@ -0,0 +1,154 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+#include "itkTimeProbe.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads a region at spacings 1 to 12 times that of level 0 with exact and scaled DCT resampling and compares them.
+// Level spacings must give the same pixels; other spacings may only differ by the documented accuracy.
+int
+itkOpenSlideTestScaledDCT(int argc, char * argv[])
+{
+  using ImageIOType = itk::OpenSlideImageIO;
+  using PixelType = itk::RGBAPixel<unsigned char>;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::SizeValueType regionSize = 256;
+  const double             a_dFactors[] = { 1.0, 2.0, 3.0, 4.0, 8.0, 12.0 };
+
+  ImageIOType::Pointer p_clExactIO = ImageIOType::New();
+  ImageIOType::Pointer p_clScaledIO = ImageIOType::New();
+
+  p_clExactIO->SetFileName(argv[1]);
+  p_clScaledIO->SetFileName(argv[1]);
+  p_clScaledIO->SetResamplingMode(ImageIOType::ResamplingEnum::ScaledDCT);
+
+  itk::TimeProbe clExactProbe;
+  itk::TimeProbe clScaledProbe;
+
+  try
+  {
+    p_clExactIO->ReadImageInformation();
+    p_clScaledIO->ReadImageInformation();
+
+    const double dSpacing0 = p_clExactIO->GetSpacing(0);
+
+    for (const double dFactor : a_dFactors)
+    {
+      const double a_dSpacing[2] = { dFactor * dSpacing0, dFactor * dSpacing0 };
+
+      // A region in the middle of the grid
+      const itk::SizeValueType width = (itk::SizeValueType)(p_clExactIO->GetDimensions(0) / dFactor);
+      const itk::SizeValueType height = (itk::SizeValueType)(p_clExactIO->GetDimensions(1) / dFactor);
+
+      if (width < regionSize || height < regionSize)
+        continue;
+
+      itk::ImageIORegion clRegion(2);
+      clRegion.SetIndex(0, (width - regionSize) / 2);
+      clRegion.SetIndex(1, (height - regionSize) / 2);
+      clRegion.SetSize(0, regionSize);
+      clRegion.SetSize(1, regionSize);
+
+      std::vector<PixelType> vExact(clRegion.GetNumberOfPixels());
+      std::vector<PixelType> vScaled(clRegion.GetNumberOfPixels());
+
+      clExactProbe.Start();
+      const int iExactLevel = p_clExactIO->ReadRegionAtSpacing(a_dSpacing, clRegion, &vExact[0]);
+      clExactProbe.Stop();
+
+      const uint64_t ui64DecodedTiles = p_clScaledIO->GetNumberOfDirectlyDecodedTiles();
+
+      clScaledProbe.Start();
+      const int iScaledLevel = p_clScaledIO->ReadRegionAtSpacing(a_dSpacing, clRegion, &vScaled[0]);
+      clScaledProbe.Stop();
+
+      if (iExactLevel != iScaledLevel)
+      {
+        std::cerr << "Error: Factor " << dFactor << " read level " << iExactLevel << " and " << iScaledLevel << '.'
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      double dSum = 0.0;
+      int    iMax = 0;
+
+      for (size_t i = 0; i < vExact.size(); ++i)
+      {
+        for (unsigned int c = 0; c < 4; ++c)
+        {
+          const int iDiff = std::abs((int)vExact[i][c] - (int)vScaled[i][c]);
+
+          dSum += iDiff;
+          iMax = std::max(iMax, iDiff);
+        }
+      }
+
+      const double dMean = dSum / (4.0 * vExact.size());
+      const bool   bLevelSpacing =
+        std::fabs(dFactor - p_clExactIO->GetLevelDownsample(iExactLevel)) < 1e-3 * dFactor;
+
+      std::cout << "Factor " << dFactor << " (level " << iExactLevel << "): mean difference " << dMean
+                << ", maximum difference " << iMax << std::endl;
+
+      // At least twice the level spacing, 8 bit JPEG tiles must have been decoded at a reduced size (direct tile
+      // decoding is off, so the scaled DCT path is the only one that counts decoded tiles)
+      ImageIOType::RawTileLayout clLayout;
+
+      const bool bJPEG = p_clScaledIO->GetRawTileLayout(iScaledLevel, clLayout) && clLayout.m_Compression == 7 &&
+                         clLayout.m_BitsPerSample == 8;
+
+      if (bJPEG && dFactor >= 2.0 * p_clScaledIO->GetLevelDownsample(iScaledLevel) &&
+          p_clScaledIO->GetNumberOfDirectlyDecodedTiles() == ui64DecodedTiles)
+      {
+        std::cerr << "Error: Factor " << dFactor << " did not decode any tile with a scaled DCT." << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      if ((bLevelSpacing && iMax != 0) || dMean > 2.0)
+      {
+        std::cerr << "Error: Scaled DCT resampling differs too much at factor " << dFactor << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Exact " << clExactProbe.GetTotal() << " s, scaled DCT " << clScaledProbe.GetTotal() << " s"
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
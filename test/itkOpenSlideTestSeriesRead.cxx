@@ -0,0 +1,171 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideSeriesImageIO.h"
+#include "itkImageFileReader.h"
+#include "itkImage.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads the given slides as one volume, in full and streamed, and compares every slice with the slide read on its own.
+int
+itkOpenSlideTestSeriesRead(int argc, char * argv[])
+{
+  using PixelType = itk::RGBAPixel<unsigned char>;
+  using SliceImageType = itk::Image<PixelType, 2>;
+  using VolumeImageType = itk::Image<PixelType, 3>;
+  using SeriesIOType = itk::OpenSlideSeriesImageIO;
+  using SliceReaderType = itk::ImageFileReader<SliceImageType>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeImageType>;
+
+  if (argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile1 slideFile2 [slideFile3 ...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  SeriesIOType::FileNamesContainer vFileNames(argv + 1, argv + argc);
+
+  SeriesIOType::Pointer     p_clSeriesIO = SeriesIOType::New();
+  VolumeReaderType::Pointer p_clVolumeReader = VolumeReaderType::New();
+
+  p_clSeriesIO->SetFileNames(vFileNames);
+  p_clVolumeReader->SetImageIO(p_clSeriesIO);
+  p_clVolumeReader->SetFileName(vFileNames[0]);
+
+  try
+  {
+    p_clVolumeReader->Update();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  VolumeImageType::Pointer        p_clVolume = p_clVolumeReader->GetOutput();
+  const VolumeImageType::SizeType clVolumeSize = p_clVolume->GetLargestPossibleRegion().GetSize();
+
+  std::cout << "Volume dimensions = " << clVolumeSize << std::endl;
+
+  if (clVolumeSize[2] != vFileNames.size())
+  {
+    std::cerr << "Error: Expected " << vFileNames.size() << " slices." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t slicePixels = clVolumeSize[0] * clVolumeSize[1];
+
+  std::vector<SliceImageType::Pointer> vSlices;
+
+  for (size_t z = 0; z < vFileNames.size(); ++z)
+  {
+    SliceReaderType::Pointer p_clSliceReader = SliceReaderType::New();
+    p_clSliceReader->SetImageIO(itk::OpenSlideImageIO::New());
+    p_clSliceReader->SetFileName(vFileNames[z]);
+
+    try
+    {
+      p_clSliceReader->Update();
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    SliceImageType::Pointer         p_clSlice = p_clSliceReader->GetOutput();
+    const SliceImageType::SizeType  clSliceSize = p_clSlice->GetLargestPossibleRegion().GetSize();
+    const PixelType * const         p_clVolumeSlice = p_clVolume->GetBufferPointer() + z * slicePixels;
+
+    if (clSliceSize[0] > clVolumeSize[0] || clSliceSize[1] > clVolumeSize[1])
+    {
+      std::cerr << "Error: Slice " << z << " is larger than the volume." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (size_t y = 0; y < clSliceSize[1]; ++y)
+    {
+      if (std::memcmp(p_clSlice->GetBufferPointer() + y * clSliceSize[0],
+                      p_clVolumeSlice + y * clVolumeSize[0],
+                      clSliceSize[0] * sizeof(PixelType)) != 0)
+      {
+        std::cerr << "Error: Slice " << z << " differs in row " << y << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    vSlices.push_back(p_clSlice);
+  }
+
+  // Streamed read of a sub-volume spanning all slices
+  const size_t width = clVolumeSize[0] / 2;
+  const size_t height = clVolumeSize[1] / 2;
+  const size_t x0 = clVolumeSize[0] / 4;
+  const size_t y0 = clVolumeSize[1] / 4;
+
+  itk::ImageIORegion clRegion(3);
+  clRegion.SetIndex(0, x0);
+  clRegion.SetIndex(1, y0);
+  clRegion.SetIndex(2, 0);
+  clRegion.SetSize(0, width);
+  clRegion.SetSize(1, height);
+  clRegion.SetSize(2, vFileNames.size());
+
+  std::vector<PixelType> vBuffer(width * height * vFileNames.size());
+
+  try
+  {
+    // With one open slide at a time, each slice is released and opened again in turn
+    p_clSeriesIO->SetMaximumNumberOfOpenSlides(1);
+    p_clSeriesIO->SetIORegion(clRegion);
+    p_clSeriesIO->Read(&vBuffer[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (size_t z = 0; z < vSlices.size(); ++z)
+  {
+    const SliceImageType::SizeType clSliceSize = vSlices[z]->GetLargestPossibleRegion().GetSize();
+
+    for (size_t y = 0; y < height && y0 + y < clSliceSize[1]; ++y)
+    {
+      const size_t rowWidth = std::min(width, clSliceSize[0] - std::min<size_t>(x0, clSliceSize[0]));
+
+      if (std::memcmp(vSlices[z]->GetBufferPointer() + (y0 + y) * clSliceSize[0] + x0,
+                      &vBuffer[(z * height + y) * width],
+                      rowWidth * sizeof(PixelType)) != 0)
+      {
+        std::cerr << "Error: Streamed slice " << z << " differs in row " << y << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Accumulates statistics while reading the image in four regions and with ReadStatistics() and compares both with
+// statistics computed from the pixels.
+int
+itkOpenSlideTestStatistics(int argc, char * argv[])
+{
+  using ImageIOType = itk::OpenSlideImageIO;
+  using PixelType = itk::RGBAPixel<unsigned char>;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ImageIOType::Pointer p_clReadIO = ImageIOType::New();
+  ImageIOType::Pointer p_clStatisticsIO = ImageIOType::New();
+
+  p_clReadIO->SetFileName(argv[1]);
+  p_clReadIO->SetComputeStatistics(true);
+  p_clStatisticsIO->SetFileName(argv[1]);
+
+  std::vector<PixelType> vPixels;
+
+  try
+  {
+    p_clReadIO->ReadImageInformation();
+    p_clStatisticsIO->ReadImageInformation();
+
+    // Four quadrants (the last ones take the odd rows and columns)
+    const itk::SizeValueType width = p_clReadIO->GetDimensions(0);
+    const itk::SizeValueType height = p_clReadIO->GetDimensions(1);
+
+    vPixels.resize(width * height);
+
+    for (unsigned int j = 0; j < 2; ++j)
+    {
+      for (unsigned int i = 0; i < 2; ++i)
+      {
+        itk::ImageIORegion clRegion(2);
+        clRegion.SetIndex(0, i * (width / 2));
+        clRegion.SetIndex(1, j * (height / 2));
+        clRegion.SetSize(0, i == 0 ? width / 2 : width - width / 2);
+        clRegion.SetSize(1, j == 0 ? height / 2 : height - height / 2);
+
+        std::vector<PixelType> vRegion(clRegion.GetNumberOfPixels());
+        p_clReadIO->ReadRegion(0, clRegion, &vRegion[0]);
+
+        for (itk::SizeValueType y = 0; y < clRegion.GetSize(1); ++y)
+        {
+          std::copy(vRegion.begin() + y * clRegion.GetSize(0),
+                    vRegion.begin() + (y + 1) * clRegion.GetSize(0),
+                    vPixels.begin() + (clRegion.GetIndex(1) + y) * width + clRegion.GetIndex(0));
+        }
+      }
+    }
+
+    p_clStatisticsIO->ReadStatistics();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Reference statistics
+  std::vector<ImageIOType::HistogramType> vHistograms(4, ImageIOType::HistogramType(256, 0));
+  uint64_t                                ui64TissuePixels = 0;
+
+  for (size_t i = 0; i < vPixels.size(); ++i)
+  {
+    const PixelType & clPixel = vPixels[i];
+
+    for (unsigned int c = 0; c < 4; ++c)
+      ++vHistograms[c][clPixel[c]];
+
+    const int iMax = std::max(clPixel[0], std::max(clPixel[1], clPixel[2]));
+    const int iMin = std::min(clPixel[0], std::min(clPixel[1], clPixel[2]));
+
+    if (clPixel[3] != 0 && iMax - iMin >= (int)p_clReadIO->GetTissueSaturationThreshold())
+      ++ui64TissuePixels;
+  }
+
+  const double dTissueFraction = (double)ui64TissuePixels / vPixels.size();
+
+  const ImageIOType * const a_p_clIOs[2] = { p_clReadIO.GetPointer(), p_clStatisticsIO.GetPointer() };
+
+  for (const ImageIOType * const p_clIO : a_p_clIOs)
+  {
+    const char * const p_cName = p_clIO == p_clReadIO.GetPointer() ? "Read" : "ReadStatistics";
+
+    std::cout << p_cName << ": " << p_clIO->GetNumberOfStatisticsPixels() << " pixels, mean = " << p_clIO->GetMean(0)
+              << ", " << p_clIO->GetMean(1) << ", " << p_clIO->GetMean(2)
+              << ", tissue fraction = " << p_clIO->GetTissueFraction() << std::endl;
+
+    if (p_clIO->GetNumberOfStatisticsPixels() != vPixels.size())
+    {
+      std::cerr << "Error: " << p_cName << " counted " << p_clIO->GetNumberOfStatisticsPixels() << " pixels."
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+      if (p_clIO->GetHistogram(c) != vHistograms[c])
+      {
+        std::cerr << "Error: " << p_cName << " histogram of channel " << c << " differs." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (std::fabs(p_clIO->GetTissueFraction() - dTissueFraction) > 1e-12)
+    {
+      std::cerr << "Error: " << p_cName << " tissue fraction differs (" << p_clIO->GetTissueFraction()
+                << " != " << dTissueFraction << ")." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads the image in overlapping strips with a halo around them (like a neighborhood filter streaming its input),
+// reusing the borders of the previous strip, and compares the strips with the whole image and its padding.
+int
+itkOpenSlideTestStreamingBorders(int argc, char * argv[])
+{
+  using ImageIOType = itk::OpenSlideImageIO;
+  using PixelType = itk::RGBAPixel<unsigned char>;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::IndexValueType radius = 3;
+  const itk::IndexValueType stripHeight = 64;
+
+  ImageIOType::Pointer p_clReferenceIO = ImageIOType::New();
+  p_clReferenceIO->SetFileName(argv[1]);
+
+  std::vector<PixelType> vImage;
+  itk::IndexValueType    width = 0, height = 0;
+
+  try
+  {
+    p_clReferenceIO->ReadImageInformation();
+
+    width = p_clReferenceIO->GetDimensions(0);
+    height = p_clReferenceIO->GetDimensions(1);
+
+    itk::ImageIORegion clRegion(2);
+    clRegion.SetSize(0, width);
+    clRegion.SetSize(1, height);
+
+    vImage.resize(clRegion.GetNumberOfPixels());
+    p_clReferenceIO->ReadRegion(0, clRegion, &vImage[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const ImageIOType::PaddingEnum a_ePaddingModes[2] = { ImageIOType::PaddingEnum::Transparent,
+                                                         ImageIOType::PaddingEnum::Replicate };
+
+  for (const ImageIOType::PaddingEnum ePaddingMode : a_ePaddingModes)
+  {
+    const bool bReplicate = ePaddingMode == ImageIOType::PaddingEnum::Replicate;
+
+    ImageIOType::Pointer p_clIO = ImageIOType::New();
+    p_clIO->SetFileName(argv[1]);
+    p_clIO->SetReuseStreamingBorders(true);
+    p_clIO->SetPaddingMode(ePaddingMode);
+
+    uint64_t ui64ExpectedReused = 0, ui64ExpectedPadded = 0;
+
+    try
+    {
+      p_clIO->ReadImageInformation();
+
+      for (itk::IndexValueType y0 = 0; y0 < height; y0 += stripHeight)
+      {
+        const itk::IndexValueType y1 = std::min(y0 + stripHeight, height);
+
+        itk::ImageIORegion clRegion(2);
+        clRegion.SetIndex(0, -radius);
+        clRegion.SetIndex(1, y0 - radius);
+        clRegion.SetSize(0, width + 2 * radius);
+        clRegion.SetSize(1, y1 - y0 + 2 * radius);
+
+        std::vector<PixelType> vStrip(clRegion.GetNumberOfPixels());
+        p_clIO->SetIORegion(clRegion);
+        p_clIO->Read(&vStrip[0]);
+
+        // The rows inside of the image overlap those of the previous strip by 2 * radius
+        const itk::IndexValueType insideBegin = std::max<itk::IndexValueType>(y0 - radius, 0);
+        const itk::IndexValueType insideEnd = std::min(y1 + radius, height);
+
+        if (y0 > 0)
+          ui64ExpectedReused += (uint64_t)(std::min(y0 + radius, insideEnd) - insideBegin) * width;
+
+        ui64ExpectedPadded += clRegion.GetNumberOfPixels() - (uint64_t)(insideEnd - insideBegin) * width;
+
+        for (itk::SizeValueType j = 0; j < clRegion.GetSize(1); ++j)
+        {
+          const itk::IndexValueType y = clRegion.GetIndex(1) + (itk::IndexValueType)j;
+
+          for (itk::SizeValueType i = 0; i < clRegion.GetSize(0); ++i)
+          {
+            const itk::IndexValueType x = clRegion.GetIndex(0) + (itk::IndexValueType)i;
+            const bool                bInside = x >= 0 && x < width && y >= 0 && y < height;
+
+            PixelType clExpected;
+            clExpected.Fill(0);
+
+            if (bInside || bReplicate)
+            {
+              clExpected = vImage[std::min(std::max<itk::IndexValueType>(y, 0), height - 1) * width +
+                                  std::min(std::max<itk::IndexValueType>(x, 0), width - 1)];
+            }
+
+            if (vStrip[j * clRegion.GetSize(0) + i] != clExpected)
+            {
+              std::cerr << "Error: Pixel (" << x << ", " << y << ") of the strip at row " << y0
+                        << " differs (padding mode " << static_cast<int>(ePaddingMode) << ")." << std::endl;
+              return EXIT_FAILURE;
+            }
+          }
+        }
+      }
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::cout << "Padding mode " << static_cast<int>(ePaddingMode) << ": " << p_clIO->GetNumberOfReusedPixels()
+              << " reused pixels, " << p_clIO->GetNumberOfPaddedPixels() << " padded pixels" << std::endl;
+
+    if (p_clIO->GetNumberOfReusedPixels() != ui64ExpectedReused)
+    {
+      std::cerr << "Error: Expected " << ui64ExpectedReused << " reused pixels." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (p_clIO->GetNumberOfPaddedPixels() != ui64ExpectedPadded)
+    {
+      std::cerr << "Error: Expected " << ui64ExpectedPadded << " padded pixels." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
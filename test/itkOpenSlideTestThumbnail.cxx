@@ -0,0 +1,160 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Reads a thumbnail and checks its size and that its mean color matches the mean color of the lowest level. Also reads
+// the tissue mask of the thumbnail and checks it against the saturation of the thumbnail pixels.
+int
+itkOpenSlideTestThumbnail(int argc, char * argv[])
+{
+  using ImageIOType = itk::OpenSlideImageIO;
+  using PixelType = itk::RGBAPixel<unsigned char>;
+
+  if (argc != 4)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile maxWidth maxHeight" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const               p_cSlideFile = argv[1];
+  const ImageIOType::SizeValueType maxWidth = std::strtoul(argv[2], NULL, 10);
+  const ImageIOType::SizeValueType maxHeight = std::strtoul(argv[3], NULL, 10);
+
+  ImageIOType::Pointer       p_clImageIO = ImageIOType::New();
+  std::vector<unsigned char> vThumbnail;
+  ImageIOType::SizeValueType width = 0, height = 0;
+  std::vector<PixelType>     vLevel;
+  ImageIOType::TissueMask    clMask = ImageIOType::TissueMask();
+
+  const unsigned int saturationThreshold = 20;
+
+  p_clImageIO->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clImageIO->ReadImageInformation();
+    p_clImageIO->ReadThumbnail(maxWidth, maxHeight, vThumbnail, width, height);
+    p_clImageIO->ReadTissueMask(maxWidth, maxHeight, saturationThreshold, clMask);
+
+    // The lowest level as reference
+    p_clImageIO->SetLevel(p_clImageIO->GetLevelCount() - 1);
+    p_clImageIO->ReadImageInformation();
+
+    itk::ImageIORegion clRegion(2);
+    clRegion.SetSize(0, p_clImageIO->GetDimensions(0));
+    clRegion.SetSize(1, p_clImageIO->GetDimensions(1));
+
+    vLevel.resize(clRegion.GetNumberOfPixels());
+    p_clImageIO->ReadRegion(p_clImageIO->GetLevel(), clRegion, &vLevel[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Thumbnail dimensions = " << width << " x " << height << std::endl;
+
+  if (width == 0 || height == 0 || width > maxWidth || height > maxHeight || vThumbnail.size() != 3 * width * height)
+  {
+    std::cerr << "Error: Unexpected thumbnail size." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // One of the sides fits exactly unless level 0 is smaller than the maximum size
+  ImageIOType::SizeValueType level0Width = 0, level0Height = 0;
+  p_clImageIO->GetLevelDimensions(0, level0Width, level0Height);
+
+  if (width != std::min(maxWidth, level0Width) && height != std::min(maxHeight, level0Height))
+  {
+    std::cerr << "Error: Thumbnail does not fill the maximum size." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (unsigned int c = 0; c < 3; ++c)
+  {
+    double dThumbnailMean = 0.0, dLevelMean = 0.0;
+
+    for (size_t i = 0; i < width * height; ++i)
+      dThumbnailMean += vThumbnail[3 * i + c];
+
+    for (size_t i = 0; i < vLevel.size(); ++i)
+      dLevelMean += vLevel[i][c];
+
+    dThumbnailMean /= width * height;
+    dLevelMean /= vLevel.size();
+
+    std::cout << "Channel " << c << ": thumbnail mean = " << dThumbnailMean << ", level mean = " << dLevelMean
+              << std::endl;
+
+    // Associated thumbnails are compressed separately, so allow for some difference
+    if (std::fabs(dThumbnailMean - dLevelMean) > 5.0)
+    {
+      std::cerr << "Error: Mean of channel " << c << " differs." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // The slide is opaque, so the mask only depends on the saturation
+  if (clMask.m_Width != width || clMask.m_Height != height || clMask.m_Pixels.size() != width * height ||
+      clMask.m_Integral.size() != (width + 1) * (height + 1))
+  {
+    std::cerr << "Error: Unexpected tissue mask size." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  unsigned int tissue = 0;
+
+  for (size_t i = 0; i < width * height; ++i)
+  {
+    const unsigned char * const p_ucRGB = &vThumbnail[3 * i];
+
+    const int maximum = std::max(p_ucRGB[0], std::max(p_ucRGB[1], p_ucRGB[2]));
+    const int minimum = std::min(p_ucRGB[0], std::min(p_ucRGB[1], p_ucRGB[2]));
+
+    if (clMask.m_Pixels[i] != ((unsigned int)(maximum - minimum) >= saturationThreshold ? 1 : 0))
+    {
+      std::cerr << "Error: Tissue mask pixel " << i << " differs." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    tissue += clMask.m_Pixels[i];
+  }
+
+  const double dTissueFraction =
+    clMask.ComputeTissueFraction(level0Width, level0Height, 0, 0, level0Width, level0Height);
+
+  std::cout << "Tissue fraction = " << dTissueFraction << std::endl;
+
+  if (clMask.m_Integral.back() != tissue || std::fabs(dTissueFraction - (double)tissue / (width * height)) > 1e-12)
+  {
+    std::cerr << "Error: Tissue mask sums differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
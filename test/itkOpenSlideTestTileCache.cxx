@@ -0,0 +1,322 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkRGBAPixel.h"
+#include "itksys/Directory.hxx"
+#include "itksys/SystemTools.hxx"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+namespace
+{
+
+using ImageIOType = itk::OpenSlideImageIO;
+using PixelType = itk::RGBAPixel<unsigned char>;
+
+// Reads a region of the current level. Returns false on failure.
+bool
+ReadPatch(ImageIOType * p_clIO, int iLevel, const itk::ImageIORegion & clRegion, std::vector<PixelType> & vPixels)
+{
+  vPixels.resize(clRegion.GetNumberOfPixels());
+
+  try
+  {
+    p_clIO->ReadRegion(iLevel, clRegion, &vPixels[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Returns the total size of the cached tiles in the directory
+uint64_t
+GetCacheBytes(const std::string & strCacheDirectory)
+{
+  itksys::Directory clDirectory;
+  if (!clDirectory.Load(strCacheDirectory))
+    return 0;
+
+  uint64_t ui64Bytes = 0;
+
+  for (unsigned long i = 0; i < clDirectory.GetNumberOfFiles(); ++i)
+  {
+    const std::string strName = clDirectory.GetFile(i);
+
+    if (strName.size() > 7 && strName.compare(strName.size() - 7, 7, ".ostile") == 0)
+      ui64Bytes += itksys::SystemTools::FileLength(strCacheDirectory + '/' + strName);
+  }
+
+  return ui64Bytes;
+}
+
+} // end anonymous namespace
+
+// Reads the same regions of each level twice through the tile cache (the second time with a new ImageIO, as another
+// training epoch would) and compares them with regions read without the cache. Then the same directory is read with
+// and without approximate streaming (different tile grids at levels > 0), and finally a small size limit must hold
+// while the tiles of a region that keeps being read stay cached.
+int
+itkOpenSlideTestTileCache(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile cacheDirectory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char * const p_cSlideFile = argv[1];
+  const std::string  strCacheDirectory = argv[2];
+  const size_t       patchSize = 300;
+
+  itksys::SystemTools::RemoveADirectory(strCacheDirectory);
+
+  ImageIOType::Pointer p_clRefIO = ImageIOType::New();
+  p_clRefIO->SetFileName(p_cSlideFile);
+
+  try
+  {
+    p_clRefIO->ReadImageInformation();
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const int iLevelCount = p_clRefIO->GetLevelCount();
+
+  for (int iPass = 0; iPass < 2; ++iPass)
+  {
+    ImageIOType::Pointer p_clCacheIO = ImageIOType::New();
+    p_clCacheIO->SetFileName(p_cSlideFile);
+    p_clCacheIO->SetTileCacheDirectory(strCacheDirectory);
+
+    for (int iLevel = 0; iLevel < iLevelCount; ++iLevel)
+    {
+      std::vector<PixelType> vReference, vCached;
+      itk::ImageIORegion     clRegion(2);
+
+      try
+      {
+        p_clRefIO->SetLevel(iLevel);
+        p_clRefIO->ReadImageInformation();
+
+        p_clCacheIO->SetLevel(iLevel);
+        p_clCacheIO->ReadImageInformation();
+
+        // An unaligned region in the middle of the level
+        const size_t width = std::min<size_t>(patchSize, p_clRefIO->GetDimensions(0));
+        const size_t height = std::min<size_t>(patchSize, p_clRefIO->GetDimensions(1));
+
+        clRegion.SetIndex(0, (p_clRefIO->GetDimensions(0) - width) / 2);
+        clRegion.SetIndex(1, (p_clRefIO->GetDimensions(1) - height) / 2);
+        clRegion.SetSize(0, width);
+        clRegion.SetSize(1, height);
+
+        vReference.resize(width * height);
+        vCached.resize(width * height);
+
+        p_clRefIO->ReadRegion(iLevel, clRegion, &vReference[0]);
+        p_clCacheIO->ReadRegion(iLevel, clRegion, &vCached[0]);
+      }
+      catch (itk::ExceptionObject & e)
+      {
+        std::cerr << "Error: " << e << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      std::cout << "Pass " << iPass << ", level " << iLevel << ": " << p_clCacheIO->GetTileCacheHits() << " hits, "
+                << p_clCacheIO->GetTileCacheMisses() << " misses" << std::endl;
+
+      if (std::memcmp(&vReference[0], &vCached[0], vReference.size() * sizeof(PixelType)) != 0)
+      {
+        std::cerr << "Error: Pass " << iPass << " differs from the uncached read at level " << iLevel << '.'
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      // The second pass must not decode any cached tile again
+      if (iPass == 1 && p_clCacheIO->GetTileCacheMisses() != 0)
+      {
+        std::cerr << "Error: Tile cache missed on the second pass at level " << iLevel << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // Approximate streaming on and then off against the same directory
+  for (int iApproximate = 1; iApproximate >= 0; --iApproximate)
+  {
+    ImageIOType::Pointer p_clApproximateRefIO = ImageIOType::New();
+    p_clApproximateRefIO->SetFileName(p_cSlideFile);
+    p_clApproximateRefIO->SetApproximateStreaming(iApproximate != 0);
+
+    ImageIOType::Pointer p_clCacheIO = ImageIOType::New();
+    p_clCacheIO->SetFileName(p_cSlideFile);
+    p_clCacheIO->SetApproximateStreaming(iApproximate != 0);
+    p_clCacheIO->SetTileCacheDirectory(strCacheDirectory);
+
+    for (int iLevel = 0; iLevel < iLevelCount; ++iLevel)
+    {
+      itk::ImageIORegion clRegion(2);
+
+      try
+      {
+        p_clApproximateRefIO->SetLevel(iLevel);
+        p_clApproximateRefIO->ReadImageInformation();
+
+        p_clCacheIO->SetLevel(iLevel);
+        p_clCacheIO->ReadImageInformation();
+      }
+      catch (itk::ExceptionObject & e)
+      {
+        std::cerr << "Error: " << e << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      // An unaligned region at the top left (background for most slides) and one in the middle
+      const size_t width = std::min<size_t>(patchSize, p_clCacheIO->GetDimensions(0));
+      const size_t height = std::min<size_t>(patchSize, p_clCacheIO->GetDimensions(1));
+
+      clRegion.SetSize(0, width);
+      clRegion.SetSize(1, height);
+
+      for (int iRegion = 0; iRegion < 2; ++iRegion)
+      {
+        clRegion.SetIndex(0, iRegion == 0 ? std::min<size_t>(7, p_clCacheIO->GetDimensions(0) - width)
+                                          : (p_clCacheIO->GetDimensions(0) - width) / 2);
+        clRegion.SetIndex(1, iRegion == 0 ? std::min<size_t>(7, p_clCacheIO->GetDimensions(1) - height)
+                                          : (p_clCacheIO->GetDimensions(1) - height) / 2);
+
+        std::vector<PixelType> vReference, vCached;
+
+        if (!ReadPatch(p_clApproximateRefIO, iLevel, clRegion, vReference) ||
+            !ReadPatch(p_clCacheIO, iLevel, clRegion, vCached))
+          return EXIT_FAILURE;
+
+        if (std::memcmp(&vReference[0], &vCached[0], vReference.size() * sizeof(PixelType)) != 0)
+        {
+          std::cerr << "Error: Cached read with approximate streaming " << (iApproximate != 0 ? "on" : "off")
+                    << " differs from the uncached read at level " << iLevel << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  // A size limit of a few tiles while reading 8 x 8 regions spread over level 0, re-reading one region after each
+  {
+    const uint64_t ui64MaximumBytes = 4 << 20;
+
+    itksys::SystemTools::RemoveADirectory(strCacheDirectory);
+
+    ImageIOType::Pointer p_clCacheIO = ImageIOType::New();
+    p_clCacheIO->SetFileName(p_cSlideFile);
+    p_clCacheIO->SetTileCacheDirectory(strCacheDirectory);
+    p_clCacheIO->SetTileCacheSize(ui64MaximumBytes);
+
+    try
+    {
+      p_clCacheIO->SetLevel(0);
+      p_clCacheIO->ReadImageInformation();
+    }
+    catch (itk::ExceptionObject & e)
+    {
+      std::cerr << "Error: " << e << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const size_t width = std::min<size_t>(patchSize, p_clCacheIO->GetDimensions(0));
+    const size_t height = std::min<size_t>(patchSize, p_clCacheIO->GetDimensions(1));
+
+    itk::ImageIORegion clRecentRegion(2);
+    clRecentRegion.SetIndex(0, (p_clCacheIO->GetDimensions(0) - width) / 2);
+    clRecentRegion.SetIndex(1, (p_clCacheIO->GetDimensions(1) - height) / 2);
+    clRecentRegion.SetSize(0, width);
+    clRecentRegion.SetSize(1, height);
+
+    std::vector<PixelType> vRecent, vPixels;
+
+    if (!ReadPatch(p_clCacheIO, 0, clRecentRegion, vRecent))
+      return EXIT_FAILURE;
+
+    itk::ImageIORegion clRegion(2);
+    clRegion.SetSize(0, width);
+    clRegion.SetSize(1, height);
+
+    for (size_t j = 0; j < 8; ++j)
+    {
+      for (size_t i = 0; i < 8; ++i)
+      {
+        const size_t x = (p_clCacheIO->GetDimensions(0) - width) * i / 7;
+        const size_t y = (p_clCacheIO->GetDimensions(1) - height) * j / 7;
+
+        clRegion.SetIndex(0, x);
+        clRegion.SetIndex(1, y);
+
+        if (!ReadPatch(p_clCacheIO, 0, clRegion, vPixels))
+          return EXIT_FAILURE;
+
+        const uint64_t ui64Bytes = GetCacheBytes(strCacheDirectory);
+        if (ui64Bytes > ui64MaximumBytes)
+        {
+          std::cerr << "Error: Tile cache holds " << ui64Bytes << " bytes, more than its limit of "
+                    << ui64MaximumBytes << " bytes." << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        // The recently used tiles must not be evicted
+        const uint64_t ui64Misses = p_clCacheIO->GetTileCacheMisses();
+
+        if (!ReadPatch(p_clCacheIO, 0, clRecentRegion, vPixels))
+          return EXIT_FAILURE;
+
+        if (p_clCacheIO->GetTileCacheMisses() != ui64Misses)
+        {
+          std::cerr << "Error: Recently used tiles were evicted after reading region " << x << ", " << y << '.'
+                    << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        if (std::memcmp(&vRecent[0], &vPixels[0], vRecent.size() * sizeof(PixelType)) != 0)
+        {
+          std::cerr << "Error: Recently used region differs after reading region " << x << ", " << y << '.'
+                    << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+
+    std::cout << "Size limit: " << p_clCacheIO->GetTileCacheHits() << " hits, " << p_clCacheIO->GetTileCacheMisses()
+              << " misses, " << GetCacheBytes(strCacheDirectory) << " bytes" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "itkOpenSlideImageIO.h"
+#include "itkOpenSlideTiledImage.h"
+
+#define SPECIFIC_IMAGEIO_MODULE_TEST
+
+// Accesses random pixels and regions of a tiled image with a budget of a few tiles (from one and from several
+// threads) and compares them with the level image read at once. Also checks that a budget below one tile keeps one.
+int
+itkOpenSlideTestTiledImage(int argc, char * argv[])
+{
+  using TiledImageType = itk::OpenSlideTiledImage;
+  using PixelType = TiledImageType::PixelType;
+
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " slideFile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::SizeValueType tileSize = 128;
+  const itk::SizeValueType maxResidentTiles = 4;
+
+  itk::OpenSlideImageIO::Pointer p_clImageIO = itk::OpenSlideImageIO::New();
+  TiledImageType::Pointer        p_clTiledImage = TiledImageType::New();
+
+  p_clImageIO->SetFileName(argv[1]);
+  p_clTiledImage->SetImageIO(p_clImageIO);
+  p_clTiledImage->SetTileSize(tileSize);
+  p_clTiledImage->SetMemoryBudget(maxResidentTiles * tileSize * tileSize * sizeof(PixelType));
+
+  std::vector<PixelType>     vReference;
+  TiledImageType::RegionType clLargestRegion;
+
+  try
+  {
+    p_clTiledImage->Initialize();
+
+    clLargestRegion = p_clTiledImage->GetLargestPossibleRegion();
+    vReference.resize(clLargestRegion.GetNumberOfPixels());
+
+    itk::ImageIORegion clIORegion(2);
+    clIORegion.SetSize(0, clLargestRegion.GetSize(0));
+    clIORegion.SetSize(1, clLargestRegion.GetSize(1));
+    p_clImageIO->ReadRegion(p_clTiledImage->GetLevel(), clIORegion, &vReference[0]);
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const itk::SizeValueType width = clLargestRegion.GetSize(0);
+  const itk::SizeValueType height = clLargestRegion.GetSize(1);
+
+  std::cout << "Level dimensions = " << clLargestRegion.GetSize() << std::endl;
+
+  std::mt19937                                       clGenerator(42);
+  std::uniform_int_distribution<itk::SizeValueType> clXDistribution(0, width - 1);
+  std::uniform_int_distribution<itk::SizeValueType> clYDistribution(0, height - 1);
+
+  try
+  {
+    for (int i = 0; i < 10000; ++i)
+    {
+      TiledImageType::IndexType clIndex;
+      clIndex[0] = clXDistribution(clGenerator);
+      clIndex[1] = clYDistribution(clGenerator);
+
+      if (p_clTiledImage->GetPixel(clIndex) != vReference[clIndex[1] * width + clIndex[0]])
+      {
+        std::cerr << "Error: Pixel differs at " << clIndex << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      if (p_clTiledImage->GetNumberOfResidentTiles() > maxResidentTiles)
+      {
+        std::cerr << "Error: " << p_clTiledImage->GetNumberOfResidentTiles() << " tiles are resident." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    // Regions spanning several tiles
+    for (int i = 0; i < 20; ++i)
+    {
+      TiledImageType::RegionType clRegion;
+      clRegion.SetIndex(0, clXDistribution(clGenerator) / 2);
+      clRegion.SetIndex(1, clYDistribution(clGenerator) / 2);
+      clRegion.SetSize(0, std::min<itk::SizeValueType>(300, width - clRegion.GetIndex(0)));
+      clRegion.SetSize(1, std::min<itk::SizeValueType>(300, height - clRegion.GetIndex(1)));
+
+      TiledImageType::ImageType::Pointer p_clImage = p_clTiledImage->GetRegion(clRegion);
+
+      for (itk::SizeValueType y = 0; y < clRegion.GetSize(1); ++y)
+      {
+        if (std::memcmp(p_clImage->GetBufferPointer() + y * clRegion.GetSize(0),
+                        &vReference[(clRegion.GetIndex(1) + y) * width + clRegion.GetIndex(0)],
+                        clRegion.GetSize(0) * sizeof(PixelType)) != 0)
+        {
+          std::cerr << "Error: Region " << clRegion << " differs in row " << y << '.' << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Tile reads = " << p_clTiledImage->GetNumberOfTileReads() << std::endl;
+
+  // Random pixels from several threads
+  {
+    const unsigned int uiNumThreads = 4;
+    std::vector<int>   vFailures(uiNumThreads, 0);
+
+    std::vector<std::thread> vThreads;
+
+    for (unsigned int t = 0; t < uiNumThreads; ++t)
+    {
+      vThreads.push_back(std::thread([&, t]() {
+        std::mt19937 clThreadGenerator(t);
+
+        try
+        {
+          for (int i = 0; i < 10000; ++i)
+          {
+            TiledImageType::IndexType clIndex;
+            clIndex[0] = clXDistribution(clThreadGenerator);
+            clIndex[1] = clYDistribution(clThreadGenerator);
+
+            if (p_clTiledImage->GetPixel(clIndex) != vReference[clIndex[1] * width + clIndex[0]])
+              ++vFailures[t];
+          }
+        }
+        catch (itk::ExceptionObject &)
+        {
+          ++vFailures[t];
+        }
+      }));
+    }
+
+    for (std::thread & clThread : vThreads)
+      clThread.join();
+
+    for (unsigned int t = 0; t < uiNumThreads; ++t)
+    {
+      if (vFailures[t] != 0)
+      {
+        std::cerr << "Error: " << vFailures[t] << " pixels differ or failed in thread " << t << '.' << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (p_clTiledImage->GetNumberOfResidentTiles() > maxResidentTiles)
+    {
+      std::cerr << "Error: " << p_clTiledImage->GetNumberOfResidentTiles() << " tiles are resident." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // A budget below one tile keeps the last tile
+  try
+  {
+    p_clTiledImage->SetMemoryBudget(0);
+    p_clTiledImage->Initialize();
+
+    TiledImageType::RegionType clRegion;
+    clRegion.SetSize(0, std::min<itk::SizeValueType>(tileSize, width));
+    clRegion.SetSize(1, std::min<itk::SizeValueType>(tileSize, height));
+
+    std::vector<PixelType> vTile(clRegion.GetNumberOfPixels());
+    p_clTiledImage->ReadRegion(clRegion, &vTile[0]);
+    p_clTiledImage->ReadRegion(clRegion, &vTile[0]);
+
+    if (p_clTiledImage->GetNumberOfResidentTiles() != 1 || p_clTiledImage->GetNumberOfTileReads() != 1)
+    {
+      std::cerr << "Error: A budget below one tile left " << p_clTiledImage->GetNumberOfResidentTiles()
+                << " tiles resident after " << p_clTiledImage->GetNumberOfTileReads() << " reads." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch (itk::ExceptionObject & e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}